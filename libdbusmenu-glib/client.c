@@ -30,6 +30,7 @@ License version 3 and version 2.1 along with this program.  If not, see
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <gio/gio.h>
 
 #include "client.h"
@@ -46,6 +47,15 @@ License version 3 and version 2.1 along with this program.  If not, see
    sending the message on dbus */
 #define MAX_PROPERTIES_TO_QUEUE  100
 
+/* How long to wait after the server has taken a click for it
+   to confirm a predicted toggle before we put it back */
+#define PREDICTION_TIMEOUT  500
+
+/* The most a compressed reply can inflate to, which is as big as
+   a D-Bus message can be, and how much of it we read at a time */
+#define DECOMPRESS_LIMIT  (128 * 1024 * 1024)
+#define DECOMPRESS_CHUNK  (64 * 1024)
+
 /* Properties */
 enum {
 	PROP_0,
@@ -53,7 +63,13 @@ enum {
 	PROP_DBUSNAME,
 	PROP_STATUS,
 	PROP_TEXT_DIRECTION,
-	PROP_GROUP_EVENTS
+	PROP_GROUP_EVENTS,
+	PROP_DBUSCONNECTION,
+	PROP_OPTIMISTIC_TOGGLES,
+	PROP_HEAVY_PROPERTIES,
+	PROP_COMPRESSION,
+	PROP_WORKER_PARSING,
+	PROP_REPARENT_CHILDREN
 };
 
 /* Signals */
@@ -95,6 +111,7 @@ struct _DbusmenuClientPrivate
 
 	gint current_revision;
 	gint my_revision;
+	guint32 remote_version;
 
 	guint dbusproxy;
 
@@ -114,6 +131,28 @@ struct _DbusmenuClientPrivate
 
 	guint about_to_show_idle;
 	GQueue * about_to_show_to_go; /* type: about_to_show_t * */
+	GQueue * layout_waiters; /* type: about_to_show_t * */
+
+	gboolean optimistic_toggles;
+	guint prediction_serial;
+	GList * predictions; /* type: prediction_t * */
+
+	GStrv heavy_properties;
+	GHashTable * heavy_shown; /* parents whose children have them */
+	GHashTable * heavy_pending; /* items still waiting for them */
+
+	gboolean compression;
+
+	gboolean worker_parsing;
+	gboolean worker_busy; /* A layout is out on the worker */
+	GVariant * worker_snapshot; /* The last full layout we applied, if the items still match it */
+	GQueue * worker_held; /* type: GVariant * (sv), signals from while busy */
+
+	gboolean reparent_children;
+
+	GHashTable * parse_items; /* every item we had, by ID, while parsing */
+	GHashTable * parse_leftovers; /* items no longer under their parent */
+	gboolean parse_changes; /* parsing layouts that come with their property changes */
 };
 
 typedef struct _newItemPropData newItemPropData;
@@ -130,6 +169,7 @@ struct _properties_listener_t {
 	properties_func callback;
 	gpointer user_data;
 	gboolean replied;
+	gboolean light;
 };
 
 typedef struct _event_data_t event_data_t;
@@ -140,6 +180,19 @@ struct _event_data_t {
 	gchar * event;
 	GVariant * variant;
 	guint timestamp;
+	guint prediction;
+};
+
+typedef struct _prediction_t prediction_t;
+struct _prediction_t {
+	guint serial;
+	DbusmenuClient * client;
+	DbusmenuMenuitem * item;
+	const gchar * property;
+	GVariant * original;
+	GVariant * predicted;
+	guint pending;
+	guint timeout;
 };
 
 typedef struct _type_handler_t type_handler_t;
@@ -157,6 +210,25 @@ struct _properties_callback_t {
 	GArray * listeners;
 };
 
+/* A full layout going to the worker to be compared with the one
+   we have, and coming back with what changed */
+typedef struct _worker_job_t worker_job_t;
+struct _worker_job_t {
+	DbusmenuClient * client;
+	GMainContext * context; /* Where to come back to */
+	GCancellable * cancel;
+	GVariant * reply;
+	GVariant * snapshot;
+	/* Filled in on the worker */
+	GError * error;
+	guint revision;
+	GVariant * layout;
+	GVariant * changes; /* a(ia{sv}av), NULL to parse the whole layout */
+	GVariant * updated; /* a(ia{sv}) */
+	GVariant * removed; /* a(ias) */
+	GHashTable * kept; /* IDs from the old layout that are still there */
+};
+
 
 #define DBUSMENU_CLIENT_GET_PRIVATE(o) (DBUSMENU_CLIENT(o)->priv)
 #define DBUSMENU_INTERFACE  "com.canonical.dbusmenu"
@@ -164,6 +236,7 @@ struct _properties_callback_t {
 /* GObject Stuff */
 static void dbusmenu_client_class_init (DbusmenuClientClass *klass);
 static void dbusmenu_client_init       (DbusmenuClient *self);
+static void dbusmenu_client_constructed (GObject *object);
 static void dbusmenu_client_dispose    (GObject *object);
 static void dbusmenu_client_finalize   (GObject *object);
 static void set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec);
@@ -173,12 +246,17 @@ static void layout_update (GDBusProxy * proxy, guint revision, gint parent, Dbus
 static void id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client);
 static void id_update (GDBusProxy * proxy, gint id, DbusmenuClient * client);
 static void build_proxies (DbusmenuClient * client);
+static gboolean connection_is_peer (DbusmenuClient * client);
+static gboolean menuproxy_has_owner (DbusmenuClient * client);
 static DbusmenuMenuitem * parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem * item, DbusmenuMenuitem * parent, GDBusProxy * proxy);
 static gint parse_layout (DbusmenuClient * client, GVariant * layout);
 static void update_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data);
 static void update_layout (DbusmenuClient * client);
+static void get_layout (DbusmenuClient * client);
+static void update_changes_cb (GObject * proxy, GAsyncResult * res, gpointer data);
+static void items_properties_updated (DbusmenuClient * client, GDBusProxy * proxy, GVariant * updated, GVariant * removed);
 static void menuitem_get_properties_cb (GVariant * properties, GError * error, gpointer data);
-static void get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, properties_func callback, gpointer user_data);
+static void get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, gboolean light, properties_func callback, gpointer user_data);
 static GQuark error_domain (void);
 static void item_activated (GDBusProxy * proxy, gint id, guint timestamp, DbusmenuClient * client);
 static void menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer user_data);
@@ -188,6 +266,13 @@ static void menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * sig
 static void type_handler_destroy (gpointer user_data);
 static void event_data_end (event_data_t * eventd, GError * error);
 static void about_to_show_finish_pntr (gpointer data, gpointer user_data);
+static void layout_waiters_flush (DbusmenuClient * client);
+static void prediction_free (gpointer data);
+static void prediction_settle (DbusmenuClient * client, DbusmenuMenuitem * item, const gchar * property);
+static void worker_ref (void);
+static void worker_unref (void);
+static void worker_held_free (gpointer data);
+static void worker_snapshot_drop (DbusmenuClient * client);
 
 /* Globals */
 static GDBusNodeInfo *            dbusmenu_node_info = NULL;
@@ -203,6 +288,7 @@ dbusmenu_client_class_init (DbusmenuClientClass *klass)
 
 	g_type_class_add_private (klass, sizeof (DbusmenuClientPrivate));
 
+	object_class->constructed = dbusmenu_client_constructed;
 	object_class->dispose = dbusmenu_client_dispose;
 	object_class->finalize = dbusmenu_client_finalize;
 	object_class->set_property = set_property;
@@ -330,6 +416,31 @@ dbusmenu_client_class_init (DbusmenuClientClass *klass)
 	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_GROUP_EVENTS, "Whether or not multiple events should be grouped",
 	                                              "Event grouping lowers the number of messages on DBus and will be set automatically based on the version to optimize traffic.  It can be disabled for testing or other purposes.",
 	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_DBUSCONNECTION,
+	                                 g_param_spec_object(DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, "DBus connection to use",
+	                                              "The connection to find the server on.  If not set the session bus is used.",
+	                                              G_TYPE_DBUS_CONNECTION,
+	                                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_OPTIMISTIC_TOGGLES,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_OPTIMISTIC_TOGGLES, "Whether toggles change before the server confirms them",
+	                                              "Flips the toggle state of check and radio items as soon as they are clicked instead of waiting for the server to send the new state.  If the server doesn't follow up with it the old state is put back.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_HEAVY_PROPERTIES,
+	                                 g_param_spec_boxed(DBUSMENU_CLIENT_PROP_HEAVY_PROPERTIES, "Properties to get when they're needed",
+	                                              "Properties that are expensive to send, like icons.  They are left out when fetching the items in a submenu and all fetched together when the submenu is about to be shown.  Only servers that support leaving out properties are asked to.  An empty list gets everything up front.",
+	                                              G_TYPE_STRV, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_COMPRESSION,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_COMPRESSION, "Whether large replies can be compressed",
+	                                              "Asks servers that support it to compress large layouts and property lists.  Saves copying megabytes of icons through the bus for a bit of CPU time on both sides, so it's worth turning on for menus with a lot of pixbuf icons.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_WORKER_PARSING,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_WORKER_PARSING, "Whether full layouts are handled on a worker thread",
+	                                              "Unpacks full layouts on a worker thread and compares them there with the last one, so that only the parts that changed are applied to the items in the main context.  Signals from the server are held back while a layout is out so they still apply in order.  Each client keeps its last full layout in memory to compare with, which is the whole tree but only the few properties a layout asks for, unless the server sends them all.  The rest of the properties of the items that are kept are fetched again, like they are when a layout is applied whole.  It's dropped when the items change some other way and the next layout is then applied whole.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_REPARENT_CHILDREN,
+	                                 g_param_spec_boolean(DBUSMENU_CLIENT_PROP_REPARENT_CHILDREN, "Whether items that change parents are moved",
+	                                              "Moves an item that the server put under a different parent, along with its children, and signals it with DbusmenuMenuitem::child-reparented.  Otherwise it is removed from the old parent and built again under the new one, which is all code that only handles child-removed and child-added can follow.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
 	if (dbusmenu_node_info == NULL) {
 		GError * error = NULL;
@@ -387,6 +498,7 @@ dbusmenu_client_init (DbusmenuClient *self)
 
 	priv->current_revision = 0;
 	priv->my_revision = 0;
+	priv->remote_version = 0;
 
 	priv->dbusproxy = 0;
 
@@ -407,6 +519,47 @@ dbusmenu_client_init (DbusmenuClient *self)
 
 	priv->about_to_show_idle = 0;
 	priv->about_to_show_to_go = NULL;
+	priv->layout_waiters = NULL;
+
+	priv->optimistic_toggles = FALSE;
+	priv->prediction_serial = 0;
+	priv->predictions = NULL;
+
+	const gchar * heavy_properties[] = { DBUSMENU_MENUITEM_PROP_ICON_DATA, NULL };
+	priv->heavy_properties = g_strdupv((gchar **)heavy_properties);
+	priv->heavy_shown = g_hash_table_new(g_direct_hash, g_direct_equal);
+	priv->heavy_pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	priv->compression = FALSE;
+
+	priv->worker_parsing = FALSE;
+	priv->worker_busy = FALSE;
+	priv->worker_snapshot = NULL;
+	priv->worker_held = NULL;
+
+	priv->reparent_children = FALSE;
+
+	priv->parse_items = NULL;
+	priv->parse_leftovers = NULL;
+	priv->parse_changes = FALSE;
+
+	return;
+}
+
+/* With all the construct properties set we can start looking
+   for the server.  A peer connection doesn't need a name. */
+static void
+dbusmenu_client_constructed (GObject *object)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(object);
+
+	if (priv->dbus_object != NULL && (priv->dbus_name != NULL || connection_is_peer(DBUSMENU_CLIENT(object)))) {
+		build_proxies(DBUSMENU_CLIENT(object));
+	}
+
+	if (G_OBJECT_CLASS (dbusmenu_client_parent_class)->constructed != NULL) {
+		G_OBJECT_CLASS (dbusmenu_client_parent_class)->constructed (object);
+	}
 
 	return;
 }
@@ -447,6 +600,11 @@ dbusmenu_client_dispose (GObject *object)
 		priv->about_to_show_to_go = NULL;
 	}
 
+	if (priv->predictions != NULL) {
+		g_list_free_full(priv->predictions, prediction_free);
+		priv->predictions = NULL;
+	}
+
 	/* Only used for queueing up a new command, so we can
 	   just drop this array. */
 	if (priv->delayed_property_list != NULL) {
@@ -486,6 +644,8 @@ dbusmenu_client_dispose (GObject *object)
 		priv->layoutcall = NULL;
 	}
 
+	layout_waiters_flush(DBUSMENU_CLIENT(object));
+
 	if (priv->layout_props != NULL) {
 		g_variant_unref(priv->layout_props);
 		priv->layout_props = NULL;
@@ -528,6 +688,19 @@ dbusmenu_client_dispose (GObject *object)
 		priv->root = NULL;
 	}
 
+	if (priv->worker_snapshot != NULL) {
+		g_variant_unref(priv->worker_snapshot);
+		priv->worker_snapshot = NULL;
+	}
+	if (priv->worker_held != NULL) {
+		g_queue_free_full(priv->worker_held, worker_held_free);
+		priv->worker_held = NULL;
+	}
+	if (priv->worker_parsing) {
+		priv->worker_parsing = FALSE;
+		worker_unref();
+	}
+
 	G_OBJECT_CLASS (dbusmenu_client_parent_class)->dispose (object);
 	return;
 }
@@ -549,6 +722,10 @@ dbusmenu_client_finalize (GObject *object)
 		priv->icon_dirs = NULL;
 	}
 
+	g_strfreev(priv->heavy_properties);
+	g_hash_table_destroy(priv->heavy_shown);
+	g_hash_table_destroy(priv->heavy_pending);
+
 	G_OBJECT_CLASS (dbusmenu_client_parent_class)->finalize (object);
 	return;
 }
@@ -563,21 +740,43 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 		g_return_if_fail(g_dbus_is_name(g_value_get_string(value)));
 
 		priv->dbus_name = g_value_dup_string(value);
-		if (priv->dbus_name != NULL && priv->dbus_object != NULL) {
-			build_proxies(DBUSMENU_CLIENT(obj));
-		}
 		break;
 	case PROP_DBUSOBJECT:
 		g_return_if_fail(g_variant_is_object_path(g_value_get_string(value)));
 
 		priv->dbus_object = g_value_dup_string(value);
-		if (priv->dbus_name != NULL && priv->dbus_object != NULL) {
-			build_proxies(DBUSMENU_CLIENT(obj));
-		}
+		break;
+	case PROP_DBUSCONNECTION:
+		g_return_if_fail(priv->session_bus == NULL);
+		priv->session_bus = g_value_dup_object(value);
 		break;
 	case PROP_GROUP_EVENTS:
 		priv->group_events = g_value_get_boolean(value);
 		break;
+	case PROP_OPTIMISTIC_TOGGLES:
+		priv->optimistic_toggles = g_value_get_boolean(value);
+		break;
+	case PROP_HEAVY_PROPERTIES:
+		g_strfreev(priv->heavy_properties);
+		priv->heavy_properties = g_value_dup_boxed(value);
+		break;
+	case PROP_COMPRESSION:
+		priv->compression = g_value_get_boolean(value);
+		break;
+	case PROP_WORKER_PARSING:
+		if (g_value_get_boolean(value) && !priv->worker_parsing) {
+			worker_ref();
+		} else if (!g_value_get_boolean(value) && priv->worker_parsing) {
+			worker_unref();
+
+			/* Layouts won't be kept up to date with the items */
+			worker_snapshot_drop(DBUSMENU_CLIENT(obj));
+		}
+		priv->worker_parsing = g_value_get_boolean(value);
+		break;
+	case PROP_REPARENT_CHILDREN:
+		priv->reparent_children = g_value_get_boolean(value);
+		break;
 	default:
 		g_warning("Unknown property %d.", id);
 		return;
@@ -607,6 +806,24 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 	case PROP_GROUP_EVENTS:
 		g_value_set_boolean(value, priv->group_events);
 		break;
+	case PROP_DBUSCONNECTION:
+		g_value_set_object(value, priv->session_bus);
+		break;
+	case PROP_OPTIMISTIC_TOGGLES:
+		g_value_set_boolean(value, priv->optimistic_toggles);
+		break;
+	case PROP_HEAVY_PROPERTIES:
+		g_value_set_boxed(value, priv->heavy_properties);
+		break;
+	case PROP_COMPRESSION:
+		g_value_set_boolean(value, priv->compression);
+		break;
+	case PROP_WORKER_PARSING:
+		g_value_set_boolean(value, priv->worker_parsing);
+		break;
+	case PROP_REPARENT_CHILDREN:
+		g_value_set_boolean(value, priv->reparent_children);
+		break;
 	default:
 		g_warning("Unknown property %d.", id);
 		return;
@@ -627,6 +844,236 @@ error_domain (void)
 	return error;
 }
 
+/* Calls one of the methods with big replies, through GetCompressed
+   if the server has it.  The reply needs large_call_finish(). */
+static void
+large_call (DbusmenuClient * client, const gchar * method, GVariant * params, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->compression && priv->remote_version >= 6) {
+		const gchar * encodings[] = { "zlib", NULL };
+		params = g_variant_new("(s@v^as)", method, g_variant_new_variant(params), encodings);
+		method = "GetCompressed";
+	}
+
+	g_dbus_proxy_call(priv->menuproxy,
+	                  method,
+	                  params,
+	                  G_DBUS_CALL_FLAGS_NONE,
+	                  -1,   /* timeout */
+	                  cancellable,
+	                  callback,
+	                  user_data);
+
+	return;
+}
+
+/* Inflates zlib @data into a new buffer of @size bytes.  Data that
+   inflates to more than DECOMPRESS_LIMIT is an error. */
+static gpointer
+reply_decompress (GVariant * data, gsize * size, GError ** error)
+{
+	GConverter * decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+	GInputStream * memory = g_memory_input_stream_new_from_data(g_variant_get_data(data), g_variant_get_size(data), NULL);
+	GInputStream * stream = g_converter_input_stream_new(memory, decompressor);
+	GByteArray * inflated = g_byte_array_new();
+	gboolean failed = FALSE;
+
+	while (TRUE) {
+		guint offset = inflated->len;
+		g_byte_array_set_size(inflated, offset + DECOMPRESS_CHUNK);
+
+		gssize count = g_input_stream_read(stream, inflated->data + offset, DECOMPRESS_CHUNK, NULL, error);
+		if (count < 0) {
+			failed = TRUE;
+			break;
+		}
+
+		g_byte_array_set_size(inflated, offset + count);
+		if (count == 0) {
+			break;
+		}
+
+		if (inflated->len > DECOMPRESS_LIMIT) {
+			g_set_error(error, error_domain(), 0, "Reply inflates to more than %d bytes", DECOMPRESS_LIMIT);
+			failed = TRUE;
+			break;
+		}
+	}
+
+	g_object_unref(stream);
+	g_object_unref(memory);
+	g_object_unref(decompressor);
+
+	if (failed) {
+		g_byte_array_free(inflated, TRUE);
+		return NULL;
+	}
+
+	*size = inflated->len;
+	return g_byte_array_free(inflated, FALSE);
+}
+
+/* Turns a reply to large_call() into the @type it would have been
+   if it hadn't gone through GetCompressed.  Takes the reply, and
+   doesn't touch the client so it can be done on the worker. */
+static GVariant *
+large_reply_unwrap (GVariant * reply, const gchar * type, GError ** error)
+{
+	if (!g_variant_is_of_type(reply, G_VARIANT_TYPE("(say)"))) {
+		return reply;
+	}
+
+	const gchar * encoding;
+	GVariant * data;
+	gpointer bytes = NULL;
+	gsize size = 0;
+	GError * local_error = NULL;
+
+	g_variant_get(reply, "(&s@ay)", &encoding, &data);
+
+	if (encoding[0] == '\0') {
+		/* Copied so that it's lined up for the type */
+		size = g_variant_get_size(data);
+		bytes = g_malloc(size);
+		memcpy(bytes, g_variant_get_data(data), size);
+	} else if (g_strcmp0(encoding, "zlib") == 0) {
+		bytes = reply_decompress(data, &size, &local_error);
+	} else {
+		g_set_error(&local_error, error_domain(), 0, "Reply in an unknown encoding '%s'", encoding);
+	}
+
+	GVariant * retval = NULL;
+	if (local_error == NULL) {
+		retval = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(type), bytes, size, FALSE, g_free, bytes));
+
+		if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+			GVariant * swapped = g_variant_byteswap(retval);
+			g_variant_unref(retval);
+			retval = swapped;
+		}
+	} else {
+		g_propagate_error(error, local_error);
+	}
+
+	g_variant_unref(data);
+	g_variant_unref(reply);
+
+	return retval;
+}
+
+/* Gets the reply from large_call() as the @type it would have
+   been if it hadn't gone through GetCompressed */
+static GVariant *
+large_call_finish (GObject * proxy, GAsyncResult * res, const gchar * type, GError ** error)
+{
+	GVariant * reply = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, error);
+
+	if (reply == NULL) {
+		return NULL;
+	}
+
+	return large_reply_unwrap(reply, type, error);
+}
+
+/* The thread that full layouts are unpacked and compared on, shared
+   by all of the clients that have worker-parsing set */
+static GMutex worker_lock;
+static GThread * worker_thread = NULL;
+static GMainContext * worker_context = NULL;
+static GMainLoop * worker_loop = NULL;
+static guint worker_users = 0;
+
+/* Runs the loop it's given, which it has a reference to, so the
+   thread can be let go of and finish on its own */
+static gpointer
+worker_main (gpointer user_data)
+{
+	GMainLoop * loop = (GMainLoop *)user_data;
+	GMainContext * context = g_main_loop_get_context(loop);
+
+	g_main_context_push_thread_default(context);
+	g_main_loop_run(loop);
+	g_main_context_pop_thread_default(context);
+
+	g_main_loop_unref(loop);
+	return NULL;
+}
+
+static gboolean
+worker_quit (gpointer user_data)
+{
+	g_main_loop_quit((GMainLoop *)user_data);
+	return FALSE;
+}
+
+static void
+worker_ref (void)
+{
+	g_mutex_lock(&worker_lock);
+
+	if (worker_users++ == 0) {
+		worker_context = g_main_context_new();
+		worker_loop = g_main_loop_new(worker_context, FALSE);
+		worker_thread = g_thread_new("dbusmenu-client", worker_main, g_main_loop_ref(worker_loop));
+	}
+
+	g_mutex_unlock(&worker_lock);
+	return;
+}
+
+/* The last one out doesn't wait for the worker.  It stops once
+   it's done with the jobs that are already on it, which still come
+   back to their client's context, and new ones are done in place
+   until there's a worker again. */
+static void
+worker_unref (void)
+{
+	g_mutex_lock(&worker_lock);
+
+	if (--worker_users == 0) {
+		GSource * quit = g_idle_source_new();
+		g_source_set_priority(quit, G_PRIORITY_LOW);
+		g_source_set_callback(quit, worker_quit, worker_loop, (GDestroyNotify)g_main_loop_unref);
+		g_source_attach(quit, worker_context);
+		g_source_unref(quit);
+		worker_loop = NULL;
+
+		g_thread_unref(worker_thread);
+		worker_thread = NULL;
+		g_main_context_unref(worker_context);
+		worker_context = NULL;
+	}
+
+	g_mutex_unlock(&worker_lock);
+	return;
+}
+
+static void
+worker_held_free (gpointer data)
+{
+	g_variant_unref((GVariant *)data);
+	return;
+}
+
+/* Something other than a full layout changed the items, so the last
+   one can't be used to tell what's new in the next anymore.  A layout
+   that's out on the worker is compared with the old one, so it gets
+   parsed whole when it comes back. */
+static void
+worker_snapshot_drop (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->worker_snapshot != NULL) {
+		g_variant_unref(priv->worker_snapshot);
+		priv->worker_snapshot = NULL;
+	}
+
+	return;
+}
+
 /* Quick little function to search through the listeners and find
    one that matches an ID */
 static properties_listener_t *
@@ -655,7 +1102,7 @@ get_properties_callback (GObject *obj, GAsyncResult * res, gpointer user_data)
 	GError * error = NULL;
 	GVariant * params = NULL;
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(obj), res, &error);
+	params = large_call_finish(obj, res, "(a(ia{sv}))", &error);
 
 	if (error != NULL) {
 		/* If we get an error, all our callbacks need to hear about it. */
@@ -733,36 +1180,37 @@ get_properties_callback (GObject *obj, GAsyncResult * res, gpointer user_data)
 	return;
 }
 
-/* Idle handler to send out all of our property requests as one big
-   lovely property request. */
-static gboolean
-get_properties_idle (gpointer user_data)
+/* Sends one property request for the items in @listeners, leaving
+   out the heavy properties if @light */
+static void
+get_properties_send (DbusmenuClient * client, GArray * listeners, gboolean light)
 {
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 	properties_callback_t * cbdata = NULL;
-	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
-	g_return_val_if_fail(priv->menuproxy != NULL, TRUE);
-
-	if (priv->delayed_property_listeners->len == 0) {
-		g_warning("Odd, idle func got no listeners.");
-		return FALSE;
-	}
 
 	/* Build up an ID list to pass */
 	GVariantBuilder builder;
 	g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
 
 	gint i;
-	for (i = 0; i < priv->delayed_property_listeners->len; i++) {
-		g_variant_builder_add(&builder, "i", g_array_index(priv->delayed_property_listeners, properties_listener_t, i).id);
+	for (i = 0; i < listeners->len; i++) {
+		g_variant_builder_add(&builder, "i", g_array_index(listeners, properties_listener_t, i).id);
 	}
 
 	GVariant * variant_ids = g_variant_builder_end(&builder);
 
-	/* Build up a prop list to pass */
+	/* Build up a prop list to pass, the names of the ones to
+	   leave out start with a '-' */
 	GVariantType * type = g_variant_type_new("as");
 	g_variant_builder_init(&builder, type);
 	g_variant_type_free(type);
-	/* TODO: need to use delayed property list here */
+	if (light) {
+		for (i = 0; priv->heavy_properties[i] != NULL; i++) {
+			gchar * exclude = g_strconcat("-", priv->heavy_properties[i], NULL);
+			g_variant_builder_add(&builder, "s", exclude);
+			g_free(exclude);
+		}
+	}
 	GVariant * variant_props = g_variant_builder_end(&builder);
 
 	/* Combine them into a value for the parameter */
@@ -772,18 +1220,52 @@ get_properties_idle (gpointer user_data)
 	GVariant * variant_params = g_variant_builder_end(&builder);
 
 	cbdata = g_new(properties_callback_t, 1);
-	cbdata->listeners = priv->delayed_property_listeners;
-	cbdata->client = DBUSMENU_CLIENT(user_data);
-	g_object_ref(G_OBJECT(user_data));
+	cbdata->listeners = listeners;
+	cbdata->client = client;
+	g_object_ref(G_OBJECT(client));
 
-	g_dbus_proxy_call(priv->menuproxy,
-	                  "GetGroupProperties",
-	                  variant_params,
-	                  G_DBUS_CALL_FLAGS_NONE,
-	                  -1,   /* timeout */
-	                  NULL, /* cancellable */
-	                  get_properties_callback,
-	                  cbdata);
+	large_call(client, "GetGroupProperties", variant_params, NULL, get_properties_callback, cbdata);
+
+	return;
+}
+
+/* Idle handler to send out all of our property requests as one big
+   lovely property request.  Or two if some of the items can wait
+   for their heavy properties. */
+static gboolean
+get_properties_idle (gpointer user_data)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(user_data);
+	g_return_val_if_fail(priv->menuproxy != NULL, TRUE);
+
+	if (priv->delayed_property_listeners->len == 0) {
+		g_warning("Odd, idle func got no listeners.");
+		return FALSE;
+	}
+
+	GArray * full = priv->delayed_property_listeners;
+	GArray * light = g_array_new(FALSE, FALSE, sizeof(properties_listener_t));
+
+	gint i;
+	for (i = full->len - 1; i >= 0; i--) {
+		properties_listener_t * listener = &g_array_index(full, properties_listener_t, i);
+		if (listener->light) {
+			g_array_prepend_val(light, *listener);
+			g_array_remove_index(full, i);
+		}
+	}
+
+	if (full->len > 0) {
+		get_properties_send(DBUSMENU_CLIENT(user_data), full, FALSE);
+	} else {
+		g_array_free(full, TRUE);
+	}
+
+	if (light->len > 0) {
+		get_properties_send(DBUSMENU_CLIENT(user_data), light, TRUE);
+	} else {
+		g_array_free(light, TRUE);
+	}
 
 	/* Free properties */
 	gchar ** dataregion = (gchar **)g_array_free(priv->delayed_property_list, FALSE);
@@ -823,7 +1305,7 @@ get_properties_flush (DbusmenuClient * client)
 /* A function to group all the get_properties commands to make them
    more efficient over dbus. */
 static void
-get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, properties_func callback, gpointer user_data)
+get_properties_globber (DbusmenuClient * client, gint id, const gchar ** properties, gboolean light, properties_func callback, gpointer user_data)
 {
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 	if (find_listener(priv->delayed_property_listeners, 0, id) != NULL) {
@@ -857,6 +1339,7 @@ get_properties_globber (DbusmenuClient * client, gint id, const gchar ** propert
 	listener.callback = callback;
 	listener.user_data = user_data;
 	listener.replied = FALSE;
+	listener.light = light;
 
 	g_array_append_val(priv->delayed_property_listeners, listener);
 
@@ -874,60 +1357,211 @@ get_properties_globber (DbusmenuClient * client, gint id, const gchar ** propert
 	return;
 }
 
-/* Called when a server item wants to activate the menu */
-static void
-item_activated (GDBusProxy * proxy, gint id, guint timestamp, DbusmenuClient * client)
+/* Whether @property is one that we put off getting */
+static gboolean
+heavy_property (DbusmenuClient * client, const gchar * property)
 {
-	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	gint i;
+
+	for (i = 0; priv->heavy_properties != NULL && priv->heavy_properties[i] != NULL; i++) {
+		if (g_strcmp0(priv->heavy_properties[i], property) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
 
+/* Whether @item can be fetched without its heavy properties because
+   its parent hasn't been shown yet.  The items at the top level are
+   always shown, so they get everything.  If so the item is noted so
+   they get fetched when the parent is about to be shown. */
+static gboolean
+heavy_defer (DbusmenuClient * client, DbusmenuMenuitem * item, DbusmenuMenuitem * parent)
+{
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	if (priv->root == NULL) {
-		g_warning("Asked to activate item %d when we don't have a menu structure.", id);
-		return;
+	if (priv->heavy_properties == NULL || priv->heavy_properties[0] == NULL) {
+		return FALSE;
 	}
 
-	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
-	if (menuitem == NULL) {
-		g_warning("Unable to find menu item %d to activate.", id);
-		return;
+	/* Older servers send everything whatever we ask for */
+	if (priv->remote_version < 5) {
+		return FALSE;
 	}
 
-	g_signal_emit(G_OBJECT(client), signals[ITEM_ACTIVATE], 0, menuitem, timestamp, TRUE);
+	if (parent == NULL || dbusmenu_menuitem_get_root(parent)) {
+		return FALSE;
+	}
 
-	return;
+	if (g_hash_table_contains(priv->heavy_shown, GINT_TO_POINTER(dbusmenu_menuitem_get_id(parent)))) {
+		return FALSE;
+	}
+
+	g_hash_table_add(priv->heavy_pending, GINT_TO_POINTER(dbusmenu_menuitem_get_id(item)));
+	return TRUE;
 }
 
-/* Annoying little wrapper to make the right function update */
+/* Sets the heavy properties on the items that were waiting for them */
 static void
-layout_update (GDBusProxy * proxy, guint revision, gint parent, DbusmenuClient * client)
+heavy_load_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
 {
+	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
-	priv->current_revision = revision;
-	if (priv->current_revision > priv->my_revision) {
-		update_layout(client);
+	GError * error = NULL;
+
+	GVariant * params = large_call_finish(proxy, res, "(a(ia{sv}))", &error);
+
+	if (error != NULL) {
+		g_warning("Unable to get heavy properties: %s", error->message);
+		g_error_free(error);
+		g_object_unref(client);
+		return;
+	}
+
+	if (priv->root != NULL) {
+		GVariantIter * iter;
+		gint id;
+		GVariant * properties;
+
+		worker_snapshot_drop(client);
+
+		g_variant_get(params, "(a(ia{sv}))", &iter);
+		while (g_variant_iter_loop(iter, "(i@a{sv})", &id, &properties)) {
+			DbusmenuMenuitem * item = dbusmenu_menuitem_find_id(priv->root, id);
+			if (item == NULL) {
+				continue;
+			}
+
+			g_object_ref(item);
+			menuitem_get_properties_cb(properties, NULL, item);
+		}
+		g_variant_iter_free(iter);
 	}
+
+	g_variant_unref(params);
+	g_object_unref(client);
 	return;
 }
 
-/* Signal from the server that a property has changed
-   on one of our menuitems */
+/* The item @id is about to be shown, so its children need their
+   heavy properties.  Gets them all in one request. */
 static void
-id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client)
+heavy_load (DbusmenuClient * client, gint id)
 {
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
-	g_return_if_fail(priv->root != NULL);
+	if (priv->heavy_properties == NULL || priv->heavy_properties[0] == NULL) {
+		return;
+	}
 
-	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
-	if (menuitem == NULL) {
+	if (!g_hash_table_add(priv->heavy_shown, GINT_TO_POINTER(id))) {
+		return;
+	}
+
+	if (priv->root == NULL || priv->menuproxy == NULL) {
+		return;
+	}
+
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_find_id(priv->root, id);
+	if (parent == NULL) {
+		return;
+	}
+
+	/* Light requests that are still queued need to go first so that
+	   their replies don't land after the heavy properties */
+	get_properties_flush(client);
+
+	GVariantBuilder builder;
+	gboolean builder_init = FALSE;
+	GList * child;
+
+	for (child = dbusmenu_menuitem_get_children(parent); child != NULL; child = g_list_next(child)) {
+		gint childid = dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(child->data));
+		if (!g_hash_table_remove(priv->heavy_pending, GINT_TO_POINTER(childid))) {
+			continue;
+		}
+
+		if (!builder_init) {
+			g_variant_builder_init(&builder, G_VARIANT_TYPE("ai"));
+			builder_init = TRUE;
+		}
+		g_variant_builder_add(&builder, "i", childid);
+	}
+
+	if (!builder_init) {
+		return;
+	}
+
+	GVariant * ids = g_variant_builder_end(&builder);
+
+	large_call(client,
+	           "GetGroupProperties",
+	           g_variant_new("(@ai^as)", ids, priv->heavy_properties),
+	           NULL, /* cancellable */
+	           heavy_load_cb,
+	           g_object_ref(client));
+
+	return;
+}
+
+/* Called when a server item wants to activate the menu */
+static void
+item_activated (GDBusProxy * proxy, gint id, guint timestamp, DbusmenuClient * client)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->root == NULL) {
+		g_warning("Asked to activate item %d when we don't have a menu structure.", id);
+		return;
+	}
+
+	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
+	if (menuitem == NULL) {
+		g_warning("Unable to find menu item %d to activate.", id);
+		return;
+	}
+
+	g_signal_emit(G_OBJECT(client), signals[ITEM_ACTIVATE], 0, menuitem, timestamp, TRUE);
+
+	return;
+}
+
+/* Annoying little wrapper to make the right function update */
+static void
+layout_update (GDBusProxy * proxy, guint revision, gint parent, DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	priv->current_revision = revision;
+	if (priv->current_revision > priv->my_revision) {
+		update_layout(client);
+	}
+	return;
+}
+
+/* Signal from the server that a property has changed
+   on one of our menuitems */
+static void
+id_prop_update (GDBusProxy * proxy, gint id, gchar * property, GVariant * value, DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	g_return_if_fail(priv->root != NULL);
+
+	DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
+	if (menuitem == NULL) {
 		#ifdef MASSIVEDEBUGGING
 		g_debug("Property update '%s' on id %d which couldn't be found", property, id);
 		#endif
 		return;
 	}
 
+	prediction_settle(client, menuitem, property);
 	dbusmenu_menuitem_property_set_variant(menuitem, property, value);
+	worker_snapshot_drop(client);
 
 	return;
 }
@@ -948,8 +1582,9 @@ id_update (GDBusProxy * proxy, gint id, DbusmenuClient * client)
 	g_return_if_fail(menuitem != NULL);
 
 	g_debug("Getting properties");
+	worker_snapshot_drop(client);
 	g_object_ref(menuitem);
-	get_properties_globber(client, id, NULL, menuitem_get_properties_cb, menuitem);
+	get_properties_globber(client, id, NULL, heavy_defer(client, menuitem, dbusmenu_menuitem_get_parent(menuitem)), menuitem_get_properties_cb, menuitem);
 	return;
 }
 
@@ -977,6 +1612,11 @@ build_dbus_proxy (DbusmenuClient * client)
 		return;
 	}
 
+	/* Nobody else can own a name on a peer connection */
+	if (connection_is_peer(client)) {
+		return;
+	}
+
 	priv->dbusproxy = g_bus_watch_name_on_connection(priv->session_bus,
 	                                                 priv->dbus_name,
 	                                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
@@ -1021,6 +1661,8 @@ proxy_destroyed (GObject * gobj_proxy, gpointer userdata)
 	priv->current_revision = 0;
 	priv->my_revision = 0;
 
+	worker_snapshot_drop(DBUSMENU_CLIENT(userdata));
+
 	build_dbus_proxy(DBUSMENU_CLIENT(userdata));
 	return;
 }
@@ -1065,7 +1707,7 @@ build_proxies (DbusmenuClient * client)
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
 	g_return_if_fail(priv->dbus_object != NULL);
-	g_return_if_fail(priv->dbus_name != NULL);
+	g_return_if_fail(priv->dbus_name != NULL || connection_is_peer(client));
 
 	if (priv->session_bus == NULL) {
 		/* We don't have the session bus yet, that's okay, but
@@ -1094,7 +1736,7 @@ build_proxies (DbusmenuClient * client)
 			g_dbus_proxy_new(priv->session_bus,
 			                 G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
 			                 dbusmenu_interface_info,
-			                 priv->dbus_name,
+			                 connection_is_peer(client) ? NULL : priv->dbus_name,
 			                 priv->dbus_object,
 			                 DBUSMENU_INTERFACE,
 			                 priv->menuproxy_cancel,
@@ -1106,6 +1748,45 @@ build_proxies (DbusmenuClient * client)
 	return;
 }
 
+/* A connection without a unique name isn't talking to a bus
+   daemon, it's directly connected to the server. */
+static gboolean
+connection_is_peer (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->session_bus == NULL) {
+		return FALSE;
+	}
+
+	return g_dbus_connection_get_unique_name(priv->session_bus) == NULL;
+}
+
+/* Checks whether there is someone on the other side of the menu
+   proxy.  Peer connections don't track owners, if we have a proxy
+   we've got a server. */
+static gboolean
+menuproxy_has_owner (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->menuproxy == NULL) {
+		return FALSE;
+	}
+
+	if (connection_is_peer(client)) {
+		return TRUE;
+	}
+
+	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
+	if (name_owner == NULL) {
+		return FALSE;
+	}
+
+	g_free(name_owner);
+	return TRUE;
+}
+
 /* Callback when we know if the menu proxy can be created or
    not and do something with it! */
 static void
@@ -1193,6 +1874,8 @@ menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer user_data)
 			remote_version = g_variant_get_uint32(version);
 		}
 
+		priv->remote_version = remote_version;
+
 		gboolean old_group = priv->group_events;
 		/* Figure out if we can group the events or not */
 		if (remote_version >= 3) {
@@ -1220,10 +1903,8 @@ menuproxy_build_cb (GObject * object, GAsyncResult * res, gpointer user_data)
 	g_signal_connect(priv->menuproxy, "notify::g-name-owner", G_CALLBACK(menuproxy_name_changed_cb), client);
 	g_signal_connect(priv->menuproxy, "g-properties-changed", G_CALLBACK(menuproxy_prop_changed_cb), client);
 
-	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
-	if (name_owner != NULL) {
+	if (menuproxy_has_owner(client)) {
 		update_layout(client);
-		g_free(name_owner);
 	}
 
 	return;
@@ -1296,6 +1977,8 @@ menuproxy_prop_changed_cb (GDBusProxy * proxy, GVariant * properties, GStrv inva
 				remote_version = g_variant_get_uint32(value);
 			}
 
+			priv->remote_version = remote_version;
+
 			if (remote_version >= 3) {
 				priv->group_events = TRUE;
 			} else {
@@ -1338,6 +2021,83 @@ menuproxy_name_changed_cb (GObject * object, GParamSpec * pspec, gpointer user_d
 	return;
 }
 
+/* Applies a set of updated and removed properties in the format
+   of the ItemsPropertiesUpdated signal */
+static void
+items_properties_updated (DbusmenuClient * client, GDBusProxy * proxy, GVariant * updated, GVariant * removed)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	worker_snapshot_drop(client);
+
+	/* Remove before adding just incase there is a duplicate, against the
+	   rules, but we can handle it so let's do it. */
+	GVariantIter ritems;
+	g_variant_iter_init(&ritems, removed);
+
+	GVariant * ritem;
+	while ((ritem = g_variant_iter_next_value(&ritems)) != NULL) {
+		GVariant * idv = g_variant_get_child_value(ritem, 0);
+		gint id = g_variant_get_int32(idv);
+		g_variant_unref(idv);
+		DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
+
+		if (menuitem == NULL) {
+			g_variant_unref(ritem);
+			continue;
+		}
+
+		GVariantIter properties;
+		GVariant * propv = g_variant_get_child_value(ritem, 1);
+		g_variant_iter_init(&properties, propv);
+		gchar * property;
+
+		while (g_variant_iter_loop(&properties, "s", &property)) {
+			/* g_debug("Removing property '%s' on %d", property, id); */
+			prediction_settle(client, menuitem, property);
+			dbusmenu_menuitem_property_remove(menuitem, property);
+		}
+		g_variant_unref(ritem);
+		g_variant_unref(propv);
+	}
+
+	GVariantIter items;
+	g_variant_iter_init(&items, updated);
+
+	GVariant * item;
+	while ((item = g_variant_iter_next_value(&items)) != NULL) {
+		GVariant * idv = g_variant_get_child_value(item, 0);
+		gint id = g_variant_get_int32(idv);
+		g_variant_unref(idv);
+
+		GVariantIter properties;
+		GVariant * propv = g_variant_get_child_value(item, 1);
+		g_variant_iter_init(&properties, propv);
+		gchar * property;
+		GVariant * value;
+
+		while (g_variant_iter_loop(&properties, "{sv}", &property, &value)) {
+			GVariant * internalvalue = value;
+			if (G_LIKELY(g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT))) {
+				/* Unboxing if needed */
+				internalvalue = g_variant_get_variant(value);
+			}
+
+			id_prop_update(proxy, id, property, internalvalue, client);
+
+			if (internalvalue != value) {
+				/* If we unboxed, we need to drop it, otherwise the
+				   iter_loop function will unref for us */
+				g_variant_unref(internalvalue);
+			}
+		}
+		g_variant_unref(propv);
+		g_variant_unref(item);
+	}
+
+	return;
+}
+
 /* Handle the signals out of the proxy */
 static void
 menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVariant * params, gpointer user_data)
@@ -1346,6 +2106,17 @@ menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVarian
 	DbusmenuClient * client = DBUSMENU_CLIENT(user_data);
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
+	/* These were sent after the layout that's out on the worker
+	   so they wait for it.  A new revision only asks for another
+	   layout once this one is done anyway. */
+	if (priv->worker_busy && g_strcmp0(signal, "LayoutUpdated") != 0) {
+		if (priv->worker_held == NULL) {
+			priv->worker_held = g_queue_new();
+		}
+		g_queue_push_tail(priv->worker_held, g_variant_ref_sink(g_variant_new("(sv)", signal, params)));
+		return;
+	}
+
 	if (g_strcmp0(signal, "LayoutUpdated") == 0) {
 		guint revision; gint parent;
 		g_variant_get(params, "(ui)", &revision, &parent);
@@ -1354,72 +2125,11 @@ menuproxy_signal_cb (GDBusProxy * proxy, gchar * sender, gchar * signal, GVarian
 		/* Drop out here, all the rest of these really need to have a root
 		   node so we can just ignore them if there isn't one. */
 	} else if (g_strcmp0(signal, "ItemsPropertiesUpdated") == 0) {
-		/* Remove before adding just incase there is a duplicate, against the
-		   rules, but we can handle it so let's do it. */
-		GVariantIter ritems;
-		GVariant * ritemsv = g_variant_get_child_value(params, 1);
-		g_variant_iter_init(&ritems, ritemsv);
-
-		GVariant * ritem;
-		while ((ritem = g_variant_iter_next_value(&ritems)) != NULL) {
-			GVariant * idv = g_variant_get_child_value(ritem, 0);
-			gint id = g_variant_get_int32(idv);
-			g_variant_unref(idv);
-			DbusmenuMenuitem * menuitem = dbusmenu_menuitem_find_id(priv->root, id);
-
-			if (menuitem == NULL) {
-				continue;
-			}
-
-			GVariantIter properties;
-			GVariant * propv = g_variant_get_child_value(ritem, 1);
-			g_variant_iter_init(&properties, propv);
-			gchar * property;
-
-			while (g_variant_iter_loop(&properties, "s", &property)) {
-				/* g_debug("Removing property '%s' on %d", property, id); */
-				dbusmenu_menuitem_property_remove(menuitem, property);
-			}
-			g_variant_unref(ritem);
-			g_variant_unref(propv);
-		}
-		g_variant_unref(ritemsv);
-
-		GVariantIter items;
 		GVariant * itemsv = g_variant_get_child_value(params, 0);
-		g_variant_iter_init(&items, itemsv);
-
-		GVariant * item;
-		while ((item = g_variant_iter_next_value(&items)) != NULL) {
-			GVariant * idv = g_variant_get_child_value(item, 0);
-			gint id = g_variant_get_int32(idv);
-			g_variant_unref(idv);
-
-			GVariantIter properties;
-			GVariant * propv = g_variant_get_child_value(item, 1);
-			g_variant_iter_init(&properties, propv);
-			gchar * property;
-			GVariant * value;
-
-			while (g_variant_iter_loop(&properties, "{sv}", &property, &value)) {
-				GVariant * internalvalue = value;
-				if (G_LIKELY(g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT))) {
-					/* Unboxing if needed */
-					internalvalue = g_variant_get_variant(value);
-				}
-
-				id_prop_update(proxy, id, property, internalvalue, client);
-
-				if (internalvalue != value) {
-					/* If we unboxed, we need to drop it, otherwise the
-					   iter_loop function will unref for us */
-					g_variant_unref(internalvalue);
-				}
-			}
-			g_variant_unref(propv);
-			g_variant_unref(item);
-		}
+		GVariant * ritemsv = g_variant_get_child_value(params, 1);
+		items_properties_updated(client, proxy, itemsv, ritemsv);
 		g_variant_unref(itemsv);
+		g_variant_unref(ritemsv);
 	} else if (g_strcmp0(signal, "ItemPropertyUpdated") == 0) {
 		gint id; gchar * property; GVariant * value;
 		g_variant_get(params, "(isv)", &id, &property, &value);
@@ -1488,11 +2198,14 @@ out:
 static void
 menuitem_get_properties_replace_cb (GVariant * properties, GError * error, gpointer data)
 {
-	g_return_if_fail(DBUSMENU_IS_MENUITEM(data));
+	g_return_if_fail(data != NULL);
+	newItemPropData * propdata = (newItemPropData *)data;
+	DbusmenuMenuitem * item = propdata->item;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(propdata->client);
 	gboolean have_error = FALSE;
 
 	if (error != NULL) {
-		g_warning("Unable to replace properties on %d: %s", dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(data)), error->message);
+		g_warning("Unable to replace properties on %d: %s", dbusmenu_menuitem_get_id(item), error->message);
 		have_error = TRUE;
 	}
 	
@@ -1501,7 +2214,7 @@ menuitem_get_properties_replace_cb (GVariant * properties, GError * error, gpoin
 	}
 
 	/* Get the list of the current properties */
-	GList * current_props = dbusmenu_menuitem_properties_list(DBUSMENU_MENUITEM(data));
+	GList * current_props = dbusmenu_menuitem_properties_list(item);
 	GList * tmp = NULL;
 
 	if (!have_error && g_variant_is_of_type(properties, G_VARIANT_TYPE("a{sv}"))) {
@@ -1523,18 +2236,29 @@ menuitem_get_properties_replace_cb (GVariant * properties, GError * error, gpoin
 	}
 
 	/* Remove all entries that we're not getting values for, we can
-	   assume that they no longer exist */
+	   assume that they no longer exist.  Except for the state of a
+	   radio group member which the server never sends, and the heavy
+	   properties if we didn't ask for them. */
+	gboolean in_group = dbusmenu_menuitem_property_exist(item, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP);
+	gboolean light = g_hash_table_contains(priv->heavy_pending, GINT_TO_POINTER(dbusmenu_menuitem_get_id(item)));
 	for (tmp = current_props; tmp != NULL && have_error == FALSE; tmp = g_list_next(tmp)) {
-		dbusmenu_menuitem_property_remove(DBUSMENU_MENUITEM(data), (const gchar *)tmp->data);
+		if (in_group && g_strcmp0((const gchar *)tmp->data, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) == 0) {
+			continue;
+		}
+		if (light && heavy_property(propdata->client, (const gchar *)tmp->data)) {
+			continue;
+		}
+		dbusmenu_menuitem_property_remove(item, (const gchar *)tmp->data);
 	}
 	g_list_free(current_props);
 
 	if (!have_error) {
-		menuitem_get_properties_cb(properties, error, data);
+		menuitem_get_properties_cb(properties, error, item);
 	} else {
-		g_object_unref(data);
+		g_object_unref(item);
 	}
 
+	g_free(propdata);
 	return;
 }
 
@@ -1574,8 +2298,9 @@ menuitem_get_properties_new_cb (GVariant * properties, GError * error, gpointer
 		th = (type_handler_t *)g_hash_table_lookup(priv->type_handlers, DBUSMENU_CLIENT_TYPES_DEFAULT);
 	}
 
+	/* It could have moved to another parent while we waited */
 	if (th != NULL && th->cb != NULL) {
-		handled = th->cb(propdata->item, propdata->parent, propdata->client, th->user_data);
+		handled = th->cb(propdata->item, dbusmenu_menuitem_get_parent(propdata->item), propdata->client, th->user_data);
 	}
 
 	#ifdef MASSIVEDEBUGGING
@@ -1594,94 +2319,301 @@ out:
 	return;
 }
 
-/* A function to work with an event_data_t and make sure it gets
-   free'd and in a terminal state. */
+/* Frees a prediction without touching the menu item's
+   properties */
 static void
-event_data_end (event_data_t * edata, GError * error)
+prediction_free (gpointer data)
 {
-	g_signal_emit(edata->client, signals[EVENT_RESULT], 0, edata->menuitem, edata->event, edata->variant, edata->timestamp, error, TRUE);
+	prediction_t * prediction = (prediction_t *)data;
 
-	g_variant_unref(edata->variant);
-	g_free(edata->event);
-	g_object_unref(edata->menuitem);
-	g_object_unref(edata->client);
-	g_free(edata);
+	if (prediction->timeout != 0) {
+		g_source_remove(prediction->timeout);
+	}
+
+	if (prediction->original != NULL) {
+		g_variant_unref(prediction->original);
+	}
+	if (prediction->predicted != NULL) {
+		g_variant_unref(prediction->predicted);
+	}
+	g_object_unref(prediction->item);
+	g_free(prediction);
 
 	return;
 }
 
-/* Respond to the call function to make sure that the other side
-   got it, or print a warning. */
-static void
-menuitem_call_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+/* Looks for a prediction on a property of an item */
+static prediction_t *
+prediction_find (DbusmenuClient * client, DbusmenuMenuitem * item, const gchar * property)
 {
-	GError * error = NULL;
-	event_data_t * edata = (event_data_t *)userdata;
-	GVariant * params;
-
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	GList * lpred;
 
-	if (error != NULL) {
-		g_warning("Unable to call event '%s' on menu item %d: %s", edata->event, dbusmenu_menuitem_get_id(edata->menuitem), error->message);
+	for (lpred = priv->predictions; lpred != NULL; lpred = g_list_next(lpred)) {
+		prediction_t * prediction = (prediction_t *)lpred->data;
+		if (prediction->item == item && g_strcmp0(prediction->property, property) == 0) {
+			return prediction;
+		}
 	}
 
-	event_data_end(edata, error);
+	return NULL;
+}
 
-	if (G_UNLIKELY(error != NULL)) {
-		g_error_free(error);
-	}
-	if (G_LIKELY(params != NULL)) {
-		g_variant_unref(params);
+/* The server didn't go along with us, put back what it last told us
+   unless something else has changed the value since */
+static void
+prediction_rollback (DbusmenuClient * client, prediction_t * prediction)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	priv->predictions = g_list_remove(priv->predictions, prediction);
+
+	GVariant * current = dbusmenu_menuitem_property_get_variant(prediction->item, prediction->property);
+	if (current != NULL && g_variant_equal(current, prediction->predicted)) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Rolling back '%s' on %d", prediction->property, dbusmenu_menuitem_get_id(prediction->item));
+		#endif
+		dbusmenu_menuitem_property_set_variant(prediction->item, prediction->property, prediction->original);
+		worker_snapshot_drop(client);
 	}
 
+	prediction_free(prediction);
 	return;
 }
 
-/* Looks at event_data_t structs to match an ID */
-static gint
-event_data_find (gconstpointer data, gconstpointer user_data)
+/* Times out waiting for the server to confirm */
+static gboolean
+prediction_timeout (gpointer user_data)
 {
-	event_data_t * edata = (event_data_t *)data;
-	gint id = GPOINTER_TO_INT(user_data);
+	prediction_t * prediction = (prediction_t *)user_data;
+	prediction->timeout = 0;
 
-	if (edata->id == id) {
-		return 0;
-	} else {
-		return -1;
-	}
+	prediction_rollback(prediction->client, prediction);
+
+	return FALSE;
 }
 
-/* The callback from the dbus message to pass events to the
-   to the server en masse */
+/* The server told us the value, whatever it is it's the truth */
 static void
-event_group_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
+prediction_settle (DbusmenuClient * client, DbusmenuMenuitem * item, const gchar * property)
 {
-	GQueue * events = (GQueue *)user_data;
-
-	GError * error = NULL;
-	GVariant * params;
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	if (priv->predictions == NULL) {
+		return;
+	}
 
-	if (error != NULL) {
-		/* If we got an actual DBus error, we should just pass that
-		   along and finish up */
-		g_queue_foreach(events, (GFunc)event_data_end, error);
-		g_queue_free(events);
-		events = NULL;
+	prediction_t * prediction = prediction_find(client, item, property);
+	if (prediction == NULL) {
 		return;
 	}
 
-	gint id = 0;
-	GVariant * array = g_variant_get_child_value(params, 0);
-	GVariantIter iter;
-	g_variant_iter_init(&iter, array);
+	priv->predictions = g_list_remove(priv->predictions, prediction);
+	prediction_free(prediction);
 
-	while (g_variant_iter_loop(&iter, "i", &id)) {
-		GList * item = g_queue_find_custom(events, GINT_TO_POINTER(id), event_data_find);
+	return;
+}
 
-		if (item != NULL) {
-			GError * iderror = g_error_new(error_domain(), ERROR_ID_NOT_FOUND, "Unable to find ID: %d", id);
-			event_data_end((event_data_t *)item->data, iderror);
+/* Changes the toggle state locally for a click on a check or radio
+   item.  Returns the serial of the prediction or zero if there's
+   nothing to predict. */
+static guint
+prediction_start (DbusmenuClient * client, DbusmenuMenuitem * mi)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	const gchar * toggle = dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE);
+	if (toggle == NULL || !dbusmenu_menuitem_property_get_bool(mi, DBUSMENU_MENUITEM_PROP_ENABLED)) {
+		return 0;
+	}
+
+	/* Radio groups change their selection on the parent */
+	DbusmenuMenuitem * item = mi;
+	const gchar * property = DBUSMENU_MENUITEM_PROP_TOGGLE_STATE;
+	if (dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP) && dbusmenu_menuitem_get_parent(mi) != NULL) {
+		item = dbusmenu_menuitem_get_parent(mi);
+		property = DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION;
+	} else if (g_strcmp0(toggle, DBUSMENU_MENUITEM_TOGGLE_CHECK) != 0 && g_strcmp0(toggle, DBUSMENU_MENUITEM_TOGGLE_RADIO) != 0) {
+		return 0;
+	}
+
+	/* If we're already waiting on this one we keep the value from
+	   the server as the one to go back to */
+	prediction_t * prediction = prediction_find(client, item, property);
+	if (prediction == NULL) {
+		prediction = g_new0(prediction_t, 1);
+		prediction->client = client;
+		prediction->item = g_object_ref(item);
+		prediction->property = property;
+		prediction->original = dbusmenu_menuitem_property_get_variant(item, property);
+		if (prediction->original != NULL) {
+			g_variant_ref(prediction->original);
+		}
+		priv->predictions = g_list_prepend(priv->predictions, prediction);
+	} else {
+		if (prediction->timeout != 0) {
+			g_source_remove(prediction->timeout);
+			prediction->timeout = 0;
+		}
+		if (prediction->predicted != NULL) {
+			g_variant_unref(prediction->predicted);
+			prediction->predicted = NULL;
+		}
+	}
+
+	if (item != mi) {
+		dbusmenu_menuitem_toggle_group_select(mi);
+	} else if (g_strcmp0(toggle, DBUSMENU_MENUITEM_TOGGLE_CHECK) == 0) {
+		gint state = dbusmenu_menuitem_property_get_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE);
+		dbusmenu_menuitem_property_set_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
+			state == DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED ? DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED);
+	} else {
+		dbusmenu_menuitem_property_set_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE, DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED);
+	}
+
+	worker_snapshot_drop(client);
+
+	prediction->predicted = dbusmenu_menuitem_property_get_variant(item, property);
+	if (prediction->predicted == NULL || (prediction->original != NULL && g_variant_equal(prediction->original, prediction->predicted))) {
+		/* Nothing for the user to see, like clicking on the radio
+		   item that is already selected */
+		prediction->predicted = NULL;
+		priv->predictions = g_list_remove(priv->predictions, prediction);
+		prediction_free(prediction);
+		return 0;
+	}
+	g_variant_ref(prediction->predicted);
+
+	if (prediction->serial == 0) {
+		prediction->serial = ++priv->prediction_serial;
+	}
+	prediction->pending++;
+
+	return prediction->serial;
+}
+
+/* The server has replied to the click, if it failed the state goes
+   back now, otherwise we give it a bit to send the new state */
+static void
+prediction_event_result (DbusmenuClient * client, guint serial, GError * error)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	GList * lpred;
+
+	for (lpred = priv->predictions; lpred != NULL; lpred = g_list_next(lpred)) {
+		prediction_t * prediction = (prediction_t *)lpred->data;
+		if (prediction->serial != serial) {
+			continue;
+		}
+
+		if (error != NULL) {
+			prediction_rollback(client, prediction);
+			return;
+		}
+
+		if (prediction->pending > 0) {
+			prediction->pending--;
+		}
+		if (prediction->pending == 0 && prediction->timeout == 0) {
+			prediction->timeout = g_timeout_add(PREDICTION_TIMEOUT, prediction_timeout, prediction);
+		}
+		return;
+	}
+
+	/* Already settled by the server, nothing to do */
+	return;
+}
+
+/* A function to work with an event_data_t and make sure it gets
+   free'd and in a terminal state. */
+static void
+event_data_end (event_data_t * edata, GError * error)
+{
+	if (edata->prediction != 0) {
+		prediction_event_result(edata->client, edata->prediction, error);
+	}
+
+	g_signal_emit(edata->client, signals[EVENT_RESULT], 0, edata->menuitem, edata->event, edata->variant, edata->timestamp, error, TRUE);
+
+	g_variant_unref(edata->variant);
+	g_free(edata->event);
+	g_object_unref(edata->menuitem);
+	g_object_unref(edata->client);
+	g_free(edata);
+
+	return;
+}
+
+/* Respond to the call function to make sure that the other side
+   got it, or print a warning. */
+static void
+menuitem_call_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
+{
+	GError * error = NULL;
+	event_data_t * edata = (event_data_t *)userdata;
+	GVariant * params;
+
+	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to call event '%s' on menu item %d: %s", edata->event, dbusmenu_menuitem_get_id(edata->menuitem), error->message);
+	}
+
+	event_data_end(edata, error);
+
+	if (G_UNLIKELY(error != NULL)) {
+		g_error_free(error);
+	}
+	if (G_LIKELY(params != NULL)) {
+		g_variant_unref(params);
+	}
+
+	return;
+}
+
+/* Looks at event_data_t structs to match an ID */
+static gint
+event_data_find (gconstpointer data, gconstpointer user_data)
+{
+	event_data_t * edata = (event_data_t *)data;
+	gint id = GPOINTER_TO_INT(user_data);
+
+	if (edata->id == id) {
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+/* The callback from the dbus message to pass events to the
+   to the server en masse */
+static void
+event_group_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
+{
+	GQueue * events = (GQueue *)user_data;
+
+	GError * error = NULL;
+	GVariant * params;
+	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+
+	if (error != NULL) {
+		/* If we got an actual DBus error, we should just pass that
+		   along and finish up */
+		g_queue_foreach(events, (GFunc)event_data_end, error);
+		g_queue_free(events);
+		events = NULL;
+		return;
+	}
+
+	gint id = 0;
+	GVariant * array = g_variant_get_child_value(params, 0);
+	GVariantIter iter;
+	g_variant_iter_init(&iter, array);
+
+	while (g_variant_iter_loop(&iter, "i", &id)) {
+		GList * item = g_queue_find_custom(events, GINT_TO_POINTER(id), event_data_find);
+
+		if (item != NULL) {
+			GError * iderror = g_error_new(error_domain(), ERROR_ID_NOT_FOUND, "Unable to find ID: %d", id);
+			event_data_end((event_data_t *)item->data, iderror);
 			g_queue_delete_link(events, item);
 			g_error_free(iderror);
 		}
@@ -1736,7 +2668,7 @@ event_idle_cb (gpointer user_data)
 	g_queue_foreach(levents, events_to_builder, &array);
 	GVariant * vevents = g_variant_builder_end(&array);
 
-	if (g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
+	if (priv->predictions != NULL || g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
 		g_dbus_proxy_call(priv->menuproxy,
 		                  "EventGroup",
 		                  g_variant_new_tuple(&vevents, 1),
@@ -1778,8 +2710,13 @@ dbusmenu_client_send_event (DbusmenuClient * client, gint id, const gchar * name
 		variant = g_variant_new_int32(0);
 	}
 
+	guint prediction = 0;
+	if (priv->optimistic_toggles && g_strcmp0(name, DBUSMENU_MENUITEM_EVENT_ACTIVATED) == 0) {
+		prediction = prediction_start(client, mi);
+	}
+
 	/* Don't bother with the reply handling if nobody is watching... */
-	if (!priv->group_events && !g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
+	if (!priv->group_events && prediction == 0 && !g_signal_has_handler_pending (client, signals[EVENT_RESULT], 0, TRUE)) {
 		g_dbus_proxy_call(priv->menuproxy,
 		                  "Event",
 		                  g_variant_new("(isvu)", id, name, variant, timestamp),
@@ -1800,6 +2737,7 @@ dbusmenu_client_send_event (DbusmenuClient * client, gint id, const gchar * name
 	edata->timestamp = timestamp;
 	edata->variant = variant;
 	g_variant_ref_sink(variant);
+	edata->prediction = prediction;
 
 	if (!priv->group_events) {
 		g_dbus_proxy_call(priv->menuproxy,
@@ -1840,9 +2778,19 @@ about_to_show_finish (about_to_show_t * data, gboolean need_update)
 {
 	g_return_if_fail(data != NULL);
 
-	/* If we need to update, do that first. */
+	/* If we need to update, do that first.  The callback waits
+	   for the new layout so that the menu shows what's in it. */
 	if (need_update) {
 		update_layout(data->client);
+
+		DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(data->client);
+		if (data->cb != NULL && priv->layoutcall != NULL) {
+			if (priv->layout_waiters == NULL) {
+				priv->layout_waiters = g_queue_new();
+			}
+			g_queue_push_tail(priv->layout_waiters, data);
+			return;
+		}
 	}
 
 	if (data->cb != NULL) {
@@ -1863,6 +2811,26 @@ about_to_show_finish_pntr (gpointer data, gpointer user_data)
 	return about_to_show_finish((about_to_show_t *)data, GPOINTER_TO_INT(user_data));
 }
 
+/* Finishes the about to show calls that were waiting on a new
+   layout, once there's no layout call going anymore */
+static void
+layout_waiters_flush (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->layoutcall != NULL || priv->layout_waiters == NULL) {
+		return;
+	}
+
+	GQueue * waiters = priv->layout_waiters;
+	priv->layout_waiters = NULL;
+
+	g_queue_foreach(waiters, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
+	g_queue_free(waiters);
+
+	return;
+}
+
 /* Respond to the DBus message from sending a bunch of about-to-show events
    to the server */
 static void
@@ -1871,6 +2839,7 @@ about_to_show_group_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
 	GError * error = NULL;
 	GQueue * showers = (GQueue *)userdata;
 	GVariant * params = NULL;
+	gboolean need_update = FALSE;
 
 	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
 
@@ -1888,8 +2857,7 @@ about_to_show_group_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
 		   single structure.  So if we have any ask, we get the update once to
 		   avoid itterating through all the structures. */
 		if (g_variant_iter_init(&iter, updates) > 0) {
-			about_to_show_t * first = (about_to_show_t *)g_queue_peek_head(showers);
-			update_layout(first->client);
+			need_update = TRUE;
 		}
 
 		g_variant_unref(updates);
@@ -1897,7 +2865,7 @@ about_to_show_group_cb (GObject * proxy, GAsyncResult * res, gpointer userdata)
 		params = NULL;
 	}
 
-	g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(FALSE));
+	g_queue_foreach(showers, about_to_show_finish_pntr, GINT_TO_POINTER(need_update));
 	g_queue_free(showers);
 
 	return;
@@ -2021,6 +2989,8 @@ dbusmenu_client_send_about_to_show(DbusmenuClient * client, gint id, void (*cb)(
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 	g_return_if_fail(priv != NULL);
 
+	heavy_load(client, id);
+
 	about_to_show_t * data = g_new0(about_to_show_t, 1);
 	data->id = id;
 	data->client = client;
@@ -2063,6 +3033,49 @@ dbusmenu_client_send_about_to_show(DbusmenuClient * client, gint id, void (*cb)(
 	return;
 }
 
+/* Members of a radio group don't get a toggle state from the
+   server, we figure it out from the selection on their parent */
+static void
+toggle_group_update_state (DbusmenuMenuitem * mi)
+{
+	const gchar * group = dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP);
+	if (group == NULL) {
+		return;
+	}
+
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent(mi);
+	if (parent == NULL) {
+		return;
+	}
+
+	gint selected = dbusmenu_menuitem_toggle_group_get_selected(parent, group);
+	dbusmenu_menuitem_property_set_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
+		selected == dbusmenu_menuitem_get_id(mi) ? DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED);
+
+	return;
+}
+
+/* Watches for changes in the selection of a radio group or an
+   item joining or leaving one */
+static void
+toggle_group_prop_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * value, gpointer user_data)
+{
+	if (g_strcmp0(property, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION) == 0) {
+		GList * child;
+		for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+			toggle_group_update_state(DBUSMENU_MENUITEM(child->data));
+		}
+	} else if (g_strcmp0(property, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP) == 0) {
+		if (value != NULL) {
+			toggle_group_update_state(mi);
+		} else {
+			dbusmenu_menuitem_property_remove(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE);
+		}
+	}
+
+	return;
+}
+
 /* Builds a new child with property requests and everything
    else to clean up the code a bit */
 static DbusmenuMenuitem *
@@ -2076,6 +3089,8 @@ parse_layout_new_child (gint id, DbusmenuClient * client, DbusmenuMenuitem * par
 		dbusmenu_menuitem_set_root(item, TRUE);
 	}
 
+	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(toggle_group_prop_changed), NULL);
+
 	/* Get the properties queued up for this item */
 	/* Not happy allocating about this, but I need these :( */
 	newItemPropData * propdata = g_new0(newItemPropData, 1);
@@ -2085,7 +3100,7 @@ parse_layout_new_child (gint id, DbusmenuClient * client, DbusmenuMenuitem * par
 		propdata->parent  = parent;
 
 		g_object_ref(item);
-		get_properties_globber(client, id, NULL, menuitem_get_properties_new_cb, propdata);
+		get_properties_globber(client, id, NULL, heavy_defer(client, item, parent), menuitem_get_properties_new_cb, propdata);
 	} else {
 		g_warning("Unable to allocate memory to get properties for menuitem.  This menuitem will never be realized.");
 	}
@@ -2097,8 +3112,158 @@ parse_layout_new_child (gint id, DbusmenuClient * client, DbusmenuMenuitem * par
 static void
 parse_layout_update (DbusmenuMenuitem * item, DbusmenuClient * client)
 {
+	newItemPropData * propdata = g_new0(newItemPropData, 1);
+	propdata->client  = client;
+	propdata->item    = item;
+	propdata->parent  = dbusmenu_menuitem_get_parent(item);
+
 	g_object_ref(item);
-	get_properties_globber(client, dbusmenu_menuitem_get_id(item), NULL, menuitem_get_properties_replace_cb, item);
+	get_properties_globber(client, dbusmenu_menuitem_get_id(item), NULL, heavy_defer(client, item, propdata->parent), menuitem_get_properties_replace_cb, propdata);
+	return;
+}
+
+/* Refreshes the properties of an item that was kept.  Layouts
+   from a change set already come with everything that changed on
+   the items, so only the new ones need to be asked about. */
+static void
+parse_layout_recycled (DbusmenuMenuitem * item, DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->parse_changes) {
+		return;
+	}
+
+	parse_layout_update(item, client);
+	return;
+}
+
+/* Whether the layout node @child has the same type as @mi
+   already does */
+static gboolean
+parse_layout_same_type (DbusmenuMenuitem * mi, GVariant * child)
+{
+	GVariantIter iter;
+	const gchar * prop;
+	GVariant * value;
+	GVariant * child_props;
+	GVariant * new_type = NULL;
+	GVariant * old_type = NULL;
+	gboolean same;
+
+	child_props = g_variant_get_child_value(child, 1);
+	g_variant_iter_init(&iter, child_props);
+	while (g_variant_iter_next(&iter, "{&sv}", &prop, &value)) {
+		if (g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
+			new_type = value;
+			break;
+		}
+		g_variant_unref(value);
+	}
+	g_variant_unref(child_props);
+
+	old_type = dbusmenu_menuitem_property_get_variant(mi, DBUSMENU_MENUITEM_PROP_TYPE);
+	same = (old_type == NULL && new_type == NULL) || (old_type != NULL && new_type != NULL && g_variant_compare(old_type, new_type) == 0);
+
+	if (new_type != NULL) {
+		g_variant_unref(new_type);
+	}
+
+	return same;
+}
+
+/* Puts an item into the table of ones we had */
+static void
+parse_items_add (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	g_hash_table_insert((GHashTable *)user_data, GINT_TO_POINTER(dbusmenu_menuitem_get_id(mi)), mi);
+	return;
+}
+
+/* Looks for an item that we already have somewhere else in the
+   tree that can be moved under @parent for the layout node @child.
+   Items that leave their parent aren't deleted until the whole
+   layout is parsed so they can still be found. */
+static DbusmenuMenuitem *
+parse_layout_moved_child (DbusmenuClient * client, gint id, GVariant * child, DbusmenuMenuitem * parent)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->parse_leftovers == NULL) {
+		return NULL;
+	}
+
+	/* New items only get built after one isn't found here, so
+	   the first time through the tree is all items we had. */
+	if (priv->parse_items == NULL) {
+		priv->parse_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+		dbusmenu_menuitem_foreach(priv->root, parse_items_add, priv->parse_items);
+	}
+
+	DbusmenuMenuitem * mi = g_hash_table_lookup(priv->parse_items, GINT_TO_POINTER(id));
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * oldparent = dbusmenu_menuitem_get_parent(mi);
+	if (oldparent == NULL || oldparent == parent) {
+		return NULL;
+	}
+
+	if (!parse_layout_same_type(mi, child)) {
+		return NULL;
+	}
+
+	return mi;
+}
+
+/* Starts parsing layouts on top of the items we've got.  Unless
+   moves were asked for, items leaving their parent are deleted
+   right away and built again wherever they went. */
+static void
+parse_layout_begin (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->root == NULL || !priv->reparent_children) {
+		return;
+	}
+
+	priv->parse_leftovers = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, g_object_unref);
+	return;
+}
+
+/* Deletes the items that didn't get moved somewhere else */
+static void
+parse_layout_end (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	if (priv->parse_items != NULL) {
+		g_hash_table_destroy(priv->parse_items);
+		priv->parse_items = NULL;
+	}
+
+	if (priv->parse_leftovers == NULL) {
+		return;
+	}
+
+	GHashTable * leftovers = priv->parse_leftovers;
+	priv->parse_leftovers = NULL;
+
+	GHashTableIter iter;
+	gpointer mi, parent;
+	g_hash_table_iter_init(&iter, leftovers);
+	while (g_hash_table_iter_next(&iter, &mi, &parent)) {
+		if (dbusmenu_menuitem_get_parent(DBUSMENU_MENUITEM(mi)) == parent) {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Unref'ing menu item with layout update. ID: %d", dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(mi)));
+			#endif
+			dbusmenu_menuitem_child_delete(DBUSMENU_MENUITEM(parent), DBUSMENU_MENUITEM(mi));
+		}
+	}
+
+	g_hash_table_destroy(leftovers);
 	return;
 }
 
@@ -2125,6 +3290,8 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 	g_return_val_if_fail(item != NULL, NULL);
 	g_return_val_if_fail(id == dbusmenu_menuitem_get_id(item), NULL);
 
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
 	/* Some variables */
 	GVariantIter children;
 	GVariant * childrenv;
@@ -2136,6 +3303,11 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 	GList * oldchildren = g_list_copy(dbusmenu_menuitem_get_children(item));
 	/* g_debug("Starting old children: %d", g_list_length(oldchildren)); */
 
+	/* The child that's at position right now.  Children that are
+	   already in place don't get moved, which would mean looking
+	   them up in the list each time. */
+	GList * inplace = dbusmenu_menuitem_get_children(item);
+
 	/* Go through all the XML Nodes and make sure that we have menuitems
 	   to cover those XML nodes. */
 	GVariant * child;
@@ -2164,25 +3336,7 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 		for (childsearch = oldchildren; childsearch != NULL; childsearch = g_list_next(childsearch)) {
 			DbusmenuMenuitem * cs_mi = DBUSMENU_MENUITEM(childsearch->data);
 			if (childid == dbusmenu_menuitem_get_id(cs_mi)) {
-				GVariantIter iter;
-				gchar * prop;
-				GVariant * value;
-				GVariant * child_props;
-				GVariant * new_type = NULL;
-				GVariant * old_type = NULL;
-
-				child_props = g_variant_get_child_value(child, 1);
-				g_variant_iter_init(&iter, child_props);
-				while (g_variant_iter_loop(&iter, "{sv}", &prop, &value)) {
-					if (g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE) == 0) {
-						new_type = value;
-						break;
-					}
-				}
-				g_variant_unref(child_props);
-				
-				old_type = dbusmenu_menuitem_property_get_variant(cs_mi, DBUSMENU_MENUITEM_PROP_TYPE);
-				if ((old_type == NULL && new_type == NULL) || (old_type != NULL && new_type != NULL && g_variant_compare(old_type, new_type) == 0)) {
+				if (parse_layout_same_type(cs_mi, child)) {
 					// Only recycle the menu item if it's of the same type
 					oldchildren = g_list_remove(oldchildren, cs_mi);
 					childmi = cs_mi;
@@ -2191,7 +3345,20 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 			}
 		}
 
+		/* Or one that's moved over from another parent, which
+		   brings all of its children along */
+		DbusmenuMenuitem * moved = NULL;
 		if (childmi == NULL) {
+			moved = parse_layout_moved_child(client, childid, child, item);
+		}
+
+		if (moved != NULL && dbusmenu_menuitem_child_reparent(item, moved, position)) {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Moving menu item %d from another parent to position %d", childid, position);
+			#endif
+			childmi = moved;
+			parse_layout_recycled(childmi, client);
+		} else if (childmi == NULL) {
 			#ifdef MASSIVEDEBUGGING
 			g_debug("Building new menu item %d at position %d", childid, position);
 			#endif
@@ -2199,13 +3366,21 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 			childmi = parse_layout_new_child(childid, client, item);
 			dbusmenu_menuitem_child_add_position(item, childmi, position);
 			g_object_unref(childmi);
+		} else if (inplace != NULL && inplace->data == childmi) {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Recycling menu item %d in place at position %d", childid, position);
+			#endif
+			inplace = g_list_next(inplace);
+			parse_layout_recycled(childmi, client);
 		} else {
 			#ifdef MASSIVEDEBUGGING
 			g_debug("Recycling menu item %d at position %d", childid, position);
 			#endif
-			/* If we can recycle, make sure it's in the right place */
+			/* If we can recycle, make sure it's in the right place.
+			   It goes in front of the one in place, so that one is
+			   still next. */
 			dbusmenu_menuitem_child_reorder(item, childmi, position);
-			parse_layout_update(childmi, client);
+			parse_layout_recycled(childmi, client);
 		}
 
 		/* Apply known properties sent in the structure to the
@@ -2239,10 +3414,16 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 	}
 
 	/* Remove any children that are no longer used by this version of
-	   the layout. */
+	   the layout.  If we're parsing on top of the items we had they
+	   stay at the end until we're done, as they might have moved
+	   to a parent that we haven't gotten to yet. */
 	GList * oldchildleft = NULL;
 	for (oldchildleft = oldchildren; oldchildleft != NULL; oldchildleft = g_list_next(oldchildleft)) {
 		DbusmenuMenuitem * oldmi = DBUSMENU_MENUITEM(oldchildleft->data);
+		if (priv->parse_leftovers != NULL) {
+			g_hash_table_insert(priv->parse_leftovers, g_object_ref(oldmi), g_object_ref(item));
+			continue;
+		}
 		#ifdef MASSIVEDEBUGGING
 		g_debug("Unref'ing menu item with layout update. ID: %d", dbusmenu_menuitem_get_id(oldmi));
 		#endif
@@ -2297,7 +3478,8 @@ parse_layout_xml(DbusmenuClient * client, GVariant * layout, DbusmenuMenuitem *
 	if (child != NULL) {
 		g_warning("Sync failed, now we've got extra layout nodes.");
 	}
-	if (childmis != NULL) {
+	/* Other than the ones that are left over */
+	if (childmis != NULL && (priv->parse_leftovers == NULL || !g_hash_table_contains(priv->parse_leftovers, childmis->data))) {
 		g_warning("Sync failed, now we've got extra menu items.");
 	}
 
@@ -2317,6 +3499,8 @@ parse_layout (DbusmenuClient * client, GVariant * layout)
 
 	DbusmenuMenuitem * oldroot = priv->root;
 
+	parse_layout_begin(client);
+
 	if (priv->root == NULL) {
 		priv->root = parse_layout_new_child(0, client, NULL);
 	} else {
@@ -2325,6 +3509,8 @@ parse_layout (DbusmenuClient * client, GVariant * layout)
 
 	priv->root = parse_layout_xml(client, layout, priv->root, NULL, priv->menuproxy);
 
+	parse_layout_end(client);
+
 	if (priv->root == NULL) {
 		g_warning("Unable to parse layout on client %s object %s: %s", priv->dbus_name, priv->dbus_object, g_variant_print(layout, TRUE));
 	}
@@ -2360,7 +3546,7 @@ update_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data)
 	GVariant * params = NULL;
 	GVariant * layout = NULL;
 
-	params = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	params = large_call_finish(proxy, res, "(u(ia{sv}av))", &error);
 
 	if (error != NULL) {
 		g_warning("Getting layout failed: %s", error->message);
@@ -2400,6 +3586,8 @@ out:
 		priv->layoutcall = NULL;
 	}
 
+	layout_waiters_flush(client);
+
 	if (layout != NULL) {
 		g_variant_unref(layout);
 	}
@@ -2412,6 +3600,554 @@ out:
 	return;
 }
 
+/* Applies the subtrees that have changed since our revision on top
+   of the items we already have.  The properties that changed on the
+   items come along with the subtrees, so only new items get theirs
+   fetched.  Returns FALSE if we don't have one of the items, and a
+   full layout is needed. */
+static gboolean
+apply_layout_changes (DbusmenuClient * client, GVariant * layouts)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GVariantIter iter;
+	GVariant * layout;
+	g_variant_iter_init(&iter, layouts);
+
+	/* Items can move from one of the layouts to another */
+	parse_layout_begin(client);
+	priv->parse_changes = TRUE;
+
+	while ((layout = g_variant_iter_next_value(&iter)) != NULL) {
+		GVariant * idv = g_variant_get_child_value(layout, 0);
+		gint id = g_variant_get_int32(idv);
+		g_variant_unref(idv);
+
+		DbusmenuMenuitem * item = priv->root;
+		if (id != 0) {
+			item = dbusmenu_menuitem_find_id(priv->root, id);
+		}
+
+		if (item == NULL) {
+			g_variant_unref(layout);
+			priv->parse_changes = FALSE;
+			parse_layout_end(client);
+			return FALSE;
+		}
+
+		GVariantIter piter;
+		gchar * prop;
+		GVariant * value;
+		GVariant * props = g_variant_get_child_value(layout, 1);
+		g_variant_iter_init(&piter, props);
+		while (g_variant_iter_loop(&piter, "{sv}", &prop, &value)) {
+			dbusmenu_menuitem_property_set_variant(item, prop, value);
+		}
+		g_variant_unref(props);
+
+		parse_layout_xml(client, layout, item, dbusmenu_menuitem_get_parent(item), priv->menuproxy);
+		g_variant_unref(layout);
+	}
+
+	priv->parse_changes = FALSE;
+	parse_layout_end(client);
+	return TRUE;
+}
+
+/* Gets the changes since our revision, or if the server can't
+   tell us those, falls back to getting the whole layout. */
+static void
+update_changes_cb (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GError * error = NULL;
+	GVariant * params = large_call_finish(proxy, res, "(uba(ia{sv}av)a(ia{sv})a(ias))", &error);
+
+	if (error != NULL) {
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_warning("Getting layout changes failed: %s", error->message);
+			get_layout(client);
+		} else if (priv->layoutcall != NULL) {
+			g_object_unref(priv->layoutcall);
+			priv->layoutcall = NULL;
+		}
+		g_error_free(error);
+		layout_waiters_flush(client);
+		g_object_unref(G_OBJECT(client));
+		return;
+	}
+
+	guint32 revision;
+	gboolean too_old;
+	GVariant * layouts;
+	GVariant * updated;
+	GVariant * removed;
+	g_variant_get(params, "(ub@a(ia{sv}av)@a(ia{sv})@a(ias))", &revision, &too_old, &layouts, &updated, &removed);
+
+	if (too_old || priv->root == NULL || !apply_layout_changes(client, layouts)) {
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Client unable to catch up from revision %d, getting full layout", priv->my_revision);
+		#endif
+		get_layout(client);
+	} else {
+		items_properties_updated(client, G_DBUS_PROXY(proxy), updated, removed);
+
+		priv->my_revision = revision;
+
+		/* The last full layout doesn't match the items anymore */
+		worker_snapshot_drop(client);
+
+		if (priv->layoutcall != NULL) {
+			g_object_unref(priv->layoutcall);
+			priv->layoutcall = NULL;
+		}
+
+		g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+
+		/* Check to see if we got another update in the time this
+		   one was issued. */
+		if (priv->my_revision < priv->current_revision) {
+			update_layout(client);
+		}
+	}
+
+	g_variant_unref(layouts);
+	g_variant_unref(updated);
+	g_variant_unref(removed);
+	g_variant_unref(params);
+
+	layout_waiters_flush(client);
+
+	g_object_unref(G_OBJECT(client));
+	return;
+}
+
+/* The layout node that's in one of the children variants */
+static GVariant *
+layout_node_get (GVariant * child)
+{
+	if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT)) {
+		GVariant * node = g_variant_get_variant(child);
+		g_variant_unref(child);
+		return node;
+	}
+
+	return child;
+}
+
+static gint
+layout_node_id (GVariant * node)
+{
+	gint id;
+	g_variant_get_child(node, 0, "i", &id);
+	return id;
+}
+
+/* The children of a layout node, leaving out the ones that
+   aren't items, like parse_layout_xml() does */
+static GPtrArray *
+layout_node_children (GVariant * node)
+{
+	GPtrArray * array = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+	GVariant * children = g_variant_get_child_value(node, 2);
+	GVariantIter iter;
+	GVariant * child;
+
+	g_variant_iter_init(&iter, children);
+	while ((child = g_variant_iter_next_value(&iter)) != NULL) {
+		child = layout_node_get(child);
+		if (layout_node_id(child) >= 0) {
+			g_ptr_array_add(array, child);
+		} else {
+			g_variant_unref(child);
+		}
+	}
+
+	g_variant_unref(children);
+	return array;
+}
+
+/* Puts every node of the layout into @index by ID */
+static void
+layout_index (GVariant * node, GHashTable * index)
+{
+	g_hash_table_insert(index, GINT_TO_POINTER(layout_node_id(node)), g_variant_ref(node));
+
+	GPtrArray * children = layout_node_children(node);
+	guint i;
+	for (i = 0; i < children->len; i++) {
+		layout_index(g_ptr_array_index(children, i), index);
+	}
+	g_ptr_array_unref(children);
+
+	return;
+}
+
+/* Whether the two nodes are the same type of item */
+static gboolean
+layout_same_type (GVariant * old, GVariant * new)
+{
+	GVariant * oldprops = g_variant_get_child_value(old, 1);
+	GVariant * newprops = g_variant_get_child_value(new, 1);
+	GVariant * oldtype = g_variant_lookup_value(oldprops, DBUSMENU_MENUITEM_PROP_TYPE, NULL);
+	GVariant * newtype = g_variant_lookup_value(newprops, DBUSMENU_MENUITEM_PROP_TYPE, NULL);
+
+	gboolean same = (oldtype == NULL && newtype == NULL) || (oldtype != NULL && newtype != NULL && g_variant_equal(oldtype, newtype));
+
+	if (oldtype != NULL) {
+		g_variant_unref(oldtype);
+	}
+	if (newtype != NULL) {
+		g_variant_unref(newtype);
+	}
+	g_variant_unref(oldprops);
+	g_variant_unref(newprops);
+
+	return same;
+}
+
+/* Whether @old had the same @children, in the same order.  If any
+   of them changed type the items get rebuilt, so that counts too. */
+static gboolean
+layout_same_children (GVariant * old, GPtrArray * children)
+{
+	GPtrArray * oldchildren = layout_node_children(old);
+	gboolean same = (oldchildren->len == children->len);
+	guint i;
+
+	for (i = 0; same && i < children->len; i++) {
+		GVariant * oldchild = g_ptr_array_index(oldchildren, i);
+		GVariant * child = g_ptr_array_index(children, i);
+
+		same = layout_node_id(oldchild) == layout_node_id(child) && layout_same_type(oldchild, child);
+	}
+
+	g_ptr_array_unref(oldchildren);
+	return same;
+}
+
+/* Adds the properties of the node that changed to @updated and
+   the ones that went away to @removed */
+static void
+layout_props_diff (gint id, GVariant * old, GVariant * new, GVariantBuilder * updated, GVariantBuilder * removed)
+{
+	GVariant * oldprops = g_variant_get_child_value(old, 1);
+	GVariant * newprops = g_variant_get_child_value(new, 1);
+	GVariantIter iter;
+	const gchar * prop;
+	GVariant * value;
+
+	GVariantBuilder changed;
+	gboolean anychanged = FALSE;
+	g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+
+	g_variant_iter_init(&iter, newprops);
+	while (g_variant_iter_next(&iter, "{&sv}", &prop, &value)) {
+		GVariant * was = g_variant_lookup_value(oldprops, prop, NULL);
+		if (was == NULL || !g_variant_equal(was, value)) {
+			g_variant_builder_add(&changed, "{sv}", prop, value);
+			anychanged = TRUE;
+		}
+		if (was != NULL) {
+			g_variant_unref(was);
+		}
+		g_variant_unref(value);
+	}
+
+	GVariantBuilder gone;
+	gboolean anygone = FALSE;
+	g_variant_builder_init(&gone, G_VARIANT_TYPE("as"));
+
+	g_variant_iter_init(&iter, oldprops);
+	while (g_variant_iter_next(&iter, "{&sv}", &prop, &value)) {
+		GVariant * is = g_variant_lookup_value(newprops, prop, NULL);
+		if (is == NULL) {
+			g_variant_builder_add(&gone, "s", prop);
+			anygone = TRUE;
+		} else {
+			g_variant_unref(is);
+		}
+		g_variant_unref(value);
+	}
+
+	if (anychanged) {
+		g_variant_builder_add(updated, "(i@a{sv})", id, g_variant_builder_end(&changed));
+	} else {
+		g_variant_builder_clear(&changed);
+	}
+
+	if (anygone) {
+		g_variant_builder_add(removed, "(i@as)", id, g_variant_builder_end(&gone));
+	} else {
+		g_variant_builder_clear(&gone);
+	}
+
+	g_variant_unref(oldprops);
+	g_variant_unref(newprops);
+	return;
+}
+
+/* Puts the nodes in @children, and everything under them, that
+   were in the old layout on @kept */
+static void
+layout_diff_kept (GPtrArray * children, GHashTable * oldindex, GHashTable * kept)
+{
+	guint i;
+	for (i = 0; i < children->len; i++) {
+		GVariant * child = g_ptr_array_index(children, i);
+		gint id = layout_node_id(child);
+
+		if (g_hash_table_contains(oldindex, GINT_TO_POINTER(id))) {
+			g_hash_table_add(kept, GINT_TO_POINTER(id));
+		}
+
+		GPtrArray * grandchildren = layout_node_children(child);
+		layout_diff_kept(grandchildren, oldindex, kept);
+		g_ptr_array_unref(grandchildren);
+	}
+
+	return;
+}
+
+/* Compares the node with the one in the old layout.  If its children
+   are different the whole node goes into @changes, as it would come
+   from GetChangesSince, otherwise only its properties that changed
+   and we keep looking further down.  The items that were in the old
+   layout go on @kept. */
+static void
+layout_diff_node (GVariant * node, GHashTable * oldindex, GVariantBuilder * changes, GVariantBuilder * updated, GVariantBuilder * removed, GHashTable * kept)
+{
+	gint id = layout_node_id(node);
+	GVariant * old = g_hash_table_lookup(oldindex, GINT_TO_POINTER(id));
+	GPtrArray * children = layout_node_children(node);
+
+	if (old != NULL) {
+		g_hash_table_add(kept, GINT_TO_POINTER(id));
+	}
+
+	if (old == NULL || !layout_same_children(old, children)) {
+		g_variant_builder_add_value(changes, node);
+		/* Changes only set properties, they can't take them away */
+		if (old != NULL) {
+			layout_props_diff(id, old, node, updated, removed);
+		}
+		/* And the ones under it that were in the old layout */
+		layout_diff_kept(children, oldindex, kept);
+		g_ptr_array_unref(children);
+		return;
+	}
+
+	layout_props_diff(id, old, node, updated, removed);
+
+	guint i;
+	for (i = 0; i < children->len; i++) {
+		layout_diff_node(g_ptr_array_index(children, i), oldindex, changes, updated, removed, kept);
+	}
+
+	g_ptr_array_unref(children);
+	return;
+}
+
+/* Refreshes all of the properties of the items that were kept.
+   The layouts only have a few of them to compare, so the others
+   are fetched like they are when a layout is parsed whole. */
+static void
+worker_kept_refresh (DbusmenuMenuitem * item, gpointer user_data)
+{
+	worker_job_t * job = (worker_job_t *)user_data;
+
+	if (g_hash_table_contains(job->kept, GINT_TO_POINTER(dbusmenu_menuitem_get_id(item)))) {
+		parse_layout_update(item, job->client);
+	}
+
+	return;
+}
+
+/* Comes back to the client's context with the layout */
+static gboolean
+worker_layout_done (gpointer user_data)
+{
+	worker_job_t * job = (worker_job_t *)user_data;
+	DbusmenuClient * client = job->client;
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+	gboolean cancelled = g_cancellable_is_cancelled(job->cancel);
+
+	priv->worker_busy = FALSE;
+
+	if (cancelled) {
+		/* Whoever cancelled it has cleaned up after the call */
+	} else if (job->error != NULL) {
+		g_warning("Getting layout failed: %s", job->error->message);
+	} else {
+		/* The items only match the layout it was compared with if
+		   nothing else has changed them since it went out */
+		if (job->changes != NULL && job->snapshot == priv->worker_snapshot && priv->root != NULL && apply_layout_changes(client, job->changes)) {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Client applied the changes to the layout from the worker");
+			#endif
+			items_properties_updated(client, priv->menuproxy, job->updated, job->removed);
+			dbusmenu_menuitem_foreach(priv->root, worker_kept_refresh, job);
+		} else {
+			parse_layout(client, job->layout);
+		}
+
+		if (priv->worker_snapshot != NULL) {
+			g_variant_unref(priv->worker_snapshot);
+		}
+		priv->worker_snapshot = g_variant_ref(job->layout);
+
+		priv->my_revision = job->revision;
+		g_signal_emit(G_OBJECT(client), signals[LAYOUT_UPDATED], 0, TRUE);
+	}
+
+	if (!cancelled && priv->layoutcall != NULL) {
+		g_object_unref(priv->layoutcall);
+		priv->layoutcall = NULL;
+	}
+
+	/* Now what came in while we were waiting */
+	GQueue * held = priv->worker_held;
+	priv->worker_held = NULL;
+	if (held != NULL) {
+		GVariant * signal;
+		while ((signal = g_queue_pop_head(held)) != NULL) {
+			const gchar * name;
+			GVariant * params;
+			g_variant_get(signal, "(&sv)", &name, &params);
+			menuproxy_signal_cb(priv->menuproxy, NULL, (gchar *)name, params, client);
+			g_variant_unref(params);
+			g_variant_unref(signal);
+		}
+		g_queue_free(held);
+	}
+
+	/* Check to see if we got another update in the time this
+	   one was issued. */
+	if (!cancelled && job->error == NULL && priv->my_revision < priv->current_revision) {
+		update_layout(client);
+	}
+
+	layout_waiters_flush(client);
+
+	if (job->error != NULL) {
+		g_error_free(job->error);
+	}
+	if (job->snapshot != NULL) {
+		g_variant_unref(job->snapshot);
+	}
+	if (job->layout != NULL) {
+		g_variant_unref(job->layout);
+	}
+	if (job->changes != NULL) {
+		g_variant_unref(job->changes);
+		g_variant_unref(job->updated);
+		g_variant_unref(job->removed);
+		g_hash_table_destroy(job->kept);
+	}
+	g_object_unref(job->cancel);
+	g_main_context_unref(job->context);
+	g_free(job);
+
+	g_object_unref(G_OBJECT(client));
+	return FALSE;
+}
+
+/* Runs on the worker.  Only looks at the variants in the job and
+   not at the client, which belongs to the other context. */
+static gboolean
+worker_layout_run (gpointer user_data)
+{
+	worker_job_t * job = (worker_job_t *)user_data;
+
+	GVariant * params = large_reply_unwrap(job->reply, "(u(ia{sv}av))", &job->error);
+	job->reply = NULL;
+
+	if (params != NULL && !g_variant_is_of_type(params, G_VARIANT_TYPE("(u(ia{sv}av))"))) {
+		g_set_error(&job->error, error_domain(), 0, "Layout of type '%s'", g_variant_get_type_string(params));
+	} else if (params != NULL) {
+		g_variant_get(params, "(u@(ia{sv}av))", &job->revision, &job->layout);
+	}
+
+	if (job->layout != NULL && job->snapshot != NULL) {
+		GHashTable * oldindex = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+		layout_index(job->snapshot, oldindex);
+
+		GVariantBuilder changes, updated, removed;
+		g_variant_builder_init(&changes, G_VARIANT_TYPE("a(ia{sv}av)"));
+		g_variant_builder_init(&updated, G_VARIANT_TYPE("a(ia{sv})"));
+		g_variant_builder_init(&removed, G_VARIANT_TYPE("a(ias)"));
+
+		job->kept = g_hash_table_new(g_direct_hash, g_direct_equal);
+		layout_diff_node(job->layout, oldindex, &changes, &updated, &removed, job->kept);
+
+		job->changes = g_variant_ref_sink(g_variant_builder_end(&changes));
+		job->updated = g_variant_ref_sink(g_variant_builder_end(&updated));
+		job->removed = g_variant_ref_sink(g_variant_builder_end(&removed));
+
+		g_hash_table_destroy(oldindex);
+	}
+
+	if (params != NULL) {
+		g_variant_unref(params);
+	}
+
+	g_main_context_invoke(job->context, worker_layout_done, job);
+	return FALSE;
+}
+
+/* The reply to GetLayout when we're using the worker, which gets
+   it unpacked and compared to the one we had before. */
+static void
+worker_layout_cb (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+	DbusmenuClient * client = DBUSMENU_CLIENT(data);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GError * error = NULL;
+	GVariant * reply = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+
+	if (error != NULL) {
+		g_warning("Getting layout failed: %s", error->message);
+		g_error_free(error);
+
+		if (priv->layoutcall != NULL) {
+			g_object_unref(priv->layoutcall);
+			priv->layoutcall = NULL;
+		}
+
+		layout_waiters_flush(client);
+		g_object_unref(G_OBJECT(client));
+		return;
+	}
+
+	worker_job_t * job = g_new0(worker_job_t, 1);
+	job->client = client; /* Keeps the ref from the call */
+	job->context = g_main_context_ref_thread_default();
+	job->cancel = priv->layoutcall != NULL ? g_object_ref(priv->layoutcall) : g_cancellable_new();
+	job->reply = reply;
+	if (priv->worker_snapshot != NULL && priv->root != NULL) {
+		job->snapshot = g_variant_ref(priv->worker_snapshot);
+	}
+
+	priv->worker_busy = TRUE;
+
+	g_mutex_lock(&worker_lock);
+	if (worker_context != NULL) {
+		g_main_context_invoke(worker_context, worker_layout_run, job);
+		job = NULL;
+	}
+	g_mutex_unlock(&worker_lock);
+
+	/* The worker was turned off while the call was out */
+	if (job != NULL) {
+		worker_layout_run(job);
+	}
+
+	return;
+}
+
 /* Call the property on the server we're connected to and set it up to
    be async back to _update_layout_cb */
 static void
@@ -2420,21 +4156,39 @@ update_layout (DbusmenuClient * client)
 	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 	g_return_if_fail(priv->layout_props != NULL);
 
-	if (priv->menuproxy == NULL) {
+	if (!menuproxy_has_owner(client)) {
 		return;
 	}
 
-	gchar * name_owner = g_dbus_proxy_get_name_owner(priv->menuproxy);
-	if (name_owner == NULL) {
+	if (priv->layoutcall != NULL) {
 		return;
 	}
-	g_free(name_owner);
 
-	if (priv->layoutcall != NULL) {
+	priv->layoutcall = g_cancellable_new();
+
+	/* If we've already got a layout and the server keeps a journal
+	   we only need to ask for what changed since then */
+	if (priv->root != NULL && priv->my_revision != 0 && priv->remote_version >= 4) {
+		g_object_ref(G_OBJECT(client));
+		large_call(client,
+		           "GetChangesSince",
+		           g_variant_new("(u@as)", priv->my_revision, priv->layout_props),
+		           priv->layoutcall, /* cancellable */
+		           update_changes_cb,
+		           client);
 		return;
 	}
 
-	priv->layoutcall = g_cancellable_new();
+	get_layout(client);
+	return;
+}
+
+/* Asks for the whole layout, the layout call must already be
+   setup to cancel it. */
+static void
+get_layout (DbusmenuClient * client)
+{
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
 
 	GVariantBuilder tupleb;
 	g_variant_builder_init(&tupleb, G_VARIANT_TYPE_TUPLE);
@@ -2447,14 +4201,12 @@ update_layout (DbusmenuClient * client)
 	// g_debug("Args (type: %s): %s", g_variant_get_type_string(args), g_variant_print(args, TRUE));
 
 	g_object_ref(G_OBJECT(client));
-	g_dbus_proxy_call(priv->menuproxy,
-	                  "GetLayout",
-	                  args,
-	                  G_DBUS_CALL_FLAGS_NONE,
-	                  -1,   /* timeout */
-	                  priv->layoutcall, /* cancellable */
-	                  update_layout_cb,
-	                  client);
+	large_call(client,
+	           "GetLayout",
+	           args,
+	           priv->layoutcall, /* cancellable */
+	           priv->worker_parsing ? worker_layout_cb : update_layout_cb,
+	           client);
 
 	return;
 }
@@ -2487,6 +4239,45 @@ dbusmenu_client_new (const gchar * name, const gchar * object)
 	return self;
 }
 
+/**
+ * dbusmenu_client_new_for_connection:
+ * @connection: The #GDBusConnection to find the server on
+ * @name: (allow-none): The DBus name for the server, NULL on a peer connection
+ * @object: The object on the server to monitor
+ *
+ * Like #dbusmenu_client_new but uses @connection instead of the
+ * session bus.  When @connection is a peer to peer connection, for
+ * instance one end of a socket pair shared with a #DbusmenuServer
+ * in the same process, there is no bus daemon so @name should be
+ * NULL and is ignored otherwise.
+ *
+ * Return value: A brand new #DbusmenuClient
+ */
+DbusmenuClient *
+dbusmenu_client_new_for_connection (GDBusConnection * connection, const gchar * name, const gchar * object)
+{
+	g_return_val_if_fail(G_IS_DBUS_CONNECTION(connection), NULL);
+	g_return_val_if_fail(name == NULL || g_dbus_is_name(name), NULL);
+	g_return_val_if_fail(g_variant_is_object_path(object), NULL);
+
+	DbusmenuClient * self = NULL;
+
+	if (name != NULL) {
+		self = g_object_new(DBUSMENU_TYPE_CLIENT,
+		                    DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, connection,
+		                    DBUSMENU_CLIENT_PROP_DBUS_NAME, name,
+		                    DBUSMENU_CLIENT_PROP_DBUS_OBJECT, object,
+		                    NULL);
+	} else {
+		self = g_object_new(DBUSMENU_TYPE_CLIENT,
+		                    DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, connection,
+		                    DBUSMENU_CLIENT_PROP_DBUS_OBJECT, object,
+		                    NULL);
+	}
+
+	return self;
+}
+
 /**
  * dbusmenu_client_get_root:
  * @client: The #DbusmenuClient to get the root node from
@@ -2672,3 +4463,119 @@ dbusmenu_client_get_icon_paths (DbusmenuClient * client)
 	return priv->icon_dirs;
 }
 
+/* The reply to Search, handing back the results */
+static void
+search_cb (GObject * proxy, GAsyncResult * res, gpointer user_data)
+{
+	GTask * task = G_TASK(user_data);
+	GError * error = NULL;
+
+	GVariant * reply = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), res, &error);
+	if (error != NULL) {
+		g_task_return_error(task, error);
+		g_object_unref(task);
+		return;
+	}
+
+	g_task_return_pointer(task, reply, (GDestroyNotify)g_variant_unref);
+	g_object_unref(task);
+
+	return;
+}
+
+/**
+ * dbusmenu_client_search:
+ * @client: The #DbusmenuClient to search the menu of
+ * @text: The text to look for in the labels
+ * @requirements: (array zero-terminated=1) (allow-none): Boolean
+ *   properties, like #DBUSMENU_MENUITEM_PROP_ENABLED, that the items
+ *   and all of their parents need to have set to be found
+ * @cancellable: (allow-none): A #GCancellable to stop the search
+ * @callback: Called with the results
+ * @user_data: Data for @callback
+ * 
+ * Asks the server for the items that have @text in their label,
+ * ignoring case and mnemonics.  Only the items that are found come
+ * over the bus, so this is a lot cheaper than getting the whole menu
+ * with the client to look through it.  Servers from before version 7
+ * of the protocol don't support it and the search fails.
+ * 
+ * Call dbusmenu_client_search_finish() in @callback to get the results.
+ */
+void
+dbusmenu_client_search (DbusmenuClient * client, const gchar * text, const gchar ** requirements, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail(DBUSMENU_IS_CLIENT(client));
+	g_return_if_fail(text != NULL);
+	DbusmenuClientPrivate * priv = DBUSMENU_CLIENT_GET_PRIVATE(client);
+
+	GTask * task = g_task_new(client, cancellable, callback, user_data);
+	g_task_set_source_tag(task, dbusmenu_client_search);
+
+	if (priv->menuproxy == NULL) {
+		g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, "The client isn't connected to a menu");
+		g_object_unref(task);
+		return;
+	}
+
+	const gchar * none[] = { NULL };
+	if (requirements == NULL) {
+		requirements = none;
+	}
+
+	g_dbus_proxy_call(priv->menuproxy,
+	                  "Search",
+	                  g_variant_new("(s^as)", text, requirements),
+	                  G_DBUS_CALL_FLAGS_NONE,
+	                  -1,   /* timeout */
+	                  cancellable,
+	                  search_cb,
+	                  task);
+
+	return;
+}
+
+/**
+ * dbusmenu_client_search_finish:
+ * @client: The #DbusmenuClient that was searched
+ * @result: The #GAsyncResult given to the callback
+ * @revision: (out) (allow-none): Where to put the revision of the
+ *   layout that was searched
+ * @error: Where to put an error if the search failed
+ * 
+ * Gets the results of dbusmenu_client_search().  They are a list of
+ * the IDs of the items that were found, each with the labels from
+ * the top level of the menu down to the item, as an "a(ias)".
+ * 
+ * The IDs are the ones from the layout at @revision.  If the menu
+ * has changed since, which it has when the revision is newer than
+ * the one the client has, some of them might not be on the client
+ * yet or might have gone away from the server.  Searchers that
+ * activate the results should check the revision first.
+ * 
+ * Return value: (transfer full): The results, or NULL if the search
+ *   failed.  Free with g_variant_unref().
+ */
+GVariant *
+dbusmenu_client_search_finish (DbusmenuClient * client, GAsyncResult * result, guint * revision, GError ** error)
+{
+	g_return_val_if_fail(DBUSMENU_IS_CLIENT(client), NULL);
+	g_return_val_if_fail(g_task_is_valid(result, client), NULL);
+
+	GVariant * reply = (GVariant *)g_task_propagate_pointer(G_TASK(result), error);
+	if (reply == NULL) {
+		return NULL;
+	}
+
+	guint32 searched = 0;
+	GVariant * results = NULL;
+	g_variant_get(reply, "(u@a(ias))", &searched, &results);
+	g_variant_unref(reply);
+
+	if (revision != NULL) {
+		*revision = searched;
+	}
+
+	return results;
+}
+
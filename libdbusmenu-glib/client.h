@@ -31,6 +31,7 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "menuitem.h"
 #include "types.h"
@@ -111,6 +112,42 @@ G_BEGIN_DECLS
  * String to access property #DbusmenuClient:group-events
  */
 #define DBUSMENU_CLIENT_PROP_GROUP_EVENTS "group-events"
+/**
+ * DBUSMENU_CLIENT_PROP_DBUS_CONNECTION:
+ *
+ * String to access property #DbusmenuClient:dbus-connection
+ */
+#define DBUSMENU_CLIENT_PROP_DBUS_CONNECTION "dbus-connection"
+/**
+ * DBUSMENU_CLIENT_PROP_OPTIMISTIC_TOGGLES:
+ *
+ * String to access property #DbusmenuClient:optimistic-toggles
+ */
+#define DBUSMENU_CLIENT_PROP_OPTIMISTIC_TOGGLES "optimistic-toggles"
+/**
+ * DBUSMENU_CLIENT_PROP_HEAVY_PROPERTIES:
+ *
+ * String to access property #DbusmenuClient:heavy-properties
+ */
+#define DBUSMENU_CLIENT_PROP_HEAVY_PROPERTIES "heavy-properties"
+/**
+ * DBUSMENU_CLIENT_PROP_COMPRESSION:
+ *
+ * String to access property #DbusmenuClient:compression
+ */
+#define DBUSMENU_CLIENT_PROP_COMPRESSION "compression"
+/**
+ * DBUSMENU_CLIENT_PROP_WORKER_PARSING:
+ *
+ * String to access property #DbusmenuClient:worker-parsing
+ */
+#define DBUSMENU_CLIENT_PROP_WORKER_PARSING "worker-parsing"
+/**
+ * DBUSMENU_CLIENT_PROP_REPARENT_CHILDREN:
+ *
+ * String to access property #DbusmenuClient:reparent-children
+ */
+#define DBUSMENU_CLIENT_PROP_REPARENT_CHILDREN "reparent-children"
 
 /**
  * DBUSMENU_CLIENT_TYPES_DEFAULT:
@@ -208,6 +245,9 @@ typedef gboolean (*DbusmenuClientTypeHandler) (DbusmenuMenuitem * newitem, Dbusm
 GType                dbusmenu_client_get_type          (void);
 DbusmenuClient *     dbusmenu_client_new               (const gchar * name,
                                                         const gchar * object);
+DbusmenuClient *     dbusmenu_client_new_for_connection (GDBusConnection * connection,
+                                                        const gchar * name,
+                                                        const gchar * object);
 DbusmenuMenuitem *   dbusmenu_client_get_root          (DbusmenuClient * client);
 gboolean             dbusmenu_client_add_type_handler  (DbusmenuClient * client,
                                                         const gchar * type,
@@ -220,6 +260,16 @@ gboolean             dbusmenu_client_add_type_handler_full (DbusmenuClient * cli
 DbusmenuTextDirection dbusmenu_client_get_text_direction (DbusmenuClient * client);
 DbusmenuStatus       dbusmenu_client_get_status        (DbusmenuClient * client);
 GStrv                dbusmenu_client_get_icon_paths    (DbusmenuClient * client);
+void                 dbusmenu_client_search            (DbusmenuClient * client,
+                                                        const gchar * text,
+                                                        const gchar ** requirements,
+                                                        GCancellable * cancellable,
+                                                        GAsyncReadyCallback callback,
+                                                        gpointer user_data);
+GVariant *           dbusmenu_client_search_finish     (DbusmenuClient * client,
+                                                        GAsyncResult * result,
+                                                        guint * revision,
+                                                        GError ** error);
 
 /**
 	SECTION:client
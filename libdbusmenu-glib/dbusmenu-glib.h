@@ -32,6 +32,7 @@ License version 3 and version 2.1 along with this program.  If not, see
 #include <libdbusmenu-glib/client.h>
 #include <libdbusmenu-glib/menuitem.h>
 #include <libdbusmenu-glib/menuitem-proxy.h>
+#include <libdbusmenu-glib/mirror.h>
 #include <libdbusmenu-glib/server.h>
 
 #endif /* __DBUSMENU_GLIB_H__ */
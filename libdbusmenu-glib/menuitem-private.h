@@ -34,11 +34,16 @@ License version 3 and version 2.1 along with this program.  If not, see
 G_BEGIN_DECLS
 
 GVariant * dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse);
+GVariant * dbusmenu_menuitem_build_variant_ids (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse, gboolean prune_hidden, GHashTable * ids);
 gboolean dbusmenu_menuitem_realized (DbusmenuMenuitem * mi);
 void dbusmenu_menuitem_set_realized (DbusmenuMenuitem * mi);
 GVariant * dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** properties);
 gboolean dbusmenu_menuitem_property_is_default (DbusmenuMenuitem * mi, const gchar * property);
 gboolean dbusmenu_menuitem_exposed (DbusmenuMenuitem * mi);
+void dbusmenu_menuitem_seal (DbusmenuMenuitem * mi);
+gboolean dbusmenu_menuitem_sealed (DbusmenuMenuitem * mi);
+gboolean dbusmenu_menuitem_id_automatic (DbusmenuMenuitem * mi);
+void dbusmenu_menuitem_stand_in (DbusmenuMenuitem * mi, DbusmenuMenuitem * old);
 
 G_END_DECLS
 
@@ -38,6 +38,7 @@ struct _DbusmenuMenuitemProxyPrivate {
 	gulong sig_child_added;
 	gulong sig_child_removed;
 	gulong sig_child_moved;
+	gulong sig_child_reparented;
 };
 
 /* Properties */
@@ -100,6 +101,7 @@ dbusmenu_menuitem_proxy_init (DbusmenuMenuitemProxy *self)
 	priv->sig_child_added = 0;
 	priv->sig_child_removed = 0;
 	priv->sig_child_moved = 0;
+	priv->sig_child_reparented = 0;
 
 	return;
 }
@@ -242,6 +244,20 @@ proxy_item_child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, gui
 	return;
 }
 
+/* The wrappers don't know about each other's parents, so a child
+   that moves gets taken out of the old one and wrapped again in
+   the new one. */
+static void
+proxy_item_child_reparented (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position, gpointer user_data)
+{
+	if (dbusmenu_menuitem_get_parent(child) != parent) {
+		proxy_item_child_removed(parent, child, user_data);
+	} else {
+		proxy_item_child_added(parent, child, position, user_data);
+	}
+	return;
+}
+
 /* Making g_object_unref into a GFunc */
 static void
 func_g_object_unref (gpointer data, gpointer user_data)
@@ -268,6 +284,7 @@ add_menuitem (DbusmenuMenuitemProxy * pmi, DbusmenuMenuitem * mi)
 	priv->sig_child_added =      g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED,      G_CALLBACK(proxy_item_child_added),      pmi);
 	priv->sig_child_removed =    g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED,    G_CALLBACK(proxy_item_child_removed),    pmi);
 	priv->sig_child_moved =      g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED,      G_CALLBACK(proxy_item_child_moved),      pmi);
+	priv->sig_child_reparented = g_signal_connect(G_OBJECT(priv->mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(proxy_item_child_reparented), pmi);
 
 	/* Grab (cache) Properties */
 	GList * props = dbusmenu_menuitem_properties_list(priv->mi);
@@ -313,6 +330,9 @@ remove_menuitem (DbusmenuMenuitemProxy * pmi)
 	if (priv->sig_child_moved != 0) {
 		g_signal_handler_disconnect(G_OBJECT(priv->mi), priv->sig_child_moved);
 	}
+	if (priv->sig_child_reparented != 0) {
+		g_signal_handler_disconnect(G_OBJECT(priv->mi), priv->sig_child_reparented);
+	}
 
 	/* Unref */
 	g_object_unref(G_OBJECT(priv->mi));
@@ -56,12 +56,14 @@ License version 3 and version 2.1 along with this program.  If not, see
 struct _DbusmenuMenuitemPrivate
 {
 	gint id;
+	gboolean automatic_id;
 	GList * children;
 	GHashTable * properties;
 	gboolean root;
 	gboolean realized;
 	DbusmenuDefaults * defaults;
 	gboolean exposed;
+	gboolean sealed;
 	DbusmenuMenuitem * parent;
 };
 
@@ -76,6 +78,7 @@ enum {
 	SHOW_TO_USER,
 	ABOUT_TO_SHOW,
 	EVENT,
+	CHILD_REPARENTED,
 	LAST_SIGNAL
 };
 
@@ -202,6 +205,29 @@ dbusmenu_menuitem_class_init (DbusmenuMenuitemClass *klass)
 	                                           NULL, NULL,
 	                                           _dbusmenu_menuitem_marshal_VOID__OBJECT_UINT_UINT,
 	                                           G_TYPE_NONE, 3, G_TYPE_OBJECT, G_TYPE_UINT, G_TYPE_UINT);
+	/**
+		DbusmenuMenuitem::child-reparented:
+		@arg0: The #DbusmenuMenuitem which is either the old or the new parent.
+		@arg1: The #DbusmenuMenuitem which is the child.
+		@arg2: The #DbusmenuMenuitem which was the parent.
+		@arg3: The position that the child is being added in.
+
+		Signaled when the child menuitem has been moved from one
+		parent to another, along with all of its children.  It is
+		signaled first on the old parent and then on the new one,
+		instead of #DbusmenuMenuitem::child-removed and
+		#DbusmenuMenuitem::child-added.  The child already has
+		its new parent both times.  A #DbusmenuClient only moves
+		items this way when #DbusmenuClient:reparent-children is
+		set.
+	*/
+	signals[CHILD_REPARENTED] =   g_signal_new(DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED,
+	                                           G_TYPE_FROM_CLASS(klass),
+	                                           G_SIGNAL_RUN_LAST,
+	                                           G_STRUCT_OFFSET(DbusmenuMenuitemClass, child_reparented),
+	                                           NULL, NULL,
+	                                           _dbusmenu_menuitem_marshal_VOID__OBJECT_OBJECT_UINT,
+	                                           G_TYPE_NONE, 3, G_TYPE_OBJECT, G_TYPE_OBJECT, G_TYPE_UINT);
 	/**
 		DbusmenuMenuitem::realized:
 		@arg0: The #DbusmenuMenuitem object.
@@ -328,6 +354,7 @@ dbusmenu_menuitem_init (DbusmenuMenuitem *self)
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(self);
 
 	priv->id = -1; 
+	priv->automatic_id = FALSE;
 	priv->children = NULL;
 
 	priv->properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _g_variant_unref);
@@ -337,6 +364,7 @@ dbusmenu_menuitem_init (DbusmenuMenuitem *self)
 
 	priv->defaults = dbusmenu_defaults_ref_default();
 	priv->exposed = FALSE;
+	priv->sealed = FALSE;
 	
 	return;
 }
@@ -415,6 +443,7 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 	case PROP_ID:
 		if (priv->id == -1) {
 			priv->id = menuitem_next_id;
+			priv->automatic_id = TRUE;
 			if (menuitem_next_id == G_MAXINT) {
 				menuitem_next_id = 1;
 			} else {
@@ -608,6 +637,21 @@ take_children_helper (gpointer data, gpointer user_data)
 	return;
 }
 
+/* Sealed items belong to a server that has stopped watching
+   them, so they can't change anymore. */
+static gboolean
+sealed_check (DbusmenuMenuitem * mi)
+{
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+
+	if (priv->sealed) {
+		g_warning("Menuitem %d is sealed and can not be changed", priv->id);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 /**
  * dbusmenu_menuitem_take_children:
  * @mi: The #DbusmenMenuitem to take the children from.
@@ -626,6 +670,10 @@ dbusmenu_menuitem_take_children (DbusmenuMenuitem * mi)
 {
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
 
+	if (sealed_check(mi)) {
+		return NULL;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	GList * children = priv->children;
 	priv->children = NULL;
@@ -735,6 +783,10 @@ dbusmenu_menuitem_child_append (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
 
@@ -771,6 +823,10 @@ dbusmenu_menuitem_child_prepend (DbusmenuMenuitem * mi, DbusmenuMenuitem * child
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
 
@@ -808,6 +864,10 @@ dbusmenu_menuitem_child_delete (DbusmenuMenuitem * mi, DbusmenuMenuitem * child)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	if (dbusmenu_menuitem_get_parent(child) != mi) {
 		g_warning("Trying to remove a child that doesn't believe we're its parent.");
 		return FALSE;
@@ -847,6 +907,10 @@ dbusmenu_menuitem_child_add_position (DbusmenuMenuitem * mi, DbusmenuMenuitem *
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	g_return_val_if_fail(g_list_find(priv->children, child) == NULL, FALSE);
 
@@ -885,6 +949,10 @@ dbusmenu_menuitem_child_reorder(DbusmenuMenuitem * mi, DbusmenuMenuitem * child,
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	gint oldpos = g_list_index(priv->children, child);
 
@@ -907,6 +975,75 @@ dbusmenu_menuitem_child_reorder(DbusmenuMenuitem * mi, DbusmenuMenuitem * child,
 	return TRUE;
 }
 
+/**
+ * dbusmenu_menuitem_child_reparent:
+ * @mi: The #DbusmenuMenuitem that will become the new parent of @child
+ * @child: The #DbusmenuMenuitem that is a child of another item
+ * @position: Where in @mi object's list of chidren @child should be placed.
+ * 
+ * Moves @child, along with all of its children, from the item that
+ * it is a child of now to @mi.  Unlike deleting it and adding it
+ * again nothing below @child changes, so all that is signaled is
+ * #DbusmenuMenuitem::child-reparented on the old parent and then
+ * on @mi.  If @child isn't a child of any item this is the same
+ * as #dbusmenu_menuitem_child_add_position.
+ * 
+ * Return value: Whether @child was moved successfully.
+ */
+gboolean
+dbusmenu_menuitem_child_reparent (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(child), FALSE);
+
+	DbusmenuMenuitem * oldparent = dbusmenu_menuitem_get_parent(child);
+
+	if (oldparent == NULL) {
+		return dbusmenu_menuitem_child_add_position(mi, child, position);
+	}
+
+	if (oldparent == mi) {
+		return dbusmenu_menuitem_child_reorder(mi, child, position);
+	}
+
+	if (sealed_check(mi) || sealed_check(oldparent) || sealed_check(child)) {
+		return FALSE;
+	}
+
+	DbusmenuMenuitem * ancestor;
+	for (ancestor = mi; ancestor != NULL; ancestor = dbusmenu_menuitem_get_parent(ancestor)) {
+		if (ancestor == child) {
+			g_warning("Can not make menuitem %d a child of itself.", dbusmenu_menuitem_get_id(child));
+			return FALSE;
+		}
+	}
+
+	DbusmenuMenuitemPrivate * oldpriv = DBUSMENU_MENUITEM_GET_PRIVATE(oldparent);
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+
+	/* The reference that the old parent had moves along with it */
+	oldpriv->children = g_list_remove(oldpriv->children, child);
+	dbusmenu_menuitem_unparent(child);
+	dbusmenu_menuitem_set_parent(child, mi);
+
+	if (priv->children == NULL && !dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY)) {
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	}
+
+	priv->children = g_list_insert(priv->children, child, position);
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Menuitem %d (%s) signalling child %d (%s) reparented from %d (%s) at %d", ID(mi), LABEL(mi), ID(child), LABEL(child), ID(oldparent), LABEL(oldparent), position);
+	#endif
+	g_signal_emit(G_OBJECT(oldparent), signals[CHILD_REPARENTED], 0, child, oldparent, position, TRUE);
+	g_signal_emit(G_OBJECT(mi), signals[CHILD_REPARENTED], 0, child, oldparent, position, TRUE);
+
+	if (oldpriv->children == NULL) {
+		dbusmenu_menuitem_property_remove(oldparent, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY);
+	}
+
+	return TRUE;
+}
+
 /**
  * dbusmenu_menuitem_child_find:
  * @mi: The #DbusmenuMenuitem who's children to look on
@@ -936,28 +1073,12 @@ dbusmenu_menuitem_child_find (DbusmenuMenuitem * mi, gint id)
 	return NULL;
 }
 
-typedef struct {
-	DbusmenuMenuitem * mi;
-	gint id;
-} find_id_t;
-
-/* Basically the heart of the find_id that matches the
-   API of GFunc.  Unfortunately, this goes through all the
-   children, but it rejects them quickly. */
-static void
-find_id_helper (gpointer in_mi, gpointer in_find_id)
+/* Basically the heart of the find_id, stops the traversal
+   as soon as we've got a match. */
+static gboolean
+find_id_helper (DbusmenuMenuitem * mi, gpointer data)
 {
-	DbusmenuMenuitem * mi = (DbusmenuMenuitem *)in_mi;
-	find_id_t * find_id = (find_id_t *)in_find_id;
-
-	if (find_id->mi != NULL) return;
-	if (find_id->id == dbusmenu_menuitem_get_id(mi)) {
-		find_id->mi = mi;
-		return;
-	}
-
-	g_list_foreach(dbusmenu_menuitem_get_children(mi), find_id_helper, in_find_id);
-	return;
+	return dbusmenu_menuitem_get_id(mi) == GPOINTER_TO_INT(data);
 }
 
 /**
@@ -983,9 +1104,7 @@ dbusmenu_menuitem_find_id (DbusmenuMenuitem * mi, gint id)
 		}
 		return mi;
 	}
-	find_id_t find_id = {.mi=NULL, .id=id};
-	find_id_helper(mi, &find_id);
-	return find_id.mi;
+	return dbusmenu_menuitem_traverse(mi, G_PRE_ORDER, -1, find_id_helper, GINT_TO_POINTER(id));
 }
 
 /**
@@ -1007,6 +1126,10 @@ dbusmenu_menuitem_set_parent (DbusmenuMenuitem * mi, DbusmenuMenuitem * parent)
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 
 	if (priv->parent != NULL) {
@@ -1036,6 +1159,11 @@ gboolean
 dbusmenu_menuitem_unparent (DbusmenuMenuitem * mi)
 {
 	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 
 	if (priv->parent == NULL) {
@@ -1183,6 +1311,10 @@ dbusmenu_menuitem_property_set_variant (DbusmenuMenuitem * mi, const gchar * pro
 	g_return_val_if_fail(property != NULL, FALSE);
 	g_return_val_if_fail(g_utf8_validate(property, -1, NULL), FALSE);
 
+	if (sealed_check(mi)) {
+		return FALSE;
+	}
+
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	GVariant * default_value = NULL;
 
@@ -1462,6 +1594,89 @@ dbusmenu_menuitem_property_remove (DbusmenuMenuitem * mi, const gchar * property
 	return;
 }
 
+/**
+ * dbusmenu_menuitem_toggle_group_select:
+ * @mi: The #DbusmenuMenuitem that should become the selected member
+ * 
+ * Makes @mi the selected item of the radio group named by its
+ * #DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP property.  Only the
+ * #DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION property on the
+ * parent of @mi changes, the #DBUSMENU_MENUITEM_PROP_TOGGLE_STATE
+ * of the members is left for the clients to work out.  So switching
+ * the selection is one property update no matter how large the
+ * group is.
+ * 
+ * Return value: Whether the selection was set.  Fails if @mi has
+ * 	no parent or isn't in a group.
+ */
+gboolean
+dbusmenu_menuitem_toggle_group_select (DbusmenuMenuitem * mi)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+
+	const gchar * group = dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP);
+	if (group == NULL) {
+		return FALSE;
+	}
+
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent(mi);
+	if (parent == NULL) {
+		return FALSE;
+	}
+
+	/* Copy over the other groups that share this parent */
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{si}"));
+
+	GVariant * current = dbusmenu_menuitem_property_get_variant(parent, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION);
+	if (current != NULL && g_variant_is_of_type(current, G_VARIANT_TYPE("a{si}"))) {
+		GVariantIter iter;
+		const gchar * name;
+		gint id;
+
+		g_variant_iter_init(&iter, current);
+		while (g_variant_iter_next(&iter, "{&si}", &name, &id)) {
+			if (g_strcmp0(name, group) != 0) {
+				g_variant_builder_add(&builder, "{si}", name, id);
+			}
+		}
+	}
+
+	g_variant_builder_add(&builder, "{si}", group, dbusmenu_menuitem_get_id(mi));
+
+	return dbusmenu_menuitem_property_set_variant(parent, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION, g_variant_builder_end(&builder));
+}
+
+/**
+ * dbusmenu_menuitem_toggle_group_get_selected:
+ * @mi: The parent #DbusmenuMenuitem of the group members
+ * @group: Name of the radio group
+ * 
+ * Looks in the #DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION
+ * property of @mi for the selected member of @group.
+ * 
+ * Return value: The ID of the selected member or -1 if nothing
+ * 	in the group is selected.
+ */
+gint
+dbusmenu_menuitem_toggle_group_get_selected (DbusmenuMenuitem * mi, const gchar * group)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), -1);
+	g_return_val_if_fail(group != NULL, -1);
+
+	GVariant * current = dbusmenu_menuitem_property_get_variant(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION);
+	if (current == NULL || !g_variant_is_of_type(current, G_VARIANT_TYPE("a{si}"))) {
+		return -1;
+	}
+
+	gint id = -1;
+	if (!g_variant_lookup(current, group, "i", &id)) {
+		return -1;
+	}
+
+	return id;
+}
+
 /**
  * dbusmenu_menuitem_properties_list:
  * @mi: #DbusmenuMenuitem to list the properties on
@@ -1535,9 +1750,32 @@ variant_helper (gpointer in_key, gpointer in_value, gpointer user_data)
 	return;
 }
 
+/* Whether a list of property names is one of names to leave out,
+   those all start with a '-' */
+static gboolean
+properties_excluded (const gchar ** properties)
+{
+	int i;
+
+	if (properties == NULL || properties[0] == NULL) {
+		return FALSE;
+	}
+
+	for (i = 0; properties[i] != NULL; i++) {
+		if (properties[i][0] != '-') {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 /**
  * dbusmenu_menuitem_properties_variant:
  * @mi: #DbusmenuMenuitem to get properties from
+ * @properties: (allow-none): The names of the properties to get, or names
+ *   starting with a '-' for the properties to leave out.  %NULL for all
+ *   of them.
  * 
  * Grabs the properties of the menuitem as a GVariant with the
  * type "a{sv}".
@@ -1562,7 +1800,36 @@ dbusmenu_menuitem_properties_variant (DbusmenuMenuitem * mi, const gchar ** prop
 		final_variant = g_variant_builder_end(&builder);
 	}
 
-	if (properties != NULL) {
+	if (properties_excluded(properties)) {
+		GVariantBuilder builder;
+		gboolean builder_init = FALSE;
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, priv->properties);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			int i;
+			for (i = 0; properties[i] != NULL; i++) {
+				if (g_strcmp0(properties[i] + 1, (gchar *)key) == 0) {
+					break;
+				}
+			}
+			if (properties[i] != NULL) {
+				continue;
+			}
+
+			if (!builder_init) {
+				builder_init = TRUE;
+				g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
+			}
+
+			variant_helper(key, value, &builder);
+		}
+
+		if (builder_init) {
+			final_variant = g_variant_builder_end(&builder);
+		}
+	} else if (properties != NULL) {
 		GVariantBuilder builder;
 		gboolean builder_init = FALSE;
 		int i = 0; const gchar * prop;
@@ -1627,29 +1894,23 @@ dbusmenu_menuitem_get_root (DbusmenuMenuitem * mi)
 }
 
 
-/**
- * dbusmenu_menuitem_buildvariant:
- * @mi: #DbusmenuMenuitem to represent in a variant
- * @properties: (element-type utf8): A list of string that will be put into
- *      a variant
- * 
- * This function will put at least one entry if this menu item has no children.
- * If it has children it will put two for this entry, one representing the
- * start tag and one that is a closing tag.  It will allow its
- * children to place their own tags in the array in between those two.
- *
- * Return value: (transfer full): Variant representing @properties
-*/
-GVariant *
-dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse)
+/* Builds the variant for the item and its children, leaving out the
+   children of hidden items if @prune_hidden is set.  Items in @ids
+   are sent with the ID they map to instead of their own. */
+static GVariant *
+build_variant_internal (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse, gboolean prune_hidden, GHashTable * ids)
 {
-	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	priv->exposed = TRUE;
 
 	gint id = 0;
 	if (!dbusmenu_menuitem_get_root(mi)) {
-		id = dbusmenu_menuitem_get_id(mi);
+		gpointer mapped;
+		if (ids != NULL && g_hash_table_lookup_extended(ids, mi, NULL, &mapped)) {
+			id = GPOINTER_TO_INT(mapped);
+		} else {
+			id = dbusmenu_menuitem_get_id(mi);
+		}
 	}
 
 	/* This is the tuple that'll build up being a representation of
@@ -1672,6 +1933,10 @@ dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** propertie
 
 	/* Pillage the children */
 	GList * children = dbusmenu_menuitem_get_children(mi);
+	if (prune_hidden && !priv->root && !dbusmenu_menuitem_property_get_bool(mi, DBUSMENU_MENUITEM_PROP_VISIBLE)) {
+		children = NULL;
+	}
+
 	if (children == NULL || recurse == 0) {
 		g_variant_builder_add_value(&tupleb, g_variant_new_array(G_VARIANT_TYPE_VARIANT, NULL, 0));
 	} else {
@@ -1679,7 +1944,7 @@ dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** propertie
 		g_variant_builder_init(&childrenbuilder, G_VARIANT_TYPE_ARRAY);
 
 		for ( ; children != NULL; children = children->next) {
-			GVariant * child = dbusmenu_menuitem_build_variant(DBUSMENU_MENUITEM(children->data), properties, recurse - 1);
+			GVariant * child = build_variant_internal(DBUSMENU_MENUITEM(children->data), properties, recurse - 1, prune_hidden, ids);
 
 			g_variant_builder_add_value(&childrenbuilder, g_variant_new_variant(child));
 		}
@@ -1690,6 +1955,39 @@ dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** propertie
 	return g_variant_builder_end(&tupleb);
 }
 
+/**
+ * dbusmenu_menuitem_buildvariant:
+ * @mi: #DbusmenuMenuitem to represent in a variant
+ * @properties: (element-type utf8): A list of string that will be put into
+ *      a variant
+ * 
+ * This function will put at least one entry if this menu item has no children.
+ * If it has children it will put two for this entry, one representing the
+ * start tag and one that is a closing tag.  It will allow its
+ * children to place their own tags in the array in between those two.
+ *
+ * Return value: (transfer full): Variant representing @properties
+*/
+GVariant *
+dbusmenu_menuitem_build_variant (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
+	return build_variant_internal(mi, properties, recurse, FALSE, NULL);
+}
+
+/* Like dbusmenu_menuitem_build_variant(), but with the IDs in @ids,
+   which maps a #DbusmenuMenuitem to the ID that it is known by on
+   the bus, used in place of the items' own.  With @prune_hidden
+   items that aren't visible are put in without their children, and
+   the children aren't marked as exposed either, so their property
+   changes don't get sent until they are. */
+GVariant *
+dbusmenu_menuitem_build_variant_ids (DbusmenuMenuitem * mi, const gchar ** properties, gint recurse, gboolean prune_hidden, GHashTable * ids)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
+	return build_variant_internal(mi, properties, recurse, prune_hidden, ids);
+}
+
 typedef struct {
 	void (*func) (DbusmenuMenuitem * mi, gpointer data);
 	gpointer data;
@@ -1726,6 +2024,96 @@ dbusmenu_menuitem_foreach (DbusmenuMenuitem * mi, void (*func) (DbusmenuMenuitem
 	return;
 }
 
+/* How deep we remember where we are in each list of children.
+   Deeper than this and we look ourselves up in our parent's
+   list when climbing back out. */
+#define TRAVERSE_STACK_SIZE  32
+
+/**
+ * dbusmenu_menuitem_traverse:
+ * @mi: The #DbusmenuMenuitem to start from
+ * @order: Either #G_PRE_ORDER or #G_POST_ORDER
+ * @max_depth: The maximum depth to visit, where @mi is at depth one,
+ * 	or -1 for the whole tree
+ * @func: (scope call): Function to call on the menu items, returning #TRUE stops
+ * 	the traversal
+ * @data: (closure): User data to pass to the function
+ * 
+ * Walks the tree under @mi depth first, calling @func on each
+ * item either before (#G_PRE_ORDER) or after (#G_POST_ORDER) its
+ * children.  It doesn't recurse or allocate memory, so it is safe
+ * on very deep trees, and unlike dbusmenu_menuitem_foreach() @func
+ * can stop it as soon as it has found what it is looking for.
+ * @func must not add or remove menu items in the tree.
+ * 
+ * Return value: (transfer none): The #DbusmenuMenuitem that @func
+ * 	returned #TRUE for or #NULL if the whole tree was visited.
+ */
+DbusmenuMenuitem *
+dbusmenu_menuitem_traverse (DbusmenuMenuitem * mi, GTraverseType order, gint max_depth, dbusmenu_menuitem_traverse_cb func, gpointer data)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), NULL);
+	g_return_val_if_fail(order == G_PRE_ORDER || order == G_POST_ORDER, NULL);
+	g_return_val_if_fail(max_depth == -1 || max_depth > 0, NULL);
+	g_return_val_if_fail(func != NULL, NULL);
+
+	/* links[depth] is the entry for the current item at that
+	   depth in the list of its parent's children */
+	GList * links[TRAVERSE_STACK_SIZE] = { NULL };
+	DbusmenuMenuitem * current = mi;
+	gint depth = 1;
+
+	while (TRUE) {
+		/* First time we get to an item */
+		if (order == G_PRE_ORDER && func(current, data)) {
+			return current;
+		}
+
+		GList * children = current->priv->children;
+		if (children != NULL && (max_depth == -1 || depth < max_depth)) {
+			depth++;
+			if (depth < TRAVERSE_STACK_SIZE) {
+				links[depth] = children;
+			}
+			current = DBUSMENU_MENUITEM(children->data);
+			continue;
+		}
+
+		/* Done with this item, find the next one by going
+		   across or climbing back up */
+		while (TRUE) {
+			if (order == G_POST_ORDER && func(current, data)) {
+				return current;
+			}
+
+			if (current == mi) {
+				return NULL;
+			}
+
+			DbusmenuMenuitem * parent = current->priv->parent;
+			GList * link = NULL;
+			if (depth < TRAVERSE_STACK_SIZE) {
+				link = links[depth];
+			} else {
+				link = g_list_find(parent->priv->children, current);
+			}
+
+			if (link->next != NULL) {
+				if (depth < TRAVERSE_STACK_SIZE) {
+					links[depth] = link->next;
+				}
+				current = DBUSMENU_MENUITEM(link->next->data);
+				break;
+			}
+
+			current = parent;
+			depth--;
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * dbusmenu_menuitem_handle_event:
  * @mi: The #DbusmenuMenuitem to send the signal on.
@@ -1845,3 +2233,48 @@ dbusmenu_menuitem_exposed (DbusmenuMenuitem * mi)
 	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
 	return priv->exposed;
 }
+
+/* Marks @mi as not changing anymore, see #dbusmenu_server_seal */
+void
+dbusmenu_menuitem_seal (DbusmenuMenuitem * mi)
+{
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	priv->sealed = TRUE;
+	return;
+}
+
+/* Whether @mi has been sealed */
+gboolean
+dbusmenu_menuitem_sealed (DbusmenuMenuitem * mi)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	return priv->sealed;
+}
+
+/* Whether the ID of @mi was picked for it rather than being
+   asked for when it was built */
+gboolean
+dbusmenu_menuitem_id_automatic (DbusmenuMenuitem * mi)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MENUITEM(mi), FALSE);
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	dbusmenu_menuitem_get_id(mi);
+	return priv->automatic_id;
+}
+
+/* @mi is standing in for @old, which the clients already have, so
+   if @old was sent out then @mi is counted as sent too. */
+void
+dbusmenu_menuitem_stand_in (DbusmenuMenuitem * mi, DbusmenuMenuitem * old)
+{
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(mi));
+	g_return_if_fail(DBUSMENU_IS_MENUITEM(old));
+	DbusmenuMenuitemPrivate * priv = DBUSMENU_MENUITEM_GET_PRIVATE(mi);
+	DbusmenuMenuitemPrivate * old_priv = DBUSMENU_MENUITEM_GET_PRIVATE(old);
+
+	priv->exposed = priv->exposed || old_priv->exposed;
+
+	return;
+}
@@ -74,6 +74,12 @@ G_BEGIN_DECLS
  * String to attach to signal #DbusmenuServer::child-moved
  */
 #define DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED         "child-moved"
+/**
+ * DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED:
+ *
+ * String to attach to signal #DbusmenuServer::child-reparented
+ */
+#define DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED    "child-reparented"
 /**
  * DBUSMENU_MENUITEM_SIGNAL_REALIZED:
  *
@@ -182,6 +188,26 @@ G_BEGIN_DECLS
  * Type: #G_VARIANT_TYPE_INT32
  */
 #define DBUSMENU_MENUITEM_PROP_TOGGLE_STATE          "toggle-state"
+/**
+ * DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP:
+ *
+ * #DbusmenuMenuitem property that names the radio group that this
+ * item belongs to.  Items with the same group name under the same
+ * parent get their #DBUSMENU_MENUITEM_PROP_TOGGLE_STATE from the
+ * parent's #DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION instead
+ * of having it set on each of them.  Type: #G_VARIANT_TYPE_STRING
+ */
+#define DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP          "toggle-group"
+/**
+ * DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION:
+ *
+ * #DbusmenuMenuitem property on the parent of radio group members
+ * that maps each group name to the ID of the selected member.  It is
+ * recommended that this is set with dbusmenu_menuitem_toggle_group_select()
+ * so that changing the selection is a single property change.
+ * Type: #G_VARIANT_TYPE_DICTIONARY of string to #G_VARIANT_TYPE_INT32
+ */
+#define DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP_SELECTION "toggle-group-selection"
 /**
  * DBUSMENU_MENUITEM_PROP_SHORTCUT:
  *
@@ -403,6 +429,17 @@ struct _DbusmenuMenuitem
  */
 typedef void (*dbusmenu_menuitem_about_to_show_cb) (DbusmenuMenuitem * mi, gpointer user_data);
 
+/**
+ * dbusmenu_menuitem_traverse_cb:
+ * @mi: Menu item that is being visited
+ * @user_data: (closure): Extra user data sent with the function
+ * 
+ * Callback prototype for dbusmenu_menuitem_traverse().
+ * 
+ * Return value: #TRUE to stop the traversal at @mi
+ */
+typedef gboolean (*dbusmenu_menuitem_traverse_cb) (DbusmenuMenuitem * mi, gpointer user_data);
+
 /**
  * dbusmenu_menuitem_buildvariant_slot_t:
  * @mi: (in): Menu item that should be built from
@@ -430,7 +467,7 @@ typedef GVariant * (*dbusmenu_menuitem_buildvariant_slot_t) (DbusmenuMenuitem *
  * @send_about_to_show: Virtual function that notifies server that the client is about to show a menu.
  * @show_to_user: Slot for #DbusmenuMenuitem::show-to-user.
  * @event: Slot for #DbsumenuMenuitem::event.
- * @reserved1: Reserved for future use.
+ * @child_reparented: Slot for #DbusmenuMenuitem::child-reparented.
  * @reserved2: Reserved for future use.
  * @reserved3: Reserved for future use.
  * @reserved4: Reserved for future use.
@@ -462,8 +499,9 @@ struct _DbusmenuMenuitemClass
 
 	void (*event) (const gchar * name, GVariant * value, guint timestamp);
 
+	void (*child_reparented) (DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position);
+
 	/*< Private >*/
-	void (*reserved1) (void);
 	void (*reserved2) (void);
 	void (*reserved3) (void);
 	void (*reserved4) (void);
@@ -486,6 +524,7 @@ gboolean dbusmenu_menuitem_child_prepend (DbusmenuMenuitem * mi, DbusmenuMenuite
 gboolean dbusmenu_menuitem_child_delete (DbusmenuMenuitem * mi, DbusmenuMenuitem * child);
 gboolean dbusmenu_menuitem_child_add_position (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position);
 gboolean dbusmenu_menuitem_child_reorder (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position);
+gboolean dbusmenu_menuitem_child_reparent (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position);
 DbusmenuMenuitem * dbusmenu_menuitem_child_find (DbusmenuMenuitem * mi, gint id);
 DbusmenuMenuitem * dbusmenu_menuitem_find_id (DbusmenuMenuitem * mi, gint id);
 
@@ -508,10 +547,14 @@ GList * dbusmenu_menuitem_properties_list (DbusmenuMenuitem * mi) G_GNUC_WARN_UN
 GHashTable * dbusmenu_menuitem_properties_copy (DbusmenuMenuitem * mi);
 void dbusmenu_menuitem_property_remove (DbusmenuMenuitem * mi, const gchar * property);
 
+gboolean dbusmenu_menuitem_toggle_group_select (DbusmenuMenuitem * mi);
+gint dbusmenu_menuitem_toggle_group_get_selected (DbusmenuMenuitem * mi, const gchar * group);
+
 void dbusmenu_menuitem_set_root (DbusmenuMenuitem * mi, gboolean root);
 gboolean dbusmenu_menuitem_get_root (DbusmenuMenuitem * mi);
 
 void dbusmenu_menuitem_foreach (DbusmenuMenuitem * mi, void (*func) (DbusmenuMenuitem * mi, gpointer data), gpointer data);
+DbusmenuMenuitem * dbusmenu_menuitem_traverse (DbusmenuMenuitem * mi, GTraverseType order, gint max_depth, dbusmenu_menuitem_traverse_cb func, gpointer data);
 void dbusmenu_menuitem_handle_event (DbusmenuMenuitem * mi, const gchar * name, GVariant * variant, guint timestamp);
 void dbusmenu_menuitem_send_about_to_show (DbusmenuMenuitem * mi, void (*cb) (DbusmenuMenuitem * mi, gpointer user_data), gpointer cb_data);
 
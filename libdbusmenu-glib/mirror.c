@@ -0,0 +1,980 @@
+/*
+A read only copy of a remote menu that doesn't build menuitems.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of either or both of the following licenses:
+
+1) the GNU Lesser General Public License version 3, as published by the
+Free Software Foundation; and/or
+2) the GNU Lesser General Public License version 2.1, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the applicable version of the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of both the GNU Lesser General Public
+License version 3 and version 2.1 along with this program.  If not, see
+<http://www.gnu.org/licenses/>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "mirror.h"
+
+#define DBUSMENU_INTERFACE  "com.canonical.dbusmenu"
+
+/* Properties */
+enum {
+	PROP_0,
+	PROP_DBUSOBJECT,
+	PROP_DBUSNAME,
+	PROP_DBUSCONNECTION
+};
+
+/* Signals */
+enum {
+	LAYOUT_CHANGED,
+	PROPERTIES_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* One entry in the table.  The items are in tree order so the
+   children of an item are the @size - 1 entries that follow it. */
+typedef struct _mirror_item_t mirror_item_t;
+struct _mirror_item_t {
+	gint id;
+	gint parent;    /* position of the parent, -1 for the root */
+	guint size;     /* entries in the subtree, including this one */
+	GVariant * properties; /* type: a{sv} */
+};
+
+struct _DbusmenuMirrorPrivate
+{
+	gchar * dbus_name;
+	gchar * dbus_object;
+
+	GDBusConnection * bus;
+	GCancellable * bus_cancel;
+
+	guint name_watch;
+	guint signal_sub;
+	gboolean have_server;
+
+	GCancellable * layoutcall;
+	gboolean layout_dirty;
+	guint revision;
+
+	GArray * items;       /* type: mirror_item_t */
+	GHashTable * index;   /* id -> position in items + 1 */
+};
+
+#define DBUSMENU_MIRROR_GET_PRIVATE(o) (DBUSMENU_MIRROR(o)->priv)
+
+static void dbusmenu_mirror_class_init (DbusmenuMirrorClass *klass);
+static void dbusmenu_mirror_init       (DbusmenuMirror *self);
+static void dbusmenu_mirror_constructed (GObject *object);
+static void dbusmenu_mirror_dispose    (GObject *object);
+static void dbusmenu_mirror_finalize   (GObject *object);
+static void set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec);
+static void get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec);
+static void start_watching (DbusmenuMirror * mirror);
+static void layout_fetch (DbusmenuMirror * mirror);
+static void items_clear (DbusmenuMirror * mirror);
+
+G_DEFINE_TYPE (DbusmenuMirror, dbusmenu_mirror, G_TYPE_OBJECT);
+
+static void
+dbusmenu_mirror_class_init (DbusmenuMirrorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DbusmenuMirrorPrivate));
+
+	object_class->constructed = dbusmenu_mirror_constructed;
+	object_class->dispose = dbusmenu_mirror_dispose;
+	object_class->finalize = dbusmenu_mirror_finalize;
+	object_class->set_property = set_property;
+	object_class->get_property = get_property;
+
+	/**
+		DbusmenuMirror::layout-changed:
+		@arg0: The #DbusmenuMirror object
+
+		Tells that items have been added, removed or moved.  All
+		the items are in place when it is emitted.
+	*/
+	signals[LAYOUT_CHANGED]     = g_signal_new(DBUSMENU_MIRROR_SIGNAL_LAYOUT_CHANGED,
+	                                           G_TYPE_FROM_CLASS (klass),
+	                                           G_SIGNAL_RUN_LAST,
+	                                           G_STRUCT_OFFSET (DbusmenuMirrorClass, layout_changed),
+	                                           NULL, NULL,
+	                                           g_cclosure_marshal_VOID__VOID,
+	                                           G_TYPE_NONE, 0, G_TYPE_NONE);
+	/**
+		DbusmenuMirror::properties-changed:
+		@arg0: The #DbusmenuMirror object
+		@arg1: A #GVariant of type "ai" with the IDs of the items
+
+		Tells that the properties of some items changed, one signal
+		for each batch the server sends.
+	*/
+	signals[PROPERTIES_CHANGED] = g_signal_new(DBUSMENU_MIRROR_SIGNAL_PROPERTIES_CHANGED,
+	                                           G_TYPE_FROM_CLASS (klass),
+	                                           G_SIGNAL_RUN_LAST,
+	                                           G_STRUCT_OFFSET (DbusmenuMirrorClass, properties_changed),
+	                                           NULL, NULL,
+	                                           g_cclosure_marshal_VOID__VARIANT,
+	                                           G_TYPE_NONE, 1, G_TYPE_VARIANT);
+
+	g_object_class_install_property (object_class, PROP_DBUSOBJECT,
+	                                 g_param_spec_string(DBUSMENU_MIRROR_PROP_DBUS_OBJECT, "DBus Object we represent",
+	                                              "The Object on the server that we're getting our data from.",
+	                                              NULL,
+	                                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_DBUSNAME,
+	                                 g_param_spec_string(DBUSMENU_MIRROR_PROP_DBUS_NAME, "DBus Client we connect to",
+	                                              "Name of the DBus client we're connecting to.",
+	                                              NULL,
+	                                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_DBUSCONNECTION,
+	                                 g_param_spec_object(DBUSMENU_MIRROR_PROP_DBUS_CONNECTION, "DBus connection to use",
+	                                              "The connection to find the server on.  If not set the session bus is used.",
+	                                              G_TYPE_DBUS_CONNECTION,
+	                                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+	return;
+}
+
+static void
+mirror_item_clear (gpointer data)
+{
+	mirror_item_t * item = (mirror_item_t *)data;
+
+	if (item->properties != NULL) {
+		g_variant_unref(item->properties);
+		item->properties = NULL;
+	}
+
+	return;
+}
+
+static void
+dbusmenu_mirror_init (DbusmenuMirror *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self), DBUSMENU_TYPE_MIRROR, DbusmenuMirrorPrivate);
+
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(self);
+
+	priv->dbus_name = NULL;
+	priv->dbus_object = NULL;
+
+	priv->bus = NULL;
+	priv->bus_cancel = NULL;
+
+	priv->name_watch = 0;
+	priv->signal_sub = 0;
+	priv->have_server = FALSE;
+
+	priv->layoutcall = NULL;
+	priv->layout_dirty = FALSE;
+	priv->revision = 0;
+
+	priv->items = g_array_new(FALSE, FALSE, sizeof(mirror_item_t));
+	g_array_set_clear_func(priv->items, mirror_item_clear);
+	priv->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	return;
+}
+
+/* Got the session bus, now we can look for the server */
+static void
+session_bus_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GDBusConnection * bus = g_bus_get_finish(res, &error);
+
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* Cancelled means we're gone, and dispose has cleaned up */
+		g_error_free(error);
+		return;
+	}
+
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(user_data);
+
+	g_object_unref(priv->bus_cancel);
+	priv->bus_cancel = NULL;
+
+	if (error != NULL) {
+		g_warning("Unable to get session bus: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	priv->bus = bus;
+	start_watching(DBUSMENU_MIRROR(user_data));
+
+	return;
+}
+
+static void
+dbusmenu_mirror_constructed (GObject *object)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(object);
+
+	if (priv->bus != NULL) {
+		start_watching(DBUSMENU_MIRROR(object));
+	} else {
+		priv->bus_cancel = g_cancellable_new();
+		g_bus_get(G_BUS_TYPE_SESSION, priv->bus_cancel, session_bus_cb, object);
+	}
+
+	G_OBJECT_CLASS (dbusmenu_mirror_parent_class)->constructed (object);
+	return;
+}
+
+static void
+dbusmenu_mirror_dispose (GObject *object)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(object);
+
+	if (priv->bus_cancel != NULL) {
+		g_cancellable_cancel(priv->bus_cancel);
+		g_object_unref(priv->bus_cancel);
+		priv->bus_cancel = NULL;
+	}
+
+	if (priv->layoutcall != NULL) {
+		g_cancellable_cancel(priv->layoutcall);
+		g_object_unref(priv->layoutcall);
+		priv->layoutcall = NULL;
+	}
+
+	if (priv->name_watch != 0) {
+		g_bus_unwatch_name(priv->name_watch);
+		priv->name_watch = 0;
+	}
+
+	if (priv->signal_sub != 0) {
+		g_dbus_connection_signal_unsubscribe(priv->bus, priv->signal_sub);
+		priv->signal_sub = 0;
+	}
+
+	if (priv->bus != NULL) {
+		g_object_unref(priv->bus);
+		priv->bus = NULL;
+	}
+
+	G_OBJECT_CLASS (dbusmenu_mirror_parent_class)->dispose (object);
+	return;
+}
+
+static void
+dbusmenu_mirror_finalize (GObject *object)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(object);
+
+	g_free(priv->dbus_name);
+	g_free(priv->dbus_object);
+
+	g_array_free(priv->items, TRUE);
+	g_hash_table_destroy(priv->index);
+
+	G_OBJECT_CLASS (dbusmenu_mirror_parent_class)->finalize (object);
+	return;
+}
+
+static void
+set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(obj);
+
+	switch (id) {
+	case PROP_DBUSNAME:
+		priv->dbus_name = g_value_dup_string(value);
+		break;
+	case PROP_DBUSOBJECT:
+		priv->dbus_object = g_value_dup_string(value);
+		break;
+	case PROP_DBUSCONNECTION:
+		priv->bus = g_value_dup_object(value);
+		break;
+	default:
+		g_warning("Unknown property %d.", id);
+		return;
+	}
+
+	return;
+}
+
+static void
+get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(obj);
+
+	switch (id) {
+	case PROP_DBUSNAME:
+		g_value_set_string(value, priv->dbus_name);
+		break;
+	case PROP_DBUSOBJECT:
+		g_value_set_string(value, priv->dbus_object);
+		break;
+	case PROP_DBUSCONNECTION:
+		g_value_set_object(value, priv->bus);
+		break;
+	default:
+		g_warning("Unknown property %d.", id);
+		return;
+	}
+
+	return;
+}
+
+/* Internal funcs */
+
+/* Finds the position of an item in the table */
+static mirror_item_t *
+item_lookup (DbusmenuMirror * mirror, gint id, guint * position)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	guint found = GPOINTER_TO_UINT(g_hash_table_lookup(priv->index, GINT_TO_POINTER(id)));
+	if (found == 0) {
+		return NULL;
+	}
+
+	if (position != NULL) {
+		*position = found - 1;
+	}
+
+	return &g_array_index(priv->items, mirror_item_t, found - 1);
+}
+
+/* Adds an item and all of its children to the end of the table */
+static void
+items_flatten (DbusmenuMirror * mirror, GVariant * layout, gint parent)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+	guint position = priv->items->len;
+
+	mirror_item_t item = {0};
+	g_variant_get_child(layout, 0, "i", &item.id);
+	item.parent = parent;
+	item.properties = g_variant_get_child_value(layout, 1);
+
+	if (g_hash_table_lookup(priv->index, GINT_TO_POINTER(item.id)) != NULL) {
+		g_warning("Item %d is in the layout twice, ignoring the second one", item.id);
+		g_variant_unref(item.properties);
+		return;
+	}
+
+	g_array_append_val(priv->items, item);
+	g_hash_table_insert(priv->index, GINT_TO_POINTER(item.id), GUINT_TO_POINTER(position + 1));
+
+	GVariant * children = g_variant_get_child_value(layout, 2);
+	GVariantIter iter;
+	GVariant * child;
+
+	g_variant_iter_init(&iter, children);
+	while (g_variant_iter_loop(&iter, "v", &child)) {
+		if (!g_variant_is_of_type(child, G_VARIANT_TYPE("(ia{sv}av)"))) {
+			g_warning("Child of item %d is of type '%s' instead of '(ia{sv}av)'", item.id, g_variant_get_type_string(child));
+			continue;
+		}
+		items_flatten(mirror, child, position);
+	}
+	g_variant_unref(children);
+
+	/* The table might have moved while adding the children */
+	g_array_index(priv->items, mirror_item_t, position).size = priv->items->len - position;
+
+	return;
+}
+
+/* Drops all of the items */
+static void
+items_clear (DbusmenuMirror * mirror)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	g_array_set_size(priv->items, 0);
+	g_hash_table_remove_all(priv->index);
+
+	return;
+}
+
+/* Got a whole new layout, replace the table with it */
+static void
+layout_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GVariant * params = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+
+	if (error != NULL && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* We might be gone */
+		g_error_free(error);
+		return;
+	}
+
+	DbusmenuMirror * mirror = DBUSMENU_MIRROR(user_data);
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	g_object_unref(priv->layoutcall);
+	priv->layoutcall = NULL;
+
+	if (error != NULL) {
+		g_warning("Unable to get the layout: %s", error->message);
+		g_error_free(error);
+	} else {
+		GVariant * layout = NULL;
+		g_variant_get(params, "(u@(ia{sv}av))", &priv->revision, &layout);
+
+		items_clear(mirror);
+		items_flatten(mirror, layout, -1);
+
+		g_variant_unref(layout);
+		g_variant_unref(params);
+	}
+
+	/* Changed again while we were asking */
+	if (priv->layout_dirty) {
+		layout_fetch(mirror);
+	}
+
+	if (error == NULL) {
+		g_signal_emit(G_OBJECT(mirror), signals[LAYOUT_CHANGED], 0);
+	}
+
+	return;
+}
+
+/* Asks for the whole layout, or for it again when the one we're
+   waiting on comes back */
+static void
+layout_fetch (DbusmenuMirror * mirror)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	if (priv->layoutcall != NULL) {
+		priv->layout_dirty = TRUE;
+		return;
+	}
+
+	priv->layout_dirty = FALSE;
+	priv->layoutcall = g_cancellable_new();
+
+	const gchar * props[] = { NULL };
+	g_dbus_connection_call(priv->bus,
+	                       priv->dbus_name,
+	                       priv->dbus_object,
+	                       DBUSMENU_INTERFACE,
+	                       "GetLayout",
+	                       g_variant_new("(ii^as)", 0, -1, props),
+	                       G_VARIANT_TYPE("(u(ia{sv}av))"),
+	                       G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                       -1,   /* timeout */
+	                       priv->layoutcall,
+	                       layout_cb,
+	                       mirror);
+
+	return;
+}
+
+/* Builds a new set of properties from the old ones with the
+   changes from the server */
+static void
+item_merge (mirror_item_t * item, GVariant * updated, GVariant * removed)
+{
+	GVariantBuilder builder;
+	GVariantIter iter;
+	const gchar * name;
+	GVariant * value;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+	g_variant_iter_init(&iter, item->properties);
+	while (g_variant_iter_loop(&iter, "{&sv}", &name, &value)) {
+		if (updated != NULL) {
+			GVariant * replaced = g_variant_lookup_value(updated, name, NULL);
+			if (replaced != NULL) {
+				g_variant_unref(replaced);
+				continue;
+			}
+		}
+
+		if (removed != NULL) {
+			gboolean gone = FALSE;
+			GVariantIter riter;
+			const gchar * rname;
+
+			g_variant_iter_init(&riter, removed);
+			while (!gone && g_variant_iter_next(&riter, "&s", &rname)) {
+				gone = g_strcmp0(rname, name) == 0;
+			}
+
+			if (gone) {
+				continue;
+			}
+		}
+
+		g_variant_builder_add(&builder, "{sv}", name, value);
+	}
+
+	if (updated != NULL) {
+		g_variant_iter_init(&iter, updated);
+		while (g_variant_iter_loop(&iter, "{&sv}", &name, &value)) {
+			g_variant_builder_add(&builder, "{sv}", name, value);
+		}
+	}
+
+	g_variant_unref(item->properties);
+	item->properties = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+	return;
+}
+
+/* Applies a batch of property changes and tells everyone which
+   items they were on */
+static void
+items_properties_updated (DbusmenuMirror * mirror, GVariant * updated, GVariant * removed)
+{
+	GHashTable * changed = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GVariantBuilder builder;
+	gboolean have_changes = FALSE;
+	GVariantIter iter;
+	gint id;
+	GVariant * props;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("ai"));
+
+	g_variant_iter_init(&iter, updated);
+	while (g_variant_iter_loop(&iter, "(i@a{sv})", &id, &props)) {
+		mirror_item_t * item = item_lookup(mirror, id, NULL);
+		if (item == NULL) {
+			continue;
+		}
+
+		item_merge(item, props, NULL);
+
+		if (g_hash_table_add(changed, GINT_TO_POINTER(id))) {
+			g_variant_builder_add(&builder, "i", id);
+			have_changes = TRUE;
+		}
+	}
+
+	g_variant_iter_init(&iter, removed);
+	while (g_variant_iter_loop(&iter, "(i@as)", &id, &props)) {
+		mirror_item_t * item = item_lookup(mirror, id, NULL);
+		if (item == NULL) {
+			continue;
+		}
+
+		item_merge(item, NULL, props);
+
+		if (g_hash_table_add(changed, GINT_TO_POINTER(id))) {
+			g_variant_builder_add(&builder, "i", id);
+			have_changes = TRUE;
+		}
+	}
+
+	g_hash_table_destroy(changed);
+
+	GVariant * ids = g_variant_ref_sink(g_variant_builder_end(&builder));
+	if (have_changes) {
+		g_signal_emit(G_OBJECT(mirror), signals[PROPERTIES_CHANGED], 0, ids);
+	}
+	g_variant_unref(ids);
+
+	return;
+}
+
+/* Signals from the server */
+static void
+server_signal_cb (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	DbusmenuMirror * mirror = DBUSMENU_MIRROR(user_data);
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	if (!priv->have_server) {
+		return;
+	}
+
+	if (g_strcmp0(signal, "LayoutUpdated") == 0) {
+		guint revision;
+		gint parent;
+		g_variant_get(params, "(ui)", &revision, &parent);
+
+		if (revision > priv->revision || priv->layoutcall != NULL) {
+			layout_fetch(mirror);
+		}
+	} else if (g_strcmp0(signal, "ItemsPropertiesUpdated") == 0) {
+		/* The layout we're waiting on already has these */
+		if (priv->layoutcall != NULL) {
+			return;
+		}
+
+		GVariant * updated = g_variant_get_child_value(params, 0);
+		GVariant * removed = g_variant_get_child_value(params, 1);
+		items_properties_updated(mirror, updated, removed);
+		g_variant_unref(updated);
+		g_variant_unref(removed);
+	}
+
+	return;
+}
+
+static void
+name_appeared (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(user_data);
+
+	priv->have_server = TRUE;
+	priv->revision = 0;
+	layout_fetch(DBUSMENU_MIRROR(user_data));
+
+	return;
+}
+
+static void
+name_vanished (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	DbusmenuMirror * mirror = DBUSMENU_MIRROR(user_data);
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	priv->have_server = FALSE;
+
+	if (priv->layoutcall != NULL) {
+		g_cancellable_cancel(priv->layoutcall);
+		g_object_unref(priv->layoutcall);
+		priv->layoutcall = NULL;
+	}
+
+	if (priv->items->len > 0) {
+		items_clear(mirror);
+		g_signal_emit(G_OBJECT(mirror), signals[LAYOUT_CHANGED], 0);
+	}
+
+	return;
+}
+
+/* Listens to the server and waits for it to show up.  A peer
+   connection doesn't have names, the server is just there. */
+static void
+start_watching (DbusmenuMirror * mirror)
+{
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+
+	g_return_if_fail(priv->dbus_object != NULL);
+
+	gboolean peer = g_dbus_connection_get_unique_name(priv->bus) == NULL;
+	if (peer) {
+		g_free(priv->dbus_name);
+		priv->dbus_name = NULL;
+	}
+
+	priv->signal_sub = g_dbus_connection_signal_subscribe(priv->bus,
+	                                                      priv->dbus_name,
+	                                                      DBUSMENU_INTERFACE,
+	                                                      NULL, /* all signals */
+	                                                      priv->dbus_object,
+	                                                      NULL, /* arg0 */
+	                                                      G_DBUS_SIGNAL_FLAGS_NONE,
+	                                                      server_signal_cb,
+	                                                      mirror,
+	                                                      NULL);
+
+	if (peer) {
+		priv->have_server = TRUE;
+		layout_fetch(mirror);
+	} else {
+		g_return_if_fail(priv->dbus_name != NULL);
+		priv->name_watch = g_bus_watch_name_on_connection(priv->bus,
+		                                                  priv->dbus_name,
+		                                                  G_BUS_NAME_WATCHER_FLAGS_NONE,
+		                                                  name_appeared,
+		                                                  name_vanished,
+		                                                  mirror,
+		                                                  NULL);
+	}
+
+	return;
+}
+
+/* Public API */
+
+/**
+ * dbusmenu_mirror_new:
+ * @name: The DBus name for the server to connect to
+ * @object: The object on the server to monitor
+ *
+ * Makes a read only copy of the menu on the session bus at
+ * @name and @object.  It'll start out empty until the server
+ * shows up and sends its layout.
+ *
+ * Return value: A brand new #DbusmenuMirror
+ */
+DbusmenuMirror *
+dbusmenu_mirror_new (const gchar * name, const gchar * object)
+{
+	g_return_val_if_fail(g_dbus_is_name(name), NULL);
+	g_return_val_if_fail(g_variant_is_object_path(object), NULL);
+
+	return g_object_new(DBUSMENU_TYPE_MIRROR,
+	                    DBUSMENU_MIRROR_PROP_DBUS_NAME, name,
+	                    DBUSMENU_MIRROR_PROP_DBUS_OBJECT, object,
+	                    NULL);
+}
+
+/**
+ * dbusmenu_mirror_new_for_connection:
+ * @connection: The #GDBusConnection to find the server on
+ * @name: (allow-none): The DBus name for the server, NULL on a peer connection
+ * @object: The object on the server to monitor
+ *
+ * Like #dbusmenu_mirror_new but uses @connection instead of the
+ * session bus.
+ *
+ * Return value: A brand new #DbusmenuMirror
+ */
+DbusmenuMirror *
+dbusmenu_mirror_new_for_connection (GDBusConnection * connection, const gchar * name, const gchar * object)
+{
+	g_return_val_if_fail(G_IS_DBUS_CONNECTION(connection), NULL);
+	g_return_val_if_fail(name == NULL || g_dbus_is_name(name), NULL);
+	g_return_val_if_fail(g_variant_is_object_path(object), NULL);
+
+	return g_object_new(DBUSMENU_TYPE_MIRROR,
+	                    DBUSMENU_MIRROR_PROP_DBUS_CONNECTION, connection,
+	                    DBUSMENU_MIRROR_PROP_DBUS_NAME, name,
+	                    DBUSMENU_MIRROR_PROP_DBUS_OBJECT, object,
+	                    NULL);
+}
+
+/**
+ * dbusmenu_mirror_get_n_items:
+ * @mirror: The #DbusmenuMirror to look in
+ *
+ * Counts the items in the menu, including the root.
+ *
+ * Return value: The number of items, zero if there's no layout yet
+ */
+guint
+dbusmenu_mirror_get_n_items (DbusmenuMirror * mirror)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), 0);
+
+	return DBUSMENU_MIRROR_GET_PRIVATE(mirror)->items->len;
+}
+
+/**
+ * dbusmenu_mirror_has_item:
+ * @mirror: The #DbusmenuMirror to look in
+ * @id: ID of the item
+ *
+ * Checks whether there's an item with @id in the menu.
+ *
+ * Return value: Whether the item is there
+ */
+gboolean
+dbusmenu_mirror_has_item (DbusmenuMirror * mirror, gint id)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), FALSE);
+
+	return item_lookup(mirror, id, NULL) != NULL;
+}
+
+/**
+ * dbusmenu_mirror_get_parent:
+ * @mirror: The #DbusmenuMirror to look in
+ * @id: ID of the item
+ *
+ * Finds the parent of an item.
+ *
+ * Return value: The ID of the parent or -1 for the root or an
+ * 	item that isn't there
+ */
+gint
+dbusmenu_mirror_get_parent (DbusmenuMirror * mirror, gint id)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), -1);
+
+	mirror_item_t * item = item_lookup(mirror, id, NULL);
+	if (item == NULL || item->parent < 0) {
+		return -1;
+	}
+
+	return g_array_index(DBUSMENU_MIRROR_GET_PRIVATE(mirror)->items, mirror_item_t, item->parent).id;
+}
+
+/**
+ * dbusmenu_mirror_get_properties:
+ * @mirror: The #DbusmenuMirror to look in
+ * @id: ID of the item
+ *
+ * Gets all of the properties the server sent for an item.  Unlike
+ * #dbusmenu_menuitem_properties_variant the defaults are not filled
+ * in.
+ *
+ * Return value: (transfer none): A #GVariant of type "a{sv}" or NULL
+ * 	if the item isn't there
+ */
+GVariant *
+dbusmenu_mirror_get_properties (DbusmenuMirror * mirror, gint id)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), NULL);
+
+	mirror_item_t * item = item_lookup(mirror, id, NULL);
+	if (item == NULL) {
+		return NULL;
+	}
+
+	return item->properties;
+}
+
+/**
+ * dbusmenu_mirror_get_property:
+ * @mirror: The #DbusmenuMirror to look in
+ * @id: ID of the item
+ * @property: Name of the property
+ *
+ * Gets one property of an item as the server sent it.
+ *
+ * Return value: (transfer full): The value or NULL if either the
+ * 	item or the property isn't there
+ */
+GVariant *
+dbusmenu_mirror_get_property (DbusmenuMirror * mirror, gint id, const gchar * property)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), NULL);
+	g_return_val_if_fail(property != NULL, NULL);
+
+	mirror_item_t * item = item_lookup(mirror, id, NULL);
+	if (item == NULL) {
+		return NULL;
+	}
+
+	return g_variant_lookup_value(item->properties, property, NULL);
+}
+
+/**
+ * dbusmenu_mirror_query:
+ * @mirror: The #DbusmenuMirror to look in
+ * @property: Name of the property to look at
+ * @value: (allow-none): Value that @property needs to have
+ *
+ * Looks through all of the items for the ones that have @property
+ * set to @value, or that have @property at all if @value is NULL.
+ *
+ * Return value: (transfer full) (element-type gint): The IDs of the
+ * 	items in tree order
+ */
+GArray *
+dbusmenu_mirror_query (DbusmenuMirror * mirror, const gchar * property, GVariant * value)
+{
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), NULL);
+	g_return_val_if_fail(property != NULL, NULL);
+
+	DbusmenuMirrorPrivate * priv = DBUSMENU_MIRROR_GET_PRIVATE(mirror);
+	GArray * found = g_array_new(FALSE, FALSE, sizeof(gint));
+	guint i;
+
+	for (i = 0; i < priv->items->len; i++) {
+		mirror_item_t * item = &g_array_index(priv->items, mirror_item_t, i);
+		GVariant * itemvalue = g_variant_lookup_value(item->properties, property, NULL);
+
+		if (itemvalue == NULL) {
+			continue;
+		}
+
+		if (value == NULL || g_variant_equal(itemvalue, value)) {
+			g_array_append_val(found, item->id);
+		}
+
+		g_variant_unref(itemvalue);
+	}
+
+	return found;
+}
+
+/**
+ * dbusmenu_mirror_iter_init:
+ * @iter: An uninitialized #DbusmenuMirrorIter
+ * @mirror: The #DbusmenuMirror to walk through
+ * @id: ID of the item whose children to walk through, 0 for the root
+ * @recurse: Whether to include the children of the children
+ *
+ * Sets up @iter to go through the children of @id with
+ * #dbusmenu_mirror_iter_next.  With @recurse the whole subtree
+ * is walked through in tree order.
+ *
+ * Return value: FALSE if there's no item @id
+ */
+gboolean
+dbusmenu_mirror_iter_init (DbusmenuMirrorIter * iter, DbusmenuMirror * mirror, gint id, gboolean recurse)
+{
+	g_return_val_if_fail(iter != NULL, FALSE);
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(mirror), FALSE);
+
+	guint position = 0;
+	mirror_item_t * item = item_lookup(mirror, id, &position);
+
+	iter->mirror = mirror;
+	iter->recurse = recurse;
+
+	if (item == NULL) {
+		iter->position = 0;
+		iter->end = 0;
+		return FALSE;
+	}
+
+	iter->position = position + 1;
+	iter->end = position + item->size;
+
+	return TRUE;
+}
+
+/**
+ * dbusmenu_mirror_iter_next:
+ * @iter: A #DbusmenuMirrorIter set up with #dbusmenu_mirror_iter_init
+ * @id: (out) (allow-none): The ID of the next item
+ * @properties: (out) (allow-none) (transfer none): The properties of
+ * 	the next item, of type "a{sv}"
+ *
+ * Moves on to the next item.
+ *
+ * Return value: FALSE when there are no more items
+ */
+gboolean
+dbusmenu_mirror_iter_next (DbusmenuMirrorIter * iter, gint * id, GVariant ** properties)
+{
+	g_return_val_if_fail(iter != NULL, FALSE);
+	g_return_val_if_fail(DBUSMENU_IS_MIRROR(iter->mirror), FALSE);
+
+	GArray * items = DBUSMENU_MIRROR_GET_PRIVATE(iter->mirror)->items;
+
+	if (iter->position >= iter->end || iter->end > items->len) {
+		return FALSE;
+	}
+
+	mirror_item_t * item = &g_array_index(items, mirror_item_t, iter->position);
+
+	if (id != NULL) {
+		*id = item->id;
+	}
+	if (properties != NULL) {
+		*properties = item->properties;
+	}
+
+	/* Skip over the children unless we want them too */
+	iter->position += iter->recurse ? 1 : item->size;
+
+	return TRUE;
+}
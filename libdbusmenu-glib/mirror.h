@@ -0,0 +1,179 @@
+/*
+A read only copy of a remote menu that doesn't build menuitems.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of either or both of the following licenses:
+
+1) the GNU Lesser General Public License version 3, as published by the
+Free Software Foundation; and/or
+2) the GNU Lesser General Public License version 2.1, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the applicable version of the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of both the GNU Lesser General Public
+License version 3 and version 2.1 along with this program.  If not, see
+<http://www.gnu.org/licenses/>
+*/
+
+#ifndef __DBUSMENU_MIRROR_H__
+#define __DBUSMENU_MIRROR_H__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define DBUSMENU_TYPE_MIRROR            (dbusmenu_mirror_get_type ())
+#define DBUSMENU_MIRROR(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), DBUSMENU_TYPE_MIRROR, DbusmenuMirror))
+#define DBUSMENU_MIRROR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), DBUSMENU_TYPE_MIRROR, DbusmenuMirrorClass))
+#define DBUSMENU_IS_MIRROR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), DBUSMENU_TYPE_MIRROR))
+#define DBUSMENU_IS_MIRROR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), DBUSMENU_TYPE_MIRROR))
+#define DBUSMENU_MIRROR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), DBUSMENU_TYPE_MIRROR, DbusmenuMirrorClass))
+
+/**
+ * DBUSMENU_MIRROR_SIGNAL_LAYOUT_CHANGED:
+ *
+ * String to attach to signal #DbusmenuMirror::layout-changed
+ */
+#define DBUSMENU_MIRROR_SIGNAL_LAYOUT_CHANGED      "layout-changed"
+/**
+ * DBUSMENU_MIRROR_SIGNAL_PROPERTIES_CHANGED:
+ *
+ * String to attach to signal #DbusmenuMirror::properties-changed
+ */
+#define DBUSMENU_MIRROR_SIGNAL_PROPERTIES_CHANGED  "properties-changed"
+
+/**
+ * DBUSMENU_MIRROR_PROP_DBUS_NAME:
+ *
+ * String to access property #DbusmenuMirror:dbus-name
+ */
+#define DBUSMENU_MIRROR_PROP_DBUS_NAME        "dbus-name"
+/**
+ * DBUSMENU_MIRROR_PROP_DBUS_OBJECT:
+ *
+ * String to access property #DbusmenuMirror:dbus-object
+ */
+#define DBUSMENU_MIRROR_PROP_DBUS_OBJECT      "dbus-object"
+/**
+ * DBUSMENU_MIRROR_PROP_DBUS_CONNECTION:
+ *
+ * String to access property #DbusmenuMirror:dbus-connection
+ */
+#define DBUSMENU_MIRROR_PROP_DBUS_CONNECTION  "dbus-connection"
+
+typedef struct _DbusmenuMirrorPrivate DbusmenuMirrorPrivate;
+
+/**
+	DbusmenuMirrorClass:
+	@parent_class: #GObjectClass
+	@layout_changed: Slot for #DbusmenuMirror::layout-changed.
+	@properties_changed: Slot for #DbusmenuMirror::properties-changed.
+	@reserved1: Reserved for future use.
+	@reserved2: Reserved for future use.
+	@reserved3: Reserved for future use.
+	@reserved4: Reserved for future use.
+
+	Functions and signal slots for #DbusmenuMirror.
+*/
+typedef struct _DbusmenuMirrorClass DbusmenuMirrorClass;
+struct _DbusmenuMirrorClass {
+	GObjectClass parent_class;
+
+	void (*layout_changed) (void);
+	void (*properties_changed) (GVariant * ids);
+
+	/*< Private >*/
+	void (*reserved1) (void);
+	void (*reserved2) (void);
+	void (*reserved3) (void);
+	void (*reserved4) (void);
+};
+
+/**
+	DbusmenuMirror:
+
+	A read only copy of the menu of a #DbusmenuServer.
+*/
+typedef struct _DbusmenuMirror      DbusmenuMirror;
+struct _DbusmenuMirror {
+	/*< private >*/
+	GObject parent;
+
+	/*< Private >*/
+	DbusmenuMirrorPrivate * priv;
+};
+
+/**
+	DbusmenuMirrorIter:
+
+	Walks through the items of a #DbusmenuMirror, see
+	#dbusmenu_mirror_iter_init.  It's only good until the
+	layout of the mirror changes.
+*/
+typedef struct _DbusmenuMirrorIter DbusmenuMirrorIter;
+struct _DbusmenuMirrorIter {
+	/*< private >*/
+	DbusmenuMirror * mirror;
+	guint position;
+	guint end;
+	gboolean recurse;
+};
+
+GType                dbusmenu_mirror_get_type          (void);
+DbusmenuMirror *     dbusmenu_mirror_new               (const gchar * name,
+                                                        const gchar * object);
+DbusmenuMirror *     dbusmenu_mirror_new_for_connection (GDBusConnection * connection,
+                                                        const gchar * name,
+                                                        const gchar * object);
+guint                dbusmenu_mirror_get_n_items       (DbusmenuMirror * mirror);
+gboolean             dbusmenu_mirror_has_item          (DbusmenuMirror * mirror,
+                                                        gint id);
+gint                 dbusmenu_mirror_get_parent        (DbusmenuMirror * mirror,
+                                                        gint id);
+GVariant *           dbusmenu_mirror_get_properties    (DbusmenuMirror * mirror,
+                                                        gint id);
+GVariant *           dbusmenu_mirror_get_property      (DbusmenuMirror * mirror,
+                                                        gint id,
+                                                        const gchar * property);
+GArray *             dbusmenu_mirror_query             (DbusmenuMirror * mirror,
+                                                        const gchar * property,
+                                                        GVariant * value);
+gboolean             dbusmenu_mirror_iter_init         (DbusmenuMirrorIter * iter,
+                                                        DbusmenuMirror * mirror,
+                                                        gint id,
+                                                        gboolean recurse);
+gboolean             dbusmenu_mirror_iter_next         (DbusmenuMirrorIter * iter,
+                                                        gint * id,
+                                                        GVariant ** properties);
+
+/**
+	SECTION:mirror
+	@short_description: A read only copy of a remote menu
+	@stability: Unstable
+	@include: libdbusmenu-glib/mirror.h
+
+	The mirror follows a #DbusmenuServer like #DbusmenuClient does,
+	but it never builds #DbusmenuMenuitem objects.  All of the items
+	are kept in one flat table in tree order, with their properties
+	left in the #GVariant they came over the bus in.  It's meant for
+	indexers and search tools that watch a lot of menus but never
+	show them.
+
+	Instead of signals on every item there are two for the whole
+	menu.  #DbusmenuMirror::layout-changed when items come and go
+	and #DbusmenuMirror::properties-changed with the IDs of the
+	items whose properties changed.
+*/
+
+G_END_DECLS
+
+#endif
@@ -30,6 +30,8 @@ License version 3 and version 2.1 along with this program.  If not, see
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
 
@@ -42,16 +44,56 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 static void layout_update_signal (DbusmenuServer * server);
 
-#define DBUSMENU_VERSION_NUMBER    3
+#define DBUSMENU_VERSION_NUMBER    7
 #define DBUSMENU_INTERFACE         "com.canonical.dbusmenu"
 
 /* Privates, I'll show you mine... */
+/* Requests from one client, counted over one second windows
+   to apply the request limits */
+typedef struct _sender_t sender_t;
+struct _sender_t {
+	gchar * name;
+	gint64 window;
+	guint window_requests;
+	guint64 window_bytes;
+	gint64 last;
+	guint requests;
+	guint64 reply_bytes;
+	guint deferred;
+	guint shared;
+	gboolean warned;
+	GList * pending;
+};
+
+/* What the clients were last told about the children of an item.
+   Emptying an item takes its child-display away and filling it
+   puts it back, so that's kept too. */
+typedef struct _published_t published_t;
+struct _published_t {
+	GList * children;
+	gchar * child_display;
+};
+
+/* A request held back until the next window, along with the
+   identical ones that'll get the same reply */
+typedef struct _deferred_t deferred_t;
+struct _deferred_t {
+	guint method;
+	GVariant * params;
+	GDBusMethodInvocation * invocation;
+	GList * shared;
+};
+
 struct _DbusmenuServerPrivate
 {
 	DbusmenuMenuitem * root;
 	gchar * dbusobject;
 	gint layout_revision;
 	guint layout_idle;
+	gboolean layout_forced;
+
+	GHashTable * published;
+	GHashTable * repopulated;
 
 	GDBusConnection * bus;
 	guint find_server_signal;
@@ -63,11 +105,46 @@ struct _DbusmenuServerPrivate
 	GStrv icon_dirs;
 
 	GArray * prop_array;
+	GHashTable * prop_index; /* DbusmenuMenuitem * -> its GArray in prop_array */
 	guint property_idle;
 
 	GHashTable * lookup_cache;
+	GHashTable * stand_ins; /* DbusmenuMenuitem * -> ID of the item it replaced */
+
+	GQueue * journal;
+	GHashTable * journal_index; /* journal_entry_t * -> GList * in journal */
+	guint journal_floor;
+
+	gboolean prune_hidden;
+
+	GHashTable * senders;
+	guint request_limit;
+	guint reply_byte_limit;
+	guint deferred_flush;
+	sender_t * current_sender;
+	GList * shared_invocations;
+
+	guint compress_threshold;
+	const gchar * reply_encoding;
+
+	GHashTable * sealed;
+	GHashTable * hibernated;
+	GClosure * hibernate_wake; /* On every item while hibernating */
 };
 
+/* How many changes we remember for clients catching up */
+#define JOURNAL_MAX_ENTRIES  256
+
+/* How many clients we keep numbers on before forgetting
+   the ones that have been quiet for a while */
+#define SENDERS_MAX          64
+#define SENDER_EXPIRE        60
+
+/* Replies this big are compressed for the clients that ask */
+#define COMPRESS_THRESHOLD   (64 * 1024)
+/* The encoding GetCompressed knows about */
+#define ENCODING_ZLIB        "zlib"
+
 #define DBUSMENU_SERVER_GET_PRIVATE(o) (DBUSMENU_SERVER(o)->priv)
 
 /* Signals */
@@ -76,6 +153,7 @@ enum {
 	ID_UPDATE,
 	LAYOUT_UPDATED,
 	ITEM_ACTIVATION,
+	RESUMED,
 	LAST_SIGNAL
 };
 
@@ -89,7 +167,12 @@ enum {
 	PROP_VERSION,
 	PROP_TEXT_DIRECTION,
 	PROP_STATUS,
-	PROP_ICON_THEME_DIRS
+	PROP_ICON_THEME_DIRS,
+	PROP_DBUS_CONNECTION,
+	PROP_PRUNE_HIDDEN,
+	PROP_REQUEST_LIMIT,
+	PROP_REPLY_BYTE_LIMIT,
+	PROP_COMPRESS_THRESHOLD
 };
 
 /* Errors */
@@ -109,6 +192,8 @@ typedef struct _method_table_t method_table_t;
 struct _method_table_t {
 	const gchar * interned_name;
 	MethodTableFunc func;
+	gboolean throttle;
+	gboolean compress;
 };
 
 enum {
@@ -121,6 +206,9 @@ enum {
 	METHOD_EVENT_GROUP,
 	METHOD_ABOUT_TO_SHOW,
 	METHOD_ABOUT_TO_SHOW_GROUP,
+	METHOD_GET_CHANGES_SINCE,
+	METHOD_GET_COMPRESSED,
+	METHOD_SEARCH,
 	/* Counter, do not remove! */
 	METHOD_COUNT
 };
@@ -128,6 +216,7 @@ enum {
 /* Prototype */
 static void       dbusmenu_server_class_init  (DbusmenuServerClass *class);
 static void       dbusmenu_server_init        (DbusmenuServer *self);
+static void       dbusmenu_server_constructed (GObject *object);
 static void       dbusmenu_server_dispose     (GObject *object);
 static void       dbusmenu_server_finalize    (GObject *object);
 static void       set_property                (GObject * obj,
@@ -140,6 +229,7 @@ static void       get_property                (GObject * obj,
                                                GParamSpec * pspec);
 static void       default_text_direction      (DbusmenuServer * server);
 static void       register_object             (DbusmenuServer * server);
+static void       bus_setup                   (DbusmenuServer * server);
 static void       bus_got_cb                  (GObject * obj,
                                                GAsyncResult * result,
                                                gpointer user_data);
@@ -169,6 +259,11 @@ static void       menuitem_child_added        (DbusmenuMenuitem * parent,
 static void       menuitem_child_removed      (DbusmenuMenuitem * parent,
                                                DbusmenuMenuitem * child,
                                                DbusmenuServer * server);
+static void       menuitem_child_reparented   (DbusmenuMenuitem * parent,
+                                               DbusmenuMenuitem * child,
+                                               DbusmenuMenuitem * oldparent,
+                                               guint pos,
+                                               DbusmenuServer * server);
 static void       menuitem_signals_create     (DbusmenuMenuitem * mi,
                                                gpointer data);
 static void       menuitem_signals_remove     (DbusmenuMenuitem * mi,
@@ -202,6 +297,15 @@ static void       bus_about_to_show           (DbusmenuServer * server,
 static void       bus_about_to_show_group     (DbusmenuServer * server,
                                                GVariant * params,
                                                GDBusMethodInvocation * invocation);
+static void       bus_get_changes_since       (DbusmenuServer * server,
+                                               GVariant * params,
+                                               GDBusMethodInvocation * invocation);
+static void       bus_get_compressed          (DbusmenuServer * server,
+                                               GVariant * params,
+                                               GDBusMethodInvocation * invocation);
+static void       bus_search                  (DbusmenuServer * server,
+                                               GVariant * params,
+                                               GDBusMethodInvocation * invocation);
 static void       find_servers_cb             (GDBusConnection * connection,
                                                const gchar * sender,
                                                const gchar * path,
@@ -210,6 +314,19 @@ static void       find_servers_cb             (GDBusConnection * connection,
                                                GVariant * params,
                                                gpointer user_data);
 static gboolean   layout_update_idle          (gpointer user_data);
+static void       journal_add                 (DbusmenuServer * server,
+                                               DbusmenuMenuitem * mi,
+                                               const gchar * property);
+static void       journal_reset               (DbusmenuServer * server);
+static guint      journal_entry_hash          (gconstpointer key);
+static gboolean   journal_entry_equal         (gconstpointer a,
+                                               gconstpointer b);
+static void       repopulate_resolve          (DbusmenuServer * server);
+static gboolean   bus_params_match            (const gchar * method,
+                                               GVariant * params);
+static void       sender_free                 (gpointer data);
+static void       published_free              (published_t * published);
+static void       hibernate_unwatch           (DbusmenuServer * server);
 
 /* Globals */
 static GDBusNodeInfo *            dbusmenu_node_info = NULL;
@@ -230,6 +347,7 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 
 	g_type_class_add_private (class, sizeof (DbusmenuServerPrivate));
 
+	object_class->constructed = dbusmenu_server_constructed;
 	object_class->dispose = dbusmenu_server_dispose;
 	object_class->finalize = dbusmenu_server_finalize;
 	object_class->set_property = set_property;
@@ -301,6 +419,26 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 	                                         NULL, NULL,
 	                                         _dbusmenu_server_marshal_VOID__INT_UINT,
 	                                         G_TYPE_NONE, 2, G_TYPE_INT, G_TYPE_UINT);
+	/**
+		DbusmenuServer::resumed:
+		@arg0: The #DbusmenuServer emitting the signal.
+		@arg1: The #DbusmenuMenuitem that is the root of the
+		       menu.
+
+		Emitted when a hibernating server goes back to watching its
+		items, because one of them changed, dbusmenu_server_resume()
+		was called or a client needs them, like to send them an
+		event.  If the application let go of the menu while it was
+		hibernating the root is a new one, rebuilt with the same IDs
+		and properties.
+	*/
+	signals[RESUMED] =          g_signal_new(DBUSMENU_SERVER_SIGNAL_RESUMED,
+	                                         G_TYPE_FROM_CLASS(class),
+	                                         G_SIGNAL_RUN_LAST,
+	                                         G_STRUCT_OFFSET(DbusmenuServerClass, resumed),
+	                                         NULL, NULL,
+	                                         g_cclosure_marshal_VOID__OBJECT,
+	                                         G_TYPE_NONE, 1, G_TYPE_OBJECT);
 
 
 	g_object_class_install_property (object_class, PROP_DBUS_OBJECT,
@@ -328,6 +466,30 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 	                                              "Exports over DBus whether the menus should be given special visuals",
 	                                              DBUSMENU_TYPE_STATUS, DBUSMENU_STATUS_NORMAL,
 	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_DBUS_CONNECTION,
+	                                 g_param_spec_object(DBUSMENU_SERVER_PROP_DBUS_CONNECTION, "DBus connection to export on",
+	                                              "The connection the menus are exported on.  If not set the session bus is used.",
+	                                              G_TYPE_DBUS_CONNECTION,
+	                                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_PRUNE_HIDDEN,
+	                                 g_param_spec_boolean(DBUSMENU_SERVER_PROP_PRUNE_HIDDEN, "Send hidden items without their children",
+	                                              "Items that aren't visible are sent to clients without their children, which are sent once the item is shown.  Saves building and mirroring large hidden sections of menus.",
+	                                              FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_REQUEST_LIMIT,
+	                                 g_param_spec_uint(DBUSMENU_SERVER_PROP_REQUEST_LIMIT, "Requests per second for each client",
+	                                              "How many layout, property and about-to-show requests a client can make in a second before they are held back.  Zero for no limit.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_REPLY_BYTE_LIMIT,
+	                                 g_param_spec_uint(DBUSMENU_SERVER_PROP_REPLY_BYTE_LIMIT, "Reply bytes per second for each client",
+	                                              "How many bytes of replies a client can get in a second before its requests are held back.  Zero for no limit.",
+	                                              0, G_MAXUINT, 0,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property (object_class, PROP_COMPRESS_THRESHOLD,
+	                                 g_param_spec_uint(DBUSMENU_SERVER_PROP_COMPRESS_THRESHOLD, "Smallest reply to compress",
+	                                              "Layout and property replies of at least this many bytes are compressed for clients that ask for it.  Zero to never compress them.",
+	                                              0, G_MAXUINT, COMPRESS_THRESHOLD,
+	                                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
 	if (dbusmenu_node_info == NULL) {
 		GError * error = NULL;
@@ -350,18 +512,25 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 	/* Building our Method table :( */
 	dbusmenu_method_table[METHOD_GET_LAYOUT].interned_name = g_intern_static_string("GetLayout");
 	dbusmenu_method_table[METHOD_GET_LAYOUT].func          = bus_get_layout;
+	dbusmenu_method_table[METHOD_GET_LAYOUT].throttle      = TRUE;
+	dbusmenu_method_table[METHOD_GET_LAYOUT].compress      = TRUE;
 
 	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].interned_name = g_intern_static_string("GetGroupProperties");
 	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].func          = bus_get_group_properties;
+	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].throttle      = TRUE;
+	dbusmenu_method_table[METHOD_GET_GROUP_PROPERTIES].compress      = TRUE;
 
 	dbusmenu_method_table[METHOD_GET_CHILDREN].interned_name = g_intern_static_string("GetChildren");
 	dbusmenu_method_table[METHOD_GET_CHILDREN].func          = bus_get_children;
+	dbusmenu_method_table[METHOD_GET_CHILDREN].throttle      = TRUE;
 
 	dbusmenu_method_table[METHOD_GET_PROPERTY].interned_name = g_intern_static_string("GetProperty");
 	dbusmenu_method_table[METHOD_GET_PROPERTY].func          = bus_get_property;
+	dbusmenu_method_table[METHOD_GET_PROPERTY].throttle      = TRUE;
 
 	dbusmenu_method_table[METHOD_GET_PROPERTIES].interned_name = g_intern_static_string("GetProperties");
 	dbusmenu_method_table[METHOD_GET_PROPERTIES].func          = bus_get_properties;
+	dbusmenu_method_table[METHOD_GET_PROPERTIES].throttle      = TRUE;
 
 	dbusmenu_method_table[METHOD_EVENT].interned_name = g_intern_static_string("Event");
 	dbusmenu_method_table[METHOD_EVENT].func          = bus_event;
@@ -371,9 +540,24 @@ dbusmenu_server_class_init (DbusmenuServerClass *class)
 
 	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW].interned_name = g_intern_static_string("AboutToShow");
 	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW].func          = bus_about_to_show;
+	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW].throttle      = TRUE;
 
 	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW_GROUP].interned_name = g_intern_static_string("AboutToShowGroup");
 	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW_GROUP].func          = bus_about_to_show_group;
+	dbusmenu_method_table[METHOD_ABOUT_TO_SHOW_GROUP].throttle      = TRUE;
+
+	dbusmenu_method_table[METHOD_GET_CHANGES_SINCE].interned_name = g_intern_static_string("GetChangesSince");
+	dbusmenu_method_table[METHOD_GET_CHANGES_SINCE].func          = bus_get_changes_since;
+	dbusmenu_method_table[METHOD_GET_CHANGES_SINCE].throttle      = TRUE;
+	dbusmenu_method_table[METHOD_GET_CHANGES_SINCE].compress      = TRUE;
+
+	dbusmenu_method_table[METHOD_GET_COMPRESSED].interned_name = g_intern_static_string("GetCompressed");
+	dbusmenu_method_table[METHOD_GET_COMPRESSED].func          = bus_get_compressed;
+	dbusmenu_method_table[METHOD_GET_COMPRESSED].throttle      = TRUE;
+
+	dbusmenu_method_table[METHOD_SEARCH].interned_name = g_intern_static_string("Search");
+	dbusmenu_method_table[METHOD_SEARCH].func          = bus_search;
+	dbusmenu_method_table[METHOD_SEARCH].throttle      = TRUE;
 
 	return;
 }
@@ -389,12 +573,37 @@ dbusmenu_server_init (DbusmenuServer *self)
 	priv->dbusobject = NULL;
 	priv->layout_revision = 1;
 	priv->layout_idle = 0;
+	priv->layout_forced = FALSE;
 	priv->bus = NULL;
 	priv->bus_lookup = NULL;
 	priv->find_server_signal = 0;
 	priv->dbus_registration = 0;
 
 	priv->lookup_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+	priv->stand_ins = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL);
+
+	priv->published = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)published_free);
+	priv->repopulated = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL);
+
+	priv->journal = g_queue_new();
+	priv->journal_index = g_hash_table_new(journal_entry_hash, journal_entry_equal);
+	priv->journal_floor = priv->layout_revision;
+
+	priv->prune_hidden = FALSE;
+
+	priv->senders = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, sender_free);
+	priv->request_limit = 0;
+	priv->reply_byte_limit = 0;
+	priv->deferred_flush = 0;
+	priv->current_sender = NULL;
+	priv->shared_invocations = NULL;
+
+	priv->compress_threshold = COMPRESS_THRESHOLD;
+	priv->reply_encoding = NULL;
+
+	priv->sealed = NULL;
+	priv->hibernated = NULL;
+	priv->hibernate_wake = NULL;
 
 	default_text_direction(self);
 	priv->status = DBUSMENU_STATUS_NORMAL;
@@ -403,6 +612,33 @@ dbusmenu_server_init (DbusmenuServer *self)
 	return;
 }
 
+/* Once all the construct properties are in we know whether
+   we were given a connection or need to go find the session bus */
+static void
+dbusmenu_server_constructed (GObject *object)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(object);
+
+	if (priv->dbusobject != NULL) {
+		if (priv->bus == NULL) {
+			if (priv->bus_lookup == NULL) {
+				priv->bus_lookup = g_cancellable_new();
+			}
+
+			g_object_ref(object);
+			g_bus_get(G_BUS_TYPE_SESSION, priv->bus_lookup, bus_got_cb, object);
+		} else {
+			bus_setup(DBUSMENU_SERVER(object));
+		}
+	}
+
+	if (G_OBJECT_CLASS (dbusmenu_server_parent_class)->constructed != NULL) {
+		G_OBJECT_CLASS (dbusmenu_server_parent_class)->constructed (object);
+	}
+
+	return;
+}
+
 static void
 dbusmenu_server_dispose (GObject *object)
 {
@@ -421,13 +657,38 @@ dbusmenu_server_dispose (GObject *object)
 	if (priv->prop_array != NULL) {
 		prop_array_teardown(priv->prop_array);
 		priv->prop_array = NULL;
+		g_hash_table_destroy(priv->prop_index);
+		priv->prop_index = NULL;
+	}
+
+	if (priv->deferred_flush != 0) {
+		g_source_remove(priv->deferred_flush);
+		priv->deferred_flush = 0;
+	}
+
+	/* Answers anything that's been held back */
+	if (priv->senders != NULL) {
+		g_hash_table_destroy(priv->senders);
+		priv->senders = NULL;
 	}
 
+	hibernate_unwatch(DBUSMENU_SERVER(object));
+
 	if (priv->root != NULL) {
 		dbusmenu_menuitem_foreach(priv->root, menuitem_signals_remove, object);
 		g_object_unref(priv->root);
 	}
 
+	if (priv->repopulated != NULL) {
+		g_hash_table_destroy(priv->repopulated);
+		priv->repopulated = NULL;
+	}
+
+	if (priv->published != NULL) {
+		g_hash_table_destroy(priv->published);
+		priv->published = NULL;
+	}
+
 	if (priv->dbus_registration != 0) {
 		g_dbus_connection_unregister_object(priv->bus, priv->dbus_registration);
 		priv->dbus_registration = 0;
@@ -478,6 +739,29 @@ dbusmenu_server_finalize (GObject *object)
 		priv->lookup_cache = NULL;
 	}
 
+	if (priv->stand_ins) {
+		g_hash_table_destroy(priv->stand_ins);
+		priv->stand_ins = NULL;
+	}
+
+	if (priv->journal != NULL) {
+		journal_reset(DBUSMENU_SERVER(object));
+		g_queue_free(priv->journal);
+		priv->journal = NULL;
+		g_hash_table_destroy(priv->journal_index);
+		priv->journal_index = NULL;
+	}
+
+	if (priv->sealed != NULL) {
+		g_hash_table_destroy(priv->sealed);
+		priv->sealed = NULL;
+	}
+
+	if (priv->hibernated != NULL) {
+		g_hash_table_destroy(priv->hibernated);
+		priv->hibernated = NULL;
+	}
+
 	G_OBJECT_CLASS (dbusmenu_server_parent_class)->finalize (object);
 	return;
 }
@@ -495,25 +779,94 @@ lookup_menuitem_by_id (DbusmenuServer * server, gint id)
 	return res;
 }
 
+/* The ID that the clients know @mi by, which is the ID of the
+   item it replaced if it is standing in for one */
+static gint
+item_id (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	gpointer id;
+	if (priv->stand_ins != NULL && g_hash_table_lookup_extended(priv->stand_ins, mi, NULL, &id)) {
+		return GPOINTER_TO_INT(id);
+	}
+
+	return dbusmenu_menuitem_get_id(mi);
+}
+
+/* @mi goes back to its own ID, the clients have to get a new
+   layout to find out */
+static void
+stand_in_drop (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	gint id = item_id(server, mi);
+	if (g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(id)) == mi) {
+		g_hash_table_remove(priv->lookup_cache, GINT_TO_POINTER(id));
+		g_hash_table_insert(priv->lookup_cache, GINT_TO_POINTER(dbusmenu_menuitem_get_id(mi)), g_object_ref(mi));
+	}
+
+	g_hash_table_remove(priv->stand_ins, mi);
+	layout_update_signal(server);
+
+	return;
+}
+
+/* Forgets the stand-ins in a tree that's been thrown away */
+static void
+stand_in_forget (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	g_hash_table_remove(priv->stand_ins, mi);
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		stand_in_forget(server, DBUSMENU_MENUITEM(child->data));
+	}
+
+	return;
+}
+
 static void
-cache_remove_entries_for_menuitem (GHashTable * cache, DbusmenuMenuitem * item)
+cache_remove_entries_for_menuitem (DbusmenuServer * server, DbusmenuMenuitem * item)
 {
-	g_hash_table_remove(cache, GINT_TO_POINTER(dbusmenu_menuitem_get_id(item)));
+	GHashTable * cache = DBUSMENU_SERVER_GET_PRIVATE(server)->lookup_cache;
+	gint id = item_id(server, item);
+
+	if (g_hash_table_lookup(cache, GINT_TO_POINTER(id)) == item) {
+		g_hash_table_remove(cache, GINT_TO_POINTER(id));
+	}
 
 	GList *child, *children = dbusmenu_menuitem_get_children(item);
 	for (child = children; child != NULL; child = child->next) {
-		cache_remove_entries_for_menuitem(cache, child->data);
+		cache_remove_entries_for_menuitem(server, child->data);
 	}
 }
 
 static void
-cache_add_entries_for_menuitem (GHashTable * cache, DbusmenuMenuitem * item)
+cache_add_entries_for_menuitem (DbusmenuServer * server, DbusmenuMenuitem * item)
 {
-	g_hash_table_insert(cache, GINT_TO_POINTER(dbusmenu_menuitem_get_id(item)), g_object_ref(item));
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	/* An item that took over an ID gives it back to the item
+	   that really has it */
+	DbusmenuMenuitem * current = g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(item_id(server, item)));
+	if (current != NULL && current != item) {
+		if (g_hash_table_contains(priv->stand_ins, item)) {
+			g_hash_table_remove(priv->stand_ins, item);
+			layout_update_signal(server);
+		} else if (g_hash_table_contains(priv->stand_ins, current)) {
+			stand_in_drop(server, current);
+		}
+	}
+
+	g_hash_table_insert(priv->lookup_cache, GINT_TO_POINTER(item_id(server, item)), g_object_ref(item));
 
 	GList *child, *children = dbusmenu_menuitem_get_children(item);
 	for (child = children; child != NULL; child = child->next) {
-		cache_add_entries_for_menuitem(cache, child->data);
+		cache_add_entries_for_menuitem(server, child->data);
 	}
 }
 
@@ -526,24 +879,27 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 	case PROP_DBUS_OBJECT:
 		g_return_if_fail(priv->dbusobject == NULL);
 		priv->dbusobject = g_value_dup_string(value);
-
-		if (priv->bus == NULL) {
-			if (priv->bus_lookup == NULL) {
-				priv->bus_lookup = g_cancellable_new();
-				g_return_if_fail(priv->bus_lookup != NULL);
-			}
-
-			g_object_ref(obj);
-			g_bus_get(G_BUS_TYPE_SESSION, priv->bus_lookup, bus_got_cb, obj);
-		} else {
-			register_object(DBUSMENU_SERVER(obj));
-		}
+		break;
+	case PROP_DBUS_CONNECTION:
+		g_return_if_fail(priv->bus == NULL);
+		priv->bus = g_value_dup_object(value);
 		break;
 	case PROP_ROOT_NODE:
+		if (priv->sealed != NULL) {
+			g_warning("Unable to change the root of a sealed server");
+			break;
+		}
+		/* The new root replaces the one we were keeping */
+		if (priv->hibernated != NULL) {
+			hibernate_unwatch(DBUSMENU_SERVER(obj));
+			g_hash_table_destroy(priv->hibernated);
+			priv->hibernated = NULL;
+		}
 		if (priv->root != NULL) {
 			dbusmenu_menuitem_foreach(priv->root, menuitem_signals_remove, obj);
 			dbusmenu_menuitem_set_root(priv->root, FALSE);
-			cache_remove_entries_for_menuitem(priv->lookup_cache, priv->root);
+			cache_remove_entries_for_menuitem(DBUSMENU_SERVER(obj), priv->root);
+			g_hash_table_remove_all(priv->stand_ins);
 
 			GList * properties = dbusmenu_menuitem_properties_list(priv->root);
 			GList * iter;
@@ -559,7 +915,7 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 		priv->root = DBUSMENU_MENUITEM(g_value_get_object(value));
 		if (priv->root != NULL) {
 			g_object_ref(G_OBJECT(priv->root));
-			cache_add_entries_for_menuitem(priv->lookup_cache, priv->root);
+			cache_add_entries_for_menuitem(DBUSMENU_SERVER(obj), priv->root);
 			dbusmenu_menuitem_set_root(priv->root, TRUE);
 			dbusmenu_menuitem_foreach(priv->root, menuitem_signals_create, obj);
 
@@ -574,6 +930,8 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 			g_debug("Setting root node to NULL");
 		}
 		layout_update_signal(DBUSMENU_SERVER(obj));
+		/* A new root can't be described as changes to the old one */
+		journal_reset(DBUSMENU_SERVER(obj));
 		break;
 	case PROP_TEXT_DIRECTION: {
 		DbusmenuTextDirection indir = g_value_get_enum(value);
@@ -633,6 +991,31 @@ set_property (GObject * obj, guint id, const GValue * value, GParamSpec * pspec)
 		priv->status = instatus;
 		break;
 	}
+	case PROP_PRUNE_HIDDEN: {
+		gboolean prune = g_value_get_boolean(value);
+		if (prune == priv->prune_hidden) {
+			break;
+		}
+
+		priv->prune_hidden = prune;
+
+		/* Every hidden submenu changes, easier to have the
+		   clients start over */
+		if (priv->root != NULL) {
+			layout_update_signal(DBUSMENU_SERVER(obj));
+			journal_reset(DBUSMENU_SERVER(obj));
+		}
+		break;
+	}
+	case PROP_REQUEST_LIMIT:
+		priv->request_limit = g_value_get_uint(value);
+		break;
+	case PROP_REPLY_BYTE_LIMIT:
+		priv->reply_byte_limit = g_value_get_uint(value);
+		break;
+	case PROP_COMPRESS_THRESHOLD:
+		priv->compress_threshold = g_value_get_uint(value);
+		break;
 	default:
 		g_return_if_reached();
 		break;
@@ -651,6 +1034,10 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 		g_value_set_string(value, priv->dbusobject);
 		break;
 	case PROP_ROOT_NODE:
+		/* Only rebuilt when there's nothing to look at */
+		if (priv->hibernated != NULL && priv->root == NULL) {
+			dbusmenu_server_resume(DBUSMENU_SERVER(obj));
+		}
 		g_value_set_object(value, priv->root);
 		break;
 	case PROP_VERSION:
@@ -662,6 +1049,21 @@ get_property (GObject * obj, guint id, GValue * value, GParamSpec * pspec)
 	case PROP_STATUS:
 		g_value_set_enum(value, priv->status);
 		break;
+	case PROP_DBUS_CONNECTION:
+		g_value_set_object(value, priv->bus);
+		break;
+	case PROP_PRUNE_HIDDEN:
+		g_value_set_boolean(value, priv->prune_hidden);
+		break;
+	case PROP_REQUEST_LIMIT:
+		g_value_set_uint(value, priv->request_limit);
+		break;
+	case PROP_REPLY_BYTE_LIMIT:
+		g_value_set_uint(value, priv->reply_byte_limit);
+		break;
+	case PROP_COMPRESS_THRESHOLD:
+		g_value_set_uint(value, priv->compress_threshold);
+		break;
 	default:
 		g_return_if_reached();
 		break;
@@ -786,6 +1188,19 @@ bus_got_cb (GObject * obj, GAsyncResult * result, gpointer user_data)
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(user_data);
 	priv->bus = bus;
 
+	bus_setup(DBUSMENU_SERVER(user_data));
+
+	g_object_unref(G_OBJECT(user_data));
+	return;
+}
+
+/* Now that we have a connection, listen for clients looking
+   for us and put our object on it */
+static void
+bus_setup (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
 	priv->find_server_signal = g_dbus_connection_signal_subscribe(priv->bus,
 	                                                              NULL, /* sender */
 	                                                              "com.canonical.dbusmenu", /* interface */
@@ -794,12 +1209,11 @@ bus_got_cb (GObject * obj, GAsyncResult * result, gpointer user_data)
 	                                                              NULL, /* arg0 */
 	                                                              G_DBUS_SIGNAL_FLAGS_NONE, /* flags */
 	                                                              find_servers_cb, /* cb */
-	                                                              user_data, /* data */
+	                                                              server, /* data */
 	                                                              NULL); /* free func */
 
-	register_object(DBUSMENU_SERVER(user_data));
+	register_object(server);
 
-	g_object_unref(G_OBJECT(user_data));
 	return;
 }
 
@@ -812,106 +1226,659 @@ find_servers_cb (GDBusConnection * connection, const gchar * sender, const gchar
 	return;
 }
 
-/* Function for the GDBus vtable to handle all method calls and dish
-   them out the appropriate functions */
+/* Answers anything that was held back for the client when the
+   server is going away */
 static void
-bus_method_call (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+deferred_free (gpointer data)
 {
-	int i;
-	const gchar * interned_method = g_intern_string(method);
+	deferred_t * deferred = (deferred_t *)data;
+	GList * link;
+
+	for (link = deferred->shared; link != NULL; link = g_list_next(link)) {
+		g_dbus_method_invocation_return_error(G_DBUS_METHOD_INVOCATION(link->data),
+		                                      error_quark(),
+		                                      NO_VALID_LAYOUT,
+		                                      "The menu is going away");
+	}
+	g_list_free(deferred->shared);
 
-	for (i = 0; i < METHOD_COUNT; i++) {
-		if (dbusmenu_method_table[i].interned_name == interned_method) {
-			if (dbusmenu_method_table[i].func != NULL) {
-				return dbusmenu_method_table[i].func(DBUSMENU_SERVER(user_data), params, invocation);
-			} else {
-				/* If we have a null function we're responding but nothing else. */
-				g_warning("Invalid function call for '%s' with parameters: %s", method, g_variant_print(params, TRUE));
-				g_dbus_method_invocation_return_value(invocation, NULL);
-				return;
-			}
+	if (deferred->invocation != NULL) {
+		g_dbus_method_invocation_return_error(deferred->invocation,
+		                                      error_quark(),
+		                                      NO_VALID_LAYOUT,
+		                                      "The menu is going away");
+	}
+
+	g_variant_unref(deferred->params);
+	g_free(deferred);
+	return;
+}
+
+static void
+sender_free (gpointer data)
+{
+	sender_t * sender = (sender_t *)data;
+
+	g_list_free_full(sender->pending, deferred_free);
+	g_free(sender->name);
+	g_free(sender);
+	return;
+}
+
+/* Forgets the clients that have been quiet for a while so that
+   ones that come and go don't pile up */
+static void
+senders_expire (DbusmenuServer * server, gint64 now)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, priv->senders);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		sender_t * sender = (sender_t *)value;
+		if (sender->pending == NULL && now - sender->last > SENDER_EXPIRE * G_USEC_PER_SEC) {
+			g_hash_table_iter_remove(&iter);
 		}
 	}
 
-	/* We're here because there's an error */
-	g_dbus_method_invocation_return_error(invocation,
-	                                      error_quark(),
-	                                      NOT_IMPLEMENTED,
-	                                      "Unable to find method '%s'",
-	                                      method);
 	return;
 }
 
-/* For the GDBus vtable but we only have one property so it's pretty
-   simple. */
-static GVariant *
-bus_get_prop (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+/* Starts a new window if the last one is over */
+static void
+sender_window (sender_t * sender, gint64 now)
 {
-	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(user_data);
+	if (now - sender->window >= G_USEC_PER_SEC) {
+		sender->window = now;
+		sender->window_requests = 0;
+		sender->window_bytes = 0;
+	}
+	return;
+}
 
-	/* None of these should happen */
-	g_return_val_if_fail(g_strcmp0(interface, DBUSMENU_INTERFACE) == 0, NULL);
-	g_return_val_if_fail(g_strcmp0(path, priv->dbusobject) == 0, NULL);
+/* Counts the request against the client that made it */
+static sender_t *
+sender_account (DbusmenuServer * server, const gchar * name)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	gint64 now = g_get_monotonic_time();
 
-	if (g_strcmp0(property, "Version") == 0) {
-		return g_variant_new_uint32(DBUSMENU_VERSION_NUMBER);
-	} else if (g_strcmp0(property, "TextDirection") == 0) {
-		return g_variant_new_string(dbusmenu_text_direction_get_nick(priv->text_direction));
-	} else if (g_strcmp0(property, "IconThemePath") == 0) {
-		GVariant * dirs = NULL;
+	if (name == NULL) {
+		/* Peer to peer connections don't have names */
+		name = "";
+	}
 
-		if (priv->icon_dirs != NULL) {
-			dirs = g_variant_new_strv((const gchar * const *)priv->icon_dirs, -1);
-		} else {
-			dirs = g_variant_new_array(G_VARIANT_TYPE_STRING, NULL, 0);
+	sender_t * sender = g_hash_table_lookup(priv->senders, name);
+	if (sender == NULL) {
+		if (g_hash_table_size(priv->senders) >= SENDERS_MAX) {
+			senders_expire(server, now);
 		}
 
-		return dirs;
-	} else if (g_strcmp0(property, "Status") == 0) {
-		return g_variant_new_string(dbusmenu_status_get_nick(priv->status));
-	} else {
-		g_warning("Unknown property '%s'", property);
+		sender = g_new0(sender_t, 1);
+		sender->name = g_strdup(name);
+		sender->window = now;
+		g_hash_table_insert(priv->senders, sender->name, sender);
 	}
 
-	return NULL;
+	sender_window(sender, now);
+	sender->window_requests++;
+	sender->requests++;
+	sender->last = now;
+
+	return sender;
 }
 
-/* Handle actually signalling in the idle loop.  This way we collect all
-   the updates. */
 static gboolean
-layout_update_idle (gpointer user_data)
+sender_over_limit (DbusmenuServer * server, sender_t * sender)
 {
-	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 
-	g_signal_emit(G_OBJECT(server), signals[LAYOUT_UPDATED], 0, priv->layout_revision, 0, TRUE);
-	if (priv->dbusobject != NULL && priv->bus != NULL) {
-		g_dbus_connection_emit_signal(priv->bus,
-		                              NULL,
-		                              priv->dbusobject,
-		                              DBUSMENU_INTERFACE,
-		                              "LayoutUpdated",
-		                              g_variant_new("(ui)", priv->layout_revision, 0),
-		                              NULL);
+	return (priv->request_limit != 0 && sender->window_requests > priv->request_limit) ||
+	       (priv->reply_byte_limit != 0 && sender->window_bytes > priv->reply_byte_limit);
+}
+
+/* Runs @size bytes of @data through zlib, NULL if it fails */
+static GVariant *
+reply_compress (gconstpointer data, gsize size)
+{
+	GError * error = NULL;
+	GConverter * compressor = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, 1));
+	GOutputStream * memory = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+	GOutputStream * stream = g_converter_output_stream_new(memory, compressor);
+	GVariant * retval = NULL;
+
+	if (g_output_stream_write_all(stream, data, size, NULL, NULL, &error) &&
+	        g_output_stream_close(stream, NULL, &error)) {
+		gsize length = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(memory));
+		retval = g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING,
+		                                 g_memory_output_stream_steal_data(G_MEMORY_OUTPUT_STREAM(memory)),
+		                                 length, TRUE, g_free, NULL);
+	} else {
+		g_warning("Unable to compress reply: %s", error->message);
+		g_error_free(error);
 	}
 
-	priv->layout_idle = 0;
+	g_object_unref(stream);
+	g_object_unref(memory);
+	g_object_unref(compressor);
 
-	return FALSE;
+	return retval;
 }
 
-/* Signals that the layout has been updated */
-static void
-layout_update_signal (DbusmenuServer * server)
+/* Packs a reply up for GetCompressed, as the little endian
+   serialized value which is compressed if it's big enough */
+static GVariant *
+reply_encode (DbusmenuServer * server, GVariant * value)
 {
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
-	priv->layout_revision++;
+	GVariant * normal = g_variant_get_normal_form(value);
+	const gchar * encoding = priv->reply_encoding;
+	GVariant * data = NULL;
+
+	if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+		GVariant * swapped = g_variant_byteswap(normal);
+		g_variant_unref(normal);
+		normal = swapped;
+	}
 
-	if (priv->layout_idle == 0) {
-		priv->layout_idle = g_idle_add(layout_update_idle, server);
+	if (g_strcmp0(encoding, ENCODING_ZLIB) == 0 && priv->compress_threshold != 0 && g_variant_get_size(normal) >= priv->compress_threshold) {
+		data = reply_compress(g_variant_get_data(normal), g_variant_get_size(normal));
 	}
 
-	return;
+	if (data == NULL) {
+		encoding = "";
+		data = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, g_variant_get_data(normal), g_variant_get_size(normal), sizeof(guchar));
+	}
+
+	g_variant_unref(normal);
+
+	return g_variant_new("(s@ay)", encoding, data);
+}
+
+/* Replies to a method call, sharing the reply with any identical
+   requests that were held back with it and counting the bytes
+   against the client. */
+static void
+bus_return_value (DbusmenuServer * server, GDBusMethodInvocation * invocation, GVariant * value)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	GList * shared = priv->shared_invocations;
+	GList * link;
+
+	priv->shared_invocations = NULL;
+
+	if (value != NULL) {
+		g_variant_ref_sink(value);
+	}
+
+	/* Asked for through GetCompressed */
+	if (value != NULL && priv->reply_encoding != NULL) {
+		GVariant * encoded = g_variant_ref_sink(reply_encode(server, value));
+		g_variant_unref(value);
+		value = encoded;
+	}
+
+	if (priv->current_sender != NULL && value != NULL) {
+		guint64 bytes = g_variant_get_size(value) * (g_list_length(shared) + 1);
+		priv->current_sender->window_bytes += bytes;
+		priv->current_sender->reply_bytes += bytes;
+	}
+
+	for (link = shared; link != NULL; link = g_list_next(link)) {
+		g_dbus_method_invocation_return_value(G_DBUS_METHOD_INVOCATION(link->data), value);
+	}
+	g_list_free(shared);
+
+	g_dbus_method_invocation_return_value(invocation, value);
+
+	if (value != NULL) {
+		g_variant_unref(value);
+	}
+
+	return;
+}
+
+/* Whether a hibernating server can answer the call without waking
+   up.  That's the full layout and all of the properties of items
+   from the layout it kept, which is what clients ask for when they
+   start, and searches. */
+static gboolean
+hibernate_serves (DbusmenuServer * server, guint method, GVariant * params)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	gboolean retval = FALSE;
+
+	switch (method) {
+	case METHOD_GET_LAYOUT: {
+		gint32 parent, recurse;
+		const gchar ** props;
+		g_variant_get(params, "(ii^a&s)", &parent, &recurse, &props);
+		retval = recurse == -1 && props[0] == NULL && !priv->prune_hidden;
+		g_free(props);
+		break;
+	}
+	case METHOD_GET_GROUP_PROPERTIES: {
+		GVariant * names = g_variant_get_child_value(params, 1);
+		retval = g_variant_n_children(names) == 0;
+		g_variant_unref(names);
+		break;
+	}
+	case METHOD_GET_PROPERTIES:
+		retval = TRUE;
+		break;
+	case METHOD_SEARCH:
+		/* Looks through the items, if the application still has
+		   them, with the IDs from the stand-ins that are kept.
+		   Nothing in them has changed or the server would be
+		   awake. */
+		retval = priv->root != NULL;
+		break;
+	case METHOD_GET_COMPRESSED: {
+		const gchar * name;
+		GVariant * inner;
+		g_variant_get(params, "(&sv^as)", &name, &inner, NULL);
+
+		const gchar * interned_name = g_intern_string(name);
+		guint i;
+		for (i = 0; i < METHOD_COUNT; i++) {
+			if (dbusmenu_method_table[i].interned_name == interned_name) {
+				break;
+			}
+		}
+
+		/* Anything it can't call is an error, which we can do
+		   without the items too */
+		retval = i == METHOD_COUNT || !dbusmenu_method_table[i].compress || !bus_params_match(name, inner) ||
+		         hibernate_serves(server, i, inner);
+		g_variant_unref(inner);
+		break;
+	}
+	default:
+		break;
+	}
+
+	return retval;
+}
+
+/* Calls the function for a method.  The identical requests in
+   @shared get the same reply if it's a successful one, otherwise
+   they get their own. */
+static void
+bus_dispatch (DbusmenuServer * server, sender_t * sender, guint method, GVariant * params, GDBusMethodInvocation * invocation, GList * shared)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	GList * link;
+
+	priv->current_sender = sender;
+	priv->shared_invocations = shared;
+
+	/* Clients need to see the IDs that are going to stick */
+	repopulate_resolve(server);
+
+	/* Everything else needs the items back */
+	if (priv->hibernated != NULL && !hibernate_serves(server, method, params)) {
+		dbusmenu_server_resume(server);
+	}
+
+	dbusmenu_method_table[method].func(server, params, invocation);
+
+	shared = priv->shared_invocations;
+	priv->shared_invocations = NULL;
+
+	for (link = shared; link != NULL; link = g_list_next(link)) {
+		dbusmenu_method_table[method].func(server, params, G_DBUS_METHOD_INVOCATION(link->data));
+	}
+	g_list_free(shared);
+
+	priv->current_sender = NULL;
+	return;
+}
+
+/* Serves the held back requests as the limits allow, starting
+   a new window for each client */
+static gboolean
+deferred_flush (gpointer user_data)
+{
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	gint64 now = g_get_monotonic_time();
+	gboolean waiting = FALSE;
+	GHashTableIter iter;
+	gpointer value;
+
+	priv->deferred_flush = 0;
+
+	g_hash_table_iter_init(&iter, priv->senders);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		sender_t * sender = (sender_t *)value;
+
+		if (sender->pending == NULL) {
+			continue;
+		}
+
+		sender_window(sender, now);
+
+		while (sender->pending != NULL && !sender_over_limit(server, sender)) {
+			deferred_t * deferred = (deferred_t *)sender->pending->data;
+			sender->pending = g_list_delete_link(sender->pending, sender->pending);
+			sender->window_requests++;
+
+			bus_dispatch(server, sender, deferred->method, deferred->params, deferred->invocation, deferred->shared);
+
+			deferred->invocation = NULL;
+			deferred->shared = NULL;
+			deferred_free(deferred);
+		}
+
+		if (sender->pending != NULL) {
+			waiting = TRUE;
+		}
+	}
+
+	if (waiting) {
+		priv->deferred_flush = g_timeout_add(1000, deferred_flush, server);
+	}
+
+	return FALSE;
+}
+
+/* Holds the request back if the client is over its limits, or
+   already has requests waiting so that they stay in order */
+static gboolean
+sender_throttle (DbusmenuServer * server, sender_t * sender, guint method, GVariant * params, GDBusMethodInvocation * invocation)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (!dbusmenu_method_table[method].throttle) {
+		return FALSE;
+	}
+
+	if (sender->pending == NULL && !sender_over_limit(server, sender)) {
+		return FALSE;
+	}
+
+	if (!sender->warned) {
+		g_warning("Client '%s' is over its request limits, holding back its requests", sender->name);
+		sender->warned = TRUE;
+	}
+
+	GList * link;
+	for (link = sender->pending; link != NULL; link = g_list_next(link)) {
+		deferred_t * deferred = (deferred_t *)link->data;
+		if (deferred->method == method && g_variant_equal(deferred->params, params)) {
+			deferred->shared = g_list_append(deferred->shared, invocation);
+			sender->shared++;
+			return TRUE;
+		}
+	}
+
+	deferred_t * deferred = g_new0(deferred_t, 1);
+	deferred->method = method;
+	deferred->params = g_variant_ref(params);
+	deferred->invocation = invocation;
+	sender->pending = g_list_append(sender->pending, deferred);
+	sender->deferred++;
+
+	if (priv->deferred_flush == 0) {
+		gint64 remaining = sender->window + G_USEC_PER_SEC - g_get_monotonic_time();
+		priv->deferred_flush = g_timeout_add(MAX(remaining / 1000, 1), deferred_flush, server);
+	}
+
+	return TRUE;
+}
+
+/* Function for the GDBus vtable to handle all method calls and dish
+   them out the appropriate functions */
+static void
+bus_method_call (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * method, GVariant * params, GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	int i;
+	const gchar * interned_method = g_intern_string(method);
+
+	for (i = 0; i < METHOD_COUNT; i++) {
+		if (dbusmenu_method_table[i].interned_name == interned_method) {
+			if (dbusmenu_method_table[i].func != NULL) {
+				DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+				sender_t * account = sender_account(server, sender);
+
+				if (!sender_throttle(server, account, i, params, invocation)) {
+					bus_dispatch(server, account, i, params, invocation, NULL);
+				}
+				return;
+			} else {
+				/* If we have a null function we're responding but nothing else. */
+				g_warning("Invalid function call for '%s' with parameters: %s", method, g_variant_print(params, TRUE));
+				g_dbus_method_invocation_return_value(invocation, NULL);
+				return;
+			}
+		}
+	}
+
+	/* We're here because there's an error */
+	g_dbus_method_invocation_return_error(invocation,
+	                                      error_quark(),
+	                                      NOT_IMPLEMENTED,
+	                                      "Unable to find method '%s'",
+	                                      method);
+	return;
+}
+
+/* For the GDBus vtable but we only have one property so it's pretty
+   simple. */
+static GVariant *
+bus_get_prop (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * property, GError ** error, gpointer user_data)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(user_data);
+
+	/* None of these should happen */
+	g_return_val_if_fail(g_strcmp0(interface, DBUSMENU_INTERFACE) == 0, NULL);
+	g_return_val_if_fail(g_strcmp0(path, priv->dbusobject) == 0, NULL);
+
+	if (g_strcmp0(property, "Version") == 0) {
+		return g_variant_new_uint32(DBUSMENU_VERSION_NUMBER);
+	} else if (g_strcmp0(property, "TextDirection") == 0) {
+		return g_variant_new_string(dbusmenu_text_direction_get_nick(priv->text_direction));
+	} else if (g_strcmp0(property, "IconThemePath") == 0) {
+		GVariant * dirs = NULL;
+
+		if (priv->icon_dirs != NULL) {
+			dirs = g_variant_new_strv((const gchar * const *)priv->icon_dirs, -1);
+		} else {
+			dirs = g_variant_new_array(G_VARIANT_TYPE_STRING, NULL, 0);
+		}
+
+		return dirs;
+	} else if (g_strcmp0(property, "Status") == 0) {
+		return g_variant_new_string(dbusmenu_status_get_nick(priv->status));
+	} else {
+		g_warning("Unknown property '%s'", property);
+	}
+
+	return NULL;
+}
+
+/* Handle actually signalling in the idle loop.  This way we collect all
+   the updates. */
+static gboolean
+layout_update_idle (gpointer user_data)
+{
+	DbusmenuServer * server = DBUSMENU_SERVER(user_data);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	/* Submenus that were cleared out and filled up with the same
+	   items again don't need to be sent */
+	repopulate_resolve(server);
+
+	if (priv->layout_forced) {
+		g_signal_emit(G_OBJECT(server), signals[LAYOUT_UPDATED], 0, priv->layout_revision, 0, TRUE);
+		if (priv->dbusobject != NULL && priv->bus != NULL) {
+			g_dbus_connection_emit_signal(priv->bus,
+			                              NULL,
+			                              priv->dbusobject,
+			                              DBUSMENU_INTERFACE,
+			                              "LayoutUpdated",
+			                              g_variant_new("(ui)", priv->layout_revision, 0),
+			                              NULL);
+		}
+	}
+
+	priv->layout_forced = FALSE;
+	priv->layout_idle = 0;
+
+	return FALSE;
+}
+
+/* Moves the layout to a new revision and makes sure that
+   the idle is queued to look at it */
+static void
+layout_update_queue (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	priv->layout_revision++;
+
+	if (priv->layout_idle == 0) {
+		priv->layout_idle = g_idle_add(layout_update_idle, server);
+	}
+
+	return;
+}
+
+/* Signals that the layout has been updated */
+static void
+layout_update_signal (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	priv->layout_forced = TRUE;
+	layout_update_queue(server);
+	return;
+}
+
+/* The children of @parent changed.  That only gets signaled, and
+   the revision only moves, if they still look different once the
+   idle comes around. */
+static void
+layout_update_children (DbusmenuServer * server, DbusmenuMenuitem * parent)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (!g_hash_table_contains(priv->repopulated, parent)) {
+		g_hash_table_insert(priv->repopulated, g_object_ref(parent), NULL);
+	}
+
+	if (priv->layout_idle == 0) {
+		priv->layout_idle = g_idle_add(layout_update_idle, server);
+	}
+
+	return;
+}
+
+typedef struct _journal_entry_t journal_entry_t;
+struct _journal_entry_t {
+	guint revision;
+	gint id;
+	gchar * property; /* NULL when the children of the item changed */
+};
+
+static void
+journal_entry_free (journal_entry_t * entry)
+{
+	g_free(entry->property);
+	g_slice_free(journal_entry_t, entry);
+	return;
+}
+
+/* Entries are looked up by the item and property they're for */
+static guint
+journal_entry_hash (gconstpointer key)
+{
+	const journal_entry_t * entry = (const journal_entry_t *)key;
+	guint hash = g_direct_hash(GINT_TO_POINTER(entry->id));
+
+	if (entry->property != NULL) {
+		hash ^= g_str_hash(entry->property);
+	}
+
+	return hash;
+}
+
+static gboolean
+journal_entry_equal (gconstpointer a, gconstpointer b)
+{
+	const journal_entry_t * entrya = (const journal_entry_t *)a;
+	const journal_entry_t * entryb = (const journal_entry_t *)b;
+
+	return entrya->id == entryb->id && g_strcmp0(entrya->property, entryb->property) == 0;
+}
+
+/* Records that something changed on @mi at the current revision.  Only
+   the latest entry for each item and property is kept as the values
+   are read from the tree when a client catches up.  When the journal
+   gets too big the oldest entries are dropped and the oldest revision
+   we can catch a client up from moves forward. */
+static void
+journal_add (DbusmenuServer * server, DbusmenuMenuitem * mi, const gchar * property)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	gint id = 0;
+	if (!dbusmenu_menuitem_get_root(mi)) {
+		id = item_id(server, mi);
+	}
+
+	journal_entry_t key = { 0, id, (gchar *)property };
+	journal_entry_t * entry = NULL;
+	GList * link = (GList *)g_hash_table_lookup(priv->journal_index, &key);
+	if (link != NULL) {
+		entry = (journal_entry_t *)link->data;
+		g_hash_table_remove(priv->journal_index, entry);
+		g_queue_delete_link(priv->journal, link);
+	}
+
+	if (entry == NULL) {
+		entry = g_slice_new(journal_entry_t);
+		entry->id = id;
+		entry->property = g_strdup(property);
+	}
+
+	entry->revision = priv->layout_revision;
+	g_queue_push_tail(priv->journal, entry);
+	g_hash_table_insert(priv->journal_index, entry, priv->journal->tail);
+
+	while (g_queue_get_length(priv->journal) > JOURNAL_MAX_ENTRIES) {
+		journal_entry_t * oldest = (journal_entry_t *)g_queue_pop_head(priv->journal);
+		g_hash_table_remove(priv->journal_index, oldest);
+
+		/* Structural changes are needed by clients before their revision,
+		   property changes by clients at it too. */
+		guint floor = oldest->revision;
+		if (oldest->property != NULL) {
+			floor++;
+		}
+		priv->journal_floor = MAX(priv->journal_floor, floor);
+
+		journal_entry_free(oldest);
+	}
+
+	return;
+}
+
+/* Forget everything, clients from before now need to start over */
+static void
+journal_reset (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	g_hash_table_remove_all(priv->journal_index);
+
+	journal_entry_t * entry;
+	while ((entry = (journal_entry_t *)g_queue_pop_head(priv->journal)) != NULL) {
+		journal_entry_free(entry);
+	}
+
+	priv->journal_floor = priv->layout_revision;
+
+	return;
 }
 
 typedef struct _prop_idle_item_t prop_idle_item_t;
@@ -962,6 +1929,10 @@ menuitem_property_idle (gpointer user_data)
 {
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(user_data);
 
+	/* Items that replaced ones the clients already have need to
+	   go out with the old IDs, if any of their properties do */
+	repopulate_resolve(DBUSMENU_SERVER(user_data));
+
 	/* Source will get removed as we return */
 	priv->property_idle = 0;
 
@@ -1023,7 +1994,7 @@ menuitem_property_idle (gpointer user_data)
 			GVariantBuilder tuplebuilder;
 			g_variant_builder_init(&tuplebuilder, G_VARIANT_TYPE_TUPLE);
 
-			g_variant_builder_add_value(&tuplebuilder, g_variant_new_int32(dbusmenu_menuitem_get_id(iitem->mi)));
+			g_variant_builder_add_value(&tuplebuilder, g_variant_new_int32(item_id(DBUSMENU_SERVER(user_data), iitem->mi)));
 			g_variant_builder_add_value(&tuplebuilder, g_variant_builder_end(&dictbuilder));
 
 			if (!item_init) {
@@ -1040,7 +2011,7 @@ menuitem_property_idle (gpointer user_data)
 			GVariantBuilder tuplebuilder;
 			g_variant_builder_init(&tuplebuilder, G_VARIANT_TYPE_TUPLE);
 
-			g_variant_builder_add_value(&tuplebuilder, g_variant_new_int32(dbusmenu_menuitem_get_id(iitem->mi)));
+			g_variant_builder_add_value(&tuplebuilder, g_variant_new_int32(item_id(DBUSMENU_SERVER(user_data), iitem->mi)));
 			g_variant_builder_add_value(&tuplebuilder, g_variant_builder_end(&removedictbuilder));
 
 			if (!removeitem_init) {
@@ -1110,6 +2081,8 @@ menuitem_property_idle (gpointer user_data)
 	/* Clean everything up */
 	prop_array_teardown(priv->prop_array);
 	priv->prop_array = NULL;
+	g_hash_table_destroy(priv->prop_index);
+	priv->prop_index = NULL;
 
 	return FALSE;
 }
@@ -1118,86 +2091,456 @@ static void
 menuitem_property_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * variant, DbusmenuServer * server)
 {
 	int i;
-	gint item_id;
+	gint id;
 
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 
-	item_id = dbusmenu_menuitem_get_id(mi);
+	id = item_id(server, mi);
+
+	g_signal_emit(G_OBJECT(server), signals[ID_PROP_UPDATE], 0, id, property, variant, TRUE);
 
-	g_signal_emit(G_OBJECT(server), signals[ID_PROP_UPDATE], 0, item_id, property, variant, TRUE);
+	journal_add(server, mi, property);
+
+	/* Changes made while the children are being refilled are
+	   compared once that's done */
+	if (g_strcmp0(property, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY) == 0 && priv->published != NULL && !g_hash_table_contains(priv->repopulated, mi)) {
+		published_t * published = g_hash_table_lookup(priv->published, mi);
+		if (published != NULL) {
+			g_free(published->child_display);
+			published->child_display = g_strdup(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY));
+		}
+	}
+
+	/* When hidden items are sent without their children showing
+	   or hiding one changes the layout under it */
+	if (priv->prune_hidden && g_strcmp0(property, DBUSMENU_MENUITEM_PROP_VISIBLE) == 0 &&
+			!dbusmenu_menuitem_get_root(mi) && dbusmenu_menuitem_get_children(mi) != NULL) {
+		layout_update_signal(server);
+		journal_add(server, mi, NULL);
+	}
 
 	/* See if we have a property array, if not, we need to
 	   build one of these suckers */
 	if (priv->prop_array == NULL) {
 		priv->prop_array = g_array_new(FALSE, FALSE, sizeof(prop_idle_item_t));
+		priv->prop_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 	}
 
 	/* Look to see if we already have this item in the list
 	   and use it if so */
-	prop_idle_item_t * item = NULL;
+	GArray * properties = g_hash_table_lookup(priv->prop_index, mi);
+
+	/* If not, we'll need to build ourselves one */
+	if (properties == NULL) {
+		prop_idle_item_t myitem;
+		myitem.mi = mi;
+		g_object_ref(G_OBJECT(mi));
+		myitem.array = g_array_new(FALSE, FALSE, sizeof(prop_idle_prop_t));
+
+		g_array_append_val(priv->prop_array, myitem);
+		g_hash_table_insert(priv->prop_index, mi, myitem.array);
+		properties = myitem.array;
+	}
+
+	/* Check to see if this property is in the list */
+	prop_idle_prop_t * prop = NULL;
+	for (i = 0; i < properties->len; i++) {
+		prop_idle_prop_t * iprop = &g_array_index(properties, prop_idle_prop_t, i);
+		if (g_strcmp0(iprop->property, property) == 0) {
+			prop = iprop;
+			break;
+		}
+	}
+
+	/* If it's the default value we want to treat it like a clearing
+	   of the value so that it doesn't get sent over dbus and waste
+	   bandwidth */
+	if (dbusmenu_menuitem_property_is_default(mi, property)) {
+		variant = NULL;
+	}
+
+	/* If so, we need to swap the value */
+	if (prop != NULL) {
+		if (prop->variant != NULL) {
+			g_variant_unref(prop->variant);
+		}
+		prop->variant = variant;
+	} else {
+	/* else we need to add it */
+		prop_idle_prop_t myprop;
+		myprop.property = g_strdup(property);
+		myprop.variant = variant;
+
+		g_array_append_val(properties, myprop);
+	}
+	if (variant != NULL) {
+		g_variant_ref_sink(variant);
+	}
+
+	/* Check to see if the idle is already queued, and queue it
+	   if not. */
+	if (priv->property_idle == 0) {
+		priv->property_idle = g_idle_add(menuitem_property_idle, server);
+	}
+
+	return;
+}
+
+static void
+published_free (published_t * published)
+{
+	g_list_free_full(published->children, g_object_unref);
+	g_free(published->child_display);
+	g_slice_free(published_t, published);
+	return;
+}
+
+/* Remembers the children of @mi as the ones the clients know
+   about.  They're compared against the ones it has when the
+   idle comes around. */
+static void
+published_set (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	if (priv->published == NULL) {
+		return;
+	}
+
+	published_t * published = g_slice_new(published_t);
+	published->children = g_list_copy(dbusmenu_menuitem_get_children(mi));
+	g_list_foreach(published->children, (GFunc)g_object_ref, NULL);
+	published->child_display = g_strdup(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY));
+	g_hash_table_replace(priv->published, mi, published);
+
+	return;
+}
+
+/* Forgets about @mi and everything under it */
+static void
+published_remove (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	if (priv->published == NULL) {
+		return;
+	}
+
+	g_hash_table_remove(priv->published, mi);
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		published_remove(server, DBUSMENU_MENUITEM(child->data));
+	}
+
+	return;
+}
+
+/* Whether @mi, or anything under it, has property changes that
+   haven't gone out yet */
+static gboolean
+prop_array_pending (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->prop_index != NULL && g_hash_table_contains(priv->prop_index, mi)) {
+		return TRUE;
+	}
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		if (prop_array_pending(server, DBUSMENU_MENUITEM(child->data))) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Drops the queued change to @property on @mi, or all of
+   them if @property is NULL */
+static void
+prop_array_drop (DbusmenuServer * server, DbusmenuMenuitem * mi, const gchar * property)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+	if (priv->prop_array == NULL || !g_hash_table_contains(priv->prop_index, mi)) {
+		return;
+	}
+
+	guint i, j;
 	for (i = 0; i < priv->prop_array->len; i++) {
 		prop_idle_item_t * iitem = &g_array_index(priv->prop_array, prop_idle_item_t, i);
-		if (iitem->mi == mi) {
-			item = iitem;
+		if (iitem->mi != mi) {
+			continue;
+		}
+
+		for (j = 0; j < iitem->array->len; j++) {
+			prop_idle_prop_t * iprop = &g_array_index(iitem->array, prop_idle_prop_t, j);
+			if (property != NULL && g_strcmp0(iprop->property, property) != 0) {
+				continue;
+			}
+
+			g_free(iprop->property);
+			if (iprop->variant != NULL) {
+				g_variant_unref(iprop->variant);
+			}
+
+			if (property != NULL) {
+				g_array_remove_index(iitem->array, j);
+				break;
+			}
+		}
+
+		if (property != NULL) {
 			break;
 		}
+
+		g_hash_table_remove(priv->prop_index, mi);
+		g_array_free(iitem->array, TRUE);
+		g_object_unref(G_OBJECT(iitem->mi));
+		g_array_remove_index(priv->prop_array, i);
+		break;
+	}
+
+	return;
+}
+
+/* Checks whether @new can stand in for @old, which the clients
+   already have.  They need the same type and the same shape of
+   children all the way down, and @new has to be able to take
+   the ID of @old.  Properties can be different, those get sent
+   as changes.  @parent is where @old should still be, which is
+   nowhere for the items that were taken out of the menu and their
+   parent for the ones under them. */
+static gboolean
+repopulate_match (DbusmenuServer * server, DbusmenuMenuitem * old, DbusmenuMenuitem * new, DbusmenuMenuitem * parent)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	/* Still in the menu, so it's the item's own business */
+	if (old == new) {
+		return TRUE;
+	}
+
+	/* Moved somewhere else, the ID is still being used */
+	if (dbusmenu_menuitem_get_parent(old) != parent) {
+		return FALSE;
+	}
+
+	gint id = item_id(server, old);
+	if (item_id(server, new) != id) {
+		if (!dbusmenu_menuitem_id_automatic(new)) {
+			return FALSE;
+		}
+		if (g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(id)) != NULL) {
+			return FALSE;
+		}
+	}
+
+	if (g_strcmp0(dbusmenu_menuitem_property_get(old, DBUSMENU_MENUITEM_PROP_TYPE),
+	              dbusmenu_menuitem_property_get(new, DBUSMENU_MENUITEM_PROP_TYPE)) != 0) {
+		return FALSE;
+	}
+
+	/* When hidden items go without their children being visible
+	   is part of the layout */
+	if (priv->prune_hidden &&
+			dbusmenu_menuitem_property_get_bool(old, DBUSMENU_MENUITEM_PROP_VISIBLE) != dbusmenu_menuitem_property_get_bool(new, DBUSMENU_MENUITEM_PROP_VISIBLE)) {
+		return FALSE;
+	}
+
+	/* The clients haven't seen those changes, so we don't
+	   know what they've got */
+	if (prop_array_pending(server, old)) {
+		return FALSE;
+	}
+
+	GList * old_children = dbusmenu_menuitem_get_children(old);
+	GList * new_children = dbusmenu_menuitem_get_children(new);
+	if (g_list_length(old_children) != g_list_length(new_children)) {
+		return FALSE;
+	}
+
+	for (; old_children != NULL; old_children = g_list_next(old_children), new_children = g_list_next(new_children)) {
+		if (!repopulate_match(server, DBUSMENU_MENUITEM(old_children->data), DBUSMENU_MENUITEM(new_children->data), old)) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Puts @new in the place of @old, which means it is sent with the
+   ID of @old and only the properties that are different go out. */
+static void
+repopulate_apply (DbusmenuServer * server, DbusmenuMenuitem * old, DbusmenuMenuitem * new, GHashTable * covered)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (old == new) {
+		return;
+	}
+
+	gint id = item_id(server, old);
+
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Item %d is standing in for %d", dbusmenu_menuitem_get_id(new), id);
+	#endif
+
+	/* @old is gone for good, @new is what the clients know by its ID */
+	g_hash_table_remove(priv->stand_ins, old);
+	gint current = item_id(server, new);
+	if (current != id) {
+		if (g_hash_table_lookup(priv->lookup_cache, GINT_TO_POINTER(current)) == new) {
+			g_hash_table_remove(priv->lookup_cache, GINT_TO_POINTER(current));
+		}
+		if (dbusmenu_menuitem_get_id(new) == id) {
+			g_hash_table_remove(priv->stand_ins, new);
+		} else {
+			g_hash_table_replace(priv->stand_ins, g_object_ref(new), GINT_TO_POINTER(id));
+		}
+		g_hash_table_insert(priv->lookup_cache, GINT_TO_POINTER(id), g_object_ref(new));
+	}
+	dbusmenu_menuitem_stand_in(new, old);
+
+	/* Everything under it is what the clients have now */
+	g_hash_table_add(covered, new);
+	published_set(server, new);
+
+	prop_array_drop(server, new, NULL);
+
+	GHashTable * old_props = dbusmenu_menuitem_properties_copy(old);
+	GHashTable * new_props = dbusmenu_menuitem_properties_copy(new);
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init(&iter, new_props);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		GVariant * old_value = g_hash_table_lookup(old_props, key);
+		if (old_value == NULL || !g_variant_equal(old_value, value)) {
+			menuitem_property_changed(new, (gchar *)key, (GVariant *)value, server);
+		}
+	}
+
+	g_hash_table_iter_init(&iter, old_props);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		if (!g_hash_table_contains(new_props, key)) {
+			menuitem_property_changed(new, (gchar *)key, NULL, server);
+		}
+	}
+
+	g_hash_table_destroy(old_props);
+	g_hash_table_destroy(new_props);
+
+	GList * old_children = dbusmenu_menuitem_get_children(old);
+	GList * new_children = dbusmenu_menuitem_get_children(new);
+	for (; old_children != NULL; old_children = g_list_next(old_children), new_children = g_list_next(new_children)) {
+		repopulate_apply(server, DBUSMENU_MENUITEM(old_children->data), DBUSMENU_MENUITEM(new_children->data), covered);
+	}
+
+	return;
+}
+
+/* How far down the tree the item is */
+static gint
+repopulate_depth (DbusmenuMenuitem * mi)
+{
+	gint depth = 0;
+	while ((mi = dbusmenu_menuitem_get_parent(mi)) != NULL) {
+		depth++;
+	}
+	return depth;
+}
+
+static gint
+repopulate_depth_compare (gconstpointer a, gconstpointer b)
+{
+	return repopulate_depth(DBUSMENU_MENUITEM(a)) - repopulate_depth(DBUSMENU_MENUITEM(b));
+}
+
+/* Looks at all the items whose children changed since the clients
+   last heard about them and compares the children to what the
+   clients have.  The ones that come out the same, applications that
+   clear out a submenu and fill it up again, take over the IDs of the
+   items they replace and only their different properties get sent.
+   If any of them really changed the layout is signaled. */
+static void
+repopulate_resolve (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->repopulated == NULL || g_hash_table_size(priv->repopulated) == 0) {
+		return;
 	}
 
-	GArray * properties = NULL;
-	/* If not, we'll need to build ourselves one */
-	if (item == NULL) {
-		prop_idle_item_t myitem;
-		myitem.mi = mi;
-		g_object_ref(G_OBJECT(mi));
-		myitem.array = g_array_new(FALSE, FALSE, sizeof(prop_idle_prop_t));
+	/* Parents first, their replacements cover what's under them */
+	GList * parents = g_hash_table_get_keys(priv->repopulated);
+	g_list_foreach(parents, (GFunc)g_object_ref, NULL);
+	g_hash_table_remove_all(priv->repopulated);
+	parents = g_list_sort(parents, repopulate_depth_compare);
 
-		g_array_append_val(priv->prop_array, myitem);
-		properties = myitem.array;
-	} else {
-		properties = item->array;
-	}
+	GHashTable * covered = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gboolean changed = FALSE;
+	GList * lparent;
 
-	/* Check to see if this property is in the list */
-	prop_idle_prop_t * prop = NULL;
-	for (i = 0; i < properties->len; i++) {
-		prop_idle_prop_t * iprop = &g_array_index(properties, prop_idle_prop_t, i);
-		if (g_strcmp0(iprop->property, property) == 0) {
-			prop = iprop;
-			break;
+	for (lparent = parents; lparent != NULL; lparent = g_list_next(lparent)) {
+		DbusmenuMenuitem * parent = DBUSMENU_MENUITEM(lparent->data);
+
+		if (g_hash_table_contains(covered, parent)) {
+			continue;
 		}
-	}
 
-	/* If it's the default value we want to treat it like a clearing
-	   of the value so that it doesn't get sent over dbus and waste
-	   bandwidth */
-	if (dbusmenu_menuitem_property_is_default(mi, property)) {
-		variant = NULL;
-	}
+		/* Not in the menu anymore, whoever it was taken
+		   from has changed */
+		published_t * published = g_hash_table_lookup(priv->published, parent);
+		if (published == NULL) {
+			continue;
+		}
 
-	/* If so, we need to swap the value */
-	if (prop != NULL) {
-		if (prop->variant != NULL) {
-			g_variant_unref(prop->variant);
+		GList * old_children = published->children;
+		GList * new_children = dbusmenu_menuitem_get_children(parent);
+		gboolean same = (g_list_length(old_children) == g_list_length(new_children));
+
+		GList * lold, * lnew;
+		for (lold = old_children, lnew = new_children; same && lold != NULL; lold = g_list_next(lold), lnew = g_list_next(lnew)) {
+			same = repopulate_match(server, DBUSMENU_MENUITEM(lold->data), DBUSMENU_MENUITEM(lnew->data), NULL);
 		}
-		prop->variant = variant;
-	} else {
-	/* else we need to add it */
-		prop_idle_prop_t myprop;
-		myprop.property = g_strdup(property);
-		myprop.variant = variant;
 
-		g_array_append_val(properties, myprop);
-	}
-	if (variant != NULL) {
-		g_variant_ref_sink(variant);
-	}
+		if (same) {
+			for (lold = old_children, lnew = new_children; lold != NULL; lold = g_list_next(lold), lnew = g_list_next(lnew)) {
+				repopulate_apply(server, DBUSMENU_MENUITEM(lold->data), DBUSMENU_MENUITEM(lnew->data), covered);
+			}
 
-	/* Check to see if the idle is already queued, and queue it
-	   if not. */
-	if (priv->property_idle == 0) {
-		priv->property_idle = g_idle_add(menuitem_property_idle, server);
+			/* Came back to what it was when the children did */
+			if (g_strcmp0(published->child_display, dbusmenu_menuitem_property_get(parent, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY)) == 0) {
+				prop_array_drop(server, parent, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY);
+			}
+		} else {
+			#ifdef MASSIVEDEBUGGING
+			g_debug("Children of %d changed", dbusmenu_menuitem_get_id(parent));
+			#endif
+
+			/* Only a layout that goes out moves the revision */
+			if (!changed) {
+				priv->layout_revision++;
+				changed = TRUE;
+			}
+			priv->layout_forced = TRUE;
+			journal_add(server, parent, NULL);
+
+			/* Whatever was taken out for good doesn't keep an ID */
+			for (lold = old_children; lold != NULL; lold = g_list_next(lold)) {
+				if (dbusmenu_menuitem_get_parent(DBUSMENU_MENUITEM(lold->data)) == NULL) {
+					stand_in_forget(server, DBUSMENU_MENUITEM(lold->data));
+				}
+			}
+		}
+
+		/* This replaces the old list, and drops the old children */
+		published_set(server, parent);
 	}
 
+	g_hash_table_destroy(covered);
+	g_list_free_full(parents, g_object_unref);
+
 	return;
 }
 
@@ -1222,10 +2565,10 @@ static void
 menuitem_child_added (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint pos, DbusmenuServer * server)
 {
 	menuitem_signals_create(child, server);
-	cache_add_entries_for_menuitem(server->priv->lookup_cache, child);
+	cache_add_entries_for_menuitem(server, child);
 	g_list_foreach(dbusmenu_menuitem_get_children(child), added_check_children, server);
 
-	layout_update_signal(server);
+	layout_update_children(server, parent);
 	return;
 }
 
@@ -1233,15 +2576,47 @@ static void
 menuitem_child_removed (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, DbusmenuServer * server)
 {
 	menuitem_signals_remove(child, server);
-	cache_remove_entries_for_menuitem(server->priv->lookup_cache, child);
-	layout_update_signal(server);
+	cache_remove_entries_for_menuitem(server, child);
+	published_remove(server, child);
+	layout_update_children(server, parent);
 	return;
 }
 
 static void 
 menuitem_child_moved (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, guint newpos, guint oldpos, DbusmenuServer * server)
 {
-	layout_update_signal(server);
+	layout_update_children(server, parent);
+	return;
+}
+
+/* Whether we're connected to @mi */
+static gboolean
+menuitem_watched (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	return g_signal_handler_find(mi, G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA, 0, 0, NULL, G_CALLBACK(menuitem_child_added), server) != 0;
+}
+
+/* Signaled on both parents when a child moves from one to the
+   other.  Everything under it stays connected and in the cache, so
+   it's just the parents that have new layouts.  If one of them is
+   outside of the items we watch it looks like a removal or an
+   addition to us. */
+static void
+menuitem_child_reparented (DbusmenuMenuitem * parent, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint pos, DbusmenuServer * server)
+{
+	if (parent == oldparent) {
+		if (!menuitem_watched(server, dbusmenu_menuitem_get_parent(child))) {
+			menuitem_child_removed(parent, child, server);
+			return;
+		}
+	} else {
+		if (!menuitem_watched(server, child)) {
+			menuitem_child_added(parent, child, pos, server);
+			return;
+		}
+	}
+
+	layout_update_children(server, parent);
 	return;
 }
 
@@ -1252,7 +2627,7 @@ menuitem_shown (DbusmenuMenuitem * mi, guint timestamp, DbusmenuServer * server)
 {
 	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
 
-	g_signal_emit(G_OBJECT(server), signals[ITEM_ACTIVATION], 0, dbusmenu_menuitem_get_id(mi), timestamp, TRUE);
+	g_signal_emit(G_OBJECT(server), signals[ITEM_ACTIVATION], 0, item_id(server, mi), timestamp, TRUE);
 
 	if (priv->dbusobject != NULL && priv->bus != NULL) {
 		g_dbus_connection_emit_signal(priv->bus,
@@ -1260,7 +2635,7 @@ menuitem_shown (DbusmenuMenuitem * mi, guint timestamp, DbusmenuServer * server)
 		                              priv->dbusobject,
 		                              DBUSMENU_INTERFACE,
 		                              "ItemActivationRequested",
-		                              g_variant_new("(iu)", dbusmenu_menuitem_get_id(mi), timestamp),
+		                              g_variant_new("(iu)", item_id(server, mi), timestamp),
 		                              NULL);
 	}
 
@@ -1275,8 +2650,10 @@ menuitem_signals_create (DbusmenuMenuitem * mi, gpointer data)
 	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(menuitem_child_added), data);
 	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(menuitem_child_removed), data);
 	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED, G_CALLBACK(menuitem_child_moved), data);
+	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(menuitem_child_reparented), data);
 	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(menuitem_property_changed), data);
 	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_SHOW_TO_USER, G_CALLBACK(menuitem_shown), data);
+	published_set(DBUSMENU_SERVER(data), mi);
 	return;
 }
 
@@ -1288,8 +2665,12 @@ menuitem_signals_remove (DbusmenuMenuitem * mi, gpointer data)
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_added), data);
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_removed), data);
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_moved), data);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_reparented), data);
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_property_changed), data);
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_shown), data);
+	if (DBUSMENU_SERVER(data)->priv->published != NULL) {
+		g_hash_table_remove(DBUSMENU_SERVER(data)->priv->published, mi);
+	}
 	return;
 }
 
@@ -1303,6 +2684,80 @@ error_quark (void)
 	return quark;
 }
 
+/* Builds the layout for an item, leaving out the children of
+   hidden items if we've been asked to */
+static GVariant *
+build_layout (DbusmenuServer * server, DbusmenuMenuitem * mi, const gchar ** props, gint recurse)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	return dbusmenu_menuitem_build_variant_ids(mi, props, recurse, priv->prune_hidden, priv->stand_ins);
+}
+
+/* Whether the item is inside of a hidden item whose children
+   aren't being sent to the clients */
+static gboolean
+item_pruned (DbusmenuServer * server, DbusmenuMenuitem * mi)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (!priv->prune_hidden) {
+		return FALSE;
+	}
+
+	DbusmenuMenuitem * ancestor;
+	for (ancestor = dbusmenu_menuitem_get_parent(mi); ancestor != NULL; ancestor = dbusmenu_menuitem_get_parent(ancestor)) {
+		if (!dbusmenu_menuitem_get_root(ancestor) &&
+				!dbusmenu_menuitem_property_get_bool(ancestor, DBUSMENU_MENUITEM_PROP_VISIBLE)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* The layout serialized when the server was sealed or went into
+   hibernation, by ID, or NULL if it's working from the items */
+static GHashTable *
+sealed_layout (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->sealed != NULL) {
+		return priv->sealed;
+	}
+
+	return priv->hibernated;
+}
+
+/* The properties of an item as they were when the server was
+   sealed or went into hibernation, or NULL if it hasn't.  Floating
+   so that it can be used like the one from
+   dbusmenu_menuitem_properties_variant(). */
+static GVariant *
+sealed_properties (DbusmenuServer * server, gint id)
+{
+	GHashTable * sealed = sealed_layout(server);
+
+	if (sealed == NULL) {
+		return NULL;
+	}
+
+	GVariant * node = (GVariant *)g_hash_table_lookup(sealed, GINT_TO_POINTER(id));
+	if (node == NULL) {
+		return NULL;
+	}
+
+	GVariant * props = g_variant_get_child_value(node, 1);
+	GVariant * retval = g_variant_new_from_data(G_VARIANT_TYPE("a{sv}"),
+	                                            g_variant_get_data(props),
+	                                            g_variant_get_size(props),
+	                                            TRUE,
+	                                            (GDestroyNotify)g_variant_unref,
+	                                            props);
+	return retval;
+}
+
 /* DBus interface */
 static void
 bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
@@ -1322,11 +2777,16 @@ bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocatio
 	guint revision = priv->layout_revision;
 	GVariant * items = NULL;
 
-	if (priv->root != NULL) {
+	if (sealed_layout(server) != NULL && recurse == -1 && props[0] == NULL && !priv->prune_hidden) {
+		items = (GVariant *)g_hash_table_lookup(sealed_layout(server), GINT_TO_POINTER(parent));
+		if (items != NULL) {
+			g_variant_ref(items);
+		}
+	} else if (priv->root != NULL) {
 		DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, parent);
 
 		if (mi != NULL) {
-			items = dbusmenu_menuitem_build_variant(mi, props, recurse);
+			items = build_layout(server, mi, props, recurse);
 			if (items) {
 				g_variant_ref_sink(items);
 			}
@@ -1363,8 +2823,7 @@ bus_get_layout (DbusmenuServer * server, GVariant * params, GDBusMethodInvocatio
 
 	GVariant * retval = g_variant_builder_end(&tuplebuilder);
 	// g_debug("Sending layout type: %s", g_variant_get_type_string(retval));
-	g_dbus_method_invocation_return_value(invocation,
-	                                      retval);
+	bus_return_value(server, invocation, retval);
 	return;
 }
 
@@ -1409,7 +2868,7 @@ bus_get_property (DbusmenuServer * server, GVariant * params, GDBusMethodInvocat
 		return;
 	}
 
-	g_dbus_method_invocation_return_value(invocation, g_variant_new("(v)", variant));
+	bus_return_value(server, invocation, g_variant_new("(v)", variant));
 	return;
 }
 
@@ -1430,20 +2889,23 @@ bus_get_properties (DbusmenuServer * server, GVariant * params, GDBusMethodInvoc
 	gint32 id;
 	g_variant_get(params, "(i)", &id);
 
-	DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, id);
+	GVariant * dict = sealed_properties(server, id);
+	if (dict == NULL) {
+		DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, id);
 
-	if (mi == NULL) {
-		g_dbus_method_invocation_return_error(invocation,
-			            error_quark(),
-			            INVALID_MENUITEM_ID,
-			            "The ID supplied %d does not refer to a menu item we have",
-			            id);
-		return;
-	}
+		if (mi == NULL) {
+			g_dbus_method_invocation_return_error(invocation,
+				            error_quark(),
+				            INVALID_MENUITEM_ID,
+				            "The ID supplied %d does not refer to a menu item we have",
+				            id);
+			return;
+		}
 
-	GVariant * dict = dbusmenu_menuitem_properties_variant(mi, NULL);
+		dict = dbusmenu_menuitem_properties_variant(mi, NULL);
+	}
 
-	g_dbus_method_invocation_return_value(invocation, g_variant_new("(a{sv})", dict));
+	bus_return_value(server, invocation, g_variant_new("(a{sv})", dict));
 
 	return;
 }
@@ -1470,7 +2932,7 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 			if (id == 0) {
 
 				GVariant * final = g_variant_parse(G_VARIANT_TYPE("(a(ia{sv}))"), "([(0, {})],)", NULL, NULL, NULL);
-				g_dbus_method_invocation_return_value(invocation, final);
+				bus_return_value(server, invocation, final);
 				g_variant_unref(final);
 			}
 		} else {
@@ -1485,16 +2947,24 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 	}
 
 	GVariantIter *ids;
-	g_variant_get(params, "(aias)", &ids, NULL);
-	/* TODO: implementation ignores propertyNames declared in XML */
+	const gchar ** names = NULL;
+	g_variant_get(params, "(ai^a&s)", &ids, &names);
 
 	GVariantBuilder builder;
 	gboolean builder_init = FALSE;
 
 	gint32 id;
 	while (g_variant_iter_loop(ids, "i", &id)) {
-		DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, id);
-		if (mi == NULL) continue;
+		GVariant * props = NULL;
+		if (names[0] == NULL) {
+			props = sealed_properties(server, id);
+		}
+
+		DbusmenuMenuitem * mi = NULL;
+		if (props == NULL) {
+			mi = lookup_menuitem_by_id(server, id);
+			if (mi == NULL) continue;
+		}
 
 		if (!builder_init) {
 			g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
@@ -1504,7 +2974,9 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 		GVariantBuilder wbuilder;
 		g_variant_builder_init(&wbuilder, G_VARIANT_TYPE_TUPLE);
 		g_variant_builder_add(&wbuilder, "i", id);
-		GVariant * props = dbusmenu_menuitem_properties_variant(mi, NULL);
+		if (props == NULL) {
+			props = dbusmenu_menuitem_properties_variant(mi, names);
+		}
 		if (props != NULL) {
 			g_variant_ref(props);
 		}
@@ -1526,6 +2998,7 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 		g_variant_builder_add_value(&builder, mi_data);
 	}
 	g_variant_iter_free(ids);
+	g_free(names);
 
 	/* a standard reference that must be unrefed */
 	GVariant * ret = NULL;
@@ -1552,7 +3025,7 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 		g_warning("Error building property list, final variant is NULL");
 	}
 
-	g_dbus_method_invocation_return_value(invocation, final);
+	bus_return_value(server, invocation, final);
 
 	return;
 }
@@ -1560,15 +3033,13 @@ bus_get_group_properties (DbusmenuServer * server, GVariant * params, GDBusMetho
 /* Turn a menuitem into an variant and attach it to the
    VariantBuilder we passed in */
 static void
-serialize_menuitem(gpointer data, gpointer user_data)
+serialize_menuitem (DbusmenuServer * server, DbusmenuMenuitem * mi, GVariantBuilder * builder)
 {
-	DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(data);
-	GVariantBuilder * builder = (GVariantBuilder *)(user_data);
 	GVariantBuilder tuple;
 	
 	g_variant_builder_init(&tuple, G_VARIANT_TYPE_TUPLE);
 
-	gint id = dbusmenu_menuitem_get_id(mi);
+	gint id = item_id(server, mi);
 	g_variant_builder_add_value(&tuple, g_variant_new_int32(id));
 
 	GVariant * props = dbusmenu_menuitem_properties_variant(mi, NULL);
@@ -1614,7 +3085,10 @@ bus_get_children (DbusmenuServer * server, GVariant * params, GDBusMethodInvocat
 		GVariantBuilder builder;
 		g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY); 
 
-		g_list_foreach(children, serialize_menuitem, &builder);
+		GList * child;
+		for (child = children; child != NULL; child = g_list_next(child)) {
+			serialize_menuitem(server, DBUSMENU_MENUITEM(child->data), &builder);
+		}
 
 		GVariant * end = g_variant_builder_end(&builder);
 		ret = g_variant_new_tuple(&end, 1);
@@ -1629,7 +3103,7 @@ bus_get_children (DbusmenuServer * server, GVariant * params, GDBusMethodInvocat
 		}
 	}
 
-	g_dbus_method_invocation_return_value(invocation, ret);
+	bus_return_value(server, invocation, ret);
 	g_variant_unref(ret);
 	return;
 }
@@ -1825,8 +3299,7 @@ bus_about_to_show (DbusmenuServer * server, GVariant * params, GDBusMethodInvoca
 	g_timeout_add(0, bus_about_to_show_idle, g_object_ref(mi));
 
 	/* GTK+ does not support about-to-show concept for now */
-	g_dbus_method_invocation_return_value(invocation,
-	                                      g_variant_new("(b)", FALSE));
+	bus_return_value(server, invocation, g_variant_new("(b)", FALSE));
 	return;
 }
 
@@ -1877,22 +3350,324 @@ bus_about_to_show_group (DbusmenuServer * server, GVariant * params, GDBusMethod
 			/* Errors */
 			g_variant_builder_add_value(&tuple, errors);
 
-			g_dbus_method_invocation_return_value(invocation, g_variant_builder_end(&tuple));
+			bus_return_value(server, invocation, g_variant_builder_end(&tuple));
 		} else {
 			g_object_unref(invocation);
 		}
 	} else {
 		gchar * ids = g_variant_print(errors, FALSE);
 		g_dbus_method_invocation_return_error(invocation,
-			                                  error_quark(),
-			                                  INVALID_MENUITEM_ID,
-			                                  "The IDs supplied '%s' do not refer to any menu items we have",
-			                                  ids);
-		g_free(ids);
+			                                  error_quark(),
+			                                  INVALID_MENUITEM_ID,
+			                                  "The IDs supplied '%s' do not refer to any menu items we have",
+			                                  ids);
+		g_free(ids);
+	}
+
+	g_variant_unref(errors);
+	g_variant_unref(items);
+
+	return;
+}
+
+/* Looks through the journal to build up what has changed since
+   the revision that the client has.  Changed subtrees are sent
+   as layouts from the highest item that changed, properties with
+   their current values. */
+static void
+bus_get_changes_since (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	guint32 revision;
+	const gchar ** props;
+	g_variant_get(params, "(u^a&s)", &revision, &props);
+
+	GVariantBuilder layouts;
+	GVariantBuilder updated;
+	GVariantBuilder removed;
+	g_variant_builder_init(&layouts, G_VARIANT_TYPE("a(ia{sv}av)"));
+	g_variant_builder_init(&updated, G_VARIANT_TYPE("a(ia{sv})"));
+	g_variant_builder_init(&removed, G_VARIANT_TYPE("a(ias)"));
+
+	gboolean too_old = priv->root == NULL || revision < priv->journal_floor || revision > priv->layout_revision;
+
+	if (!too_old) {
+		GList * link;
+
+		/* Items whose children changed */
+		GHashTable * parents = g_hash_table_new(g_direct_hash, g_direct_equal);
+		for (link = priv->journal->head; link != NULL; link = g_list_next(link)) {
+			journal_entry_t * entry = (journal_entry_t *)link->data;
+			if (entry->property != NULL || entry->revision <= revision) {
+				continue;
+			}
+
+			DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, entry->id);
+			if (mi != NULL && !item_pruned(server, mi)) {
+				g_hash_table_add(parents, mi);
+			}
+		}
+
+		/* Only send the subtrees that aren't inside of another one */
+		GHashTableIter iter;
+		gpointer key;
+		g_hash_table_iter_init(&iter, parents);
+		while (g_hash_table_iter_next(&iter, &key, NULL)) {
+			DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(key);
+			DbusmenuMenuitem * ancestor;
+			gboolean covered = FALSE;
+
+			for (ancestor = dbusmenu_menuitem_get_parent(mi); ancestor != NULL && !covered; ancestor = dbusmenu_menuitem_get_parent(ancestor)) {
+				covered = g_hash_table_contains(parents, ancestor);
+			}
+
+			if (!covered) {
+				g_variant_builder_add_value(&layouts, build_layout(server, mi, props, -1));
+			}
+		}
+		g_hash_table_destroy(parents);
+
+		/* Property changes, including the ones at the client's revision
+		   as they could have come after it got its layout */
+		for (link = priv->journal->head; link != NULL; link = g_list_next(link)) {
+			journal_entry_t * entry = (journal_entry_t *)link->data;
+			if (entry->property == NULL || entry->revision < revision) {
+				continue;
+			}
+
+			DbusmenuMenuitem * mi = lookup_menuitem_by_id(server, entry->id);
+			if (mi == NULL || !dbusmenu_menuitem_exposed(mi)) {
+				continue;
+			}
+
+			GVariant * value = dbusmenu_menuitem_property_get_variant(mi, entry->property);
+			if (value == NULL || dbusmenu_menuitem_property_is_default(mi, entry->property)) {
+				g_variant_builder_add_value(&removed, g_variant_new("(i@as)", entry->id, g_variant_new_strv((const gchar * const *)&entry->property, 1)));
+			} else {
+				GVariant * dict = g_variant_new_dict_entry(g_variant_new_string(entry->property), g_variant_new_variant(value));
+				g_variant_builder_add_value(&updated, g_variant_new("(i@a{sv})", entry->id, g_variant_new_array(NULL, &dict, 1)));
+			}
+		}
+	}
+	g_free(props);
+
+	bus_return_value(server, invocation,
+	                 g_variant_new("(ub@a(ia{sv}av)@a(ia{sv})@a(ias))",
+	                               priv->layout_revision,
+	                               too_old,
+	                               g_variant_builder_end(&layouts),
+	                               g_variant_builder_end(&updated),
+	                               g_variant_builder_end(&removed)));
+
+	return;
+}
+
+/* Whether @params fit the in arguments of @method */
+static gboolean
+bus_params_match (const gchar * method, GVariant * params)
+{
+	GDBusMethodInfo * info = g_dbus_interface_info_lookup_method(dbusmenu_interface_info, method);
+	if (info == NULL) {
+		return FALSE;
+	}
+
+	GString * type = g_string_new("(");
+	gint i;
+	for (i = 0; info->in_args != NULL && info->in_args[i] != NULL; i++) {
+		g_string_append(type, info->in_args[i]->signature);
+	}
+	g_string_append_c(type, ')');
+
+	gboolean match = g_variant_is_of_type(params, G_VARIANT_TYPE(type->str));
+	g_string_free(type, TRUE);
+
+	return match;
+}
+
+/* Calls one of the methods with big replies and sends its
+   reply back as a byte array, compressed with the first of
+   the client's encodings that we know when it's big enough */
+static void
+bus_get_compressed (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	const gchar * method;
+	GVariant * inner;
+	const gchar ** encodings;
+
+	g_variant_get(params, "(&sv^a&s)", &method, &inner, &encodings);
+
+	const gchar * interned_method = g_intern_string(method);
+	guint i;
+
+	for (i = 0; i < METHOD_COUNT; i++) {
+		if (dbusmenu_method_table[i].interned_name == interned_method) {
+			break;
+		}
+	}
+
+	if (i == METHOD_COUNT || !dbusmenu_method_table[i].compress || !bus_params_match(method, inner)) {
+		g_dbus_method_invocation_return_error(invocation,
+		                                      error_quark(),
+		                                      NOT_IMPLEMENTED,
+		                                      "Unable to call '%s' with parameters '%s' compressed",
+		                                      method, g_variant_get_type_string(inner));
+		g_variant_unref(inner);
+		g_free(encodings);
+		return;
+	}
+
+	/* Anything we can't compress with is still packed up, just
+	   without compressing it */
+	priv->reply_encoding = "";
+	gint j;
+	for (j = 0; encodings[j] != NULL; j++) {
+		if (g_strcmp0(encodings[j], ENCODING_ZLIB) == 0) {
+			priv->reply_encoding = ENCODING_ZLIB;
+			break;
+		}
+	}
+
+	dbusmenu_method_table[i].func(server, inner, invocation);
+	priv->reply_encoding = NULL;
+
+	g_variant_unref(inner);
+	g_free(encodings);
+
+	return;
+}
+
+/* Text normalized and folded so that it can be compared without
+   caring about case or how the characters were composed.  Labels
+   have their mnemonic underscores taken out first. */
+static gchar *
+search_fold (const gchar * text, gboolean mnemonics)
+{
+	GString * plain = g_string_sized_new(strlen(text));
+	const gchar * c;
+
+	for (c = text; *c != '\0'; c++) {
+		if (mnemonics && *c == '_') {
+			if (c[1] != '_') {
+				continue;
+			}
+			c++;
+		}
+		g_string_append_c(plain, *c);
+	}
+
+	gchar * normal = g_utf8_normalize(plain->str, -1, G_NORMALIZE_ALL);
+	g_string_free(plain, TRUE);
+
+	if (normal == NULL) {
+		return NULL;
+	}
+
+	gchar * retval = g_utf8_casefold(normal, -1);
+	g_free(normal);
+	return retval;
+}
+
+typedef struct _search_t search_t;
+struct _search_t {
+	DbusmenuServer * server;
+	gboolean prune_hidden;
+	gchar * text;
+	const gchar ** requirements;
+	GPtrArray * path;
+	GVariantBuilder results;
+};
+
+/* Looks at the children of @mi, adding the ones that have the
+   text in their label, and then at theirs.  Items that don't have
+   all of the required properties are left out along with
+   everything under them. */
+static void
+search_children (search_t * search, DbusmenuMenuitem * mi)
+{
+	GList * child;
+
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		DbusmenuMenuitem * item = DBUSMENU_MENUITEM(child->data);
+		gint i;
+
+		for (i = 0; search->requirements[i] != NULL; i++) {
+			if (!dbusmenu_menuitem_property_get_bool(item, search->requirements[i])) {
+				break;
+			}
+		}
+
+		if (search->requirements[i] != NULL) {
+			continue;
+		}
+
+		const gchar * label = dbusmenu_menuitem_property_get(item, DBUSMENU_MENUITEM_PROP_LABEL);
+		g_ptr_array_add(search->path, (gpointer)(label != NULL ? label : ""));
+
+		if (label != NULL) {
+			gchar * folded = search_fold(label, TRUE);
+
+			if (folded != NULL && strstr(folded, search->text) != NULL) {
+				GVariantBuilder labels;
+				guint j;
+
+				g_variant_builder_init(&labels, G_VARIANT_TYPE("as"));
+				for (j = 0; j < search->path->len; j++) {
+					g_variant_builder_add(&labels, "s", g_ptr_array_index(search->path, j));
+				}
+
+				g_variant_builder_add(&search->results, "(ias)", item_id(search->server, item), &labels);
+			}
+
+			g_free(folded);
+		}
+
+		/* What isn't sent doesn't get searched */
+		if (!search->prune_hidden || dbusmenu_menuitem_property_get_bool(item, DBUSMENU_MENUITEM_PROP_VISIBLE)) {
+			search_children(search, item);
+		}
+
+		g_ptr_array_set_size(search->path, search->path->len - 1);
+	}
+
+	return;
+}
+
+/* Finds the items with the text in their label, so that something
+   looking through the menu doesn't need to pull all of it over */
+static void
+bus_search (DbusmenuServer * server, GVariant * params, GDBusMethodInvocation * invocation)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->root == NULL) {
+		g_dbus_method_invocation_return_error(invocation,
+			            error_quark(),
+			            NO_VALID_LAYOUT,
+			            "There currently isn't a layout in this server");
+		return;
 	}
 
-	g_variant_unref(errors);
-	g_variant_unref(items);
+	const gchar * text;
+	search_t search;
+
+	g_variant_get(params, "(&s^a&s)", &text, &search.requirements);
+
+	/* Strings off the bus are always valid UTF-8 */
+	search.server = server;
+	search.prune_hidden = priv->prune_hidden;
+	search.text = search_fold(text, FALSE);
+	search.path = g_ptr_array_new();
+	g_variant_builder_init(&search.results, G_VARIANT_TYPE("a(ias)"));
+
+	search_children(&search, priv->root);
+	bus_return_value(server, invocation, g_variant_new("(ua(ias))", priv->layout_revision, &search.results));
+
+	g_ptr_array_free(search.path, TRUE);
+	g_free(search.requirements);
+	g_free(search.text);
 
 	return;
 }
@@ -1923,6 +3698,36 @@ dbusmenu_server_new (const gchar * object)
 	return self;
 }
 
+/**
+ * dbusmenu_server_new_for_connection:
+ * @connection: The #GDBusConnection to export the menus on
+ * @object: (allow-none): The object path to use, or NULL for the default
+ *
+ * Creates a new #DbusmenuServer that exports its menus on @connection
+ * instead of the session bus.  The connection can be a peer to peer
+ * connection, such as one end of a socket pair, which allows a server
+ * and a #DbusmenuClient to talk in the same process without a bus
+ * daemon in between.
+ *
+ * Return value: A brand new #DbusmenuServer
+ */
+DbusmenuServer *
+dbusmenu_server_new_for_connection (GDBusConnection * connection, const gchar * object)
+{
+	g_return_val_if_fail(G_IS_DBUS_CONNECTION(connection), NULL);
+
+	if (object == NULL) {
+		object = "/com/canonical/dbusmenu";
+	}
+
+	DbusmenuServer * self = g_object_new(DBUSMENU_TYPE_SERVER,
+	                                     DBUSMENU_SERVER_PROP_DBUS_CONNECTION, connection,
+	                                     DBUSMENU_SERVER_PROP_DBUS_OBJECT, object,
+	                                     NULL);
+
+	return self;
+}
+
 /**
 	dbusmenu_server_set_root:
 	@self: The #DbusmenuServer object to set the root on
@@ -2108,3 +3913,510 @@ dbusmenu_server_set_icon_paths (DbusmenuServer * server, GStrv icon_paths)
 
 	return;
 }
+
+/**
+ * dbusmenu_server_get_request_stats:
+ * @server: The #DbusmenuServer to get the numbers from
+ * 
+ * Gets the numbers kept on the requests from each client to find one
+ * that is asking for too much.  Each client's bus name maps to a
+ * dictionary with "requests", the number of method calls it made,
+ * "reply-bytes", how much was sent back to it, "deferred", how many
+ * requests were held back by the limits, "shared", how many of those
+ * got the reply to an identical request, and "pending", how many are
+ * still waiting.  Clients that have been quiet for a while may be left
+ * out.
+ * 
+ * Return value: (transfer full): A #GVariant of type a{sa{sv}}
+ */
+GVariant *
+dbusmenu_server_get_request_stats (DbusmenuServer * server)
+{
+	g_return_val_if_fail(DBUSMENU_IS_SERVER(server), NULL);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{sv}}"));
+
+	if (priv->senders != NULL) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init(&iter, priv->senders);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			sender_t * sender = (sender_t *)value;
+			GVariantBuilder stats;
+
+			g_variant_builder_init(&stats, G_VARIANT_TYPE("a{sv}"));
+			g_variant_builder_add(&stats, "{sv}", "requests", g_variant_new_uint32(sender->requests));
+			g_variant_builder_add(&stats, "{sv}", "reply-bytes", g_variant_new_uint64(sender->reply_bytes));
+			g_variant_builder_add(&stats, "{sv}", "deferred", g_variant_new_uint32(sender->deferred));
+			g_variant_builder_add(&stats, "{sv}", "shared", g_variant_new_uint32(sender->shared));
+			g_variant_builder_add(&stats, "{sv}", "pending", g_variant_new_uint32(g_list_length(sender->pending)));
+
+			g_variant_builder_add(&builder, "{sa{sv}}", sender->name, &stats);
+		}
+	}
+
+	return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* Sends out the updates that are waiting for the idle */
+static void
+pending_flush (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->property_idle != 0) {
+		g_source_remove(priv->property_idle);
+		priv->property_idle = 0;
+		menuitem_property_idle(server);
+	}
+
+	if (priv->layout_idle != 0) {
+		g_source_remove(priv->layout_idle);
+		priv->layout_idle = 0;
+		layout_update_idle(server);
+	}
+
+	return;
+}
+
+/* Stops listening to everything but the item asking to be
+   shown, which still needs to get out to the clients */
+static void
+seal_menuitem (DbusmenuMenuitem * mi, gpointer data)
+{
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_added), data);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_removed), data);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_moved), data);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_child_reparented), data);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menuitem_property_changed), data);
+	dbusmenu_menuitem_seal(mi);
+	return;
+}
+
+/* Puts every node of the layout in the table by ID.  The nodes
+   are all slices of the same serialized layout. */
+static void
+seal_layout (GHashTable * sealed, GVariant * node)
+{
+	gint32 id;
+	g_variant_get_child(node, 0, "i", &id);
+	g_hash_table_insert(sealed, GINT_TO_POINTER(id), g_variant_ref(node));
+
+	GVariant * children = g_variant_get_child_value(node, 2);
+	gsize i;
+	for (i = 0; i < g_variant_n_children(children); i++) {
+		GVariant * boxed = g_variant_get_child_value(children, i);
+		GVariant * child = g_variant_get_variant(boxed);
+		seal_layout(sealed, child);
+		g_variant_unref(child);
+		g_variant_unref(boxed);
+	}
+	g_variant_unref(children);
+
+	return;
+}
+
+/**
+ * dbusmenu_server_seal:
+ * @server: The #DbusmenuServer whose menu won't change anymore
+ * 
+ * Tells the server that its menu is done being built and won't
+ * change again.  Any pending updates are sent out, the server
+ * stops watching the items for changes and the layout and properties
+ * are serialized once so that the common requests are answered
+ * without building them again.  After this the items and the root
+ * of the server can't be changed, trying to will fail with a
+ * warning.  Items can still be shown to the user and get events.
+ * 
+ * Return value: Whether the server has been sealed
+ */
+gboolean
+dbusmenu_server_seal (DbusmenuServer * server)
+{
+	g_return_val_if_fail(DBUSMENU_IS_SERVER(server), FALSE);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->sealed != NULL) {
+		return TRUE;
+	}
+
+	dbusmenu_server_resume(server);
+	g_return_val_if_fail(priv->root != NULL, FALSE);
+
+	/* Get out anything that's waiting to be sent */
+	pending_flush(server);
+
+	dbusmenu_menuitem_foreach(priv->root, seal_menuitem, server);
+	g_hash_table_remove_all(priv->published);
+
+	GVariant * layout = g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(priv->root, NULL, -1, FALSE, priv->stand_ins));
+	/* Serialize it all into one block */
+	g_variant_get_data(layout);
+
+	priv->sealed = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+	seal_layout(priv->sealed, layout);
+	g_variant_unref(layout);
+
+	/* There won't be anything more to catch up on */
+	journal_reset(server);
+
+	return TRUE;
+}
+
+/* Wakes the server up when one of its items changes, for all
+   of the signals on all of the items.  The handlers that it
+   connects don't get this emission, so showing the item is
+   passed on. */
+static void
+hibernate_wake_marshal (GClosure * closure, GValue * return_value, guint n_params, const GValue * params, gpointer hint, gpointer marshal_data)
+{
+	DbusmenuServer * server = DBUSMENU_SERVER(closure->data);
+	GSignalInvocationHint * invocation = (GSignalInvocationHint *)hint;
+
+	dbusmenu_server_resume(server);
+
+	if (invocation->signal_id == g_signal_lookup(DBUSMENU_MENUITEM_SIGNAL_SHOW_TO_USER, DBUSMENU_TYPE_MENUITEM)) {
+		menuitem_shown(DBUSMENU_MENUITEM(g_value_get_object(&params[0])), g_value_get_uint(&params[1]), server);
+	}
+
+	return;
+}
+
+/* Puts the wake up handler on each item */
+static void
+hibernate_watch_item (DbusmenuMenuitem * mi, gpointer data)
+{
+	GClosure * closure = (GClosure *)data;
+
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, closure, FALSE);
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, closure, FALSE);
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, closure, FALSE);
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED, closure, FALSE);
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, closure, FALSE);
+	g_signal_connect_closure(mi, DBUSMENU_MENUITEM_SIGNAL_SHOW_TO_USER, closure, FALSE);
+
+	return;
+}
+
+/* The application let go of the menu while the server was
+   hibernating.  Items that it kept from it aren't in any menu
+   now, so they don't wake it up, and the menu gets rebuilt from
+   the layout when it's needed. */
+static void
+hibernate_root_gone (gpointer data, GObject * old_root)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(data);
+
+	priv->root = NULL;
+	g_closure_invalidate(priv->hibernate_wake);
+	g_hash_table_remove_all(priv->stand_ins);
+
+	return;
+}
+
+/* Watches the items for changes, and holds the menu only as long
+   as the application does */
+static void
+hibernate_watch (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	priv->hibernate_wake = g_closure_new_simple(sizeof(GClosure), server);
+	g_closure_set_marshal(priv->hibernate_wake, hibernate_wake_marshal);
+	g_closure_ref(priv->hibernate_wake);
+	g_closure_sink(priv->hibernate_wake);
+	dbusmenu_menuitem_foreach(priv->root, hibernate_watch_item, priv->hibernate_wake);
+
+	g_object_weak_ref(G_OBJECT(priv->root), hibernate_root_gone, server);
+	g_object_unref(priv->root);
+
+	return;
+}
+
+/* Takes the menu back, if it's still there, and drops the wake
+   up handlers from all of the items at once */
+static void
+hibernate_unwatch (DbusmenuServer * server)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->hibernate_wake == NULL) {
+		return;
+	}
+
+	if (priv->root != NULL) {
+		g_object_weak_unref(G_OBJECT(priv->root), hibernate_root_gone, server);
+		g_object_ref(priv->root);
+	}
+
+	g_closure_invalidate(priv->hibernate_wake);
+	g_closure_unref(priv->hibernate_wake);
+	priv->hibernate_wake = NULL;
+
+	return;
+}
+
+/**
+ * dbusmenu_server_hibernate:
+ * @server: The #DbusmenuServer whose menu isn't being used
+ * 
+ * Puts the menu of a server that nobody is looking at, like the
+ * one for a window that isn't focused, away until it's needed.  Any
+ * pending updates are sent out and the layout with all of the
+ * properties is serialized into a single block that the clients
+ * are served from.  The server stops watching the items and drops
+ * everything it keeps about each of them.  It lets go of its
+ * reference to the menu too, so if the application doesn't keep
+ * one the items are freed, and they're rebuilt from the block
+ * with the same IDs and properties when they're needed again.
+ * In that case get the new root from dbusmenu_server_resume()
+ * before changing the menu.
+ * 
+ * The server goes back to watching the items when any of them
+ * changes, when dbusmenu_server_resume() is called, or when a
+ * client needs the items, like to send them an event.  Searches are
+ * answered from the items without waking it, if they're still
+ * there.  The changes
+ * made while it was hibernating are sent to the clients then.  A
+ * sealed server doesn't hibernate.
+ * 
+ * Return value: Whether the server is hibernating
+ */
+gboolean
+dbusmenu_server_hibernate (DbusmenuServer * server)
+{
+	g_return_val_if_fail(DBUSMENU_IS_SERVER(server), FALSE);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->hibernated != NULL) {
+		return TRUE;
+	}
+
+	if (priv->root == NULL || priv->sealed != NULL) {
+		return FALSE;
+	}
+
+	/* Get out anything that's waiting to be sent */
+	pending_flush(server);
+
+	GVariant * layout = g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(priv->root, NULL, -1, FALSE, priv->stand_ins));
+	/* Serialize it all into one block */
+	g_variant_get_data(layout);
+
+	priv->hibernated = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+	seal_layout(priv->hibernated, layout);
+	g_variant_unref(layout);
+
+	/* The stand-ins stay, the clients know the items by them */
+	dbusmenu_menuitem_foreach(priv->root, menuitem_signals_remove, server);
+	g_hash_table_remove_all(priv->lookup_cache);
+	g_hash_table_remove_all(priv->published);
+	g_hash_table_remove_all(priv->repopulated);
+
+	hibernate_watch(server);
+
+	return TRUE;
+}
+
+/* Sends the properties of @mi that aren't what the clients
+   got before hibernating */
+static void
+hibernate_compare_properties (DbusmenuServer * server, DbusmenuMenuitem * mi, GVariant * before, GVariant * now)
+{
+	GVariantIter iter;
+	gchar * property;
+	GVariant * value;
+
+	g_variant_iter_init(&iter, before);
+	while (g_variant_iter_loop(&iter, "{sv}", &property, &value)) {
+		GVariant * current = g_variant_lookup_value(now, property, NULL);
+		if (current == NULL || !g_variant_equal(current, value)) {
+			menuitem_property_changed(mi, property, current, server);
+		}
+		if (current != NULL) {
+			g_variant_unref(current);
+		}
+	}
+
+	g_variant_iter_init(&iter, now);
+	while (g_variant_iter_loop(&iter, "{sv}", &property, &value)) {
+		GVariant * old = g_variant_lookup_value(before, property, NULL);
+		if (old == NULL) {
+			menuitem_property_changed(mi, property, value, server);
+		} else {
+			g_variant_unref(old);
+		}
+	}
+
+	return;
+}
+
+/* Finds what changed in the tree under @mi since the layout was
+   put away.  Properties go out as changes, the items whose children
+   are different are put on @changed. */
+static void
+hibernate_compare (DbusmenuServer * server, DbusmenuMenuitem * mi, GList ** changed)
+{
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	gint id = 0;
+	if (!dbusmenu_menuitem_get_root(mi)) {
+		id = item_id(server, mi);
+	}
+
+	/* New, it comes with the layout of its parent */
+	GVariant * node = (GVariant *)g_hash_table_lookup(priv->hibernated, GINT_TO_POINTER(id));
+	if (node == NULL) {
+		return;
+	}
+
+	GVariant * before = g_variant_get_child_value(node, 1);
+	GVariant * current = g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(mi, NULL, 0, FALSE, priv->stand_ins));
+	GVariant * now = g_variant_get_child_value(current, 1);
+	if (!g_variant_equal(before, now)) {
+		hibernate_compare_properties(server, mi, before, now);
+	}
+	g_variant_unref(now);
+	g_variant_unref(current);
+	g_variant_unref(before);
+
+	GVariant * oldchildren = g_variant_get_child_value(node, 2);
+	GList * children = dbusmenu_menuitem_get_children(mi);
+	gboolean same = (g_variant_n_children(oldchildren) == g_list_length(children));
+	gsize i;
+	GList * child;
+
+	for (i = 0, child = children; same && child != NULL; i++, child = g_list_next(child)) {
+		gint32 oldid;
+		GVariant * boxed = g_variant_get_child_value(oldchildren, i);
+		GVariant * oldchild = g_variant_get_variant(boxed);
+		g_variant_get_child(oldchild, 0, "i", &oldid);
+		same = (oldid == item_id(server, DBUSMENU_MENUITEM(child->data)));
+		g_variant_unref(oldchild);
+		g_variant_unref(boxed);
+	}
+	g_variant_unref(oldchildren);
+
+	if (!same) {
+		*changed = g_list_prepend(*changed, mi);
+	}
+
+	for (child = children; child != NULL; child = g_list_next(child)) {
+		hibernate_compare(server, DBUSMENU_MENUITEM(child->data), changed);
+	}
+
+	return;
+}
+
+/* Stand-ins for items that aren't in the menu anymore */
+static gboolean
+hibernate_stand_in_gone (gpointer key, gpointer value, gpointer user_data)
+{
+	return g_hash_table_lookup((GHashTable *)user_data, value) != key;
+}
+
+/* Builds an item and everything under it from a node of the
+   layout that was put away, for when the application let go of
+   the menu.  The root is @id zero. */
+static DbusmenuMenuitem *
+hibernate_thaw (GVariant * node)
+{
+	gint32 id;
+	g_variant_get_child(node, 0, "i", &id);
+	DbusmenuMenuitem * mi = id == 0 ? dbusmenu_menuitem_new() : dbusmenu_menuitem_new_with_id(id);
+
+	GVariantIter iter;
+	const gchar * property;
+	GVariant * value;
+
+	GVariant * props = g_variant_get_child_value(node, 1);
+	g_variant_iter_init(&iter, props);
+	while (g_variant_iter_loop(&iter, "{&sv}", &property, &value)) {
+		dbusmenu_menuitem_property_set_variant(mi, property, value);
+	}
+	g_variant_unref(props);
+
+	GVariant * children = g_variant_get_child_value(node, 2);
+	gsize i;
+	for (i = 0; i < g_variant_n_children(children); i++) {
+		GVariant * boxed = g_variant_get_child_value(children, i);
+		GVariant * childnode = g_variant_get_variant(boxed);
+		DbusmenuMenuitem * child = hibernate_thaw(childnode);
+
+		dbusmenu_menuitem_child_append(mi, child);
+
+		g_object_unref(child);
+		g_variant_unref(childnode);
+		g_variant_unref(boxed);
+	}
+	g_variant_unref(children);
+
+	return mi;
+}
+
+/**
+ * dbusmenu_server_resume:
+ * @server: The #DbusmenuServer to wake up
+ * 
+ * Brings a server that was put away with dbusmenu_server_hibernate()
+ * back to watching its items, sends the clients whatever changed
+ * while it was hibernating and emits #DbusmenuServer::resumed.  This
+ * happens on its own when one of the items changes, so it's rarely
+ * needed, except to get the menu back when the application let
+ * go of it while the server was hibernating.  If the server isn't
+ * hibernating it's just its root.
+ * 
+ * Return value: (transfer none): The root of the menu, or NULL if
+ * 	the server doesn't have one
+ */
+DbusmenuMenuitem *
+dbusmenu_server_resume (DbusmenuServer * server)
+{
+	g_return_val_if_fail(DBUSMENU_IS_SERVER(server), NULL);
+	DbusmenuServerPrivate * priv = DBUSMENU_SERVER_GET_PRIVATE(server);
+
+	if (priv->hibernated == NULL) {
+		return priv->root;
+	}
+
+	hibernate_unwatch(server);
+
+	/* Nothing could change in a menu nobody had, so it's just
+	   what the clients have already */
+	gboolean rebuilt = FALSE;
+	if (priv->root == NULL) {
+		priv->root = hibernate_thaw((GVariant *)g_hash_table_lookup(priv->hibernated, GINT_TO_POINTER(0)));
+		dbusmenu_menuitem_set_root(priv->root, TRUE);
+		g_variant_unref(g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(priv->root, NULL, -1, FALSE, NULL)));
+		rebuilt = TRUE;
+	}
+
+	cache_add_entries_for_menuitem(server, priv->root);
+	g_hash_table_foreach_remove(priv->stand_ins, hibernate_stand_in_gone, priv->lookup_cache);
+	dbusmenu_menuitem_foreach(priv->root, menuitem_signals_create, server);
+
+	GList * changed = NULL;
+	if (!rebuilt) {
+		hibernate_compare(server, priv->root, &changed);
+	}
+
+	g_hash_table_destroy(priv->hibernated);
+	priv->hibernated = NULL;
+
+	if (changed != NULL) {
+		layout_update_signal(server);
+
+		GList * link;
+		for (link = changed; link != NULL; link = g_list_next(link)) {
+			journal_add(server, DBUSMENU_MENUITEM(link->data), NULL);
+		}
+		g_list_free(changed);
+	}
+
+	g_signal_emit(G_OBJECT(server), signals[RESUMED], 0, priv->root);
+
+	return priv->root;
+}
@@ -31,6 +31,7 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "menuitem.h"
 #include "types.h"
@@ -68,6 +69,12 @@ G_BEGIN_DECLS
  * String to attach to signal #DbusmenuServer::item-activation-requested
  */
 #define DBUSMENU_SERVER_SIGNAL_ITEM_ACTIVATION "item-activation-requested"
+/**
+ * DBUSMENU_SERVER_SIGNAL_RESUMED:
+ *
+ * String to attach to signal #DbusmenuServer::resumed
+ */
+#define DBUSMENU_SERVER_SIGNAL_RESUMED         "resumed"
 /**
  * DBUSMENU_SERVER_SIGNAL_LAYOUT_UPDATE:
  *
@@ -105,6 +112,36 @@ G_BEGIN_DECLS
  * String to access property #DbusmenuServer:status
  */
 #define DBUSMENU_SERVER_PROP_STATUS            "status"
+/**
+ * DBUSMENU_SERVER_PROP_DBUS_CONNECTION:
+ *
+ * String to access property #DbusmenuServer:dbus-connection
+ */
+#define DBUSMENU_SERVER_PROP_DBUS_CONNECTION   "dbus-connection"
+/**
+ * DBUSMENU_SERVER_PROP_PRUNE_HIDDEN:
+ *
+ * String to access property #DbusmenuServer:prune-hidden
+ */
+#define DBUSMENU_SERVER_PROP_PRUNE_HIDDEN      "prune-hidden"
+/**
+ * DBUSMENU_SERVER_PROP_REQUEST_LIMIT:
+ *
+ * String to access property #DbusmenuServer:request-limit
+ */
+#define DBUSMENU_SERVER_PROP_REQUEST_LIMIT     "request-limit"
+/**
+ * DBUSMENU_SERVER_PROP_REPLY_BYTE_LIMIT:
+ *
+ * String to access property #DbusmenuServer:reply-byte-limit
+ */
+#define DBUSMENU_SERVER_PROP_REPLY_BYTE_LIMIT  "reply-byte-limit"
+/**
+ * DBUSMENU_SERVER_PROP_COMPRESS_THRESHOLD:
+ *
+ * String to access property #DbusmenuServer:compress-threshold
+ */
+#define DBUSMENU_SERVER_PROP_COMPRESS_THRESHOLD "compress-threshold"
 
 typedef struct _DbusmenuServerPrivate DbusmenuServerPrivate;
 
@@ -115,7 +152,7 @@ typedef struct _DbusmenuServerPrivate DbusmenuServerPrivate;
 	@id_update: Slot for #DbusmenuServer::id-update.
 	@layout_updated: Slot for #DbusmenuServer::layout-update.
 	@item_activation: Slot for #DbusmenuServer::item-activation-requested.
-	@reserved1: Reserved for future use.
+	@resumed: Slot for #DbusmenuServer::resumed.
 	@reserved2: Reserved for future use.
 	@reserved3: Reserved for future use.
 	@reserved4: Reserved for future use.
@@ -133,9 +170,9 @@ struct _DbusmenuServerClass {
 	void (*id_update)(gint id);
 	void (*layout_updated)(gint revision);
 	void (*item_activation)(gint id, guint timestamp);
+	void (*resumed)(DbusmenuMenuitem * root);
 
 	/*< Private >*/
-	void (*reserved1) (void);
 	void (*reserved2) (void);
 	void (*reserved3) (void);
 	void (*reserved4) (void);
@@ -160,6 +197,8 @@ struct _DbusmenuServer {
 
 GType                   dbusmenu_server_get_type            (void);
 DbusmenuServer *        dbusmenu_server_new                 (const gchar *          object);
+DbusmenuServer *        dbusmenu_server_new_for_connection  (GDBusConnection *      connection,
+                                                             const gchar *          object);
 void                    dbusmenu_server_set_root            (DbusmenuServer *       self,
                                                              DbusmenuMenuitem *     root);
 DbusmenuTextDirection   dbusmenu_server_get_text_direction  (DbusmenuServer *       server);
@@ -171,6 +210,10 @@ void                    dbusmenu_server_set_status          (DbusmenuServer *
 GStrv                   dbusmenu_server_get_icon_paths      (DbusmenuServer *       server);
 void                    dbusmenu_server_set_icon_paths      (DbusmenuServer *       server,
                                                              GStrv                  icon_paths);
+GVariant *              dbusmenu_server_get_request_stats   (DbusmenuServer *       server);
+gboolean                dbusmenu_server_seal                (DbusmenuServer *       server);
+gboolean                dbusmenu_server_hibernate           (DbusmenuServer *       server);
+DbusmenuMenuitem *      dbusmenu_server_resume              (DbusmenuServer *       server);
 
 /**
 	SECTION:server
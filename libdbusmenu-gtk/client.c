@@ -43,9 +43,19 @@ License version 3 and version 2.1 along with this program.  If not, see
 struct _DbusmenuGtkClientPrivate {
 	GStrv old_themedirs;
 	GtkAccelGroup * agroup;
+
+	guint submenu_flush;
+	GList * pending_submenus; /* type: DbusmenuMenuitem * */
+
+	gboolean evicted;
+	GList * resident; /* Our link in resident_clients */
+
+	gboolean flyweight;
 };
 
 GHashTable * theme_dir_db = NULL;
+/* How many clients there are, the menu pool goes with the last one */
+static guint client_count = 0;
 
 #define DBUSMENU_GTKCLIENT_GET_PRIVATE(o) (DBUSMENU_GTKCLIENT(o)->priv)
 #define USE_FALLBACK_PROP  "use-fallback"
@@ -59,14 +69,20 @@ static void new_menuitem (DbusmenuClient * client, DbusmenuMenuitem * mi, gpoint
 static void new_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position, DbusmenuGtkClient * gtkclient);
 static void delete_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuGtkClient * gtkclient);
 static void move_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint new, guint old, DbusmenuGtkClient * gtkclient);
+static void reparent_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position, DbusmenuGtkClient * gtkclient);
 static void item_activate (DbusmenuClient * client, DbusmenuMenuitem * mi, guint timestamp, gpointer userdata);
 static void theme_dir_changed (DbusmenuClient * client, GStrv theme_dirs, gpointer userdata);
 static void remove_theme_dirs (GtkIconTheme * theme, GStrv dirs);
 static void event_result (DbusmenuClient * client, DbusmenuMenuitem * mi, const gchar * event, GVariant * variant, guint timestamp, GError * error);
+static void clear_events_foreach (DbusmenuMenuitem * mi, gpointer gclient);
+static void resident_touch (DbusmenuGtkClient * client);
+static void resident_drop (DbusmenuGtkClient * client);
+static void menu_pool_drain (void);
 
 static gboolean new_item_normal     (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, DbusmenuClient * client, gpointer user_data);
 static gboolean new_item_seperator  (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, DbusmenuClient * client, gpointer user_data);
 
+static void menu_prop_change_cb (DbusmenuMenuitem * mi, gchar * prop, GVariant * variant, DbusmenuGtkClient * gtkclient);
 static void process_visible (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * value);
 static void process_sensitive (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * value);
 static void image_property_handle (DbusmenuMenuitem * item, const gchar * property, GVariant * invalue, gpointer userdata);
@@ -100,6 +116,16 @@ dbusmenu_gtkclient_init (DbusmenuGtkClient *self)
 	priv->agroup = NULL;
 	priv->old_themedirs = NULL;
 
+	priv->submenu_flush = 0;
+	priv->pending_submenus = NULL;
+
+	priv->evicted = FALSE;
+	priv->resident = NULL;
+
+	priv->flyweight = FALSE;
+
+	client_count++;
+
 	/* We either build the theme db or we get a reference
 	   to it.  This way when all clients die the hashtable
 	   will be free'd as well. */
@@ -116,6 +142,9 @@ dbusmenu_gtkclient_init (DbusmenuGtkClient *self)
 		g_hash_table_ref(theme_dir_db);
 	}
 
+	/* We move the GtkMenuItem when its item changes parents */
+	g_object_set(G_OBJECT(self), DBUSMENU_CLIENT_PROP_REPARENT_CHILDREN, TRUE, NULL);
+
 	dbusmenu_client_add_type_handler(DBUSMENU_CLIENT(self), DBUSMENU_CLIENT_TYPES_DEFAULT,   new_item_normal);
 	dbusmenu_client_add_type_handler(DBUSMENU_CLIENT(self), DBUSMENU_CLIENT_TYPES_SEPARATOR, new_item_seperator);
 
@@ -127,6 +156,8 @@ dbusmenu_gtkclient_init (DbusmenuGtkClient *self)
 
 	theme_dir_changed(DBUSMENU_CLIENT(self), dbusmenu_client_get_icon_paths(DBUSMENU_CLIENT(self)), NULL);
 
+	resident_touch(self);
+
 	return;
 }
 
@@ -141,7 +172,7 @@ clear_shortcut_foreach (DbusmenuMenuitem *mi, gpointer gclient)
 	gmi = dbusmenu_gtkclient_menuitem_get (client, mi);
 	dbusmenu_gtkclient_menuitem_get (client, mi);
 	dbusmenu_menuitem_property_get_shortcut (mi, &key, &mod);
-	if (key)
+	if (key && gmi != NULL)
 		gtk_widget_remove_accelerator (GTK_WIDGET (gmi), client->priv->agroup, key, mod);
 }
 
@@ -156,6 +187,20 @@ dbusmenu_gtkclient_dispose (GObject *object)
 		dbusmenu_menuitem_foreach (root, clear_shortcut_foreach, object);
 	g_clear_object (&priv->agroup);
 
+	resident_drop(DBUSMENU_GTKCLIENT(object));
+
+	if (priv->submenu_flush != 0) {
+		g_source_remove(priv->submenu_flush);
+		priv->submenu_flush = 0;
+	}
+	if (priv->pending_submenus != NULL) {
+		g_list_foreach(priv->pending_submenus, (GFunc)clear_events_foreach, object);
+		g_list_free_full(priv->pending_submenus, g_object_unref);
+		priv->pending_submenus = NULL;
+	}
+	if (root != NULL)
+		dbusmenu_menuitem_foreach (root, clear_events_foreach, object);
+
 	if (priv->old_themedirs) {
 		remove_theme_dirs(gtk_icon_theme_get_default(), priv->old_themedirs);
 		g_strfreev(priv->old_themedirs);
@@ -172,11 +217,17 @@ dbusmenu_gtkclient_dispose (GObject *object)
 	return;
 }
 
-/* Just calling the super class.  Future use. */
+/* Empties the menu pool after the last client is gone */
 static void
 dbusmenu_gtkclient_finalize (GObject *object)
 {
 	G_OBJECT_CLASS (dbusmenu_gtkclient_parent_class)->finalize (object);
+
+	client_count--;
+	if (client_count == 0) {
+		menu_pool_drain();
+	}
+
 	return;
 }
 
@@ -463,13 +514,144 @@ dbusmenu_gtkclient_get_accel_group (DbusmenuGtkClient * client)
 	return priv->agroup;
 }
 
+/**
+ * dbusmenu_gtkclient_set_flyweight:
+ * @client: Client whose items should be drawn without child widgets
+ * @flyweight: Whether the items draw their label and icon themselves
+ *
+ * Builds the menu items from here on so that they draw their label,
+ * icon, check and accelerator themselves instead of holding a label,
+ * an image and a box for them.  That's a single widget for each item
+ * of a large menu.  Items that are already built stay as they are.
+ * Needs GTK+ 3.
+ */
+void
+dbusmenu_gtkclient_set_flyweight (DbusmenuGtkClient * client, gboolean flyweight)
+{
+	g_return_if_fail(DBUSMENU_IS_GTKCLIENT(client));
+
+	DBUSMENU_GTKCLIENT_GET_PRIVATE(client)->flyweight = flyweight;
+	return;
+}
+
+/**
+ * dbusmenu_gtkclient_get_flyweight:
+ * @client: Client to query
+ *
+ * Gets whether new items are built with
+ * dbusmenu_gtkclient_set_flyweight().
+ *
+ * Return value: Whether the items draw their contents themselves
+ */
+gboolean
+dbusmenu_gtkclient_get_flyweight (DbusmenuGtkClient * client)
+{
+	g_return_val_if_fail(DBUSMENU_IS_GTKCLIENT(client), FALSE);
+
+	return DBUSMENU_GTKCLIENT_GET_PRIVATE(client)->flyweight;
+}
+
 /* Internal Functions */
 
 static const gchar * data_menuitem =      "dbusmenugtk-data-gtkmenuitem";
 static const gchar * data_menu =          "dbusmenugtk-data-gtkmenu";
-static const gchar * data_activating =    "dbusmenugtk-data-activating";
-static const gchar * data_idle_close_id = "dbusmenugtk-data-idle-close-id";
-static const gchar * data_delayed_close = "dbusmenugtk-data-delayed-close";
+static const gchar * data_release =       "dbusmenugtk-data-release";
+/* How long we wait to see if a submenu that was opened gets
+   closed again, or the other way around, before telling the
+   server.  Dragging across a menubar opens and closes a lot
+   of menus that the application doesn't need to hear about. */
+#define SUBMENU_EVENT_TIMEOUT  100
+/* How long an empty submenu stays on an item that no longer says
+   it has one.  Applications flip these around while refilling
+   a menu and we'd rather not rebuild it under the pointer. */
+#define SUBMENU_RELEASE_TIMEOUT  1000
+/* The most empty menus we keep to hand out again */
+#define MENU_POOL_SIZE  8
+/* How long the pointer or the keyboard has to stay on an item
+   with a submenu before we tell the server it's about to be
+   shown.  Passing over an item on the way to another one is
+   quicker than this. */
+#define PREFETCH_INTENT_TIMEOUT  60
+/* How long the server's answer stays good for when the submenu
+   opens after it */
+#define PREFETCH_FRESH_TIMEOUT  1000
+
+/* Empty, detached menus shared by all the clients */
+static GSList * menu_pool = NULL;
+
+/* The clients that have their widgets built, the one that was
+   used last at the head */
+static GQueue resident_clients = G_QUEUE_INIT;
+/* How many of them can keep their widgets, zero for no limit */
+static guint resident_limit = 0;
+
+/* The state of the events that we send about a menu item, kept
+   on the item so there's only one lookup for all of them. */
+typedef struct _item_events_t item_events_t;
+struct _item_events_t {
+	DbusmenuGtkClient * client;
+	gboolean activating;    /* Clicked and waiting on the server */
+	gboolean delayed_close; /* Submenu closed while activating */
+	gboolean shown;         /* Submenu is visible */
+	gboolean reported;      /* The server thinks the submenu is open */
+	gboolean pending;       /* On the client's list to send */
+	guint timestamp;
+	guint prefetch;         /* Waiting to see if the pointer stays */
+	gboolean prefetching;   /* Sent about to show, waiting on the layout */
+	gint64 prefetched;      /* When the layout came back */
+};
+
+static GQuark
+item_events_quark (void)
+{
+	static GQuark quark = 0;
+	if (G_UNLIKELY(quark == 0)) {
+		quark = g_quark_from_static_string("dbusmenugtk-data-events");
+	}
+	return quark;
+}
+
+static void
+item_events_free (gpointer data)
+{
+	item_events_t * events = (item_events_t *)data;
+
+	if (events->prefetch != 0) {
+		g_source_remove(events->prefetch);
+	}
+
+	g_free(events);
+	return;
+}
+
+static item_events_t *
+item_events_get (DbusmenuMenuitem * mi)
+{
+	item_events_t * events = g_object_get_qdata(G_OBJECT(mi), item_events_quark());
+	if (events == NULL) {
+		events = g_new0(item_events_t, 1);
+		g_object_set_qdata_full(G_OBJECT(mi), item_events_quark(), events, item_events_free);
+	}
+
+	return events;
+}
+
+/* Items can outlive us if someone else has a ref, make sure
+   they don't try to queue up events with us. */
+static void
+clear_events_foreach (DbusmenuMenuitem * mi, gpointer gclient)
+{
+	item_events_t * events = g_object_get_qdata(G_OBJECT(mi), item_events_quark());
+	if (events != NULL) {
+		events->client = NULL;
+		events->pending = FALSE;
+		if (events->prefetch != 0) {
+			g_source_remove(events->prefetch);
+			events->prefetch = 0;
+		}
+	}
+	return;
+}
 
 static void
 menu_item_start_activating(DbusmenuMenuitem * mi)
@@ -477,67 +659,48 @@ menu_item_start_activating(DbusmenuMenuitem * mi)
 	/* Mark this item and all its parents as activating */
 	DbusmenuMenuitem * parent = mi;
 	do {
-		g_object_set_data(G_OBJECT(parent), data_activating,
-		                  GINT_TO_POINTER(TRUE));
+		item_events_get(parent)->activating = TRUE;
 	} while ((parent = dbusmenu_menuitem_get_parent (parent)) != NULL);
 
 	GVariant * variant = g_variant_new("i", 0);
 	dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_ACTIVATED, variant, gtk_get_current_event_time());
 }
 
-static gboolean
-menu_item_is_activating(DbusmenuMenuitem * mi)
-{
-	return GPOINTER_TO_INT(g_object_get_data(G_OBJECT(mi), data_activating));
-}
-
 static void
 menu_item_stop_activating(DbusmenuMenuitem * mi)
 {
-	if (!menu_item_is_activating(mi))
+	item_events_t * events = item_events_get(mi);
+	if (!events->activating)
 		return;
 
 	/* Mark this item and all its parents as not activating and finally
 	   send their queued close event. */
-	g_object_set_data(G_OBJECT(mi), data_activating, GINT_TO_POINTER(FALSE));
+	events->activating = FALSE;
 
 	/* There is one master root parent that we don't care about, so stop
 	   right before it */
 	DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent (mi);
-	while (dbusmenu_menuitem_get_parent (parent) != NULL &&
-	       menu_item_is_activating(parent)) {
-		/* Now clean up the activating flag */
-		g_object_set_data(G_OBJECT(parent), data_activating,
-		                  GINT_TO_POINTER(FALSE));
-
-		gboolean should_close = FALSE;
-
-		/* Note that dbus might be fast enough to have already
-		   processed the app's reply before close_in_idle() is called.
-		   So to avoid that, we shut down any pending close_in_idle call */
-		guint id = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(parent),
-		                           data_idle_close_id));
-		if (id > 0) {
-			g_object_set_data(G_OBJECT(parent), data_idle_close_id,
-			                  GINT_TO_POINTER(0));
-			should_close = TRUE;
+	while (dbusmenu_menuitem_get_parent (parent) != NULL) {
+		item_events_t * pevents = item_events_get(parent);
+		if (!pevents->activating) {
+			break;
 		}
 
-		gboolean delayed = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(mi),
-		                                                     data_delayed_close));
-		if (delayed) {
-			g_object_set_data(G_OBJECT(mi), data_delayed_close,
-			                  GINT_TO_POINTER(FALSE));
-			should_close = TRUE;
-		}
+		/* Now clean up the activating flag */
+		pevents->activating = FALSE;
 
 		/* And finally send a delayed closed event if one would have
-		   happened */
-		if (should_close) {
-			dbusmenu_menuitem_handle_event(parent,
-			                               DBUSMENU_MENUITEM_EVENT_CLOSED,
-			                               NULL,
-			                               gtk_get_current_event_time());
+		   happened.  A close that is still pending gets sent with
+		   the rest of them. */
+		if (pevents->delayed_close) {
+			pevents->delayed_close = FALSE;
+			if (!pevents->shown && pevents->reported) {
+				pevents->reported = FALSE;
+				dbusmenu_menuitem_handle_event(parent,
+				                               DBUSMENU_MENUITEM_EVENT_CLOSED,
+				                               NULL,
+				                               gtk_get_current_event_time());
+			}
 		}
 
 		parent = dbusmenu_menuitem_get_parent (parent);
@@ -556,6 +719,104 @@ event_result (DbusmenuClient * client, DbusmenuMenuitem * mi,
 	return;
 }
 
+/* The server has answered about to show and we've got the
+   layout that came out of it.  A submenu that opened before
+   then has been filled in while it was up, so it might not fit
+   where it is anymore. */
+static void
+prefetch_done (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	item_events_t * events = item_events_get(mi);
+
+	events->prefetching = FALSE;
+	events->prefetched = g_get_monotonic_time();
+
+	if (events->shown && events->client != NULL) {
+		GtkMenu * menu = dbusmenu_gtkclient_menuitem_get_submenu(events->client, mi);
+		if (menu != NULL && gtk_widget_get_visible(GTK_WIDGET(menu))) {
+			gtk_menu_reposition(menu);
+		}
+	}
+
+	g_object_unref(mi);
+	return;
+}
+
+/* Tells the server that the submenu is about to be shown, unless
+   that's already on its way or it just came back. */
+static void
+prefetch_send (DbusmenuMenuitem * mi)
+{
+	item_events_t * events = item_events_get(mi);
+
+	if (events->prefetch != 0) {
+		g_source_remove(events->prefetch);
+		events->prefetch = 0;
+	}
+
+	if (events->prefetching) {
+		return;
+	}
+	if (events->prefetched != 0 && g_get_monotonic_time() - events->prefetched < PREFETCH_FRESH_TIMEOUT * 1000) {
+		return;
+	}
+
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Prefetching the submenu of %d", dbusmenu_menuitem_get_id(mi));
+	#endif
+
+	events->prefetching = TRUE;
+	dbusmenu_menuitem_send_about_to_show(g_object_ref(mi), prefetch_done, NULL);
+	return;
+}
+
+static gboolean
+prefetch_timeout (gpointer user_data)
+{
+	DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(user_data);
+
+	/* The source is going away on its own */
+	item_events_get(mi)->prefetch = 0;
+	prefetch_send(mi);
+
+	return FALSE;
+}
+
+/* The pointer or the keyboard is on an item, if it has a submenu
+   and stays there we get the submenu ready. */
+static void
+menu_selected_cb (GtkMenuItem * gmi, DbusmenuMenuitem * mi)
+{
+	if (gtk_menu_item_get_submenu(gmi) == NULL) {
+		return;
+	}
+
+	item_events_t * events = item_events_get(mi);
+	if (events->client != NULL) {
+		dbusmenu_gtkclient_restore(events->client);
+	}
+
+	if (events->prefetch == 0 && !events->prefetching) {
+		events->prefetch = g_timeout_add(PREFETCH_INTENT_TIMEOUT, prefetch_timeout, mi);
+	}
+
+	return;
+}
+
+/* It was just passing through */
+static void
+menu_deselected_cb (GtkMenuItem * gmi, DbusmenuMenuitem * mi)
+{
+	item_events_t * events = g_object_get_qdata(G_OBJECT(mi), item_events_quark());
+
+	if (events != NULL && events->prefetch != 0) {
+		g_source_remove(events->prefetch);
+		events->prefetch = 0;
+	}
+
+	return;
+}
+
 /* This is the call back for the GTK widget for when it gets
    clicked on by the user to send it back across the bus. */
 static gboolean
@@ -564,57 +825,92 @@ menu_pressed_cb (GtkMenuItem * gmi, DbusmenuMenuitem * mi)
 	if (gtk_menu_item_get_submenu(gmi) == NULL) {
 		menu_item_start_activating(mi);
 	} else {
-		/* TODO: We need to stop the display of the submenu
-		         until this callback returns. */
-		dbusmenu_menuitem_send_about_to_show(mi, NULL, NULL);
+		/* Likely to be back before the submenu opens */
+		prefetch_send(mi);
 	}
 	return TRUE;
 }
 
+/* Sends the submenus that ended up in a different state than
+   the server last heard about.  They all go out together so that
+   the client can put them in a single event group. */
 static gboolean
-close_in_idle (DbusmenuMenuitem * mi)
+submenu_events_flush (gpointer user_data)
 {
-	/* Don't send closed signal if we also sent activating signal.
-	   We'd just be asking for race conditions.  We'll send closed
-	   when done with activation. */
-	if (!menu_item_is_activating(mi))
-		dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_CLOSED, NULL, gtk_get_current_event_time());
-	else
-		g_object_set_data(G_OBJECT(mi), data_delayed_close, GINT_TO_POINTER(TRUE));
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(user_data);
+
+	GList * pending = g_list_reverse(priv->pending_submenus);
+	priv->pending_submenus = NULL;
+	priv->submenu_flush = 0;
+
+	GList * lmi;
+	for (lmi = pending; lmi != NULL; lmi = g_list_next(lmi)) {
+		DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(lmi->data);
+		item_events_t * events = item_events_get(mi);
+		events->pending = FALSE;
+
+		if (events->shown && !events->reported) {
+			events->reported = TRUE;
+			dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_OPENED, NULL, events->timestamp);
+		} else if (!events->shown && events->reported) {
+			/* Don't send closed signal if we also sent activating signal.
+			   We'd just be asking for race conditions.  We'll send closed
+			   when done with activation. */
+			if (!events->activating) {
+				events->reported = FALSE;
+				dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_CLOSED, NULL, events->timestamp);
+			} else {
+				events->delayed_close = TRUE;
+			}
+		}
 
-	g_object_set_data(G_OBJECT(mi), data_idle_close_id, GINT_TO_POINTER(0));
-	return FALSE;
-}
+		g_object_unref(mi);
+	}
 
-static void
-cancel_idle_close_id (gpointer data)
-{
-  guint id = GPOINTER_TO_INT(data);
-  if (id > 0)
-  	g_source_remove(id);
+	g_list_free(pending);
+	return FALSE;
 }
 
 static void
 submenu_notify_visible_cb (GtkWidget * menu, GParamSpec * pspec, DbusmenuMenuitem * mi)
 {
-	if (gtk_widget_get_visible (menu)) {
+	item_events_t * events = item_events_get(mi);
+
+	events->shown = gtk_widget_get_visible (menu);
+	events->timestamp = gtk_get_current_event_time();
+
+	if (events->shown) {
 		menu_item_stop_activating(mi); /* just in case */
-		dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_OPENED, NULL, gtk_get_current_event_time());
-	} else {
-		/* Try to close in the idle loop because we actually get a menu
-		   close notification before we get notified that a menu item
-		   was clicked.  We want to give that clicked signal some
-		   time, so we wait until all queued signals are handled before
-		   continuing.  (our handling of the closed signal depends on
-		   whether the user clicked an item or not) */
-		guint id = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(mi),
-		                           data_idle_close_id));
-		if (id == 0) {
-			id = g_idle_add((GSourceFunc)close_in_idle, mi);
-			g_object_set_data_full(G_OBJECT(mi), data_idle_close_id,
-			                       GINT_TO_POINTER(id), cancel_idle_close_id);
+
+		if (events->client != NULL) {
+			dbusmenu_gtkclient_restore(events->client);
 		}
+
+		/* Opened without the pointer stopping on it first.  It
+		   shows what we have and gets filled in as the layout
+		   comes in. */
+		prefetch_send(mi);
+	}
+
+	/* We don't send anything right away, both because a quick close
+	   and open again cancel out, and because we get a menu close
+	   notification before we get notified that a menu item was
+	   clicked.  Our handling of the closed signal depends on whether
+	   the user clicked an item or not. */
+	if (events->pending || events->client == NULL) {
+		return;
+	}
+
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(events->client);
+
+	events->pending = TRUE;
+	priv->pending_submenus = g_list_prepend(priv->pending_submenus, g_object_ref(mi));
+
+	if (priv->submenu_flush == 0) {
+		priv->submenu_flush = g_timeout_add(SUBMENU_EVENT_TIMEOUT, submenu_events_flush, events->client);
 	}
+
+	return;
 }
 
 /* Process the visible property */
@@ -692,6 +988,116 @@ process_toggle_state (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * varia
 	return;
 }
 
+/* Gets an empty menu out of the pool, or builds one if the
+   pool is empty.  The caller gets the reference. */
+static GtkMenu *
+menu_pool_get (void)
+{
+	GtkMenu * menu = NULL;
+
+	if (menu_pool != NULL) {
+		menu = GTK_MENU(menu_pool->data);
+		menu_pool = g_slist_delete_link(menu_pool, menu_pool);
+	} else {
+		menu = GTK_MENU(gtk_menu_new());
+		g_object_ref_sink(menu);
+	}
+
+	return menu;
+}
+
+/* Destroys all the menus in the pool */
+static void
+menu_pool_drain (void)
+{
+	while (menu_pool != NULL) {
+		GtkWidget * menu = GTK_WIDGET(menu_pool->data);
+		menu_pool = g_slist_delete_link(menu_pool, menu_pool);
+
+		gtk_widget_destroy(menu);
+		g_object_unref(menu);
+	}
+
+	return;
+}
+
+/* Takes the menu off of the item and puts it back in the pool
+   if there's room for it and it's empty.  Items can outlive
+   their client, so there's no pool once the clients are gone. */
+static void
+submenu_release (DbusmenuMenuitem * mi)
+{
+	GtkMenu * menu = GTK_MENU(g_object_steal_data(G_OBJECT(mi), data_menu));
+	if (menu == NULL) {
+		return;
+	}
+
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Releasing the submenu of %d", dbusmenu_menuitem_get_id(mi));
+	#endif
+
+	/* Close it while we're still listening so the server
+	   hears about it */
+	if (gtk_widget_get_visible(GTK_WIDGET(menu))) {
+		gtk_menu_popdown(menu);
+	}
+
+	g_signal_handlers_disconnect_by_func(menu, G_CALLBACK(submenu_notify_visible_cb), mi);
+	if (gtk_menu_get_attach_widget(menu) != NULL) {
+		gtk_menu_detach(menu);
+	}
+	gtk_menu_set_accel_group(menu, NULL);
+
+	GList * children = gtk_container_get_children(GTK_CONTAINER(menu));
+	if (children == NULL && client_count > 0 && g_slist_length(menu_pool) < MENU_POOL_SIZE) {
+		menu_pool = g_slist_prepend(menu_pool, menu);
+	} else {
+		gtk_widget_destroy(GTK_WIDGET(menu));
+		g_object_unref(menu);
+	}
+	g_list_free(children);
+
+	return;
+}
+
+/* The grace period is over, if the children didn't come back
+   the menu can go. */
+static gboolean
+submenu_release_timeout (gpointer user_data)
+{
+	DbusmenuMenuitem * mi = DBUSMENU_MENUITEM(user_data);
+
+	/* The source is going away on its own */
+	g_object_steal_data(G_OBJECT(mi), data_release);
+
+	if (dbusmenu_menuitem_get_children(mi) == NULL) {
+		submenu_release(mi);
+	}
+
+	return FALSE;
+}
+
+static void
+submenu_release_cancel (gpointer data)
+{
+	g_source_remove(GPOINTER_TO_UINT(data));
+	return;
+}
+
+/* Queues the menu on an item to be released, unless it already is */
+static void
+submenu_release_queue (DbusmenuMenuitem * mi)
+{
+	if (g_object_get_data(G_OBJECT(mi), data_release) != NULL) {
+		return;
+	}
+
+	guint source = g_timeout_add(SUBMENU_RELEASE_TIMEOUT, submenu_release_timeout, mi);
+	g_object_set_data_full(G_OBJECT(mi), data_release, GUINT_TO_POINTER(source), submenu_release_cancel);
+
+	return;
+}
+
 /* Submenu processing */
 static void
 process_submenu (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * variant, DbusmenuGtkClient * gtkclient)
@@ -707,17 +1113,30 @@ process_submenu (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * variant, D
 		/* We're just going to warn for now. */
 		gpointer pmenu = g_object_get_data(G_OBJECT(mi), data_menu);
 		if (pmenu != NULL) {
-			g_warning("The child-display variable is set to '%s' but there's a menu, odd?", submenu);
+			if (dbusmenu_menuitem_get_children(mi) == NULL) {
+				submenu_release_queue(mi);
+			} else {
+				g_warning("The child-display variable is set to '%s' but there's a menu, odd?", submenu);
+			}
 		}
 	} else {
-		/* We need to build a menu for these guys to live in. */
-		GtkMenu * menu = GTK_MENU(gtk_menu_new());
-		g_object_ref_sink(menu);
-		g_object_set_data_full(G_OBJECT(mi), data_menu, menu, g_object_unref);
+		/* Whatever was going to take the menu away is too late */
+		g_object_set_data(G_OBJECT(mi), data_release, NULL);
+
+		/* We need a menu for these guys to live in, unless we've
+		   kept one from before the item's widget was swapped or
+		   its children were cleared out. */
+		GtkMenu * menu = GTK_MENU(g_object_get_data(G_OBJECT(mi), data_menu));
+		if (menu == NULL) {
+			menu = menu_pool_get();
+			g_object_set_data_full(G_OBJECT(mi), data_menu, menu, g_object_unref);
+
+			g_signal_connect(menu, "notify::visible", G_CALLBACK(submenu_notify_visible_cb), mi);
+		}
 
 		gtk_menu_item_set_submenu(gmi, GTK_WIDGET(menu));
 
-		g_signal_connect(menu, "notify::visible", G_CALLBACK(submenu_notify_visible_cb), mi);
+		item_events_get(mi)->client = gtkclient;
 	}
 
 	return;
@@ -776,6 +1195,69 @@ process_a11y_desc (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * variant,
 	return;
 }
 
+/* When the item changes between the types that we build we swap
+   in a new widget for it.  It goes in the same place in the menu
+   and keeps the submenu, the item itself doesn't change. */
+static void
+process_type (DbusmenuMenuitem * mi, GtkMenuItem * gmi, GVariant * variant, DbusmenuGtkClient * gtkclient)
+{
+	const gchar * type = NULL;
+	if (variant != NULL) {
+		type = g_variant_get_string(variant, NULL);
+	}
+
+	gboolean separator = (g_strcmp0(type, DBUSMENU_CLIENT_TYPES_SEPARATOR) == 0);
+
+	/* Types that other handlers built we can't do anything about */
+	if (!separator && type != NULL && g_strcmp0(type, DBUSMENU_CLIENT_TYPES_DEFAULT) != 0) {
+		return;
+	}
+	if (!GTK_IS_SEPARATOR_MENU_ITEM(gmi) && !IS_GENERICMENUITEM(gmi)) {
+		return;
+	}
+	if (separator == GTK_IS_SEPARATOR_MENU_ITEM(gmi)) {
+		return;
+	}
+
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Swapping the widget for %d to type '%s'", dbusmenu_menuitem_get_id(mi), type);
+	#endif
+
+	GtkWidget * shell = gtk_widget_get_parent(GTK_WIDGET(gmi));
+	gint position = -1;
+	if (GTK_IS_MENU_SHELL(shell)) {
+		GList * children = gtk_container_get_children(GTK_CONTAINER(shell));
+		position = g_list_index(children, gmi);
+		g_list_free(children);
+	}
+
+	/* The submenu stays with the item */
+	if (g_object_get_data(G_OBJECT(mi), data_menu) != NULL) {
+		gtk_menu_item_set_submenu(gmi, NULL);
+	}
+
+	/* Drop the old widget and what was hooked up along with it */
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menu_prop_change_cb), gtkclient);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(delete_child), gtkclient);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(move_child), gtkclient);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(reparent_child), gtkclient);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(image_property_handle), gtkclient);
+	g_object_set_data(G_OBJECT(mi), data_menuitem, NULL);
+
+	if (separator) {
+		new_item_seperator(mi, NULL, DBUSMENU_CLIENT(gtkclient), NULL);
+	} else {
+		new_item_normal(mi, NULL, DBUSMENU_CLIENT(gtkclient), NULL);
+	}
+
+	if (position >= 0) {
+		GtkMenuItem * newgmi = dbusmenu_gtkclient_menuitem_get(gtkclient, mi);
+		gtk_menu_shell_insert(GTK_MENU_SHELL(shell), GTK_WIDGET(newgmi), position);
+	}
+
+	return;
+}
+
 /* Whenever we have a property change on a DbusmenuMenuitem
    we need to be responsive to that. */
 static void
@@ -801,6 +1283,8 @@ menu_prop_change_cb (DbusmenuMenuitem * mi, gchar * prop, GVariant * variant, Db
 		process_a11y_desc(mi, gmi, variant, gtkclient);
 	} else if (!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_SHORTCUT)) {
 		refresh_shortcut(gtkclient, mi);
+	} else if (!g_strcmp0(prop, DBUSMENU_MENUITEM_PROP_TYPE)) {
+		process_type(mi, gmi, variant, gtkclient);
 	}
 
 	return;
@@ -863,6 +1347,8 @@ activate_helper (GtkMenuShell * shell)
 static void
 item_activate (DbusmenuClient * client, DbusmenuMenuitem * mi, guint timestamp, gpointer userdata)
 {
+	dbusmenu_gtkclient_restore(DBUSMENU_GTKCLIENT(client));
+
 	gpointer pmenu = g_object_get_data(G_OBJECT(mi), data_menu);
 	if (pmenu == NULL) {
 		g_warning("Activated menu item doesn't have a menu?  ID: %d", dbusmenu_menuitem_get_id(mi));
@@ -923,9 +1409,12 @@ dbusmenu_gtkclient_newitem_base (DbusmenuGtkClient * client, DbusmenuMenuitem *
 	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(menu_prop_change_cb), client);
 	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(delete_child), client);
 	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED,   G_CALLBACK(move_child),   client);
+	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(reparent_child), client);
 
 	/* GtkMenuitem signals */
 	g_signal_connect(G_OBJECT(gmi), "activate", G_CALLBACK(menu_pressed_cb), item);
+	g_signal_connect(G_OBJECT(gmi), "select", G_CALLBACK(menu_selected_cb), item);
+	g_signal_connect(G_OBJECT(gmi), "deselect", G_CALLBACK(menu_deselected_cb), item);
 
 	/* Check our set of props to see if any are set already */
 	process_visible(item, gmi, dbusmenu_menuitem_property_get_variant(item, DBUSMENU_MENUITEM_PROP_VISIBLE));
@@ -962,6 +1451,11 @@ new_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position, Dbus
 
 	gpointer ann_menu = g_object_get_data(G_OBJECT(mi), data_menu);
 	if (ann_menu == NULL) {
+		/* It goes in when the parent is built again */
+		if (gtkclient->priv->evicted && g_object_get_data(G_OBJECT(mi), data_menuitem) == NULL) {
+			return;
+		}
+
 		g_warning("Children but no menu, someone's been naughty with their '" DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY "' property: '%s'", dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY));
 		return;
 	}
@@ -969,6 +1463,10 @@ new_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position, Dbus
 	GtkMenu * menu = GTK_MENU(ann_menu);
 
 	GtkMenuItem * childmi  = dbusmenu_gtkclient_menuitem_get(gtkclient, child);
+	if (childmi == NULL) {
+		return;
+	}
+
 	gtk_menu_shell_insert(GTK_MENU_SHELL(menu), GTK_WIDGET(childmi), position);
 	
 	return;
@@ -980,13 +1478,12 @@ delete_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuGtkClient
 	/* If it's a root item, we shouldn't be dealing with it here. */
 	if (dbusmenu_menuitem_get_root(mi)) { return; }
 
-	if (g_list_length(dbusmenu_menuitem_get_children(mi)) == 0) {
-		gpointer ann_menu = g_object_get_data(G_OBJECT(mi), data_menu);
-		GtkMenu * menu = GTK_MENU(ann_menu);
-
-		if (menu != NULL) {
-			gtk_widget_destroy(GTK_WIDGET(menu));
-			g_object_steal_data(G_OBJECT(mi), data_menu);
+	/* Applications refill their submenus by clearing them out
+	   first, so as long as the item says it has a submenu we
+	   keep the menu for the children that are coming back. */
+	if (dbusmenu_menuitem_get_children(mi) == NULL && g_object_get_data(G_OBJECT(mi), data_menu) != NULL) {
+		if (g_strcmp0(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY), DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU) != 0) {
+			submenu_release_queue(mi);
 		}
 	}
 
@@ -1006,11 +1503,201 @@ move_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint new, guint ol
 	}
 
 	GtkMenuItem * childmi  = dbusmenu_gtkclient_menuitem_get(gtkclient, child);
+	if (childmi == NULL) {
+		/* Evicted, it's built in the right place */
+		return;
+	}
+
 	gtk_menu_reorder_child(GTK_MENU(ann_menu), GTK_WIDGET(childmi), dbusmenu_menuitem_get_position_realized(child, mi));
 
 	return;
 }
 
+/* The child keeps its widget, along with everything under it, and
+   that gets moved from the old submenu over to the new one. */
+static void
+reparent_child (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position, DbusmenuGtkClient * gtkclient)
+{
+	if (dbusmenu_menuitem_get_parent(child) != mi) {
+		delete_child(mi, child, gtkclient);
+		return;
+	}
+
+	/* The root items are put in place by the menu */
+	if (dbusmenu_menuitem_get_root(mi)) { return; }
+
+	GtkWidget * childmi = GTK_WIDGET(dbusmenu_gtkclient_menuitem_get(gtkclient, child));
+	if (childmi == NULL) {
+		return;
+	}
+
+	GtkWidget * shell = gtk_widget_get_parent(childmi);
+	if (shell != NULL) {
+		gtk_container_remove(GTK_CONTAINER(shell), childmi);
+	}
+
+	new_child(mi, child, position, gtkclient);
+	return;
+}
+
+/* Whether one of the submenus in the tree under the item is up
+   on the screen */
+static gboolean
+item_showing (DbusmenuMenuitem * mi)
+{
+	gpointer menu = g_object_get_data(G_OBJECT(mi), data_menu);
+	if (menu != NULL && gtk_widget_get_visible(GTK_WIDGET(menu))) {
+		return TRUE;
+	}
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		if (item_showing(DBUSMENU_MENUITEM(child->data))) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Whether we built everything in the tree under the item, and so
+   can build it again just from the properties.  Widgets that other
+   type handlers made stay where they are. */
+static gboolean
+item_rebuildable (DbusmenuGtkClient * client, DbusmenuMenuitem * mi)
+{
+	const gchar * type = dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_TYPE);
+	if (type != NULL && g_strcmp0(type, DBUSMENU_CLIENT_TYPES_DEFAULT) != 0 && g_strcmp0(type, DBUSMENU_CLIENT_TYPES_SEPARATOR) != 0) {
+		return FALSE;
+	}
+
+	GtkMenuItem * gmi = dbusmenu_gtkclient_menuitem_get(client, mi);
+	if (gmi != NULL && !GTK_IS_SEPARATOR_MENU_ITEM(gmi) && !IS_GENERICMENUITEM(gmi)) {
+		return FALSE;
+	}
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		if (!item_rebuildable(client, DBUSMENU_MENUITEM(child->data))) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Drops the widgets and submenus of the item and everything under
+   it, the children first so the menus are empty when they go back
+   into the pool. */
+static void
+item_evict (DbusmenuGtkClient * client, DbusmenuMenuitem * mi)
+{
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		item_evict(client, DBUSMENU_MENUITEM(child->data));
+	}
+
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menu_prop_change_cb), client);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(delete_child), client);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(move_child), client);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(reparent_child), client);
+	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(image_property_handle), client);
+
+	/* Destroying the widget would take the submenu with it */
+	g_object_set_data(G_OBJECT(mi), data_release, NULL);
+	submenu_release(mi);
+
+	g_object_set_data(G_OBJECT(mi), data_menuitem, NULL);
+
+	return;
+}
+
+/* Builds the widgets that were evicted from the item on down, the
+   parents first so there's a menu to put the children in. */
+static void
+item_restore (DbusmenuGtkClient * client, DbusmenuMenuitem * mi, DbusmenuMenuitem * parent)
+{
+	GtkMenuItem * gmi = dbusmenu_gtkclient_menuitem_get(client, mi);
+
+	if (gmi == NULL) {
+		const gchar * type = dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_TYPE);
+
+		if (g_strcmp0(type, DBUSMENU_CLIENT_TYPES_SEPARATOR) == 0) {
+			new_item_seperator(mi, parent, DBUSMENU_CLIENT(client), NULL);
+		} else if (type == NULL || g_strcmp0(type, DBUSMENU_CLIENT_TYPES_DEFAULT) == 0) {
+			new_item_normal(mi, parent, DBUSMENU_CLIENT(client), NULL);
+		} else {
+			return;
+		}
+	} else if (!dbusmenu_menuitem_get_root(parent) && gtk_widget_get_parent(GTK_WIDGET(gmi)) == NULL) {
+		/* Built by someone else while its parent was gone */
+		new_child(parent, mi, dbusmenu_menuitem_get_position(mi, parent), client);
+	}
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		item_restore(client, DBUSMENU_MENUITEM(child->data), mi);
+	}
+
+	return;
+}
+
+/* Evicts the clients at the back of the resident ones until they
+   fit in the limit.  The one at the front was just used and ones
+   that are showing a menu stay, so this can leave more behind. */
+static void
+resident_trim (void)
+{
+	if (resident_limit == 0) {
+		return;
+	}
+
+	GList * link = resident_clients.tail;
+	while (link != NULL && link != resident_clients.head && resident_clients.length > resident_limit) {
+		GList * prev = g_list_previous(link);
+		dbusmenu_gtkclient_evict(DBUSMENU_GTKCLIENT(link->data));
+		link = prev;
+	}
+
+	return;
+}
+
+/* Puts the client at the front of the resident ones */
+static void
+resident_touch (DbusmenuGtkClient * client)
+{
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(client);
+
+	if (priv->resident == resident_clients.head && priv->resident != NULL) {
+		return;
+	}
+
+	if (priv->resident != NULL) {
+		g_queue_unlink(&resident_clients, priv->resident);
+	} else {
+		priv->resident = g_list_alloc();
+		priv->resident->data = client;
+	}
+
+	g_queue_push_head_link(&resident_clients, priv->resident);
+	resident_trim();
+
+	return;
+}
+
+static void
+resident_drop (DbusmenuGtkClient * client)
+{
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(client);
+
+	if (priv->resident != NULL) {
+		g_queue_delete_link(&resident_clients, priv->resident);
+		priv->resident = NULL;
+	}
+
+	return;
+}
+
 /* Public API */
 
 /**
@@ -1079,6 +1766,158 @@ dbusmenu_gtkclient_menuitem_get_submenu (DbusmenuGtkClient * client, DbusmenuMen
 	return GTK_MENU(data);
 }
 
+/**
+ * dbusmenu_gtkclient_evict:
+ * @client: A #DbusmenuGtkClient that isn't being shown
+ *
+ * Drops the widgets and submenus under the top level items of
+ * @client to save the memory they take while nobody is looking
+ * at them.  The #DbusmenuMenuitem tree stays and keeps following
+ * the server, so they can be built again quickly with
+ * dbusmenu_gtkclient_restore().  That happens on its own when one
+ * of the top level items is selected or the server asks for a
+ * menu to be shown.
+ *
+ * The top level items keep their #GtkMenuItem and an empty
+ * submenu as those are usually held by someone else.  Items built
+ * by other type handlers are kept too, along with everything
+ * above them.  Nothing is evicted while a submenu is showing.
+ * Shortcuts on the evicted items don't work until they are
+ * restored.
+ */
+void
+dbusmenu_gtkclient_evict (DbusmenuGtkClient * client)
+{
+	g_return_if_fail(DBUSMENU_IS_GTKCLIENT(client));
+
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(client);
+	if (priv->evicted) {
+		return;
+	}
+
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root != NULL) {
+		if (item_showing(root)) {
+			return;
+		}
+
+		GList * top;
+		for (top = dbusmenu_menuitem_get_children(root); top != NULL; top = g_list_next(top)) {
+			GList * child;
+			for (child = dbusmenu_menuitem_get_children(DBUSMENU_MENUITEM(top->data)); child != NULL; child = g_list_next(child)) {
+				if (item_rebuildable(client, DBUSMENU_MENUITEM(child->data))) {
+					item_evict(client, DBUSMENU_MENUITEM(child->data));
+				}
+			}
+		}
+	}
+
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Evicted the widgets of client %p", client);
+	#endif
+
+	priv->evicted = TRUE;
+	resident_drop(client);
+
+	return;
+}
+
+/**
+ * dbusmenu_gtkclient_restore:
+ * @client: A #DbusmenuGtkClient that's about to be shown
+ *
+ * Builds the widgets that dbusmenu_gtkclient_evict() dropped
+ * again, from the properties that the #DbusmenuMenuitem tree
+ * kept up to date.  It also counts as using the client for the
+ * limit set with dbusmenu_gtkclient_set_resident_limit().  It's
+ * cheap when there's nothing to build.
+ */
+void
+dbusmenu_gtkclient_restore (DbusmenuGtkClient * client)
+{
+	g_return_if_fail(DBUSMENU_IS_GTKCLIENT(client));
+
+	DbusmenuGtkClientPrivate * priv = DBUSMENU_GTKCLIENT_GET_PRIVATE(client);
+	gboolean evicted = priv->evicted;
+
+	/* Building the items needs this to be clear */
+	priv->evicted = FALSE;
+
+	if (evicted) {
+		DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+
+		if (root != NULL) {
+			GList * child;
+			for (child = dbusmenu_menuitem_get_children(root); child != NULL; child = g_list_next(child)) {
+				item_restore(client, DBUSMENU_MENUITEM(child->data), root);
+			}
+		}
+
+		#ifdef MASSIVEDEBUGGING
+		g_debug("Restored the widgets of client %p", client);
+		#endif
+	}
+
+	resident_touch(client);
+
+	return;
+}
+
+/**
+ * dbusmenu_gtkclient_set_resident_limit:
+ * @limit: How many clients can keep their widgets, zero for any number
+ *
+ * Bounds how many #DbusmenuGtkClient objects in the process keep
+ * their widgets built.  When there are more, the ones that were
+ * used least recently are evicted as with dbusmenu_gtkclient_evict().
+ * A client is used when it's created, when one of its menus is
+ * shown and when dbusmenu_gtkclient_restore() is called on it.
+ *
+ * The limit covers every client in the process, including the ones
+ * an application uses for its own menus.  Shortcuts set up with
+ * dbusmenu_gtkclient_set_accel_group() go with the evicted widgets,
+ * so they stop working until the client is restored.  Applications
+ * that rely on them should restore those clients themselves or
+ * leave the limit at zero.
+ */
+void
+dbusmenu_gtkclient_set_resident_limit (guint limit)
+{
+	resident_limit = limit;
+	resident_trim();
+	return;
+}
+
+/**
+ * dbusmenu_gtkclient_get_resident_limit:
+ *
+ * Gets the limit set with dbusmenu_gtkclient_set_resident_limit().
+ *
+ * Return value: How many clients can keep their widgets, zero for
+ * 	any number
+ */
+guint
+dbusmenu_gtkclient_get_resident_limit (void)
+{
+	return resident_limit;
+}
+
+/* While the client is evicted there's nowhere to put the items
+   that go under one that was evicted, they get built when it
+   is restored. */
+static gboolean
+build_deferred (DbusmenuClient * client, DbusmenuMenuitem * parent)
+{
+	if (!DBUSMENU_GTKCLIENT_GET_PRIVATE(client)->evicted) {
+		return FALSE;
+	}
+	if (parent == NULL || dbusmenu_menuitem_get_root(parent)) {
+		return FALSE;
+	}
+
+	return g_object_get_data(G_OBJECT(parent), data_menuitem) == NULL;
+}
+
 /* The base type handler that builds a plain ol'
    GtkMenuItem to represent, well, the GtkMenuItem */
 static gboolean
@@ -1088,10 +1927,17 @@ new_item_normal (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, Dbusmenu
 	g_return_val_if_fail(DBUSMENU_IS_GTKCLIENT(client), FALSE);
 	/* Note: not checking parent, it's reasonable for it to be NULL */
 
+	if (build_deferred(client, parent)) {
+		return TRUE;
+	}
+
 	GtkMenuItem * gmi;
 	gmi = GTK_MENU_ITEM(g_object_new(GENERICMENUITEM_TYPE, NULL));
 
 	if (gmi != NULL) {
+		if (DBUSMENU_GTKCLIENT_GET_PRIVATE(client)->flyweight) {
+			genericmenuitem_set_flyweight(GENERICMENUITEM(gmi), TRUE);
+		}
 		gtk_menu_item_set_label(gmi, dbusmenu_menuitem_property_get(newitem, DBUSMENU_MENUITEM_PROP_LABEL));
 		dbusmenu_gtkclient_newitem_base(DBUSMENU_GTKCLIENT(client), newitem, gmi, parent);
 	} else {
@@ -1123,6 +1969,10 @@ new_item_seperator (DbusmenuMenuitem * newitem, DbusmenuMenuitem * parent, Dbusm
 	g_return_val_if_fail(DBUSMENU_IS_GTKCLIENT(client), FALSE);
 	/* Note: not checking parent, it's reasonable for it to be NULL */
 
+	if (build_deferred(client, parent)) {
+		return TRUE;
+	}
+
 	GtkMenuItem * gmi;
 	gmi = GTK_MENU_ITEM(gtk_separator_menu_item_new());
 
@@ -101,6 +101,13 @@ GtkMenu *     dbusmenu_gtkclient_menuitem_get_submenu (DbusmenuGtkClient * clien
 
 void  dbusmenu_gtkclient_set_accel_group (DbusmenuGtkClient * client, GtkAccelGroup * agroup);
 GtkAccelGroup * dbusmenu_gtkclient_get_accel_group (DbusmenuGtkClient * client);
+void dbusmenu_gtkclient_set_flyweight (DbusmenuGtkClient * client, gboolean flyweight);
+gboolean dbusmenu_gtkclient_get_flyweight (DbusmenuGtkClient * client);
+
+void dbusmenu_gtkclient_evict (DbusmenuGtkClient * client);
+void dbusmenu_gtkclient_restore (DbusmenuGtkClient * client);
+void dbusmenu_gtkclient_set_resident_limit (guint limit);
+guint dbusmenu_gtkclient_get_resident_limit (void);
 
 void dbusmenu_gtkclient_newitem_base (DbusmenuGtkClient * client, DbusmenuMenuitem * item, GtkMenuItem * gmi, DbusmenuMenuitem * parent);
 
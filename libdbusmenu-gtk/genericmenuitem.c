@@ -34,6 +34,10 @@ License version 3 and version 2.1 along with this program.  If not, see
 
 #include "genericmenuitem.h"
 
+#if GTK_CHECK_VERSION(3,8,0)
+#include <gtk/gtk-a11y.h>
+#endif
+
 /*
 	GenericmenuitemPrivate:
 	@check_type: What type of check we have, or none at all.
@@ -44,8 +48,27 @@ struct _GenericmenuitemPrivate {
 	GenericmenuitemState       state;
 	GenericmenuitemDisposition disposition;
 	gchar * label_text;
+
+	gboolean flyweight;
+	gchar * markup;               /* The label as it was set */
+	gchar * text;                 /* The label without the markup */
+	PangoAttrList * attrs;        /* With the mnemonic underlined */
+	PangoAttrList * attrs_hidden; /* Without it */
+	guint mnemonic;
+	gchar * a11y_name;            /* The name we gave the accessible */
+	PangoLayout * layout;
+	PangoLayout * accel_layout;
+	gboolean accel_valid;
+	GtkWidget * image;            /* Not in the item, it holds what to draw */
+	GdkPixbuf * icon;             /* Loaded from the image when drawn */
+	gint toggle_size;
+	gulong shell_handler;
 };
 
+/* About what GtkAccelLabel leaves between the label and
+   the accelerator */
+#define FLYWEIGHT_ACCEL_SPACING  16
+
 /* Private macro */
 #define GENERICMENUITEM_GET_PRIVATE(o) \
 (G_TYPE_INSTANCE_GET_PRIVATE ((o), GENERICMENUITEM_TYPE, GenericmenuitemPrivate))
@@ -58,6 +81,25 @@ static void genericmenuitem_finalize   (GObject *object);
 static void set_label (GtkMenuItem * menu_item, const gchar * label);
 static const gchar * get_label (GtkMenuItem * menu_item);
 static void activate (GtkMenuItem * menu_item);
+#if GTK_CHECK_VERSION(3,0,0)
+static gboolean draw (GtkWidget * widget, cairo_t * cr);
+static void get_preferred_width (GtkWidget * widget, gint * minimum, gint * natural);
+static void get_preferred_height (GtkWidget * widget, gint * minimum, gint * natural);
+static void get_preferred_height_for_width (GtkWidget * widget, gint width, gint * minimum, gint * natural);
+static void style_updated (GtkWidget * widget);
+static void direction_changed (GtkWidget * widget, GtkTextDirection previous);
+static void parent_set (GtkWidget * widget, GtkWidget * previous);
+static void toggle_size_allocate (GtkMenuItem * menu_item, gint allocation);
+static void flyweight_clear (Genericmenuitem * item);
+static void flyweight_invalidate (Genericmenuitem * item);
+static void flyweight_accel_changed (GtkWidget * widget, gpointer user_data);
+static void flyweight_shell_connect (Genericmenuitem * item, GtkWidget * shell);
+static void flyweight_set_image (Genericmenuitem * item, GtkWidget * image);
+static gboolean flyweight_set_markup (Genericmenuitem * item, const gchar * markup, gboolean mnemonic);
+#endif
+#if GTK_CHECK_VERSION(3,8,0)
+static GType genericmenuitem_accessible_get_type (void);
+#endif
 
 /* GObject stuff */
 G_DEFINE_TYPE (Genericmenuitem, genericmenuitem, GTK_TYPE_CHECK_MENU_ITEM);
@@ -70,6 +112,9 @@ static void draw_indicator (GtkCheckMenuItem *check_menu_item, GdkRectangle *are
 static void (*parent_draw_indicator) (GtkCheckMenuItem *check_menu_item, GdkRectangle *area) = NULL;
 #endif
 static void (*parent_menuitem_activate) (GtkMenuItem * mi) = NULL;
+#if GTK_CHECK_VERSION(3,0,0)
+static void (*parent_toggle_size_allocate) (GtkMenuItem * mi, gint allocation) = NULL;
+#endif
 
 /* Initializing all of the classes.  Most notably we're
    disabling the drawing of the check early. */
@@ -83,11 +128,24 @@ genericmenuitem_class_init (GenericmenuitemClass *klass)
 	object_class->dispose = genericmenuitem_dispose;
 	object_class->finalize = genericmenuitem_finalize;
 
-#if GTK_CHECK_VERSION(3,2,0)
+#if GTK_CHECK_VERSION(3,0,0)
 	GtkWidgetClass * widget_class = GTK_WIDGET_CLASS(klass);
 
+	widget_class->draw = draw;
+	widget_class->get_preferred_width = get_preferred_width;
+	widget_class->get_preferred_height = get_preferred_height;
+	widget_class->get_preferred_height_for_width = get_preferred_height_for_width;
+	widget_class->style_updated = style_updated;
+	widget_class->direction_changed = direction_changed;
+	widget_class->parent_set = parent_set;
+#endif
+
+#if GTK_CHECK_VERSION(3,2,0)
 	gtk_widget_class_set_accessible_role(widget_class, ATK_ROLE_MENU_ITEM);
 #endif
+#if GTK_CHECK_VERSION(3,8,0)
+	gtk_widget_class_set_accessible_type(widget_class, genericmenuitem_accessible_get_type());
+#endif
 
 	GtkCheckMenuItemClass * check_class = GTK_CHECK_MENU_ITEM_CLASS (klass);
 
@@ -99,6 +157,10 @@ genericmenuitem_class_init (GenericmenuitemClass *klass)
 	menuitem_class->get_label = get_label;
 	parent_menuitem_activate = menuitem_class->activate;
 	menuitem_class->activate = activate;
+#if GTK_CHECK_VERSION(3,0,0)
+	parent_toggle_size_allocate = menuitem_class->toggle_size_allocate;
+	menuitem_class->toggle_size_allocate = toggle_size_allocate;
+#endif
 
 	return;
 }
@@ -115,6 +177,26 @@ genericmenuitem_init (Genericmenuitem *self)
 	self->priv->disposition = GENERICMENUITEM_DISPOSITION_NORMAL;
 	self->priv->label_text = NULL;
 
+	self->priv->flyweight = FALSE;
+	self->priv->markup = NULL;
+	self->priv->text = NULL;
+	self->priv->attrs = NULL;
+	self->priv->attrs_hidden = NULL;
+	self->priv->mnemonic = 0;
+	self->priv->a11y_name = NULL;
+	self->priv->layout = NULL;
+	self->priv->accel_layout = NULL;
+	self->priv->accel_valid = FALSE;
+	self->priv->image = NULL;
+	self->priv->icon = NULL;
+	self->priv->toggle_size = 0;
+	self->priv->shell_handler = 0;
+
+#if GTK_CHECK_VERSION(3,0,0)
+	/* Without an accel label somebody has to notice */
+	g_signal_connect(G_OBJECT(self), "accel-closures-changed", G_CALLBACK(flyweight_accel_changed), NULL);
+#endif
+
 #if !GTK_CHECK_VERSION(3,0,0)
 	AtkObject * aobj = gtk_widget_get_accessible(GTK_WIDGET(self));
 	if (aobj != NULL) {
@@ -129,6 +211,9 @@ genericmenuitem_init (Genericmenuitem *self)
 static void
 genericmenuitem_dispose (GObject *object)
 {
+#if GTK_CHECK_VERSION(3,0,0)
+	flyweight_clear(GENERICMENUITEM(object));
+#endif
 
 	G_OBJECT_CLASS (genericmenuitem_parent_class)->dispose (object);
 	return;
@@ -140,6 +225,7 @@ genericmenuitem_finalize (GObject *object)
 {
 	Genericmenuitem * self = GENERICMENUITEM(object);
 	g_free(self->priv->label_text);
+	g_free(self->priv->a11y_name);
 
 	G_OBJECT_CLASS (genericmenuitem_parent_class)->finalize (object);
 	return;
@@ -294,6 +380,17 @@ set_label (GtkMenuItem * menu_item, const gchar * in_label)
 		break;
 	}
 
+#if GTK_CHECK_VERSION(3,0,0)
+	/* Nothing to build, we draw it ourselves */
+	if (item->priv->flyweight) {
+		if (local_label != NULL && flyweight_set_markup(item, local_label, has_mnemonic(in_label, FALSE))) {
+			g_object_notify(G_OBJECT(menu_item), "label");
+		}
+		g_free(local_label);
+		return;
+	}
+#endif
+
 	GtkWidget * child = gtk_bin_get_child(GTK_BIN(menu_item));
 	GtkLabel * labelw = NULL;
 	gboolean suppress_update = FALSE;
@@ -530,6 +627,13 @@ set_image_helper (GtkWidget * widget, gpointer data)
 void
 genericmenuitem_set_image (Genericmenuitem * menu_item, GtkWidget * image)
 {
+#if GTK_CHECK_VERSION(3,0,0)
+	if (menu_item->priv->flyweight) {
+		flyweight_set_image(menu_item, image);
+		return;
+	}
+#endif
+
 	GtkWidget * child = gtk_bin_get_child(GTK_BIN(menu_item));
 	GtkImage * imagew = NULL;
 
@@ -600,6 +704,10 @@ genericmenuitem_set_image (Genericmenuitem * menu_item, GtkWidget * image)
 GtkWidget *
 genericmenuitem_get_image (Genericmenuitem * menu_item)
 {
+	if (menu_item->priv->flyweight) {
+		return menu_item->priv->image;
+	}
+
 	GtkWidget * child = gtk_bin_get_child(GTK_BIN(menu_item));
 	GtkWidget * imagew = NULL;
 
@@ -654,3 +762,876 @@ genericmenuitem_get_disposition (Genericmenuitem * item)
 
 	return item->priv->disposition;
 }
+
+/**
+ * genericmenuitem_set_flyweight:
+ * @item: A #Genericmenuitem
+ * @flyweight: Whether to draw the contents of the item itself
+ *
+ * Instead of building a label, an image and a box to put them
+ * in, the item can draw the label, its mnemonic, the icon and
+ * the accelerator itself.  Large menus then have one widget for
+ * each item instead of three or four.  The accessible gets the
+ * label as its name and the mnemonic and accelerator as the key
+ * binding of its action, as it would from the label widgets.  The
+ * image from genericmenuitem_set_image() is kept, without being
+ * put in the item, to know what to draw.  Only supported with
+ * GTK+ 3, otherwise the item keeps its widgets.
+ */
+void
+genericmenuitem_set_flyweight (Genericmenuitem * item, gboolean flyweight)
+{
+	g_return_if_fail(IS_GENERICMENUITEM(item));
+
+#if GTK_CHECK_VERSION(3,0,0)
+	flyweight = flyweight ? TRUE : FALSE;
+	if (item->priv->flyweight == flyweight) {
+		return;
+	}
+
+	/* The image moves over to the other way of showing it */
+	GtkWidget * image = genericmenuitem_get_image(item);
+	if (image != NULL) {
+		g_object_ref(image);
+	}
+
+	if (flyweight) {
+		GtkWidget * child = gtk_bin_get_child(GTK_BIN(item));
+
+		/* Take it out first so it isn't destroyed with the box */
+		if (image != NULL && gtk_widget_get_parent(image) != NULL) {
+			gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(image)), image);
+			if (child == image) {
+				child = NULL;
+			}
+		}
+
+		if (child != NULL) {
+			gtk_container_remove(GTK_CONTAINER(item), child);
+		}
+	} else {
+		flyweight_clear(item);
+	}
+
+	item->priv->flyweight = flyweight;
+	flyweight_shell_connect(item, flyweight ? gtk_widget_get_parent(GTK_WIDGET(item)) : NULL);
+
+	if (item->priv->label_text != NULL) {
+		set_label(GTK_MENU_ITEM(item), item->priv->label_text);
+	}
+
+	if (image != NULL) {
+		genericmenuitem_set_image(item, image);
+		g_object_unref(image);
+	}
+
+	gtk_widget_queue_resize(GTK_WIDGET(item));
+#endif
+
+	return;
+}
+
+/**
+ * genericmenuitem_get_flyweight:
+ * @item: A #Genericmenuitem
+ *
+ * Gets whether the item draws its contents itself, see
+ * genericmenuitem_set_flyweight().
+ *
+ * Return value: Whether the item is drawn without child widgets
+ */
+gboolean
+genericmenuitem_get_flyweight (Genericmenuitem * item)
+{
+	g_return_val_if_fail(IS_GENERICMENUITEM(item), FALSE);
+
+	return item->priv->flyweight;
+}
+
+#if GTK_CHECK_VERSION(3,0,0)
+/* Drops everything the flyweight mode built or holds on to */
+static void
+flyweight_clear (Genericmenuitem * item)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	flyweight_set_image(item, NULL);
+	flyweight_shell_connect(item, NULL);
+
+	g_clear_object(&priv->layout);
+	g_clear_object(&priv->accel_layout);
+	priv->accel_valid = FALSE;
+
+	if (priv->attrs != NULL) {
+		pango_attr_list_unref(priv->attrs);
+		priv->attrs = NULL;
+	}
+	if (priv->attrs_hidden != NULL) {
+		pango_attr_list_unref(priv->attrs_hidden);
+		priv->attrs_hidden = NULL;
+	}
+
+	g_free(priv->markup);
+	priv->markup = NULL;
+	g_free(priv->text);
+	priv->text = NULL;
+	priv->mnemonic = 0;
+
+	return;
+}
+
+/* Forgets the layouts and the icon so they're built again for
+   the new font, theme or accelerator */
+static void
+flyweight_invalidate (Genericmenuitem * item)
+{
+	if (!item->priv->flyweight) {
+		return;
+	}
+
+	g_clear_object(&item->priv->layout);
+	g_clear_object(&item->priv->accel_layout);
+	g_clear_object(&item->priv->icon);
+	item->priv->accel_valid = FALSE;
+
+	gtk_widget_queue_resize(GTK_WIDGET(item));
+	return;
+}
+
+static void
+flyweight_accel_changed (GtkWidget * widget, gpointer user_data)
+{
+	flyweight_invalidate(GENERICMENUITEM(widget));
+	return;
+}
+
+/* Matches the key that the closure is connected to */
+static gboolean
+flyweight_accel_find (GtkAccelKey * key, GClosure * closure, gpointer data)
+{
+	return (GClosure *)data == closure;
+}
+
+/* The first visible accelerator on the item, the one that
+   GtkAccelLabel would show */
+static gboolean
+flyweight_accel_key (Genericmenuitem * item, guint * accel_key, GdkModifierType * accel_mods)
+{
+	GList * closures = gtk_widget_list_accel_closures(GTK_WIDGET(item));
+	GList * lclosure;
+	gboolean found = FALSE;
+
+	for (lclosure = closures; lclosure != NULL && !found; lclosure = g_list_next(lclosure)) {
+		GClosure * closure = (GClosure *)lclosure->data;
+		GtkAccelGroup * group = gtk_accel_group_from_accel_closure(closure);
+		if (group == NULL) {
+			continue;
+		}
+
+		GtkAccelKey * key = gtk_accel_group_find(group, flyweight_accel_find, closure);
+		if (key != NULL && key->accel_key != 0 && (key->accel_flags & GTK_ACCEL_VISIBLE)) {
+			*accel_key = key->accel_key;
+			*accel_mods = key->accel_mods;
+			found = TRUE;
+		}
+	}
+
+	g_list_free(closures);
+	return found;
+}
+
+/* The text for the accelerator, like GtkAccelLabel would show */
+static gchar *
+flyweight_accel_text (Genericmenuitem * item)
+{
+	guint key = 0;
+	GdkModifierType mods = 0;
+
+	if (!flyweight_accel_key(item, &key, &mods)) {
+		return NULL;
+	}
+
+	return gtk_accelerator_get_label(key, mods);
+}
+
+/* Whether the window the item is in shows mnemonics right now */
+static gboolean
+flyweight_mnemonics_visible (Genericmenuitem * item)
+{
+	GtkWidget * toplevel = gtk_widget_get_toplevel(GTK_WIDGET(item));
+
+	return GTK_IS_WINDOW(toplevel) && gtk_window_get_mnemonics_visible(GTK_WINDOW(toplevel));
+}
+
+static PangoLayout *
+flyweight_layout (Genericmenuitem * item, gboolean underline)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	if (priv->layout == NULL) {
+		priv->layout = gtk_widget_create_pango_layout(GTK_WIDGET(item), priv->text);
+	}
+
+	if (priv->attrs != NULL) {
+		pango_layout_set_attributes(priv->layout, underline ? priv->attrs : priv->attrs_hidden);
+	}
+
+	return priv->layout;
+}
+
+static PangoLayout *
+flyweight_accel_layout (Genericmenuitem * item)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	if (!priv->accel_valid) {
+		gchar * text = flyweight_accel_text(item);
+		if (text != NULL) {
+			priv->accel_layout = gtk_widget_create_pango_layout(GTK_WIDGET(item), text);
+			g_free(text);
+		}
+		priv->accel_valid = TRUE;
+	}
+
+	return priv->accel_layout;
+}
+
+/* The space the image asks for, the same as it would in the box */
+static void
+flyweight_icon_size (Genericmenuitem * item, gint * width, gint * height)
+{
+	gint request_width = -1, request_height = -1;
+
+	gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, width, height);
+	gtk_widget_get_size_request(item->priv->image, &request_width, &request_height);
+
+	if (request_width > 0) {
+		*width = request_width;
+	}
+	if (request_height > 0) {
+		*height = request_height;
+	}
+
+	return;
+}
+
+/* Loads the icon from the image, only once the item is drawn */
+static GdkPixbuf *
+flyweight_icon (Genericmenuitem * item, gint width, gint height)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+	GtkImage * image = GTK_IMAGE(priv->image);
+
+	if (priv->icon != NULL) {
+		return priv->icon;
+	}
+
+	switch (gtk_image_get_storage_type(image)) {
+	case GTK_IMAGE_PIXBUF: {
+		GdkPixbuf * pixbuf = gtk_image_get_pixbuf(image);
+		if (pixbuf != NULL) {
+			priv->icon = g_object_ref(pixbuf);
+		}
+		break;
+	}
+	case GTK_IMAGE_ICON_NAME: {
+		const gchar * name = NULL;
+		gtk_image_get_icon_name(image, &name, NULL);
+		if (name != NULL) {
+			GtkIconTheme * theme = gtk_icon_theme_get_for_screen(gtk_widget_get_screen(GTK_WIDGET(item)));
+			priv->icon = gtk_icon_theme_load_icon(theme, name, MIN(width, height), GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
+		}
+		break;
+	}
+	default:
+		/* A blank icon only takes up the space */
+		break;
+	}
+
+	return priv->icon;
+}
+
+/* The image changed under us, through genericmenuitem_get_image() */
+static void
+flyweight_image_notify (GObject * image, GParamSpec * pspec, gpointer user_data)
+{
+	Genericmenuitem * item = GENERICMENUITEM(user_data);
+
+	g_clear_object(&item->priv->icon);
+	gtk_widget_queue_resize(GTK_WIDGET(item));
+	return;
+}
+
+static void
+flyweight_set_image (Genericmenuitem * item, GtkWidget * image)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	if (priv->image == image) {
+		return;
+	}
+
+	if (priv->image != NULL) {
+		g_signal_handlers_disconnect_by_func(priv->image, flyweight_image_notify, item);
+		g_object_unref(priv->image);
+		priv->image = NULL;
+	}
+
+	if (image != NULL) {
+		priv->image = g_object_ref_sink(image);
+		g_signal_connect(G_OBJECT(priv->image), "notify", G_CALLBACK(flyweight_image_notify), item);
+	}
+
+	g_clear_object(&priv->icon);
+	gtk_widget_queue_resize(GTK_WIDGET(item));
+	return;
+}
+
+/* The byte ranges in @text of the characters that had the mnemonic
+   marker in front of them in @marked, which is the same label parsed
+   without looking for mnemonics.  Pairs of start and end. */
+static GArray *
+flyweight_mnemonic_ranges (const gchar * marked, const gchar * text)
+{
+	GArray * ranges = g_array_new(FALSE, FALSE, sizeof(guint));
+	const gchar * in = marked;
+	const gchar * out = text;
+
+	while (in[0] != '\0' && out[0] != '\0') {
+		if (in[0] == '_' && in[1] == '_') {
+			/* An escaped underscore */
+			in++;
+		} else if (in[0] == '_' && in[1] != '\0') {
+			in++;
+
+			guint start = out - text;
+			guint end = g_utf8_next_char(out) - text;
+			g_array_append_val(ranges, start);
+			g_array_append_val(ranges, end);
+		}
+
+		in = g_utf8_next_char(in);
+		out = g_utf8_next_char(out);
+	}
+
+	return ranges;
+}
+
+/* Takes the underlines for the mnemonics out of the attributes,
+   leaving the ones that came with the markup */
+static gboolean
+flyweight_attr_mnemonic (PangoAttribute * attr, gpointer user_data)
+{
+	GArray * ranges = (GArray *)user_data;
+
+	if (attr->klass->type != PANGO_ATTR_UNDERLINE || ((PangoAttrInt *)attr)->value != PANGO_UNDERLINE_LOW) {
+		return FALSE;
+	}
+
+	guint i;
+	for (i = 0; i + 1 < ranges->len; i += 2) {
+		if (attr->start_index == g_array_index(ranges, guint, i) && attr->end_index == g_array_index(ranges, guint, i + 1)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Parses the label like GtkLabel would, returns whether it
+   changed */
+static gboolean
+flyweight_set_markup (Genericmenuitem * item, const gchar * markup, gboolean mnemonic)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	if (priv->markup != NULL && g_strcmp0(priv->markup, markup) == 0) {
+		return FALSE;
+	}
+
+	gchar * parsed = mnemonic ? g_strdup(markup) : sanitize_label(markup);
+	gchar * text = NULL;
+	PangoAttrList * attrs = NULL;
+	gunichar accel_char = 0;
+	GError * error = NULL;
+
+	if (!pango_parse_markup(parsed, -1, mnemonic ? '_' : 0, &attrs, &text, &accel_char, &error)) {
+		g_warning("Unable to parse label '%s': %s", parsed, error->message);
+		g_error_free(error);
+		text = g_strdup(parsed);
+		attrs = pango_attr_list_new();
+		accel_char = 0;
+	}
+
+	g_free(priv->markup);
+	priv->markup = g_strdup(markup);
+	g_free(priv->text);
+	priv->text = text;
+
+	if (priv->attrs != NULL) {
+		pango_attr_list_unref(priv->attrs);
+	}
+	priv->attrs = attrs;
+
+	if (priv->attrs_hidden != NULL) {
+		pango_attr_list_unref(priv->attrs_hidden);
+	}
+	priv->attrs_hidden = pango_attr_list_copy(attrs);
+	gchar * marked = NULL;
+	if (accel_char != 0 && pango_parse_markup(parsed, -1, 0, NULL, &marked, NULL, NULL)) {
+		GArray * ranges = flyweight_mnemonic_ranges(marked, text);
+		PangoAttrList * removed = pango_attr_list_filter(priv->attrs_hidden, flyweight_attr_mnemonic, ranges);
+		if (removed != NULL) {
+			pango_attr_list_unref(removed);
+		}
+		g_array_free(ranges, TRUE);
+		g_free(marked);
+	}
+	g_free(parsed);
+
+	priv->mnemonic = accel_char != 0 ? gdk_keyval_to_lower(gdk_unicode_to_keyval(accel_char)) : 0;
+
+	/* The label widget would have been the name of the accessible,
+	   unless someone else gave it one. */
+	AtkObject * aobj = gtk_widget_get_accessible(GTK_WIDGET(item));
+	if (aobj != NULL) {
+		const gchar * name = atk_object_get_name(aobj);
+		if (name == NULL || name[0] == '\0' || g_strcmp0(name, priv->a11y_name) == 0) {
+			atk_object_set_name(aobj, text);
+		}
+	}
+	g_free(priv->a11y_name);
+	priv->a11y_name = g_strdup(text);
+
+	g_clear_object(&priv->layout);
+	gtk_widget_queue_resize(GTK_WIDGET(item));
+
+	return TRUE;
+}
+
+/* Without a label in the menu shell nobody registers the mnemonic
+   so we watch for it in the shell's keys. */
+static gboolean
+flyweight_key_press (GtkWidget * shell, GdkEventKey * event, gpointer user_data)
+{
+	Genericmenuitem * item = GENERICMENUITEM(user_data);
+	GtkWidget * widget = GTK_WIDGET(item);
+
+	if (item->priv->mnemonic == 0 || gtk_widget_get_parent(widget) != shell) {
+		return FALSE;
+	}
+
+	if (!gtk_widget_get_visible(widget) || !gtk_widget_is_sensitive(widget)) {
+		return FALSE;
+	}
+
+	if ((event->state & gtk_accelerator_get_default_mod_mask() & ~GDK_SHIFT_MASK) != 0) {
+		return FALSE;
+	}
+
+	if (gdk_keyval_to_lower(event->keyval) != item->priv->mnemonic) {
+		return FALSE;
+	}
+
+	return gtk_widget_mnemonic_activate(widget, FALSE);
+}
+
+/* Moves the mnemonic over to @shell, or just drops it with NULL */
+static void
+flyweight_shell_connect (Genericmenuitem * item, GtkWidget * shell)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+
+	if (priv->shell_handler != 0) {
+		GtkWidget * old = gtk_widget_get_parent(GTK_WIDGET(item));
+		if (old != NULL && g_signal_handler_is_connected(old, priv->shell_handler)) {
+			g_signal_handler_disconnect(old, priv->shell_handler);
+		}
+		priv->shell_handler = 0;
+	}
+
+	if (shell != NULL && GTK_IS_MENU_SHELL(shell)) {
+		priv->shell_handler = g_signal_connect_object(G_OBJECT(shell), "key-press-event", G_CALLBACK(flyweight_key_press), item, 0);
+	}
+
+	return;
+}
+
+/* What the arrow for a submenu takes up at the end of the item,
+   which GtkMenuItem only counts when there's a child */
+static gint
+flyweight_arrow_space (Genericmenuitem * item)
+{
+	GtkWidget * widget = GTK_WIDGET(item);
+
+	if (gtk_menu_item_get_submenu(GTK_MENU_ITEM(item)) == NULL || GTK_IS_MENU_BAR(gtk_widget_get_parent(widget))) {
+		return 0;
+	}
+
+	guint arrow_spacing = 0;
+	gfloat arrow_scaling = 0.0;
+	gtk_widget_style_get(widget,
+	                     "arrow-spacing", &arrow_spacing,
+	                     "arrow-scaling", &arrow_scaling,
+	                     NULL);
+
+	gint height = 0;
+	pango_layout_get_pixel_size(flyweight_layout(item, FALSE), NULL, &height);
+
+	return arrow_spacing + (gint)(height * arrow_scaling);
+}
+
+/* The size of the icon, label and accelerator side by side */
+static void
+flyweight_content_size (Genericmenuitem * item, gint * width, gint * height)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+	gint part_width, part_height;
+
+	*width = 0;
+	*height = 0;
+
+	if (priv->image != NULL) {
+		flyweight_icon_size(item, &part_width, &part_height);
+		*width += part_width + get_toggle_space(GTK_WIDGET(item));
+		*height = MAX(*height, part_height);
+	}
+
+	pango_layout_get_pixel_size(flyweight_layout(item, FALSE), &part_width, &part_height);
+	*width += part_width;
+	*height = MAX(*height, part_height);
+
+	PangoLayout * accel = flyweight_accel_layout(item);
+	if (accel != NULL) {
+		pango_layout_get_pixel_size(accel, &part_width, &part_height);
+		*width += FLYWEIGHT_ACCEL_SPACING + part_width;
+		*height = MAX(*height, part_height);
+	}
+
+	*width += flyweight_arrow_space(item);
+
+	return;
+}
+
+/* Draws the contents where GtkMenuItem would put the child */
+static void
+flyweight_draw (Genericmenuitem * item, cairo_t * cr)
+{
+	GenericmenuitemPrivate * priv = item->priv;
+	GtkWidget * widget = GTK_WIDGET(item);
+	GtkStyleContext * context = gtk_widget_get_style_context(widget);
+	gboolean rtl = gtk_widget_get_direction(widget) == GTK_TEXT_DIR_RTL;
+
+	GtkBorder padding;
+	gtk_style_context_get_padding(context, gtk_widget_get_state_flags(widget), &padding);
+	guint border_width = gtk_container_get_border_width(GTK_CONTAINER(widget));
+
+	GtkAllocation allocation;
+	gtk_widget_get_allocation(widget, &allocation);
+
+	gint x = border_width + padding.left;
+	gint y = border_width + padding.top;
+	gint width = allocation.width - border_width * 2 - padding.left - padding.right;
+	gint height = allocation.height - border_width * 2 - padding.top - padding.bottom;
+
+	/* The check goes at the start, the arrow at the end */
+	gint arrow = flyweight_arrow_space(item);
+	width -= priv->toggle_size + arrow;
+	x += rtl ? arrow : priv->toggle_size;
+
+	gint offset = 0;
+	gint part_width, part_height;
+
+	if (priv->image != NULL) {
+		flyweight_icon_size(item, &part_width, &part_height);
+
+		GdkPixbuf * icon = flyweight_icon(item, part_width, part_height);
+		if (icon != NULL) {
+			gint icon_width = gdk_pixbuf_get_width(icon);
+			gint icon_height = gdk_pixbuf_get_height(icon);
+			gint icon_x = (rtl ? x + width - offset - part_width : x + offset) + (part_width - icon_width) / 2;
+
+			gdk_cairo_set_source_pixbuf(cr, icon, icon_x, y + (height - icon_height) / 2);
+			if (gtk_widget_is_sensitive(widget)) {
+				cairo_paint(cr);
+			} else {
+				cairo_paint_with_alpha(cr, 0.5);
+			}
+		}
+
+		offset += part_width + get_toggle_space(widget);
+	}
+
+	PangoLayout * layout = flyweight_layout(item, flyweight_mnemonics_visible(item));
+	pango_layout_get_pixel_size(layout, &part_width, &part_height);
+	gtk_render_layout(context, cr,
+	                  rtl ? x + width - offset - part_width : x + offset,
+	                  y + (height - part_height) / 2,
+	                  layout);
+
+	PangoLayout * accel = flyweight_accel_layout(item);
+	if (accel != NULL) {
+		pango_layout_get_pixel_size(accel, &part_width, &part_height);
+		gtk_render_layout(context, cr,
+		                  rtl ? x : x + width - part_width,
+		                  y + (height - part_height) / 2,
+		                  accel);
+	}
+
+	return;
+}
+
+/* Draws the item, with its contents if it's a flyweight */
+static gboolean
+draw (GtkWidget * widget, cairo_t * cr)
+{
+	gboolean retval = GTK_WIDGET_CLASS(genericmenuitem_parent_class)->draw(widget, cr);
+
+	if (GENERICMENUITEM(widget)->priv->flyweight) {
+		flyweight_draw(GENERICMENUITEM(widget), cr);
+	}
+
+	return retval;
+}
+
+static void
+get_preferred_width (GtkWidget * widget, gint * minimum, gint * natural)
+{
+	GTK_WIDGET_CLASS(genericmenuitem_parent_class)->get_preferred_width(widget, minimum, natural);
+
+	if (GENERICMENUITEM(widget)->priv->flyweight) {
+		gint width, height;
+		flyweight_content_size(GENERICMENUITEM(widget), &width, &height);
+		*minimum += width;
+		*natural += width;
+	}
+
+	return;
+}
+
+static void
+get_preferred_height (GtkWidget * widget, gint * minimum, gint * natural)
+{
+	GTK_WIDGET_CLASS(genericmenuitem_parent_class)->get_preferred_height(widget, minimum, natural);
+
+	if (GENERICMENUITEM(widget)->priv->flyweight) {
+		gint width, height;
+		flyweight_content_size(GENERICMENUITEM(widget), &width, &height);
+		*minimum += height;
+		*natural += height;
+	}
+
+	return;
+}
+
+static void
+get_preferred_height_for_width (GtkWidget * widget, gint for_width, gint * minimum, gint * natural)
+{
+	GTK_WIDGET_CLASS(genericmenuitem_parent_class)->get_preferred_height_for_width(widget, for_width, minimum, natural);
+
+	if (GENERICMENUITEM(widget)->priv->flyweight) {
+		gint width, height;
+		flyweight_content_size(GENERICMENUITEM(widget), &width, &height);
+		*minimum += height;
+		*natural += height;
+	}
+
+	return;
+}
+
+/* The font or the icon theme could have changed */
+static void
+style_updated (GtkWidget * widget)
+{
+	GTK_WIDGET_CLASS(genericmenuitem_parent_class)->style_updated(widget);
+	flyweight_invalidate(GENERICMENUITEM(widget));
+	return;
+}
+
+static void
+direction_changed (GtkWidget * widget, GtkTextDirection previous)
+{
+	GTK_WIDGET_CLASS(genericmenuitem_parent_class)->direction_changed(widget, previous);
+	flyweight_invalidate(GENERICMENUITEM(widget));
+	return;
+}
+
+/* The mnemonic goes with the item to its new menu */
+static void
+parent_set (GtkWidget * widget, GtkWidget * previous)
+{
+	Genericmenuitem * item = GENERICMENUITEM(widget);
+
+	if (item->priv->shell_handler != 0 && previous != NULL) {
+		if (g_signal_handler_is_connected(previous, item->priv->shell_handler)) {
+			g_signal_handler_disconnect(previous, item->priv->shell_handler);
+		}
+		item->priv->shell_handler = 0;
+	}
+
+	if (item->priv->flyweight) {
+		flyweight_shell_connect(item, gtk_widget_get_parent(widget));
+	}
+
+	if (GTK_WIDGET_CLASS(genericmenuitem_parent_class)->parent_set != NULL) {
+		GTK_WIDGET_CLASS(genericmenuitem_parent_class)->parent_set(widget, previous);
+	}
+
+	return;
+}
+
+/* Remembers how much room the menu gave the check, the contents
+   go after it */
+static void
+toggle_size_allocate (GtkMenuItem * menu_item, gint allocation)
+{
+	GENERICMENUITEM(menu_item)->priv->toggle_size = allocation;
+
+	if (parent_toggle_size_allocate != NULL) {
+		parent_toggle_size_allocate(menu_item, allocation);
+	}
+
+	return;
+}
+#endif
+
+#if GTK_CHECK_VERSION(3,8,0)
+/* The accessible for the item is the one GTK gives check menu items,
+   which finds the key bindings in the label widgets.  A flyweight
+   doesn't have those, so it gives them itself. */
+typedef struct _GenericmenuitemAccessible GenericmenuitemAccessible;
+typedef struct _GenericmenuitemAccessibleClass GenericmenuitemAccessibleClass;
+
+struct _GenericmenuitemAccessible {
+	GtkCheckMenuItemAccessible parent;
+};
+
+struct _GenericmenuitemAccessibleClass {
+	GtkCheckMenuItemAccessibleClass parent_class;
+};
+
+static void accessible_action_init (AtkActionIface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (GenericmenuitemAccessible, genericmenuitem_accessible, GTK_TYPE_CHECK_MENU_ITEM_ACCESSIBLE,
+                         G_IMPLEMENT_INTERFACE (ATK_TYPE_ACTION, accessible_action_init));
+
+static AtkActionIface * parent_action_iface = NULL;
+
+static void
+genericmenuitem_accessible_class_init (GenericmenuitemAccessibleClass * klass)
+{
+	return;
+}
+
+static void
+genericmenuitem_accessible_init (GenericmenuitemAccessible * self)
+{
+	return;
+}
+
+/* The mnemonic of the item as the accessible would name it, with
+   the modifier it needs in a menu bar */
+static gchar *
+accessible_mnemonic (Genericmenuitem * item)
+{
+	if (item->priv->mnemonic == 0) {
+		return NULL;
+	}
+
+	GdkModifierType mods = 0;
+	GtkWidget * shell = gtk_widget_get_parent(GTK_WIDGET(item));
+	if (GTK_IS_MENU_BAR(shell)) {
+		GtkWidget * toplevel = gtk_widget_get_toplevel(shell);
+		mods = GTK_IS_WINDOW(toplevel) ? gtk_window_get_mnemonic_modifier(GTK_WINDOW(toplevel)) : GDK_MOD1_MASK;
+	}
+
+	return gtk_accelerator_name(item->priv->mnemonic, mods);
+}
+
+/* The mnemonics from the top menu down to the item, taken from the
+   key binding of the item the menu hangs off */
+static gchar *
+accessible_path (Genericmenuitem * item, const gchar * mnemonic)
+{
+	GtkWidget * shell = gtk_widget_get_parent(GTK_WIDGET(item));
+
+	if (GTK_IS_MENU_BAR(shell)) {
+		return g_strdup(mnemonic);
+	}
+
+	if (!GTK_IS_MENU(shell)) {
+		return NULL;
+	}
+
+	GtkWidget * attach = gtk_menu_get_attach_widget(GTK_MENU(shell));
+	if (!GTK_IS_MENU_ITEM(attach)) {
+		return NULL;
+	}
+
+	AtkObject * aobj = gtk_widget_get_accessible(attach);
+	if (!ATK_IS_ACTION(aobj)) {
+		return NULL;
+	}
+
+	const gchar * binding = atk_action_get_keybinding(ATK_ACTION(aobj), 0);
+	if (binding == NULL) {
+		return NULL;
+	}
+
+	/* Its path if it has one, otherwise its mnemonic */
+	gchar ** parts = g_strsplit(binding, ";", 3);
+	gchar * retval = NULL;
+	if (parts[0] != NULL && parts[1] != NULL && parts[1][0] != '\0') {
+		retval = g_strconcat(parts[1], ":", mnemonic, NULL);
+	} else if (parts[0] != NULL && parts[0][0] != '\0') {
+		retval = g_strconcat(parts[0], ":", mnemonic, NULL);
+	}
+	g_strfreev(parts);
+
+	return retval;
+}
+
+/* Gives the mnemonic, its path and the accelerator in the same
+   form that GTK does for items with labels */
+static const gchar *
+accessible_get_keybinding (AtkAction * action, gint i)
+{
+	GtkWidget * widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(action));
+
+	if (i != 0 || !IS_GENERICMENUITEM(widget) || !GENERICMENUITEM(widget)->priv->flyweight) {
+		return parent_action_iface->get_keybinding(action, i);
+	}
+
+	Genericmenuitem * item = GENERICMENUITEM(widget);
+	gchar * mnemonic = accessible_mnemonic(item);
+	gchar * path = mnemonic != NULL ? accessible_path(item, mnemonic) : NULL;
+	gchar * accel = NULL;
+
+	guint key = 0;
+	GdkModifierType mods = 0;
+	if (flyweight_accel_key(item, &key, &mods)) {
+		accel = gtk_accelerator_name(key, mods);
+	}
+
+	gchar * keybinding = g_strconcat(mnemonic != NULL ? mnemonic : "", ";",
+	                                 path != NULL ? path : "", ";",
+	                                 accel != NULL ? accel : "",
+	                                 NULL);
+
+	g_free(mnemonic);
+	g_free(path);
+	g_free(accel);
+
+	/* Kept until it's asked for again */
+	g_object_set_data_full(G_OBJECT(action), "genericmenuitem-keybinding", keybinding, g_free);
+	return keybinding;
+}
+
+static void
+accessible_action_init (AtkActionIface * iface)
+{
+	parent_action_iface = g_type_interface_peek_parent(iface);
+	iface->get_keybinding = accessible_get_keybinding;
+	return;
+}
+#endif
@@ -118,6 +118,9 @@ GtkWidget *                  genericmenuitem_get_image       (Genericmenuitem *
 void                         genericmenuitem_set_disposition (Genericmenuitem *           item,
                                                               GenericmenuitemDisposition  disposition);
 GenericmenuitemDisposition   genericmenuitem_get_disposition (Genericmenuitem *           item);
+void                         genericmenuitem_set_flyweight   (Genericmenuitem *           item,
+                                                              gboolean                    flyweight);
+gboolean                     genericmenuitem_get_flyweight   (Genericmenuitem *           item);
 
 G_END_DECLS
 
@@ -108,6 +108,18 @@ menu_focus_cb(DbusmenuGtkMenu * menu, gpointer userdata)
 	return;
 }
 
+/* The menu is going up on the screen, if the client's widgets
+   were evicted they need to come back for it. */
+static void
+menu_map_cb (DbusmenuGtkMenu * menu, gpointer userdata)
+{
+	DbusmenuGtkMenuPrivate * priv = DBUSMENU_GTKMENU_GET_PRIVATE(menu);
+	if (priv->client != NULL) {
+		dbusmenu_gtkclient_restore(priv->client);
+	}
+	return;
+}
+
 static void
 dbusmenu_gtkmenu_init (DbusmenuGtkMenu *self)
 {
@@ -121,6 +133,7 @@ dbusmenu_gtkmenu_init (DbusmenuGtkMenu *self)
 	priv->dbus_name = NULL;
 
 	g_signal_connect(G_OBJECT(self), "focus", G_CALLBACK(menu_focus_cb), self);
+	g_signal_connect(G_OBJECT(self), "map", G_CALLBACK(menu_map_cb), self);
 
 	return;
 }
@@ -296,6 +309,36 @@ root_child_delete (DbusmenuMenuitem * root, DbusmenuMenuitem * child, DbusmenuGt
 	return;
 }
 
+/* A child moving between the root and another item keeps its
+   widget, which just needs to come out of or go into the menu. */
+static void
+root_child_reparented (DbusmenuMenuitem * root, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position, DbusmenuGtkMenu * menu)
+{
+	#ifdef MASSIVEDEBUGGING
+	g_debug("Root child reparented");
+	#endif
+
+	if (dbusmenu_menuitem_get_parent(child) != root) {
+		root_child_delete(root, child, menu);
+		return;
+	}
+
+	DbusmenuGtkMenuPrivate * priv = DBUSMENU_GTKMENU_GET_PRIVATE(menu);
+
+	/* Coming up from under an evicted item it doesn't have one */
+	if (dbusmenu_gtkclient_menuitem_get(priv->client, child) == NULL) {
+		dbusmenu_gtkclient_restore(priv->client);
+	}
+
+	GtkWidget * item = GTK_WIDGET(dbusmenu_gtkclient_menuitem_get(priv->client, child));
+	if (item != NULL && gtk_widget_get_parent(item) != NULL) {
+		gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(item)), item);
+	}
+
+	root_child_added(root, child, position, menu);
+	return;
+}
+
 /* Called when the child is realized, and thus has all of its
    properties and GTK-isms.  We can put it in our menu here. */
 static void
@@ -355,6 +398,7 @@ root_changed (DbusmenuGtkClient * client, DbusmenuMenuitem * newroot, DbusmenuGt
 		g_signal_handlers_disconnect_by_func(G_OBJECT(priv->root), root_child_added, menu);
 		g_signal_handlers_disconnect_by_func(G_OBJECT(priv->root), root_child_moved, menu);
 		g_signal_handlers_disconnect_by_func(G_OBJECT(priv->root), root_child_delete, menu);
+		g_signal_handlers_disconnect_by_func(G_OBJECT(priv->root), root_child_reparented, menu);
 
 		dbusmenu_menuitem_foreach(priv->root, popdown_all, client);
 
@@ -373,6 +417,7 @@ root_changed (DbusmenuGtkClient * client, DbusmenuMenuitem * newroot, DbusmenuGt
 	g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED,   G_CALLBACK(root_child_added),  menu);
 	g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_CHILD_MOVED,   G_CALLBACK(root_child_moved),  menu);
 	g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(root_child_delete), menu);
+	g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(root_child_reparented), menu);
 
 	GList * child = NULL;
 	guint count = 0;
@@ -203,6 +203,69 @@ find_closure (GtkAccelKey * key, GClosure * closure, gpointer user_data)
 	return closure == user_data;
 }
 
+/* Each accel group gets a table from closure to key so that we
+   don't have to look through the whole group for every item.  It's
+   built the first time it's needed and then kept up to date as the
+   accelerators in the group change. */
+#define ACCEL_INDEX_KEY  "dbusmenu-gtk-accel-index"
+
+static gboolean
+accel_index_add (GtkAccelKey * key, GClosure * closure, gpointer user_data)
+{
+	GtkAccelKey * copy = g_new(GtkAccelKey, 1);
+	*copy = *key;
+	g_hash_table_insert((GHashTable *)user_data, closure, copy);
+	return FALSE;
+}
+
+/* Called when a closure is connected, disconnected or has its
+   key changed in the group.  By the time we're told about a
+   disconnect the closure no longer points at the group. */
+static void
+accel_index_changed (GtkAccelGroup * group, guint keyval, GdkModifierType modifier, GClosure * closure, gpointer user_data)
+{
+	GHashTable * index = (GHashTable *)user_data;
+
+	if (gtk_accel_group_from_accel_closure(closure) != group) {
+		g_hash_table_remove(index, closure);
+		return;
+	}
+
+	GtkAccelKey * key = (GtkAccelKey *)g_hash_table_lookup(index, closure);
+	if (key == NULL) {
+		key = g_new0(GtkAccelKey, 1);
+		g_hash_table_insert(index, closure, key);
+	}
+
+	key->accel_key = keyval;
+	key->accel_mods = modifier;
+	return;
+}
+
+static GtkAccelKey *
+accel_index_find (GtkAccelGroup * group, GClosure * closure)
+{
+	GHashTable * index = (GHashTable *)g_object_get_data(G_OBJECT(group), ACCEL_INDEX_KEY);
+
+	if (index == NULL) {
+		index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+		gtk_accel_group_find(group, accel_index_add, index);
+		g_object_set_data_full(G_OBJECT(group), ACCEL_INDEX_KEY, index, (GDestroyNotify)g_hash_table_destroy);
+		g_signal_connect(G_OBJECT(group), "accel-changed", G_CALLBACK(accel_index_changed), index);
+	}
+
+	GtkAccelKey * key = (GtkAccelKey *)g_hash_table_lookup(index, closure);
+	if (key == NULL) {
+		/* Might not have heard about it yet */
+		key = gtk_accel_group_find(group, find_closure, closure);
+		if (key != NULL) {
+			accel_index_add(key, closure, index);
+		}
+	}
+
+	return key;
+}
+
 /**
  * dbusmenu_menuitem_property_set_shortcut_menuitem:
  * @menuitem: The #DbusmenuMenuitem to set the shortcut on
@@ -247,7 +310,7 @@ dbusmenu_menuitem_property_set_shortcut_menuitem (DbusmenuMenuitem * menuitem, c
 		return FALSE;
 	}
 
-	GtkAccelKey * key = gtk_accel_group_find(group, find_closure, closure);
+	GtkAccelKey * key = accel_index_find(group, closure);
 	/* Again, not much we can do except complain loudly. */
 	g_return_val_if_fail(key != NULL, FALSE);
 
@@ -74,7 +74,8 @@ typedef struct _RecurseContext
 } RecurseContext;
 
 static void parse_menu_structure_helper (GtkWidget * widget, RecurseContext * recurse);
-static DbusmenuMenuitem * construct_dbusmenu_for_widget (GtkWidget * widget);
+static DbusmenuMenuitem * construct_dbusmenu_for_widget (GtkWidget * widget,
+                                                          DbusmenuMenuitem * mi);
 static void           accel_changed            (GtkWidget *         widget,
                                                 gpointer            data);
 static void           checkbox_toggled         (GtkWidget *         widget,
@@ -393,13 +394,11 @@ get_child_position (GtkWidget * child)
 		return position;
 }
 
-/* Creates a new menu item that is attached to the widget and has
-   the data linkages hooked up.  Also allocates the ParserData */
-static DbusmenuMenuitem *
-new_menuitem (GtkWidget * widget)
+/* Attaches a menu item to the widget and hooks up the data
+   linkages.  Also allocates the ParserData */
+static void
+attach_menuitem (DbusmenuMenuitem * item, GtkWidget * widget)
 {
-	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
-
 	ParserData *pdata = g_new0 (ParserData, 1);
 	g_object_set_data_full(G_OBJECT(item), PARSER_DATA, pdata, (GDestroyNotify)parser_data_free);
 
@@ -407,6 +406,15 @@ new_menuitem (GtkWidget * widget)
 	g_object_add_weak_pointer(G_OBJECT (widget), (gpointer*)&pdata->widget);
 	g_object_set_data_full(G_OBJECT(widget), CACHED_MENUITEM, g_object_ref(item), g_object_unref);
 
+	return;
+}
+
+/* Creates a new menu item that is attached to the widget */
+static DbusmenuMenuitem *
+new_menuitem (GtkWidget * widget)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+	attach_menuitem(item, widget);
 	return item;
 }
 
@@ -519,7 +527,7 @@ parse_menu_structure_helper (GtkWidget * widget, RecurseContext * recurse)
 
 		/* We don't have one, so we'll need to build it */
 		if (thisitem == NULL) {
-			thisitem = construct_dbusmenu_for_widget (widget);
+			thisitem = construct_dbusmenu_for_widget (widget, NULL);
 
 			if (!gtk_widget_get_visible (widget)) {
 				ParserData *pdata = parser_data_get_from_menuitem (thisitem);
@@ -636,15 +644,19 @@ sanitize_label (GtkLabel * label)
 }
 
 /* Turn a widget into a dbusmenu item depending on the type of GTK
-   object that it is. */
+   object that it is.  If @mi is given it's filled in instead of
+   building a new one. */
 static DbusmenuMenuitem *
-construct_dbusmenu_for_widget (GtkWidget * widget)
+construct_dbusmenu_for_widget (GtkWidget * widget, DbusmenuMenuitem * mi)
 {
+  if (mi == NULL)
+    mi = new_menuitem(widget);
+  else
+    attach_menuitem(mi, widget);
+
   /* If it's a standard GTK Menu Item we need to do some of our own work */
   if (GTK_IS_MENU_ITEM (widget))
     {
-      DbusmenuMenuitem *mi = new_menuitem(widget);
-
       ParserData *pdata = (ParserData *)g_object_get_data(G_OBJECT(mi), PARSER_DATA);
 
       gboolean visible = FALSE;
@@ -802,9 +814,9 @@ construct_dbusmenu_for_widget (GtkWidget * widget)
       return mi;
     }
 
-	/* If it's none of those we're going to just create a
+	/* If it's none of those we're going to just leave it as a
 	   generic menuitem as a place holder for it. */
-	return new_menuitem(widget);
+	return mi;
 }
 
 static void
@@ -985,37 +997,102 @@ find_menu_child (GtkWidget *widget, GType child_type)
   return child;
 }
 
+/* Rebuilds the item from its widget when the widget has changed what
+   kind of item it is, like a separator getting a label.  It's done in
+   place so the item keeps its ID, its children and its spot in the
+   menu, the clients only see the properties change. */
 static void
-recreate_menu_item (DbusmenuMenuitem * parent, DbusmenuMenuitem * child)
+recreate_menu_item (DbusmenuMenuitem * child)
 {
-  if (parent == NULL)
+  ParserData * pdata = g_object_get_data (G_OBJECT (child), PARSER_DATA);
+  if (pdata == NULL || pdata->widget == NULL)
     {
-      /* We need a parent */
       return;
     }
-  ParserData * pdata = g_object_get_data (G_OBJECT (child), PARSER_DATA);
-  /* Keep a pointer to the GtkMenuItem, as pdata->widget might be
-   * invalidated when we delete the DbusmenuMenuitem
+
+  /* Keep a pointer to the GtkMenuItem, as pdata->widget will be
+   * invalidated when we drop the ParserData
    */
   GtkWidget * menuitem = pdata->widget;
 
-  dbusmenu_menuitem_child_delete (parent, child);
+  g_object_ref (child);
+
+  /* Drop everything that was hooked up for the old type.  The widget's
+   * hooks are found through the ParserData, so they have to go before it
+   * does.
+   */
+  g_signal_handlers_disconnect_by_func (child, G_CALLBACK (item_activated), menuitem);
+  g_signal_handlers_disconnect_by_func (child, G_CALLBACK (item_about_to_show), menuitem);
+  g_signal_handlers_disconnect_by_func (child, G_CALLBACK (item_handle_event), menuitem);
   disconnect_from_widget (menuitem);
+  g_object_set_data (G_OBJECT (child), PARSER_DATA, NULL);
 
-  RecurseContext recurse = {0};
-  recurse.toplevel = gtk_widget_get_toplevel(menuitem);
-  recurse.parent = parent;
+  /* Build the properties for the new type without anyone listening,
+   * and then only tell them about the ones that are different.
+   */
+  GHashTable * before = dbusmenu_menuitem_properties_copy (child);
+  guint changed_signal = g_signal_lookup (DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, DBUSMENU_TYPE_MENUITEM);
+  g_signal_handlers_block_matched (child, G_SIGNAL_MATCH_ID, changed_signal, 0, NULL, NULL, NULL);
+
+  /* The children are staying so leave how they're shown alone */
+  GList * properties = dbusmenu_menuitem_properties_list (child);
+  GList * iter;
+  for (iter = properties; iter != NULL; iter = g_list_next (iter))
+    {
+      iter->data = g_strdup (iter->data);
+    }
+  for (iter = properties; iter != NULL; iter = g_list_next (iter))
+    {
+      if (g_strcmp0 (iter->data, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY) != 0)
+        dbusmenu_menuitem_property_remove (child, iter->data);
+    }
+  g_list_free_full (properties, g_free);
 
-  parse_menu_structure_helper(menuitem, &recurse);
+  construct_dbusmenu_for_widget (menuitem, child);
+
+  g_signal_handlers_unblock_matched (child, G_SIGNAL_MATCH_ID, changed_signal, 0, NULL, NULL, NULL);
+
+  GHashTable * after = dbusmenu_menuitem_properties_copy (child);
+  GHashTableIter hiter;
+  gpointer name, value;
+
+  g_hash_table_iter_init (&hiter, after);
+  while (g_hash_table_iter_next (&hiter, &name, &value))
+    {
+      GVariant * was = g_hash_table_lookup (before, name);
+      if (was == NULL || !g_variant_equal (was, value))
+        g_signal_emit (child, changed_signal, 0, name, value);
+    }
+
+  /* Gone ones are signalled with their default, like a removal */
+  g_hash_table_iter_init (&hiter, before);
+  while (g_hash_table_iter_next (&hiter, &name, &value))
+    {
+      if (!g_hash_table_contains (after, name))
+        g_signal_emit (child, changed_signal, 0, name, dbusmenu_menuitem_property_get_variant (child, name));
+    }
+
+  g_hash_table_destroy (after);
+  g_hash_table_destroy (before);
+
+  if (!gtk_widget_get_visible (menuitem))
+    {
+      pdata = parser_data_get_from_menuitem (child);
+      pdata->widget_visible_handler_id = g_signal_connect (G_OBJECT (menuitem),
+                                                           "notify::visible",
+                                                           G_CALLBACK (menuitem_notify_cb),
+                                                           gtk_widget_get_toplevel (menuitem));
+    }
+
+  g_object_unref (child);
 }
 
 static gboolean
 recreate_menu_item_in_idle_cb (gpointer data)
 {
   DbusmenuMenuitem * child = (DbusmenuMenuitem *)data;
-  DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent (child);
+  recreate_menu_item (child);
   g_object_unref (child);
-  recreate_menu_item (parent, child);
   return FALSE;
 }
 
@@ -1045,9 +1122,8 @@ label_notify_cb (GtkWidget  *widget,
       if (GTK_WIDGET (g_value_get_object (&prop_value)) == NULL)
         {
           /* This label is being removed from its GtkMenuItem. The
-           * menuitem becomes a separator now. As the client doesn't handle
-           * changing types so well, we remove the current DbusmenuMenuitem
-           * and add a new one.
+           * menuitem becomes a separator now, so we rebuild the
+           * DbusmenuMenuitem in place as one.
            *
            * Note, we have to defer this to idle, as we are called before
            * bin->child member of our old parent is invalidated. If we go ahead
@@ -1228,11 +1304,8 @@ handle_first_label (DbusmenuMenuitem *mi)
       /* GtkMenuItem's can start life as a separator if they have no child
        * GtkLabel. In this case, we need to convert the DbusmenuMenuitem from
        * a separator to a normal menuitem if the application adds a label.
-       * As changing types isn't handled too well by the client, we delete
-       * this menuitem for now and then recreate it
        */
-      DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent (mi);
-      recreate_menu_item (parent, mi);
+      recreate_menu_item (mi);
       return TRUE;
     }
 
@@ -0,0 +1,245 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* When the server says an about to show needs a new layout, the
+   client holds the callback until that layout is in, so whoever
+   is showing the submenu sees what the server put in it.  Our
+   server never says so itself, the answers get rewritten on the
+   way out to ask for it. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static DbusmenuClient * client = NULL;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+/* The filter runs on the bus thread */
+G_LOCK_DEFINE_STATIC(rewrite);
+static guint32 rewrite_serial = 0;
+static GVariant * rewrite_body = NULL;
+
+/* Remembers the about to show calls on the way in and answers
+   them with an update being needed on the way out */
+static GDBusMessage *
+rewrite_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming) {
+		if (g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+			return message;
+		}
+
+		const gchar * member = g_dbus_message_get_member(message);
+		GVariant * body = NULL;
+
+		if (g_strcmp0(member, "AboutToShow") == 0) {
+			body = g_variant_new("(b)", TRUE);
+		} else if (g_strcmp0(member, "AboutToShowGroup") == 0) {
+			GVariant * ids = g_variant_get_child_value(g_dbus_message_get_body(message), 0);
+			body = g_variant_new("(@ai@ai)", ids, g_variant_new_array(G_VARIANT_TYPE_INT32, NULL, 0));
+			g_variant_unref(ids);
+		} else {
+			return message;
+		}
+
+		G_LOCK(rewrite);
+		if (rewrite_body != NULL) {
+			g_variant_unref(rewrite_body);
+		}
+		rewrite_body = g_variant_ref_sink(body);
+		rewrite_serial = g_dbus_message_get_serial(message);
+		G_UNLOCK(rewrite);
+
+		return message;
+	}
+
+	if (g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+		return message;
+	}
+
+	G_LOCK(rewrite);
+	if (rewrite_body != NULL && g_dbus_message_get_reply_serial(message) == rewrite_serial) {
+		GDBusMessage * copy = g_dbus_message_copy(message, NULL);
+		if (copy != NULL) {
+			g_dbus_message_set_body(copy, rewrite_body);
+			g_object_unref(message);
+			message = copy;
+		}
+		g_variant_unref(rewrite_body);
+		rewrite_body = NULL;
+	}
+	G_UNLOCK(rewrite);
+
+	return message;
+}
+
+/* Adds a child to the folder every time it's about to be shown */
+static gint next_id = 11;
+
+static gboolean
+folder_about_to_show (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(next_id++);
+	dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Added");
+	dbusmenu_menuitem_child_append(mi, child);
+	g_object_unref(child);
+	return TRUE;
+}
+
+static gboolean
+client_has (gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	return root != NULL && dbusmenu_menuitem_find_id(root, id) != NULL;
+}
+
+/* What the client had when each callback came */
+static gint callbacks = 0;
+static gboolean had_first = FALSE;
+static gboolean had_second = FALSE;
+
+static void
+shown_cb (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	gint wanted = GPOINTER_TO_INT(user_data);
+
+	if (wanted == 11) {
+		had_first = client_has(11);
+	} else {
+		had_second = client_has(12);
+	}
+
+	callbacks++;
+	g_object_unref(mi);
+	return;
+}
+
+static gint wanted_callbacks = 0;
+
+static gboolean
+poll_done (gpointer user_data)
+{
+	if (wanted_callbacks == 0) {
+		if (!client_has(10)) {
+			return TRUE;
+		}
+	} else if (callbacks < wanted_callbacks) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return TRUE;
+}
+
+static void
+wait_callbacks (gint wanted, const gchar * what)
+{
+	if (!passed) {
+		return;
+	}
+
+	wanted_callbacks = wanted;
+	guint poll = g_timeout_add(5, poll_done, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		g_warning("Timed out: %s", what);
+		passed = FALSE;
+	}
+	g_source_remove(poll);
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	g_dbus_connection_add_filter(server_bus, rewrite_filter, NULL, NULL);
+
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	DbusmenuMenuitem * folder = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(10);
+	dbusmenu_menuitem_child_append(folder, child);
+	dbusmenu_menuitem_child_append(root, folder);
+	g_signal_connect(G_OBJECT(folder), DBUSMENU_MENUITEM_SIGNAL_ABOUT_TO_SHOW, G_CALLBACK(folder_about_to_show), NULL);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	dbusmenu_server_set_root(server, root);
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+
+	wait_callbacks(0, "first layout");
+
+	/* The callback comes after the layout with the new child */
+	if (passed) {
+		DbusmenuMenuitem * cfolder = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 1);
+		dbusmenu_menuitem_send_about_to_show(g_object_ref(cfolder), shown_cb, GINT_TO_POINTER(11));
+	}
+	wait_callbacks(1, "first about to show");
+	if (passed) {
+		check(had_first, "first child there for the callback");
+	}
+
+	/* And again, now that the client has a layout to build on */
+	if (passed) {
+		DbusmenuMenuitem * cfolder = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 1);
+		dbusmenu_menuitem_send_about_to_show(g_object_ref(cfolder), shown_cb, GINT_TO_POINTER(12));
+	}
+	wait_callbacks(2, "second about to show");
+	if (passed) {
+		check(had_second, "second child there for the callback");
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(child));
+	g_object_unref(G_OBJECT(folder));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
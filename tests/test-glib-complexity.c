@@ -0,0 +1,319 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runs the operations that walk the list of children at a few
+   sizes and measures what they cost.  Appending and
+   reordering one child can be linear in the number of children,
+   and a client following a menu where one item moved can be
+   linear in the size of the menu, but none of them should grow
+   like the square of it. */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+/* How many times a single operation is done for one measurement */
+#define REPEAT        100
+/* Measurements at each size, the cheapest one is used */
+#define RUNS          5
+/* The same when it's timed, which is noisier */
+#define RUNS_TIMED    25
+/* What doubling the size can do to how much the cost grows.  It's
+   2 for linear, a bit over for n·log n and 4 for quadratic. */
+#define GROWTH_LIMIT  3.0
+/* Growth smaller than this part of the cost is noise */
+#define NOISE         0.05
+
+static const guint sizes[] = { 1000, 2000, 4000 };
+
+typedef guint64 (*cost_func) (guint size);
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static gint counter = -1;
+static guint runs = RUNS;
+
+static GDBusConnection * server_bus = NULL;
+static GDBusConnection * client_bus = NULL;
+
+/* Counts the instructions on this thread if the kernel will do it
+   for us.  Otherwise the CPU time of this thread is used, which is
+   noisier, so it takes the cheapest of more runs.  The test is only
+   skipped when there's neither. */
+static gboolean
+counter_open (void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	counter = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+	if (counter >= 0) {
+		return TRUE;
+	}
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec res;
+	if (clock_getres(CLOCK_THREAD_CPUTIME_ID, &res) == 0) {
+		g_debug("No instruction counter, timing instead");
+		runs = RUNS_TIMED;
+		return TRUE;
+	}
+#endif
+
+	return FALSE;
+}
+
+static guint64
+counter_read (void)
+{
+	guint64 count = 0;
+
+	if (counter < 0) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+		struct timespec now;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+			return (guint64)now.tv_sec * G_GUINT64_CONSTANT(1000000000) + now.tv_nsec;
+		}
+#endif
+		g_warning("Unable to read the CPU time");
+		passed = FALSE;
+		return count;
+	}
+
+	if (read(counter, &count, sizeof(count)) != sizeof(count)) {
+		g_warning("Unable to read the instruction counter");
+		passed = FALSE;
+	}
+
+	return count;
+}
+
+/* Runs @func at each of the sizes and checks how the cost grows
+   each time the size doubles */
+static void
+check_growth (const gchar * name, cost_func func)
+{
+	guint64 cost[G_N_ELEMENTS(sizes)];
+	guint i, run;
+
+	for (i = 0; i < G_N_ELEMENTS(sizes) && passed; i++) {
+		cost[i] = G_MAXUINT64;
+		for (run = 0; run < runs && passed; run++) {
+			cost[i] = MIN(cost[i], func(sizes[i]));
+		}
+		g_debug("%s at %d: %" G_GUINT64_FORMAT, name, sizes[i], cost[i]);
+	}
+
+	if (!passed) {
+		return;
+	}
+
+	for (i = 2; i < G_N_ELEMENTS(sizes); i++) {
+		gdouble before = MAX((gdouble)cost[i - 1] - (gdouble)cost[i - 2], (gdouble)cost[i - 2] * NOISE);
+		gdouble after = (gdouble)cost[i] - (gdouble)cost[i - 1];
+
+		if (after > before * GROWTH_LIMIT) {
+			g_warning("%s grew %f times as much going from %d to %d as from %d to %d",
+			          name, after / before, sizes[i - 1], sizes[i], sizes[i - 2], sizes[i - 1]);
+			passed = FALSE;
+		}
+	}
+
+	return;
+}
+
+static DbusmenuMenuitem *
+parent_new (guint size)
+{
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_new_with_id(1);
+	guint i;
+
+	for (i = 0; i < size; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(i + 100);
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Child");
+		dbusmenu_menuitem_child_append(parent, child);
+		g_object_unref(child);
+	}
+
+	return parent;
+}
+
+/* Appends a child to a long list of them and takes it back off */
+static guint64
+cost_append (guint size)
+{
+	DbusmenuMenuitem * parent = parent_new(size);
+	DbusmenuMenuitem * extra = dbusmenu_menuitem_new_with_id(2);
+	guint i;
+
+	guint64 start = counter_read();
+	for (i = 0; i < REPEAT; i++) {
+		dbusmenu_menuitem_child_append(parent, extra);
+		dbusmenu_menuitem_child_delete(parent, extra);
+	}
+	guint64 cost = counter_read() - start;
+
+	g_object_unref(extra);
+	g_object_unref(parent);
+
+	return cost;
+}
+
+/* Moves the last child to the front and back again */
+static guint64
+cost_reorder (guint size)
+{
+	DbusmenuMenuitem * parent = parent_new(size);
+	DbusmenuMenuitem * last = DBUSMENU_MENUITEM(g_list_last(dbusmenu_menuitem_get_children(parent))->data);
+	guint i;
+
+	guint64 start = counter_read();
+	for (i = 0; i < REPEAT; i++) {
+		dbusmenu_menuitem_child_reorder(parent, last, 0);
+		dbusmenu_menuitem_child_reorder(parent, last, size - 1);
+	}
+	guint64 cost = counter_read() - start;
+
+	g_object_unref(parent);
+
+	return cost;
+}
+
+static void
+layout_updated (DbusmenuClient * client, gpointer user_data)
+{
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+static void
+wait_layout (void)
+{
+	if (!loopback_run(mainloop, 30)) {
+		passed = FALSE;
+	}
+	return;
+}
+
+/* Moves the last item of a menu to the front and waits for a
+   client to catch up with it.  That's all of the client's layout
+   reconciliation, with the server's side of it along for the ride. */
+static guint64
+cost_reconcile (guint size)
+{
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	guint64 cost = 0;
+	guint i;
+
+	for (i = 0; i < size; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(i + 100);
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Child");
+		dbusmenu_menuitem_child_append(root, child);
+		g_object_unref(child);
+	}
+
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuClient * client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
+	wait_layout();
+
+	if (passed) {
+		DbusmenuMenuitem * last = DBUSMENU_MENUITEM(g_list_last(dbusmenu_menuitem_get_children(root))->data);
+
+		guint64 start = counter_read();
+		dbusmenu_menuitem_child_reorder(root, last, 0);
+		wait_layout();
+		cost = counter_read() - start;
+	}
+
+	if (passed) {
+		GList * children = dbusmenu_menuitem_get_children(dbusmenu_client_get_root(client));
+		if (g_list_length(children) != size || dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(children->data)) != (gint)size + 99) {
+			g_warning("Client didn't follow the move at %d", size);
+			passed = FALSE;
+		}
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+
+	return cost;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	if (!counter_open()) {
+		g_debug("No way to measure the cost, skipping");
+		g_object_unref(G_OBJECT(client_bus));
+		g_object_unref(G_OBJECT(server_bus));
+		return 77;
+	}
+
+	check_growth("Append", cost_append);
+	check_growth("Reorder", cost_reorder);
+	check_growth("Reconcile", cost_reconcile);
+
+	if (counter >= 0) {
+		close(counter);
+	}
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
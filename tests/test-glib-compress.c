@@ -0,0 +1,252 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builds two big menus with an icon on every item, one with icons
+   that compress like raw pixels and one with icons that don't, like
+   PNGs.  Starts a client on each with and without compression and
+   prints the bytes that came over the bus against the CPU time it
+   took to get the whole menu.  The compressed pixels should be a lot
+   smaller and the PNGs shouldn't get much bigger. */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+#define TOP_ITEMS    10
+#define SUB_ITEMS    50
+#define ICON_SIZE    4096
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static DbusmenuClient * client = NULL;
+static gint bytes = 0;
+
+/* Counts everything that comes back to the client */
+static GDBusMessage *
+count_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming) {
+		GVariant * body = g_dbus_message_get_body(message);
+		if (body != NULL) {
+			g_atomic_int_add(&bytes, g_variant_get_size(body));
+		}
+	}
+
+	return message;
+}
+
+static gboolean
+has_icon (DbusmenuMenuitem * root, gint id, const guchar * icon)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return FALSE;
+	}
+
+	GVariant * value = dbusmenu_menuitem_property_get_variant(mi, DBUSMENU_MENUITEM_PROP_ICON_DATA);
+	if (value == NULL) {
+		return FALSE;
+	}
+
+	gsize length = 0;
+	gconstpointer data = g_variant_get_fixed_array(value, &length, sizeof(guchar));
+	return length == ICON_SIZE && memcmp(data, icon, ICON_SIZE) == 0;
+}
+
+/* Polls until every icon is there */
+static gboolean
+complete (gpointer user_data)
+{
+	const guchar * icon = (const guchar *)user_data;
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	if (root == NULL) {
+		return TRUE;
+	}
+
+	gint i, j;
+	for (i = 1; i <= TOP_ITEMS; i++) {
+		if (!has_icon(root, i, icon)) {
+			return TRUE;
+		}
+		for (j = 1; j <= SUB_ITEMS; j++) {
+			if (!has_icon(root, i * 100 + j, icon)) {
+				return TRUE;
+			}
+		}
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static gdouble
+cpu_time (void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+/* Starts a client on @object and waits for all of the icons,
+   returns how many bytes it took */
+static gint
+cold_start (GDBusConnection * client_bus, const gchar * object, const guchar * icon, gboolean compression)
+{
+	g_atomic_int_set(&bytes, 0);
+	gdouble cpu = cpu_time();
+	GTimer * timer = g_timer_new();
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, object);
+	const gchar * none[] = { NULL };
+	g_object_set(G_OBJECT(client),
+	             DBUSMENU_CLIENT_PROP_HEAVY_PROPERTIES, none,
+	             DBUSMENU_CLIENT_PROP_COMPRESSION, compression,
+	             NULL);
+
+	guint poll = g_timeout_add(1, complete, (gpointer)icon);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	gint total = g_atomic_int_get(&bytes);
+	g_debug("%s, %s: %d bytes in %f ms, %f ms of CPU",
+	        object, compression ? "compressed" : "plain",
+	        total, g_timer_elapsed(timer, NULL) * 1000.0, (cpu_time() - cpu) * 1000.0);
+
+	g_timer_destroy(timer);
+	g_object_unref(G_OBJECT(client));
+	client = NULL;
+
+	return total;
+}
+
+static DbusmenuMenuitem *
+menu_new (const guchar * icon)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	gint i, j;
+	for (i = 1; i <= TOP_ITEMS; i++) {
+		DbusmenuMenuitem * top = dbusmenu_menuitem_new_with_id(i);
+		dbusmenu_menuitem_property_set(top, DBUSMENU_MENUITEM_PROP_LABEL, "Top");
+		dbusmenu_menuitem_property_set_byte_array(top, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, ICON_SIZE);
+		dbusmenu_menuitem_child_append(root, top);
+
+		for (j = 1; j <= SUB_ITEMS; j++) {
+			DbusmenuMenuitem * sub = dbusmenu_menuitem_new_with_id(i * 100 + j);
+			dbusmenu_menuitem_property_set(sub, DBUSMENU_MENUITEM_PROP_LABEL, "Sub");
+			dbusmenu_menuitem_property_set_byte_array(sub, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, ICON_SIZE);
+			dbusmenu_menuitem_child_append(top, sub);
+			g_object_unref(sub);
+		}
+
+		g_object_unref(top);
+	}
+
+	return root;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	g_dbus_connection_add_filter(client_bus, count_filter, NULL, NULL);
+
+	/* Rows of a gradient, like pixels */
+	guchar pixels[ICON_SIZE];
+	gint i;
+	for (i = 0; i < ICON_SIZE; i++) {
+		pixels[i] = (i % 64) * 4;
+	}
+
+	/* Noise, like something that's already compressed */
+	guchar noise[ICON_SIZE];
+	GRand * rand = g_rand_new_with_seed(42);
+	for (i = 0; i < ICON_SIZE; i++) {
+		noise[i] = g_rand_int_range(rand, 0, 256);
+	}
+	g_rand_free(rand);
+
+	DbusmenuServer * pixels_server = dbusmenu_server_new_for_connection(server_bus, "/org/test/pixels");
+	DbusmenuMenuitem * pixels_root = menu_new(pixels);
+	dbusmenu_server_set_root(pixels_server, pixels_root);
+
+	DbusmenuServer * noise_server = dbusmenu_server_new_for_connection(server_bus, "/org/test/noise");
+	DbusmenuMenuitem * noise_root = menu_new(noise);
+	dbusmenu_server_set_root(noise_server, noise_root);
+
+	gint pixels_plain = cold_start(client_bus, "/org/test/pixels", pixels, FALSE);
+	gint pixels_compressed = 0;
+	if (passed) {
+		pixels_compressed = cold_start(client_bus, "/org/test/pixels", pixels, TRUE);
+	}
+
+	if (passed && pixels_compressed * 2 > pixels_plain) {
+		g_warning("Compressing pixels saved less than half, %d bytes from %d", pixels_compressed, pixels_plain);
+		passed = FALSE;
+	}
+
+	gint noise_plain = 0;
+	gint noise_compressed = 0;
+	if (passed) {
+		noise_plain = cold_start(client_bus, "/org/test/noise", noise, FALSE);
+	}
+	if (passed) {
+		noise_compressed = cold_start(client_bus, "/org/test/noise", noise, TRUE);
+	}
+
+	if (passed && noise_compressed > noise_plain + noise_plain / 20) {
+		g_warning("Compressing noise made it grow, %d bytes from %d", noise_compressed, noise_plain);
+		passed = FALSE;
+	}
+
+	g_object_unref(G_OBJECT(pixels_server));
+	g_object_unref(G_OBJECT(pixels_root));
+	g_object_unref(G_OBJECT(noise_server));
+	g_object_unref(G_OBJECT(noise_root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,258 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builds a menu with an icon on every item and starts a client on it
+   twice, once getting everything up front and once leaving the icons
+   in the submenus until they're about to be shown.  Prints how long it
+   took and how many bytes it took for the top level to be ready and
+   for the whole menu to be.  Then opens a submenu to make sure its
+   icons show up. */
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+#define TOP_ITEMS    10
+#define SUB_ITEMS    20
+#define ICON_SIZE    4096
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static DbusmenuClient * client = NULL;
+static GTimer * timer = NULL;
+static gint bytes = 0;
+
+static gdouble paint_time = -1.0;
+static gint paint_bytes = 0;
+static gdouble complete_time = -1.0;
+static gint complete_bytes = 0;
+
+/* Counts everything that comes back to the client */
+static GDBusMessage *
+count_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming) {
+		GVariant * body = g_dbus_message_get_body(message);
+		if (body != NULL) {
+			g_atomic_int_add(&bytes, g_variant_get_size(body));
+		}
+	}
+
+	return message;
+}
+
+static gboolean
+has_label (DbusmenuMenuitem * root, gint id)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	return mi != NULL && dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_LABEL);
+}
+
+static gboolean
+has_icon (DbusmenuMenuitem * root, gint id)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	return mi != NULL && dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_ICON_DATA);
+}
+
+/* Polls until the top level can be drawn and then until the
+   whole menu is there */
+static gboolean
+startup (gpointer user_data)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	if (root == NULL) {
+		return TRUE;
+	}
+
+	gint i, j;
+	for (i = 1; i <= TOP_ITEMS; i++) {
+		if (!has_label(root, i) || !has_icon(root, i)) {
+			return TRUE;
+		}
+	}
+
+	if (paint_time < 0.0) {
+		paint_time = g_timer_elapsed(timer, NULL);
+		paint_bytes = g_atomic_int_get(&bytes);
+	}
+
+	for (i = 1; i <= TOP_ITEMS; i++) {
+		for (j = 1; j <= SUB_ITEMS; j++) {
+			if (!has_label(root, i * 100 + j)) {
+				return TRUE;
+			}
+		}
+	}
+
+	complete_time = g_timer_elapsed(timer, NULL);
+	complete_bytes = g_atomic_int_get(&bytes);
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Waits for the icons in the first submenu */
+static gboolean
+submenu_icons (gpointer user_data)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	gint j;
+
+	for (j = 1; j <= SUB_ITEMS; j++) {
+		if (!has_icon(root, 100 + j)) {
+			return TRUE;
+		}
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Starts a client and waits for the whole menu to show up in it */
+static void
+cold_start (GDBusConnection * client_bus, gboolean defer)
+{
+	g_atomic_int_set(&bytes, 0);
+	paint_time = -1.0;
+	complete_time = -1.0;
+
+	g_timer_start(timer);
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+	if (!defer) {
+		const gchar * none[] = { NULL };
+		g_object_set(G_OBJECT(client), DBUSMENU_CLIENT_PROP_HEAVY_PROPERTIES, none, NULL);
+	}
+
+	g_timeout_add(1, startup, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+
+	g_debug("%s: top level in %f ms and %d bytes, everything in %f ms and %d bytes",
+	        defer ? "Deferred" : "Up front",
+	        paint_time * 1000.0, paint_bytes, complete_time * 1000.0, complete_bytes);
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	g_dbus_connection_add_filter(client_bus, count_filter, NULL, NULL);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	guchar icon[ICON_SIZE];
+	memset(icon, 0x55, ICON_SIZE);
+
+	gint i, j;
+	for (i = 1; i <= TOP_ITEMS; i++) {
+		DbusmenuMenuitem * top = dbusmenu_menuitem_new_with_id(i);
+		dbusmenu_menuitem_property_set(top, DBUSMENU_MENUITEM_PROP_LABEL, "Top");
+		dbusmenu_menuitem_property_set_byte_array(top, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, ICON_SIZE);
+		dbusmenu_menuitem_child_append(root, top);
+
+		for (j = 1; j <= SUB_ITEMS; j++) {
+			DbusmenuMenuitem * sub = dbusmenu_menuitem_new_with_id(i * 100 + j);
+			dbusmenu_menuitem_property_set(sub, DBUSMENU_MENUITEM_PROP_LABEL, "Sub");
+			dbusmenu_menuitem_property_set_byte_array(sub, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, ICON_SIZE);
+			dbusmenu_menuitem_child_append(top, sub);
+			g_object_unref(sub);
+		}
+
+		g_object_unref(top);
+	}
+
+	dbusmenu_server_set_root(server, root);
+
+	cold_start(client_bus, FALSE);
+	gint up_front_bytes = complete_bytes;
+	if (passed && !has_icon(dbusmenu_client_get_root(client), 101)) {
+		g_warning("Icons in a submenu weren't fetched up front");
+		passed = FALSE;
+	}
+	g_object_unref(G_OBJECT(client));
+	client = NULL;
+
+	if (passed) {
+		cold_start(client_bus, TRUE);
+	}
+
+	if (passed && has_icon(dbusmenu_client_get_root(client), 101)) {
+		g_warning("Icons in a submenu were fetched before it was shown");
+		passed = FALSE;
+	}
+
+	if (passed && complete_bytes >= up_front_bytes) {
+		g_warning("Deferring the icons didn't save any bytes");
+		passed = FALSE;
+	}
+
+	if (passed) {
+		g_atomic_int_set(&bytes, 0);
+		g_timer_start(timer);
+
+		DbusmenuMenuitem * first = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 1);
+		dbusmenu_menuitem_send_about_to_show(first, NULL, NULL);
+
+		g_timeout_add(1, submenu_icons, NULL);
+		if (!loopback_run(mainloop, 10)) {
+			passed = FALSE;
+		} else {
+			g_debug("Submenu icons in %f ms and %d bytes", g_timer_elapsed(timer, NULL) * 1000.0, g_atomic_int_get(&bytes));
+		}
+	}
+
+	if (client != NULL) {
+		g_object_unref(G_OBJECT(client));
+	}
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+	g_timer_destroy(timer);
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
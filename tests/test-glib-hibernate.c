@@ -0,0 +1,362 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Puts a server into hibernation and makes sure that the replies
+   it sends are the same as before, that the application's items and
+   handlers keep working after an event from a client wakes it up,
+   and that changes to the items while it's hibernating get out.
+   Then lets the server have the only reference to the menu, which
+   it should let go of and rebuild the same. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static DbusmenuMenuitem * resumed_root = NULL;
+static guint resumed = 0;
+static guint label_updates = 0;
+static gboolean clicked = FALSE;
+
+/* Makes a call and waits for the reply */
+static GVariant *
+call (GDBusConnection * bus, const gchar * method, GVariant * params, const gchar * type)
+{
+	GVariant * reply = loopback_call(mainloop, bus, method, params, type);
+	if (reply == NULL) {
+		passed = FALSE;
+	}
+
+	return reply;
+}
+
+static GVariant *
+get_layout (GDBusConnection * bus)
+{
+	const gchar * props[] = { NULL };
+	return call(bus, "GetLayout", g_variant_new("(ii^as)", 0, -1, props), "(u(ia{sv}av))");
+}
+
+static GVariant *
+get_group_properties (GDBusConnection * bus)
+{
+	const gint32 ids[] = { 1, 2, 21 };
+	const gchar * props[] = { NULL };
+	GVariant * idlist = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, ids, G_N_ELEMENTS(ids), sizeof(gint32));
+	return call(bus, "GetGroupProperties", g_variant_new("(@ai^as)", idlist, props), "(a(ia{sv}))");
+}
+
+static guint
+layout_revision (GDBusConnection * bus)
+{
+	guint revision = 0;
+	GVariant * layout = get_layout(bus);
+	if (layout != NULL) {
+		g_variant_get_child(layout, 0, "u", &revision);
+		g_variant_unref(layout);
+	}
+
+	return revision;
+}
+
+/* The label the clients get for the item, or NULL */
+static gchar *
+get_label (GDBusConnection * bus, gint id)
+{
+	gchar * label = NULL;
+	GVariant * reply = call(bus, "GetProperty", g_variant_new("(is)", id, DBUSMENU_MENUITEM_PROP_LABEL), "(v)");
+	if (reply != NULL) {
+		GVariant * value = g_variant_get_child_value(reply, 0);
+		GVariant * inner = g_variant_get_variant(value);
+		label = g_variant_dup_string(inner, NULL);
+		g_variant_unref(inner);
+		g_variant_unref(value);
+		g_variant_unref(reply);
+	}
+
+	return label;
+}
+
+static void
+check_label (GDBusConnection * bus, gint id, const gchar * expected, const gchar * what)
+{
+	gchar * label = get_label(bus, id);
+	if (g_strcmp0(label, expected) != 0) {
+		g_warning("%s: label is '%s' instead of '%s'", what, label, expected);
+		passed = FALSE;
+	}
+	g_free(label);
+	return;
+}
+
+static void
+hibernate (DbusmenuServer * server)
+{
+	if (!dbusmenu_server_hibernate(server)) {
+		g_warning("Unable to hibernate the server");
+		passed = FALSE;
+	}
+	return;
+}
+
+static void
+compare (GVariant * before, GVariant * after, const gchar * what)
+{
+	if (before == NULL || after == NULL || !g_variant_equal(before, after)) {
+		g_warning("%s changed after hibernating", what);
+		passed = FALSE;
+	}
+
+	if (after != NULL) {
+		g_variant_unref(after);
+	}
+
+	return;
+}
+
+static void
+item_clicked (DbusmenuMenuitem * mi, guint timestamp, gpointer user_data)
+{
+	clicked = TRUE;
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+static void
+server_resumed (DbusmenuServer * server, DbusmenuMenuitem * root, gpointer user_data)
+{
+	resumed_root = root;
+	resumed++;
+	return;
+}
+
+/* What the server sends out about the labels */
+static void
+property_updated (DbusmenuServer * server, gint id, const gchar * property, GVariant * value, gpointer user_data)
+{
+	if (g_strcmp0(property, DBUSMENU_MENUITEM_PROP_LABEL) == 0) {
+		label_updates++;
+	}
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	g_signal_connect(G_OBJECT(server), DBUSMENU_SERVER_SIGNAL_RESUMED, G_CALLBACK(server_resumed), NULL);
+	g_signal_connect(G_OBJECT(server), DBUSMENU_SERVER_SIGNAL_ID_PROP_UPDATE, G_CALLBACK(property_updated), NULL);
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * one = dbusmenu_menuitem_new_with_id(1);
+	dbusmenu_menuitem_property_set(one, DBUSMENU_MENUITEM_PROP_LABEL, "One");
+	g_signal_connect(G_OBJECT(one), DBUSMENU_MENUITEM_SIGNAL_ITEM_ACTIVATED, G_CALLBACK(item_clicked), NULL);
+	dbusmenu_menuitem_child_append(root, one);
+	g_object_unref(one);
+
+	DbusmenuMenuitem * two = dbusmenu_menuitem_new_with_id(2);
+	dbusmenu_menuitem_property_set(two, DBUSMENU_MENUITEM_PROP_LABEL, "Two");
+	dbusmenu_menuitem_child_append(root, two);
+	g_object_unref(two);
+
+	DbusmenuMenuitem * sub = dbusmenu_menuitem_new_with_id(21);
+	dbusmenu_menuitem_property_set(sub, DBUSMENU_MENUITEM_PROP_LABEL, "Two One");
+	dbusmenu_menuitem_property_set_bool(sub, DBUSMENU_MENUITEM_PROP_ENABLED, FALSE);
+	dbusmenu_menuitem_child_append(two, sub);
+	g_object_unref(sub);
+
+	dbusmenu_server_set_root(server, root);
+
+	GVariant * layout = get_layout(client_bus);
+	GVariant * group = get_group_properties(client_bus);
+
+	hibernate(server);
+
+	compare(layout, get_layout(client_bus), "Layout");
+	compare(group, get_group_properties(client_bus), "Properties");
+
+	/* Neither the replies nor looking at the root wake it up */
+	DbusmenuMenuitem * got_root = NULL;
+	g_object_get(G_OBJECT(server), DBUSMENU_SERVER_PROP_ROOT_NODE, &got_root, NULL);
+	if (got_root != root) {
+		g_warning("Root changed while hibernating");
+		passed = FALSE;
+	}
+	if (got_root != NULL) {
+		g_object_unref(got_root);
+	}
+
+	/* Searches are answered from the items, with the IDs and the
+	   revision the clients have */
+	const gchar * requirements[] = { NULL };
+	GVariant * found = call(client_bus, "Search", g_variant_new("(s^as)", "two one", requirements), "(ua(ias))");
+	if (found != NULL) {
+		guint searched = 0;
+		GVariant * results = NULL;
+		g_variant_get(found, "(u@a(ias))", &searched, &results);
+
+		gint id = 0;
+		if (g_variant_n_children(results) == 1) {
+			g_variant_get_child(results, 0, "(i@as)", &id, NULL);
+		}
+		if (id != 21) {
+			g_warning("Search while hibernating didn't find the item");
+			passed = FALSE;
+		}
+		if (searched != layout_revision(client_bus)) {
+			g_warning("Search while hibernating had revision %u", searched);
+			passed = FALSE;
+		}
+
+		g_variant_unref(results);
+		g_variant_unref(found);
+	}
+
+	if (resumed != 0) {
+		g_warning("Resumed to answer the common requests");
+		passed = FALSE;
+	}
+
+	/* Clicking on an item needs it back, it gets to the
+	   application's own handler */
+	GVariant * reply = call(client_bus, "Event", g_variant_new("(isvu)", 1, DBUSMENU_MENUITEM_EVENT_ACTIVATED, g_variant_new_int32(0), 0), "()");
+	if (reply != NULL) {
+		g_variant_unref(reply);
+	}
+
+	if (passed && !clicked && !loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+
+	if (resumed != 1 || resumed_root != root || !clicked) {
+		g_warning("The event didn't get to the application's item");
+		passed = FALSE;
+	}
+
+	compare(layout, get_layout(client_bus), "Layout");
+	compare(group, get_group_properties(client_bus), "Properties");
+
+	if (dbusmenu_server_resume(server) != root || resumed != 1) {
+		g_warning("Resuming again did something");
+		passed = FALSE;
+	}
+
+	/* Changing an item wakes it up and the change gets out */
+	hibernate(server);
+	label_updates = 0;
+	dbusmenu_menuitem_property_set(two, DBUSMENU_MENUITEM_PROP_LABEL, "Second");
+	if (resumed != 2) {
+		g_warning("Changing a property didn't resume");
+		passed = FALSE;
+	}
+	if (label_updates != 1) {
+		g_warning("The changed label wasn't sent");
+		passed = FALSE;
+	}
+	check_label(client_bus, 2, "Second", "Changed while hibernating");
+
+	/* So do new items, along with a new layout */
+	guint revision = layout_revision(client_bus);
+	hibernate(server);
+	DbusmenuMenuitem * added = dbusmenu_menuitem_new_with_id(22);
+	dbusmenu_menuitem_property_set(added, DBUSMENU_MENUITEM_PROP_LABEL, "Two Two");
+	dbusmenu_menuitem_child_append(two, added);
+	g_object_unref(added);
+	if (resumed != 3) {
+		g_warning("Adding an item didn't resume");
+		passed = FALSE;
+	}
+	if (layout_revision(client_bus) <= revision) {
+		g_warning("Adding an item didn't change the layout");
+		passed = FALSE;
+	}
+	check_label(client_bus, 22, "Two Two", "Added while hibernating");
+
+	/* When only the server has the menu it's let go of, and
+	   rebuilt the way the clients know it */
+	GVariant * before = get_layout(client_bus);
+	hibernate(server);
+	DbusmenuMenuitem * gone = root;
+	g_object_add_weak_pointer(G_OBJECT(gone), (gpointer *)&gone);
+	g_object_unref(G_OBJECT(root));
+	root = NULL;
+	if (gone != NULL) {
+		g_warning("The menu wasn't let go of while hibernating");
+		passed = FALSE;
+		g_object_remove_weak_pointer(G_OBJECT(gone), (gpointer *)&gone);
+	}
+	compare(before, get_layout(client_bus), "Layout without the items");
+
+	DbusmenuMenuitem * rebuilt = dbusmenu_server_resume(server);
+	if (rebuilt == NULL || resumed != 4 || resumed_root != rebuilt) {
+		g_warning("The menu wasn't rebuilt");
+		passed = FALSE;
+	}
+	compare(before, get_layout(client_bus), "Rebuilt layout");
+	g_variant_unref(before);
+
+	/* And the clients hear about changes to the new items */
+	DbusmenuMenuitem * rebuilt_two = rebuilt == NULL ? NULL : dbusmenu_menuitem_find_id(rebuilt, 2);
+	if (rebuilt_two != NULL) {
+		label_updates = 0;
+		dbusmenu_menuitem_property_set(rebuilt_two, DBUSMENU_MENUITEM_PROP_LABEL, "Rebuilt");
+		if (label_updates != 1) {
+			g_warning("The rebuilt item's label wasn't sent");
+			passed = FALSE;
+		}
+		check_label(client_bus, 2, "Rebuilt", "Changed after rebuilding");
+	} else {
+		g_warning("The rebuilt menu doesn't have the item");
+		passed = FALSE;
+	}
+
+	if (layout != NULL) {
+		g_variant_unref(layout);
+	}
+	if (group != NULL) {
+		g_variant_unref(group);
+	}
+
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
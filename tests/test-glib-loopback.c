@@ -0,0 +1,373 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runs the layout test with the server and the client in the same
+   process, talking over a socket pair instead of a bus daemon.  Takes
+   an optional number of passes over the layouts so that it can be
+   used as a benchmark, or run under callgrind to cover both sides.
+   Finishes with a few changes to the last layout that the client
+   catches up on from the server's journal, only asking about the
+   properties of the new items, and then with more of them than the
+   journal holds so that it has to start over. */
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-glib-layout.h"
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static DbusmenuServer * server = NULL;
+static gboolean passed = TRUE;
+static guint layouton = 0;
+static guint passes = 1;
+static guint pass = 0;
+static GTimer * timer = NULL;
+static gdouble total = 0.0;
+static DbusmenuMenuitem * root = NULL;
+static guint change = 0;
+
+/* How many calls of each the client has made */
+static gint changes_calls = 0;
+static gint layout_calls = 0;
+static gint layout_calls_before = 0;
+
+/* Properties asked for of items from the layouts, once the
+   client has started catching up on the changes at the end */
+static gint changing = 0;
+static gint catching_up = 0;
+static gint old_fetches = 0;
+
+/* More than the server's journal holds */
+#define MANY_ITEMS  300
+
+static DbusmenuMenuitem *
+layout2menuitem (layout_t * layout)
+{
+	if (layout == NULL || layout->id == 0) return NULL;
+
+	DbusmenuMenuitem * local = dbusmenu_menuitem_new_with_id(layout->id);
+
+	if (layout->submenu != NULL) {
+		guint count;
+		for (count = 0; layout->submenu[count].id != -1; count++) {
+			DbusmenuMenuitem * child = layout2menuitem(&layout->submenu[count]);
+			if (child != NULL) {
+				dbusmenu_menuitem_child_append(local, child);
+			}
+		}
+	}
+
+	return local;
+}
+
+static gboolean
+verify_root_to_layout (DbusmenuMenuitem * mi, layout_t * layout)
+{
+	if (layout->id != dbusmenu_menuitem_get_id(mi)) {
+		if (!(dbusmenu_menuitem_get_root(mi) && dbusmenu_menuitem_get_id(mi) == 0)) {
+			return FALSE;
+		}
+	}
+
+	GList * children = dbusmenu_menuitem_get_children(mi);
+
+	if (children == NULL && layout->submenu == NULL) {
+		return TRUE;
+	}
+	if (children == NULL || layout->submenu == NULL) {
+		return FALSE;
+	}
+
+	guint i = 0;
+	for (i = 0; children != NULL && layout->submenu[i].id != -1; children = g_list_next(children), i++) {
+		if (!verify_root_to_layout(DBUSMENU_MENUITEM(children->data), &layout->submenu[i])) {
+			return FALSE;
+		}
+	}
+
+	return children == NULL && layout->submenu[i].id == -1;
+}
+
+/* Checks the client's copy against the server's items */
+static gboolean
+verify_mirror (DbusmenuMenuitem * serveritem, DbusmenuMenuitem * clientitem)
+{
+	if (!dbusmenu_menuitem_get_root(clientitem) && dbusmenu_menuitem_get_id(serveritem) != dbusmenu_menuitem_get_id(clientitem)) {
+		return FALSE;
+	}
+
+	if (g_strcmp0(dbusmenu_menuitem_property_get(serveritem, DBUSMENU_MENUITEM_PROP_LABEL),
+	              dbusmenu_menuitem_property_get(clientitem, DBUSMENU_MENUITEM_PROP_LABEL)) != 0) {
+		return FALSE;
+	}
+
+	GList * serverchildren = dbusmenu_menuitem_get_children(serveritem);
+	GList * clientchildren = dbusmenu_menuitem_get_children(clientitem);
+
+	while (serverchildren != NULL && clientchildren != NULL) {
+		if (!verify_mirror(DBUSMENU_MENUITEM(serverchildren->data), DBUSMENU_MENUITEM(clientchildren->data))) {
+			return FALSE;
+		}
+
+		serverchildren = g_list_next(serverchildren);
+		clientchildren = g_list_next(clientchildren);
+	}
+
+	return serverchildren == NULL && clientchildren == NULL;
+}
+
+/* Put the next layout on the server and start the clock */
+static void
+next_layout (void)
+{
+	if (root != NULL) {
+		g_object_unref(root);
+	}
+	root = layout2menuitem(&layouts[layouton]);
+
+	g_timer_start(timer);
+	dbusmenu_server_set_root(server, root);
+
+	return;
+}
+
+/* Counts the calls the client makes, looking inside of the
+   compressed ones */
+static GDBusMessage *
+call_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming || g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+		return message;
+	}
+
+	const gchar * method = g_dbus_message_get_member(message);
+	GVariant * body = g_dbus_message_get_body(message);
+	if (g_strcmp0(method, "GetCompressed") == 0 && body != NULL) {
+		g_variant_get_child(body, 0, "&s", &method);
+	}
+
+	if (g_strcmp0(method, "GetChangesSince") == 0) {
+		g_atomic_int_inc(&changes_calls);
+		if (g_atomic_int_get(&changing)) {
+			g_atomic_int_set(&catching_up, 1);
+		}
+	} else if (g_strcmp0(method, "GetLayout") == 0) {
+		g_atomic_int_inc(&layout_calls);
+	} else if (g_strcmp0(method, "GetGroupProperties") == 0 && g_atomic_int_get(&catching_up)) {
+		if (g_strcmp0(g_dbus_message_get_member(message), "GetCompressed") == 0) {
+			g_variant_get_child(body, 1, "v", &body);
+		} else {
+			g_variant_ref(body);
+		}
+
+		GVariant * ids = g_variant_get_child_value(body, 0);
+		gsize count, i;
+		const gint32 * idarray = g_variant_get_fixed_array(ids, &count, sizeof(gint32));
+		for (i = 0; i < count; i++) {
+			/* The new items all have IDs past the layouts' */
+			if (idarray[i] < 100) {
+				g_atomic_int_inc(&old_fetches);
+			}
+		}
+		g_variant_unref(ids);
+		g_variant_unref(body);
+	}
+
+	return message;
+}
+
+/* Change parts of the last layout, returns FALSE when there
+   are no more changes to make */
+static gboolean
+next_change (void)
+{
+	DbusmenuMenuitem * mi = NULL;
+
+	g_timer_start(timer);
+
+	switch (change) {
+	case 0:
+		mi = dbusmenu_menuitem_new_with_id(100);
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, "Deep");
+		dbusmenu_menuitem_child_append(dbusmenu_menuitem_find_id(root, 4), mi);
+		g_object_unref(mi);
+
+		dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(root, 2), DBUSMENU_MENUITEM_PROP_LABEL, "Changed");
+		return TRUE;
+	case 1:
+		mi = dbusmenu_menuitem_new_with_id(101);
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, "Top");
+		dbusmenu_menuitem_child_prepend(root, mi);
+		g_object_unref(mi);
+
+		mi = dbusmenu_menuitem_find_id(root, 100);
+		dbusmenu_menuitem_child_delete(dbusmenu_menuitem_get_parent(mi), mi);
+		return TRUE;
+	case 2: {
+		gint i;
+		for (i = 0; i < MANY_ITEMS; i++) {
+			mi = dbusmenu_menuitem_new_with_id(200 + i);
+			dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, "Many");
+			dbusmenu_menuitem_child_append(root, mi);
+			g_object_unref(mi);
+		}
+		return TRUE;
+	}
+	case 3: {
+		/* Each of these is an entry in the journal, so the client's
+		   revision falls out of it */
+		gint i;
+		for (i = 0; i < MANY_ITEMS; i++) {
+			mi = dbusmenu_menuitem_find_id(root, 200 + i);
+			dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, "Many Again");
+		}
+
+		mi = dbusmenu_menuitem_new_with_id(102);
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, "Last");
+		dbusmenu_menuitem_child_append(root, mi);
+		g_object_unref(mi);
+		return TRUE;
+	}
+	default:
+		return FALSE;
+	}
+}
+
+static void
+layout_updated (DbusmenuClient * client, gpointer data)
+{
+	DbusmenuMenuitem * menuroot = dbusmenu_client_get_root(client);
+	if (menuroot == NULL) {
+		return;
+	}
+
+	if (pass == passes) {
+		if (!verify_mirror(root, menuroot)) {
+			return;
+		}
+
+		g_debug("Change %d synced in %f ms", change, g_timer_elapsed(timer, NULL) * 1000.0);
+
+		if (change == 2) {
+			/* Everything so far fits in the journal */
+			if (g_atomic_int_get(&changes_calls) == 0 || g_atomic_int_get(&layout_calls) != layout_calls_before) {
+				g_warning("Client didn't catch up from the journal: %d catch ups, %d layouts",
+				          g_atomic_int_get(&changes_calls), g_atomic_int_get(&layout_calls) - layout_calls_before);
+				passed = FALSE;
+			}
+			if (g_atomic_int_get(&old_fetches) != 0) {
+				g_warning("Client asked for the properties of %d items it already had", g_atomic_int_get(&old_fetches));
+				passed = FALSE;
+			}
+		} else if (change == 3) {
+			if (g_atomic_int_get(&layout_calls) == layout_calls_before) {
+				g_warning("Client didn't get the whole layout when it was too far behind");
+				passed = FALSE;
+			}
+		}
+
+		change++;
+		if (!next_change()) {
+			g_main_loop_quit(mainloop);
+		}
+		return;
+	}
+
+	/* The client may still be catching up with an older root,
+	   only a match counts. */
+	if (!verify_root_to_layout(menuroot, &layouts[layouton])) {
+		return;
+	}
+
+	gdouble elapsed = g_timer_elapsed(timer, NULL);
+	total += elapsed;
+	g_debug("Layout %d synced in %f ms", layouton, elapsed * 1000.0);
+
+	layouton++;
+	if (layouts[layouton].id == -1) {
+		layouton = 0;
+		pass++;
+	}
+
+	if (pass == passes) {
+		layout_calls_before = g_atomic_int_get(&layout_calls);
+		g_atomic_int_set(&changing, 1);
+		next_change();
+		return;
+	}
+
+	next_layout();
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	if (argc > 1) {
+		passes = MAX(atoi(argv[1]), 1);
+	}
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	timer = g_timer_new();
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	g_dbus_connection_add_filter(client_bus, call_filter, NULL, NULL);
+
+	DbusmenuClient * client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
+
+	next_layout();
+
+	if (!loopback_run(mainloop, 10 * passes)) {
+		g_debug("Got to: %d", layouton);
+		passed = FALSE;
+	}
+
+	g_debug("%d passes in %f ms", passes, total * 1000.0);
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+	g_timer_destroy(timer);
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,213 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Follows a small menu with a mirror, walking through it and
+   querying it, then changes a label and adds an item on the
+   server to make sure the mirror keeps up. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/mirror.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static gboolean layout_changed = FALSE;
+static gboolean properties_changed = FALSE;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static void
+mirror_layout_changed (DbusmenuMirror * mirror, gpointer user_data)
+{
+	layout_changed = TRUE;
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+static void
+mirror_properties_changed (DbusmenuMirror * mirror, GVariant * ids, gpointer user_data)
+{
+	gsize i;
+	for (i = 0; i < g_variant_n_children(ids); i++) {
+		gint id;
+		g_variant_get_child(ids, i, "i", &id);
+		if (id == 3) {
+			properties_changed = TRUE;
+			g_main_loop_quit(mainloop);
+		}
+	}
+	return;
+}
+
+/* Walks through the items and writes their IDs in a string */
+static gchar *
+walk (DbusmenuMirror * mirror, gint id, gboolean recurse)
+{
+	DbusmenuMirrorIter iter;
+	GString * ids = g_string_new(NULL);
+	gint child;
+
+	dbusmenu_mirror_iter_init(&iter, mirror, id, recurse);
+	while (dbusmenu_mirror_iter_next(&iter, &child, NULL)) {
+		g_string_append_printf(ids, "%s%d", ids->len == 0 ? "" : " ", child);
+	}
+
+	return g_string_free(ids, FALSE);
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * one = item_new(1, "One");
+	dbusmenu_menuitem_property_set(one, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE, DBUSMENU_MENUITEM_TOGGLE_CHECK);
+	dbusmenu_menuitem_child_append(root, one);
+	g_object_unref(one);
+
+	DbusmenuMenuitem * two = item_new(2, "Two");
+	dbusmenu_menuitem_child_append(root, two);
+	g_object_unref(two);
+
+	DbusmenuMenuitem * sub = item_new(21, "Two One");
+	dbusmenu_menuitem_child_append(two, sub);
+	g_object_unref(sub);
+	sub = item_new(22, "Two Two");
+	dbusmenu_menuitem_child_append(two, sub);
+	g_object_unref(sub);
+
+	DbusmenuMenuitem * three = item_new(3, "Three");
+	dbusmenu_menuitem_child_append(root, three);
+	g_object_unref(three);
+
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuMirror * mirror = dbusmenu_mirror_new_for_connection(client_bus, NULL, "/org/test");
+	g_signal_connect(G_OBJECT(mirror), DBUSMENU_MIRROR_SIGNAL_LAYOUT_CHANGED, G_CALLBACK(mirror_layout_changed), NULL);
+	g_signal_connect(G_OBJECT(mirror), DBUSMENU_MIRROR_SIGNAL_PROPERTIES_CHANGED, G_CALLBACK(mirror_properties_changed), NULL);
+
+	/* The first layout */
+	while (passed && !layout_changed) {
+		passed = loopback_run(mainloop, 10);
+	}
+
+	if (passed) {
+		check(dbusmenu_mirror_get_n_items(mirror) == 6, "six items");
+		check(dbusmenu_mirror_get_parent(mirror, 21) == 2, "parent of a submenu item");
+		check(dbusmenu_mirror_get_parent(mirror, 0) == -1, "parent of the root");
+
+		gchar * ids = walk(mirror, 0, FALSE);
+		check(g_strcmp0(ids, "1 2 3") == 0, "children of the root");
+		g_free(ids);
+
+		ids = walk(mirror, 0, TRUE);
+		check(g_strcmp0(ids, "1 2 21 22 3") == 0, "the whole tree");
+		g_free(ids);
+
+		ids = walk(mirror, 2, FALSE);
+		check(g_strcmp0(ids, "21 22") == 0, "children of a submenu");
+		g_free(ids);
+
+		GVariant * label = g_variant_new_string("Two");
+		GArray * found = dbusmenu_mirror_query(mirror, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		check(found->len == 1 && g_array_index(found, gint, 0) == 2, "query for a label");
+		g_array_free(found, TRUE);
+		g_variant_unref(g_variant_ref_sink(label));
+
+		found = dbusmenu_mirror_query(mirror, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE, NULL);
+		check(found->len == 1 && g_array_index(found, gint, 0) == 1, "query for a property");
+		g_array_free(found, TRUE);
+
+		/* Change a label */
+		dbusmenu_menuitem_property_set(three, DBUSMENU_MENUITEM_PROP_LABEL, "Three Again");
+	}
+
+	while (passed && !properties_changed) {
+		passed = loopback_run(mainloop, 10);
+	}
+
+	if (passed) {
+		GVariant * label = dbusmenu_mirror_get_property(mirror, 3, DBUSMENU_MENUITEM_PROP_LABEL);
+		check(label != NULL && g_strcmp0(g_variant_get_string(label, NULL), "Three Again") == 0, "changed label");
+		if (label != NULL) {
+			g_variant_unref(label);
+		}
+
+		/* Add an item */
+		layout_changed = FALSE;
+		DbusmenuMenuitem * four = item_new(4, "Four");
+		dbusmenu_menuitem_child_append(root, four);
+		g_object_unref(four);
+	}
+
+	while (passed && !layout_changed) {
+		passed = loopback_run(mainloop, 10);
+	}
+
+	if (passed) {
+		check(dbusmenu_mirror_get_n_items(mirror) == 7, "added item");
+		check(dbusmenu_mirror_has_item(mirror, 4), "has the added item");
+	}
+
+	g_object_unref(G_OBJECT(mirror));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
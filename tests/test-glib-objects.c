@@ -23,6 +23,7 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <glib-object.h>
 
 #include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-glib/menuitem-private.h>
 
 /* Building the basic menu item, make sure we didn't break
    any core GObject stuff */
@@ -305,6 +306,328 @@ test_object_menuitem_props_removal (void)
 	return;
 }
 
+/* Check that a radio group selection is one property on the parent */
+static void
+test_object_menuitem_toggle_group (void)
+{
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * first = dbusmenu_menuitem_new_with_id(2);
+	DbusmenuMenuitem * second = dbusmenu_menuitem_new_with_id(3);
+	DbusmenuMenuitem * other = dbusmenu_menuitem_new_with_id(4);
+
+	dbusmenu_menuitem_child_append(parent, first);
+	dbusmenu_menuitem_child_append(parent, second);
+	dbusmenu_menuitem_child_append(parent, other);
+
+	dbusmenu_menuitem_property_set(first, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP, "zoom");
+	dbusmenu_menuitem_property_set(second, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP, "zoom");
+	dbusmenu_menuitem_property_set(other, DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP, "size");
+
+	/* Nothing selected yet */
+	g_assert(dbusmenu_menuitem_toggle_group_get_selected(parent, "zoom") == -1);
+
+	g_assert(dbusmenu_menuitem_toggle_group_select(first));
+	g_assert(dbusmenu_menuitem_toggle_group_select(other));
+	g_assert(dbusmenu_menuitem_toggle_group_get_selected(parent, "zoom") == 2);
+	g_assert(dbusmenu_menuitem_toggle_group_get_selected(parent, "size") == 4);
+
+	/* Moving the selection leaves the other group alone */
+	g_assert(dbusmenu_menuitem_toggle_group_select(second));
+	g_assert(dbusmenu_menuitem_toggle_group_get_selected(parent, "zoom") == 3);
+	g_assert(dbusmenu_menuitem_toggle_group_get_selected(parent, "size") == 4);
+
+	/* The members themselves don't change */
+	g_assert(!dbusmenu_menuitem_property_exist(first, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE));
+	g_assert(!dbusmenu_menuitem_property_exist(second, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE));
+
+	/* Items without a group or a parent can't be selected */
+	g_assert(!dbusmenu_menuitem_toggle_group_select(parent));
+
+	g_object_unref(first);
+	g_object_unref(second);
+	g_object_unref(other);
+	g_object_unref(parent);
+
+	return;
+}
+
+/* Records the order that the traversal visits items in */
+static gboolean
+test_object_menuitem_traverse_helper (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	GString * order = (GString *)user_data;
+	g_string_append_printf(order, "%d ", dbusmenu_menuitem_get_id(mi));
+	return dbusmenu_menuitem_get_id(mi) == 5;
+}
+
+/* Check the traversal orders, the depth limit and stopping */
+static void
+test_object_menuitem_traverse (void)
+{
+	/*    1
+	     / \
+	    2   5
+	   / \   \
+	  3   4   6   */
+	DbusmenuMenuitem * items[7];
+	gint i;
+	for (i = 1; i < 7; i++) {
+		items[i] = dbusmenu_menuitem_new_with_id(i);
+	}
+	dbusmenu_menuitem_child_append(items[1], items[2]);
+	dbusmenu_menuitem_child_append(items[2], items[3]);
+	dbusmenu_menuitem_child_append(items[2], items[4]);
+	dbusmenu_menuitem_child_append(items[1], items[5]);
+	dbusmenu_menuitem_child_append(items[5], items[6]);
+
+	GString * order = g_string_new("");
+
+	g_assert(dbusmenu_menuitem_traverse(items[1], G_PRE_ORDER, -1, test_object_menuitem_traverse_helper, order) == items[5]);
+	g_assert_cmpstr(order->str, ==, "1 2 3 4 5 ");
+
+	g_string_truncate(order, 0);
+	g_assert(dbusmenu_menuitem_traverse(items[1], G_POST_ORDER, -1, test_object_menuitem_traverse_helper, order) == items[5]);
+	g_assert_cmpstr(order->str, ==, "3 4 2 6 5 ");
+
+	g_string_truncate(order, 0);
+	g_assert(dbusmenu_menuitem_traverse(items[2], G_PRE_ORDER, -1, test_object_menuitem_traverse_helper, order) == NULL);
+	g_assert_cmpstr(order->str, ==, "2 3 4 ");
+
+	g_string_truncate(order, 0);
+	g_assert(dbusmenu_menuitem_traverse(items[1], G_POST_ORDER, 2, test_object_menuitem_traverse_helper, order) == items[5]);
+	g_assert_cmpstr(order->str, ==, "2 5 ");
+
+	g_string_free(order, TRUE);
+
+	g_assert(dbusmenu_menuitem_find_id(items[1], 6) == items[6]);
+	g_assert(dbusmenu_menuitem_find_id(items[1], 7) == NULL);
+
+	for (i = 1; i < 7; i++) {
+		g_object_unref(items[i]);
+	}
+
+	return;
+}
+
+/* A chain deeper than the traversal keeps track of */
+static void
+test_object_menuitem_traverse_deep (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * parent = root;
+	gint i;
+
+	for (i = 2; i <= 1000; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(i);
+		dbusmenu_menuitem_child_append(parent, child);
+		g_object_unref(child);
+		parent = child;
+	}
+
+	/* A sibling at the bottom so we climb out from under the stack */
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(1001);
+	dbusmenu_menuitem_child_append(dbusmenu_menuitem_get_parent(parent), child);
+	g_object_unref(child);
+
+	g_assert(dbusmenu_menuitem_find_id(root, 1000) == parent);
+	g_assert(dbusmenu_menuitem_find_id(root, 1001) == child);
+	g_assert(dbusmenu_menuitem_find_id(root, 1002) == NULL);
+
+	g_object_unref(root);
+
+	return;
+}
+
+/* Takes each item out of its parent as it's visited */
+static void
+test_object_menuitem_foreach_helper (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	GString * order = (GString *)user_data;
+	g_string_append_printf(order, "%d ", dbusmenu_menuitem_get_id(mi));
+
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent(mi);
+	if (parent != NULL) {
+		dbusmenu_menuitem_child_delete(parent, mi);
+	}
+
+	return;
+}
+
+/* Foreach has to keep going when the items change under it */
+static void
+test_object_menuitem_foreach_changes (void)
+{
+	DbusmenuMenuitem * items[7];
+	gint i;
+	for (i = 1; i < 7; i++) {
+		items[i] = dbusmenu_menuitem_new_with_id(i);
+	}
+	dbusmenu_menuitem_child_append(items[1], items[2]);
+	dbusmenu_menuitem_child_append(items[2], items[3]);
+	dbusmenu_menuitem_child_append(items[2], items[4]);
+	dbusmenu_menuitem_child_append(items[1], items[5]);
+	dbusmenu_menuitem_child_append(items[5], items[6]);
+
+	GString * order = g_string_new("");
+	dbusmenu_menuitem_foreach(items[1], test_object_menuitem_foreach_helper, order);
+	g_assert_cmpstr(order->str, ==, "1 2 3 4 5 6 ");
+	g_assert(dbusmenu_menuitem_get_children(items[1]) == NULL);
+	g_string_free(order, TRUE);
+
+	for (i = 1; i < 7; i++) {
+		g_object_unref(items[i]);
+	}
+
+	return;
+}
+
+/* Looks at the first child in a layout, giving its ID and how
+   many children it was sent with */
+static gsize
+test_object_menuitem_first_child (GVariant * layout, gint * id)
+{
+	GVariant * children = g_variant_get_child_value(layout, 2);
+	GVariant * boxed = g_variant_get_child_value(children, 0);
+	GVariant * stub = g_variant_get_variant(boxed);
+	GVariant * stub_children = g_variant_get_child_value(stub, 2);
+	gsize count = g_variant_n_children(stub_children);
+
+	if (id != NULL) {
+		GVariant * stub_id = g_variant_get_child_value(stub, 0);
+		*id = g_variant_get_int32(stub_id);
+		g_variant_unref(stub_id);
+	}
+
+	g_variant_unref(stub_children);
+	g_variant_unref(stub);
+	g_variant_unref(boxed);
+	g_variant_unref(children);
+
+	return count;
+}
+
+/* Hidden items are sent without their children */
+static void
+test_object_menuitem_build_pruned (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * hidden = dbusmenu_menuitem_new_with_id(2);
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(3);
+	GVariant * layout;
+	GVariant * children;
+	gint id = 0;
+
+	dbusmenu_menuitem_child_append(root, hidden);
+	dbusmenu_menuitem_child_append(hidden, child);
+	dbusmenu_menuitem_property_set_bool(hidden, DBUSMENU_MENUITEM_PROP_VISIBLE, FALSE);
+
+	layout = g_variant_ref_sink(dbusmenu_menuitem_build_variant(root, NULL, -1));
+	g_assert_cmpint(test_object_menuitem_first_child(layout, NULL), ==, 1);
+	g_variant_unref(layout);
+
+	layout = g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(root, NULL, -1, TRUE, NULL));
+	children = g_variant_get_child_value(layout, 2);
+	g_assert_cmpint(g_variant_n_children(children), ==, 1);
+	g_variant_unref(children);
+	g_assert_cmpint(test_object_menuitem_first_child(layout, &id), ==, 0);
+	g_assert_cmpint(id, ==, 2);
+	g_variant_unref(layout);
+
+	/* Showing it brings them back */
+	dbusmenu_menuitem_property_set_bool(hidden, DBUSMENU_MENUITEM_PROP_VISIBLE, TRUE);
+	layout = g_variant_ref_sink(dbusmenu_menuitem_build_variant_ids(root, NULL, -1, TRUE, NULL));
+	g_assert_cmpint(test_object_menuitem_first_child(layout, NULL), ==, 1);
+	g_variant_unref(layout);
+
+	g_object_unref(child);
+	g_object_unref(hidden);
+	g_object_unref(root);
+
+	return;
+}
+
+/* Leaving out properties with a '-' list */
+static void
+test_object_menuitem_props_excluded (void)
+{
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+	const guchar icon[] = { 1, 2, 3, 4 };
+	const gchar * excluded[] = { "-" DBUSMENU_MENUITEM_PROP_ICON_DATA, NULL };
+	GVariant * props;
+
+	dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Heavy");
+	dbusmenu_menuitem_property_set_byte_array(item, DBUSMENU_MENUITEM_PROP_ICON_DATA, icon, sizeof(icon));
+
+	props = g_variant_ref_sink(dbusmenu_menuitem_properties_variant(item, NULL));
+	g_assert_cmpint(g_variant_n_children(props), ==, 2);
+	g_variant_unref(props);
+
+	props = g_variant_ref_sink(dbusmenu_menuitem_properties_variant(item, excluded));
+	g_assert_cmpint(g_variant_n_children(props), ==, 1);
+	g_assert(g_variant_lookup(props, DBUSMENU_MENUITEM_PROP_LABEL, "&s", NULL));
+	g_assert(!g_variant_lookup(props, DBUSMENU_MENUITEM_PROP_ICON_DATA, "ay", NULL));
+	g_variant_unref(props);
+
+	g_object_unref(item);
+
+	return;
+}
+
+/* Counts the signals about children */
+static void
+test_object_menuitem_reparent_count (gint * count)
+{
+	(*count)++;
+	return;
+}
+
+/* Moving a child with children of its own to another parent */
+static void
+test_object_menuitem_reparent (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * from = dbusmenu_menuitem_new_with_id(2);
+	DbusmenuMenuitem * to = dbusmenu_menuitem_new_with_id(3);
+	DbusmenuMenuitem * moving = dbusmenu_menuitem_new_with_id(4);
+	DbusmenuMenuitem * below = dbusmenu_menuitem_new_with_id(5);
+	gint reparented = 0;
+	gint churn = 0;
+
+	dbusmenu_menuitem_child_append(root, from);
+	dbusmenu_menuitem_child_append(root, to);
+	dbusmenu_menuitem_child_append(from, moving);
+	dbusmenu_menuitem_child_append(moving, below);
+
+	g_signal_connect_swapped(G_OBJECT(from), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(test_object_menuitem_reparent_count), &reparented);
+	g_signal_connect_swapped(G_OBJECT(to), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(test_object_menuitem_reparent_count), &reparented);
+	g_signal_connect_swapped(G_OBJECT(from), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(test_object_menuitem_reparent_count), &churn);
+	g_signal_connect_swapped(G_OBJECT(to), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(test_object_menuitem_reparent_count), &churn);
+	g_signal_connect_swapped(G_OBJECT(moving), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(test_object_menuitem_reparent_count), &churn);
+	g_signal_connect_swapped(G_OBJECT(moving), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(test_object_menuitem_reparent_count), &churn);
+
+	g_assert(dbusmenu_menuitem_child_reparent(to, moving, 0));
+
+	g_assert_cmpint(reparented, ==, 2);
+	g_assert_cmpint(churn, ==, 0);
+	g_assert(dbusmenu_menuitem_get_parent(moving) == to);
+	g_assert(dbusmenu_menuitem_get_children(from) == NULL);
+	g_assert(dbusmenu_menuitem_get_children(to)->data == moving);
+	g_assert(dbusmenu_menuitem_get_children(moving)->data == below);
+	g_assert(!dbusmenu_menuitem_property_exist(from, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY));
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(to, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY), ==, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+
+	/* The reference went along with it */
+	g_object_unref(moving);
+	g_assert(DBUSMENU_IS_MENUITEM(dbusmenu_menuitem_find_id(root, 4)));
+
+	g_object_unref(below);
+	g_object_unref(to);
+	g_object_unref(from);
+	g_object_unref(root);
+
+	return;
+}
+
 /* Build the test suite */
 static void
 test_glib_objects_suite (void)
@@ -318,6 +641,13 @@ test_glib_objects_suite (void)
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_signals", test_object_menuitem_props_signals);
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_boolstr", test_object_menuitem_props_boolstr);
 	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_removal", test_object_menuitem_props_removal);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/toggle_group",  test_object_menuitem_toggle_group);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/traverse",      test_object_menuitem_traverse);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/traverse_deep", test_object_menuitem_traverse_deep);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/foreach_changes", test_object_menuitem_foreach_changes);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/build_pruned",  test_object_menuitem_build_pruned);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/props_excluded", test_object_menuitem_props_excluded);
+	g_test_add_func ("/dbusmenu/glib/objects/menuitem/reparent",      test_object_menuitem_reparent);
 	return;
 }
 
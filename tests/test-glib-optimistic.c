@@ -0,0 +1,234 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Clicks on a checkbox whose server takes a while to update it,
+   alternating between waiting for the server and predicting the
+   new state.  Prints how long it took for the client to show the
+   new state each way.  Then clicks on a checkbox that the server
+   ignores to make sure the prediction gets rolled back.  Takes an
+   optional number of clicks of each kind. */
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+/* How long the busy application takes to handle a click */
+#define SERVER_DELAY  50
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static guint clicks = 5;
+
+static DbusmenuMenuitem * busy = NULL;
+static DbusmenuClient * client = NULL;
+static DbusmenuMenuitem * clientbusy = NULL;
+static DbusmenuMenuitem * clientignored = NULL;
+
+static GTimer * timer = NULL;
+static guint clicked = 0;
+static gint expected = 0;
+static gdouble seen = -1.0;
+static gdouble totals[2] = {0.0, 0.0};
+static gboolean rolling_back = FALSE;
+
+/* The application flips the state once it gets around to it */
+static gboolean
+busy_toggle (gpointer user_data)
+{
+	gint state = dbusmenu_menuitem_property_get_int(busy, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE);
+	dbusmenu_menuitem_property_set_int(busy, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE,
+		state == DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED ? DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED);
+	return FALSE;
+}
+
+static void
+busy_activated (DbusmenuMenuitem * mi, guint timestamp, gpointer user_data)
+{
+	g_timeout_add(SERVER_DELAY, busy_toggle, NULL);
+	return;
+}
+
+/* Notes when the user would see the new state */
+static void
+client_prop_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * value, gpointer user_data)
+{
+	if (g_strcmp0(property, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) != 0) {
+		return;
+	}
+
+	if (seen < 0.0 && value != NULL && g_variant_get_int32(value) == expected) {
+		seen = g_timer_elapsed(timer, NULL);
+	}
+
+	return;
+}
+
+static void
+click (DbusmenuMenuitem * mi, gboolean optimistic)
+{
+	g_object_set(G_OBJECT(client), DBUSMENU_CLIENT_PROP_OPTIMISTIC_TOGGLES, optimistic, NULL);
+
+	gint state = dbusmenu_menuitem_property_get_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE);
+	expected = state == DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED ? DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED;
+	seen = -1.0;
+
+	g_timer_start(timer);
+	dbusmenu_menuitem_handle_event(mi, DBUSMENU_MENUITEM_EVENT_ACTIVATED, NULL, 0);
+	return;
+}
+
+/* Polls until each step is done */
+static gboolean
+step (gpointer user_data)
+{
+	if (clientbusy == NULL) {
+		DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+		if (root == NULL) {
+			return TRUE;
+		}
+
+		DbusmenuMenuitem * one = dbusmenu_menuitem_find_id(root, 1);
+		DbusmenuMenuitem * two = dbusmenu_menuitem_find_id(root, 2);
+		if (one == NULL || two == NULL ||
+				!dbusmenu_menuitem_property_exist(one, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE) ||
+				!dbusmenu_menuitem_property_exist(two, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE)) {
+			return TRUE;
+		}
+
+		clientbusy = one;
+		clientignored = two;
+		g_signal_connect(G_OBJECT(clientbusy), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(client_prop_changed), NULL);
+
+		click(clientbusy, FALSE);
+		return TRUE;
+	}
+
+	if (rolling_back) {
+		if (dbusmenu_menuitem_property_get_int(clientignored, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) == DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED) {
+			g_debug("Ignored click rolled back after %f ms", g_timer_elapsed(timer, NULL) * 1000.0);
+			g_main_loop_quit(mainloop);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* Wait for both sides to agree on the clicked state */
+	if (seen < 0.0 ||
+			dbusmenu_menuitem_property_get_int(busy, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) != expected ||
+			dbusmenu_menuitem_property_get_int(clientbusy, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) != expected) {
+		return TRUE;
+	}
+
+	gboolean optimistic = (clicked % 2) == 1;
+	totals[optimistic] += seen;
+	g_debug("Click %d (%s) shown in %f ms", clicked, optimistic ? "optimistic" : "waiting", seen * 1000.0);
+	clicked++;
+
+	if (clicked < clicks * 2) {
+		click(clientbusy, (clicked % 2) == 1);
+		return TRUE;
+	}
+
+	g_debug("Average waiting for the server: %f ms", totals[0] * 1000.0 / clicks);
+	g_debug("Average optimistic: %f ms", totals[1] * 1000.0 / clicks);
+
+	/* The prediction should show up before we even get back here */
+	if (totals[1] >= totals[0]) {
+		g_warning("Optimistic toggles weren't any faster");
+		passed = FALSE;
+		g_main_loop_quit(mainloop);
+		return FALSE;
+	}
+
+	click(clientignored, TRUE);
+	if (dbusmenu_menuitem_property_get_int(clientignored, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE) != DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED) {
+		g_warning("Ignored click wasn't predicted");
+		passed = FALSE;
+		g_main_loop_quit(mainloop);
+		return FALSE;
+	}
+	rolling_back = TRUE;
+
+	return TRUE;
+}
+
+int
+main (int argc, char ** argv)
+{
+	if (argc > 1) {
+		clicks = MAX(atoi(argv[1]), 1);
+	}
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	busy = dbusmenu_menuitem_new_with_id(1);
+	dbusmenu_menuitem_property_set(busy, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE, DBUSMENU_MENUITEM_TOGGLE_CHECK);
+	dbusmenu_menuitem_property_set_int(busy, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE, DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED);
+	g_signal_connect(G_OBJECT(busy), DBUSMENU_MENUITEM_SIGNAL_ITEM_ACTIVATED, G_CALLBACK(busy_activated), NULL);
+	dbusmenu_menuitem_child_append(root, busy);
+
+	DbusmenuMenuitem * ignored = dbusmenu_menuitem_new_with_id(2);
+	dbusmenu_menuitem_property_set(ignored, DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE, DBUSMENU_MENUITEM_TOGGLE_CHECK);
+	dbusmenu_menuitem_property_set_int(ignored, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE, DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED);
+	dbusmenu_menuitem_child_append(root, ignored);
+
+	dbusmenu_server_set_root(server, root);
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+
+	g_timeout_add(5, step, NULL);
+	if (!loopback_run(mainloop, 10 + clicks)) {
+		passed = FALSE;
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(busy));
+	g_object_unref(G_OBJECT(ignored));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+	g_timer_destroy(timer);
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,243 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Moves an item with a child from one submenu to another on the
+   server.  A client that asked for moves keeps the same items and
+   only signals child-reparented, one that didn't gets the plain
+   child-removed and child-added it always did. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+/* Signals seen on the two submenus of one client */
+typedef struct _counts_t counts_t;
+struct _counts_t {
+	guint added;
+	guint removed;
+	guint reparented;
+};
+
+static void
+child_added (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, guint position, counts_t * counts)
+{
+	counts->added++;
+	return;
+}
+
+static void
+child_removed (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, counts_t * counts)
+{
+	counts->removed++;
+	return;
+}
+
+static void
+child_reparented (DbusmenuMenuitem * mi, DbusmenuMenuitem * child, DbusmenuMenuitem * oldparent, guint position, counts_t * counts)
+{
+	counts->reparented++;
+	return;
+}
+
+static void
+counts_connect (DbusmenuMenuitem * mi, counts_t * counts)
+{
+	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(child_added), counts);
+	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REMOVED, G_CALLBACK(child_removed), counts);
+	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_CHILD_REPARENTED, G_CALLBACK(child_reparented), counts);
+	return;
+}
+
+/* The item with the ID on the client, if its parent has @parentid
+   and it has the child with @childid */
+static DbusmenuMenuitem *
+item_under (DbusmenuClient * client, gint id, gint parentid, gint childid)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	if (root == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * parent = dbusmenu_menuitem_get_parent(mi);
+	if (parent == NULL || dbusmenu_menuitem_get_id(parent) != parentid) {
+		return NULL;
+	}
+
+	if (dbusmenu_menuitem_child_find(mi, childid) == NULL) {
+		return NULL;
+	}
+
+	return mi;
+}
+
+static DbusmenuClient * moving = NULL;
+static DbusmenuClient * compat = NULL;
+static gint wanted_parent = 0;
+
+static gboolean
+items_poll (gpointer user_data)
+{
+	if (item_under(moving, 10, wanted_parent, 100) != NULL && item_under(compat, 10, wanted_parent, 100) != NULL) {
+		g_main_loop_quit(mainloop);
+	}
+	return TRUE;
+}
+
+static void
+wait_items (gint parentid, const gchar * what)
+{
+	if (!passed) {
+		return;
+	}
+
+	wanted_parent = parentid;
+	guint poll = g_timeout_add(20, items_poll, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		g_warning("Timed out: %s", what);
+		passed = FALSE;
+	}
+	g_source_remove(poll);
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new_with_id(0);
+	DbusmenuMenuitem * first = dbusmenu_menuitem_new_with_id(1);
+	DbusmenuMenuitem * second = dbusmenu_menuitem_new_with_id(2);
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new_with_id(10);
+	DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(100);
+	DbusmenuMenuitem * stays = dbusmenu_menuitem_new_with_id(20);
+
+	dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Moving");
+	dbusmenu_menuitem_child_append(item, child);
+	dbusmenu_menuitem_child_append(first, item);
+	dbusmenu_menuitem_child_append(second, stays);
+	dbusmenu_menuitem_child_append(root, first);
+	dbusmenu_menuitem_child_append(root, second);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	dbusmenu_server_set_root(server, root);
+
+	moving = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+	g_object_set(G_OBJECT(moving), DBUSMENU_CLIENT_PROP_REPARENT_CHILDREN, TRUE, NULL);
+	compat = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+
+	wait_items(1, "first layout");
+
+	counts_t moving_counts = { 0 };
+	counts_t compat_counts = { 0 };
+	DbusmenuMenuitem * moving_item = NULL;
+	DbusmenuMenuitem * moving_child = NULL;
+
+	if (passed) {
+		DbusmenuMenuitem * moving_root = dbusmenu_client_get_root(moving);
+		DbusmenuMenuitem * compat_root = dbusmenu_client_get_root(compat);
+
+		counts_connect(dbusmenu_menuitem_find_id(moving_root, 1), &moving_counts);
+		counts_connect(dbusmenu_menuitem_find_id(moving_root, 2), &moving_counts);
+		counts_connect(dbusmenu_menuitem_find_id(compat_root, 1), &compat_counts);
+		counts_connect(dbusmenu_menuitem_find_id(compat_root, 2), &compat_counts);
+
+		/* Held so that comparing them later can't hit a new
+		   item that got the same memory */
+		moving_item = g_object_ref(item_under(moving, 10, 1, 100));
+		moving_child = g_object_ref(dbusmenu_menuitem_child_find(moving_item, 100));
+
+		check(dbusmenu_menuitem_child_reparent(second, item, 0), "moved on the server");
+	}
+
+	wait_items(2, "moved to the second submenu");
+
+	if (passed) {
+		DbusmenuMenuitem * moved = item_under(moving, 10, 2, 100);
+		check(moved == moving_item, "moved item kept");
+		check(dbusmenu_menuitem_child_find(moved, 100) == moving_child, "moved child kept");
+		check(g_strcmp0(dbusmenu_menuitem_property_get(moved, DBUSMENU_MENUITEM_PROP_LABEL), "Moving") == 0, "moved label");
+		check(dbusmenu_menuitem_get_children(dbusmenu_menuitem_find_id(dbusmenu_client_get_root(moving), 2))->data == moved, "moved position");
+		check(moving_counts.reparented == 2, "reparented on both parents");
+		check(moving_counts.removed == 0, "no removal when moving");
+		check(moving_counts.added == 0, "no addition when moving");
+
+		DbusmenuMenuitem * rebuilt = item_under(compat, 10, 2, 100);
+		check(g_strcmp0(dbusmenu_menuitem_property_get(rebuilt, DBUSMENU_MENUITEM_PROP_LABEL), "Moving") == 0, "rebuilt label");
+		check(dbusmenu_menuitem_get_children(dbusmenu_menuitem_find_id(dbusmenu_client_get_root(compat), 2))->data == rebuilt, "rebuilt position");
+		check(dbusmenu_menuitem_find_id(dbusmenu_menuitem_find_id(dbusmenu_client_get_root(compat), 1), 10) == NULL, "rebuilt item left");
+		check(compat_counts.reparented == 0, "no reparenting without asking");
+		check(compat_counts.removed == 1, "removed from the old parent");
+		check(compat_counts.added == 1, "added to the new parent");
+	}
+
+	if (moving_item != NULL) {
+		g_object_unref(G_OBJECT(moving_child));
+		g_object_unref(G_OBJECT(moving_item));
+	}
+
+	g_object_unref(G_OBJECT(moving));
+	g_object_unref(G_OBJECT(compat));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(stays));
+	g_object_unref(G_OBJECT(child));
+	g_object_unref(G_OBJECT(item));
+	g_object_unref(G_OBJECT(second));
+	g_object_unref(G_OBJECT(first));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
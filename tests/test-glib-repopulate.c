@@ -0,0 +1,259 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Clears out a submenu and fills it up again the way applications
+   do with their recent files.  With the same items nothing should
+   go out, with one label changed only that label should, and with
+   another item the layout should change.  A submenu whose items
+   have submenus of their own gets the same treatment. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static guint layout_updates = 0;
+static guint property_updates = 0;
+static gint changed_id = -1;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static void
+signal_cb (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	if (g_strcmp0(signal, "LayoutUpdated") == 0) {
+		layout_updates++;
+	} else if (g_strcmp0(signal, "ItemsPropertiesUpdated") == 0) {
+		property_updates++;
+
+		GVariant * updated = g_variant_get_child_value(params, 0);
+		if (g_variant_n_children(updated) == 1) {
+			g_variant_get_child(updated, 0, "(i@a{sv})", &changed_id, NULL);
+		}
+		g_variant_unref(updated);
+	}
+
+	return;
+}
+
+static GVariant *
+get_layout (GDBusConnection * bus, guint * revision)
+{
+	const gchar * props[] = { NULL };
+	GVariant * reply = loopback_call(mainloop, bus, "GetLayout", g_variant_new("(ii^as)", 0, -1, props), "(u(ia{sv}av))");
+
+	if (reply == NULL) {
+		passed = FALSE;
+		return NULL;
+	}
+
+	GVariant * layout = NULL;
+	g_variant_get(reply, "(u@(ia{sv}av))", revision, &layout);
+	g_variant_unref(reply);
+	return layout;
+}
+
+static gboolean
+settle_func (gpointer data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Lets the idles run and the signals get across */
+static void
+settle (void)
+{
+	layout_updates = 0;
+	property_updates = 0;
+	changed_id = -1;
+
+	g_timeout_add(200, settle_func, NULL);
+	g_main_loop_run(mainloop);
+	return;
+}
+
+/* Empties the item and fills it with new items with these labels,
+   each with a submenu of its own if @nested is set */
+static void
+refill (DbusmenuMenuitem * parent, const gchar ** labels, gboolean nested)
+{
+	GList * children = g_list_copy(dbusmenu_menuitem_get_children(parent));
+	GList * child;
+	for (child = children; child != NULL; child = g_list_next(child)) {
+		dbusmenu_menuitem_child_delete(parent, DBUSMENU_MENUITEM(child->data));
+	}
+	g_list_free(children);
+
+	gint i;
+	for (i = 0; labels[i] != NULL; i++) {
+		DbusmenuMenuitem * mi = dbusmenu_menuitem_new();
+		dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, labels[i]);
+		dbusmenu_menuitem_child_append(parent, mi);
+		g_object_unref(mi);
+
+		if (nested) {
+			DbusmenuMenuitem * open = dbusmenu_menuitem_new();
+			dbusmenu_menuitem_property_set(open, DBUSMENU_MENUITEM_PROP_LABEL, "Open");
+			dbusmenu_menuitem_child_append(mi, open);
+			g_object_unref(open);
+		}
+	}
+
+	return;
+}
+
+static gint
+child_id (DbusmenuMenuitem * parent, guint position)
+{
+	return dbusmenu_menuitem_get_id(DBUSMENU_MENUITEM(g_list_nth_data(dbusmenu_menuitem_get_children(parent), position)));
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	g_dbus_connection_signal_subscribe(client_bus, NULL, "com.canonical.dbusmenu", NULL, "/org/test", NULL,
+	                                   G_DBUS_SIGNAL_FLAGS_NONE, signal_cb, NULL, NULL);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * recent = dbusmenu_menuitem_new();
+	dbusmenu_menuitem_property_set(recent, DBUSMENU_MENUITEM_PROP_LABEL, "Recent");
+	dbusmenu_menuitem_child_append(root, recent);
+	g_object_unref(recent);
+
+	DbusmenuMenuitem * projects = dbusmenu_menuitem_new();
+	dbusmenu_menuitem_property_set(projects, DBUSMENU_MENUITEM_PROP_LABEL, "Projects");
+	dbusmenu_menuitem_child_append(root, projects);
+	g_object_unref(projects);
+
+	const gchar * files[] = { "a.txt", "b.txt", "c.txt", NULL };
+	refill(recent, files, FALSE);
+	refill(projects, files, TRUE);
+
+	dbusmenu_server_set_root(server, root);
+	settle();
+
+	guint first_revision = 0;
+	GVariant * first = get_layout(client_bus, &first_revision);
+	gint first_b = child_id(recent, 1);
+
+	/* The same again */
+	if (passed) {
+		refill(recent, files, FALSE);
+		settle();
+
+		check(layout_updates == 0, "no layout update for the same items");
+		check(property_updates == 0, "no property update for the same items");
+		check(child_id(recent, 1) != first_b, "replacement kept its own ID");
+
+		guint revision = 0;
+		GVariant * again = get_layout(client_bus, &revision);
+		check(again != NULL && first != NULL && g_variant_equal(first, again), "same layout");
+		check(revision == first_revision, "same revision");
+		if (again != NULL) {
+			g_variant_unref(again);
+		}
+	}
+
+	/* The same again with submenus under the items */
+	if (passed) {
+		refill(projects, files, TRUE);
+		settle();
+
+		check(layout_updates == 0, "no layout update for the same nested items");
+		check(property_updates == 0, "no property update for the same nested items");
+
+		guint revision = 0;
+		GVariant * again = get_layout(client_bus, &revision);
+		check(again != NULL && first != NULL && g_variant_equal(first, again), "same nested layout");
+		check(revision == first_revision, "same revision after nested items");
+		if (again != NULL) {
+			g_variant_unref(again);
+		}
+	}
+
+	/* One of them is different */
+	if (passed) {
+		const gchar * changed[] = { "a.txt", "d.txt", "c.txt", NULL };
+		refill(recent, changed, FALSE);
+		settle();
+
+		check(layout_updates == 0, "no layout update for a different label");
+		check(property_updates == 1, "one property update for a different label");
+		check(changed_id == first_b, "the changed label went out on the old ID");
+	}
+
+	/* And one more */
+	if (passed) {
+		const gchar * more[] = { "a.txt", "d.txt", "c.txt", "e.txt", NULL };
+		refill(recent, more, FALSE);
+		settle();
+
+		check(layout_updates == 1, "layout update for another item");
+
+		guint revision = 0;
+		GVariant * again = get_layout(client_bus, &revision);
+		check(revision > first_revision, "new revision for another item");
+		if (again != NULL) {
+			g_variant_unref(again);
+		}
+	}
+
+	if (first != NULL) {
+		g_variant_unref(first);
+	}
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,165 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Seals a server and makes sure that the replies it sends are the
+   same as before it was sealed, and that the items can't be changed
+   anymore. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+/* Makes a call and waits for the reply */
+static GVariant *
+call (GDBusConnection * bus, const gchar * method, GVariant * params, const gchar * type)
+{
+	GVariant * reply = loopback_call(mainloop, bus, method, params, type);
+	if (reply == NULL) {
+		passed = FALSE;
+	}
+
+	return reply;
+}
+
+/* The replies without the revision, which is bumped by
+   sealing the server */
+static GVariant *
+get_layout (GDBusConnection * bus)
+{
+	const gchar * props[] = { NULL };
+	GVariant * reply = call(bus, "GetLayout", g_variant_new("(ii^as)", 0, -1, props), "(u(ia{sv}av))");
+	if (reply == NULL) {
+		return NULL;
+	}
+
+	GVariant * layout = g_variant_get_child_value(reply, 1);
+	g_variant_unref(reply);
+	return layout;
+}
+
+static GVariant *
+get_group_properties (GDBusConnection * bus)
+{
+	const gint32 ids[] = { 1, 2, 21 };
+	const gchar * props[] = { NULL };
+	GVariant * idlist = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, ids, G_N_ELEMENTS(ids), sizeof(gint32));
+	return call(bus, "GetGroupProperties", g_variant_new("(@ai^as)", idlist, props), "(a(ia{sv}))");
+}
+
+static void
+compare (GVariant * before, GVariant * after, const gchar * what)
+{
+	if (before == NULL || after == NULL || !g_variant_equal(before, after)) {
+		g_warning("%s changed after sealing", what);
+		passed = FALSE;
+	}
+
+	if (before != NULL) {
+		g_variant_unref(before);
+	}
+	if (after != NULL) {
+		g_variant_unref(after);
+	}
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * one = dbusmenu_menuitem_new_with_id(1);
+	dbusmenu_menuitem_property_set(one, DBUSMENU_MENUITEM_PROP_LABEL, "One");
+	dbusmenu_menuitem_child_append(root, one);
+	g_object_unref(one);
+
+	DbusmenuMenuitem * two = dbusmenu_menuitem_new_with_id(2);
+	dbusmenu_menuitem_property_set(two, DBUSMENU_MENUITEM_PROP_LABEL, "Two");
+	dbusmenu_menuitem_child_append(root, two);
+	g_object_unref(two);
+
+	DbusmenuMenuitem * sub = dbusmenu_menuitem_new_with_id(21);
+	dbusmenu_menuitem_property_set(sub, DBUSMENU_MENUITEM_PROP_LABEL, "Two One");
+	dbusmenu_menuitem_property_set_bool(sub, DBUSMENU_MENUITEM_PROP_ENABLED, FALSE);
+	dbusmenu_menuitem_child_append(two, sub);
+	g_object_unref(sub);
+
+	dbusmenu_server_set_root(server, root);
+
+	GVariant * layout = get_layout(client_bus);
+	GVariant * group = get_group_properties(client_bus);
+
+	if (!dbusmenu_server_seal(server)) {
+		g_warning("Unable to seal the server");
+		passed = FALSE;
+	}
+
+	compare(layout, get_layout(client_bus), "Layout");
+	compare(group, get_group_properties(client_bus), "Properties");
+
+	if (dbusmenu_menuitem_property_set(one, DBUSMENU_MENUITEM_PROP_LABEL, "Changed")) {
+		g_warning("Able to change a property on a sealed item");
+		passed = FALSE;
+	}
+
+	DbusmenuMenuitem * extra = dbusmenu_menuitem_new_with_id(3);
+	if (dbusmenu_menuitem_child_append(root, extra)) {
+		g_warning("Able to add a child to a sealed item");
+		passed = FALSE;
+	}
+	g_object_unref(extra);
+
+	if (g_strcmp0(dbusmenu_menuitem_property_get(one, DBUSMENU_MENUITEM_PROP_LABEL), "One") != 0 ||
+			g_list_length(dbusmenu_menuitem_get_children(root)) != 2) {
+		g_warning("Sealed items were changed");
+		passed = FALSE;
+	}
+
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
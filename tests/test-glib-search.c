@@ -0,0 +1,245 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Searches a small menu on the server through a client, checking
+   that case and mnemonics don't matter, that the labels of the
+   parents come back with each item, that items without the
+   required properties are left out and that the revision of the
+   layout that was searched comes back with them. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static guint searched = 0;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static DbusmenuMenuitem *
+item_new (DbusmenuMenuitem * parent, gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	dbusmenu_menuitem_child_append(parent, mi);
+	g_object_unref(mi);
+	return mi;
+}
+
+/* Polls until the client has the menu with the wanted item */
+static gint wanted_id = 0;
+
+static gboolean
+wait_root (gpointer user_data)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(user_data));
+	if (root == NULL || (wanted_id != 0 && dbusmenu_menuitem_find_id(root, wanted_id) == NULL)) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+wait_item (DbusmenuClient * client, gint id)
+{
+	if (!passed) {
+		return;
+	}
+
+	wanted_id = id;
+	guint poll = g_timeout_add(1, wait_root, client);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+static void
+search_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GVariant ** results = (GVariant **)user_data;
+	GError * error = NULL;
+
+	*results = dbusmenu_client_search_finish(DBUSMENU_CLIENT(object), res, &searched, &error);
+	if (error != NULL) {
+		g_warning("Unable to search: %s", error->message);
+		g_error_free(error);
+		passed = FALSE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+/* Searches and writes the results as "id:label/label" in a string */
+static gchar *
+search (DbusmenuClient * client, const gchar * text, const gchar ** requirements)
+{
+	if (!passed) {
+		return NULL;
+	}
+
+	GVariant * results = NULL;
+	dbusmenu_client_search(client, text, requirements, NULL, search_cb, &results);
+
+	if (!loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+	if (!passed) {
+		return NULL;
+	}
+
+	GString * found = g_string_new(NULL);
+	GVariantIter iter;
+	GVariantIter * labels;
+	const gchar * label;
+	gint id;
+
+	g_variant_iter_init(&iter, results);
+	while (g_variant_iter_next(&iter, "(ias)", &id, &labels)) {
+		g_string_append_printf(found, "%s%d:", found->len == 0 ? "" : " ", id);
+		gboolean first = TRUE;
+		while (g_variant_iter_next(labels, "&s", &label)) {
+			g_string_append_printf(found, "%s%s", first ? "" : "/", label);
+			first = FALSE;
+		}
+		g_variant_iter_free(labels);
+	}
+
+	g_variant_unref(results);
+	return g_string_free(found, FALSE);
+}
+
+/* The revision of the layout the server is sending */
+static guint
+layout_revision (GDBusConnection * bus)
+{
+	guint revision = 0;
+	const gchar * props[] = { NULL };
+	GVariant * layout = loopback_call(mainloop, bus, "GetLayout", g_variant_new("(ii^as)", 0, 0, props), "(u(ia{sv}av))");
+	if (layout == NULL) {
+		passed = FALSE;
+		return 0;
+	}
+
+	g_variant_get_child(layout, 0, "u", &revision);
+	g_variant_unref(layout);
+	return revision;
+}
+
+static void
+check_search (DbusmenuClient * client, const gchar * text, const gchar ** requirements, const gchar * expected, const gchar * what)
+{
+	gchar * found = search(client, text, requirements);
+	if (found != NULL && g_strcmp0(found, expected) != 0) {
+		g_warning("Search for '%s' found '%s' instead of '%s'", text, found, expected);
+	}
+	check(g_strcmp0(found, expected) == 0, what);
+	g_free(found);
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * file = item_new(root, 1, "_File");
+	item_new(file, 11, "_Open");
+	DbusmenuMenuitem * save = item_new(file, 12, "Save _As");
+	dbusmenu_menuitem_property_set_bool(save, DBUSMENU_MENUITEM_PROP_ENABLED, FALSE);
+	DbusmenuMenuitem * recent = item_new(file, 13, "Open _Recent");
+	item_new(recent, 131, "Notes.txt");
+
+	DbusmenuMenuitem * edit = item_new(root, 2, "_Edit");
+	dbusmenu_menuitem_property_set_bool(edit, DBUSMENU_MENUITEM_PROP_ENABLED, FALSE);
+	item_new(edit, 21, "Copy");
+	item_new(edit, 22, "Copy __Link");
+
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuClient * client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+
+	wait_item(client, 0);
+
+	const gchar * enabled[] = { DBUSMENU_MENUITEM_PROP_ENABLED, NULL };
+
+	check_search(client, "open", NULL, "11:_File/_Open 13:_File/Open _Recent", "case doesn't matter");
+	check_search(client, "NOTES", NULL, "131:_File/Open _Recent/Notes.txt", "labels of the parents");
+	check_search(client, "Save As", NULL, "12:_File/Save _As", "mnemonics are ignored");
+	check_search(client, "_link", NULL, "22:_Edit/Copy __Link", "escaped underscores are kept");
+	check_search(client, "copy", NULL, "21:_Edit/Copy 22:_Edit/Copy __Link", "everything is searched");
+	check_search(client, "copy", enabled, "", "disabled parents leave out their children");
+	check_search(client, "t", enabled, "13:_File/Open _Recent 131:_File/Open _Recent/Notes.txt", "disabled items are left out");
+	check_search(client, "nothing", NULL, "", "nothing found");
+
+	/* The revision is the one the results came from */
+	guint revision = layout_revision(client_bus);
+	check(passed && searched == revision, "revision of the search");
+
+	DbusmenuMenuitem * help = item_new(root, 3, "_Help");
+	item_new(help, 31, "_About");
+	wait_item(client, 31);
+	check_search(client, "about", NULL, "31:_Help/_About", "added items are found");
+	check(passed && searched > revision, "revision after adding");
+	check(passed && searched == layout_revision(client_bus), "revision of the new layout");
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
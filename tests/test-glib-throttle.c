@@ -0,0 +1,169 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* A client that asks for the whole layout over and over again.  The
+   server should hold it back once it's over the request limit, answer
+   the repeated requests with one reply and still answer all of them. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+#define REQUESTS       20
+#define REQUEST_LIMIT  5
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static guint replies = 0;
+static GVariant * first_layout = NULL;
+
+static void
+layout_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GVariant * layout = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to get layout: %s", error->message);
+		g_error_free(error);
+		passed = FALSE;
+	} else {
+		if (first_layout == NULL) {
+			first_layout = g_variant_ref(layout);
+		} else if (!g_variant_equal(first_layout, layout)) {
+			g_warning("Layouts don't match");
+			passed = FALSE;
+		}
+		g_variant_unref(layout);
+	}
+
+	replies++;
+	if (replies == REQUESTS) {
+		g_main_loop_quit(mainloop);
+	}
+
+	return;
+}
+
+static guint
+stat_get (GVariant * stats, const gchar * name)
+{
+	guint value = 0;
+	g_variant_lookup(stats, name, "u", &value);
+	return value;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	g_object_set(G_OBJECT(server), DBUSMENU_SERVER_PROP_REQUEST_LIMIT, REQUEST_LIMIT, NULL);
+
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	gint i;
+	for (i = 1; i <= 10; i++) {
+		DbusmenuMenuitem * child = dbusmenu_menuitem_new_with_id(i);
+		dbusmenu_menuitem_property_set(child, DBUSMENU_MENUITEM_PROP_LABEL, "Again");
+		dbusmenu_menuitem_child_append(root, child);
+		g_object_unref(child);
+	}
+	dbusmenu_server_set_root(server, root);
+
+	GTimer * timer = g_timer_new();
+	const gchar * props[] = { NULL };
+	for (i = 0; i < REQUESTS; i++) {
+		g_dbus_connection_call(client_bus, NULL, "/org/test", "com.canonical.dbusmenu", "GetLayout",
+		                       g_variant_new("(ii^as)", 0, -1, props),
+		                       G_VARIANT_TYPE("(u(ia{sv}av))"),
+		                       G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+		                       layout_cb, NULL);
+	}
+
+	if (!loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+
+	g_debug("%d requests answered in %f ms", replies, g_timer_elapsed(timer, NULL) * 1000.0);
+
+	GVariant * all = dbusmenu_server_get_request_stats(server);
+	if (g_variant_n_children(all) != 1) {
+		g_warning("Expected numbers for one client, got %d", (gint)g_variant_n_children(all));
+		passed = FALSE;
+	} else {
+		GVariant * entry = g_variant_get_child_value(all, 0);
+		GVariant * stats = g_variant_get_child_value(entry, 1);
+		guint64 bytes = 0;
+		g_variant_lookup(stats, "reply-bytes", "t", &bytes);
+
+		g_debug("Requests: %d  Deferred: %d  Shared: %d  Reply bytes: %d",
+		        stat_get(stats, "requests"), stat_get(stats, "deferred"), stat_get(stats, "shared"), (gint)bytes);
+
+		if (stat_get(stats, "requests") != REQUESTS) {
+			g_warning("Not all of the requests were counted");
+			passed = FALSE;
+		}
+		if (stat_get(stats, "deferred") == 0 || stat_get(stats, "shared") == 0) {
+			g_warning("Requests over the limit weren't held back and shared");
+			passed = FALSE;
+		}
+		if (stat_get(stats, "pending") != 0) {
+			g_warning("Requests are still waiting");
+			passed = FALSE;
+		}
+		if (bytes == 0) {
+			g_warning("Reply bytes weren't counted");
+			passed = FALSE;
+		}
+
+		g_variant_unref(stats);
+		g_variant_unref(entry);
+	}
+	g_variant_unref(all);
+
+	if (first_layout != NULL) {
+		g_variant_unref(first_layout);
+	}
+	g_timer_destroy(timer);
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,180 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The server only sends the selection of a radio group on the
+   parent, the client has to give each member its toggle state.
+   Checks that the states follow the selection as it moves, and
+   that an item leaving the group loses its state. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+static DbusmenuClient * client = NULL;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+/* The toggle state of the item on the client with the ID, or -1
+   if it doesn't have one */
+static gint
+state_get (gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	if (root == NULL) {
+		return -1;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return -1;
+	}
+
+	if (!dbusmenu_menuitem_property_exist(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE)) {
+		return -1;
+	}
+
+	return dbusmenu_menuitem_property_get_int(mi, DBUSMENU_MENUITEM_PROP_TOGGLE_STATE);
+}
+
+/* The item the states should end up on, or zero to wait for the
+   first item to lose its state */
+static gint expected = 0;
+
+static gboolean
+states_done (void)
+{
+	if (expected == 0) {
+		return state_get(1) == -1;
+	}
+
+	gint id;
+	for (id = 1; id <= 3; id++) {
+		gint want = (id == expected) ? DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED : DBUSMENU_MENUITEM_TOGGLE_STATE_UNCHECKED;
+		if (state_get(id) != want) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+states_poll (gpointer user_data)
+{
+	if (states_done()) {
+		g_main_loop_quit(mainloop);
+	}
+	return TRUE;
+}
+
+static void
+wait_states (gint selected, const gchar * what)
+{
+	if (!passed) {
+		return;
+	}
+
+	expected = selected;
+	guint poll = g_timeout_add(20, states_poll, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		g_warning("Timed out: %s", what);
+		passed = FALSE;
+	}
+	g_source_remove(poll);
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	DbusmenuMenuitem * items[3];
+	gint i;
+	for (i = 0; i < 3; i++) {
+		items[i] = dbusmenu_menuitem_new_with_id(i + 1);
+		dbusmenu_menuitem_property_set(items[i], DBUSMENU_MENUITEM_PROP_TOGGLE_TYPE, DBUSMENU_MENUITEM_TOGGLE_RADIO);
+		dbusmenu_menuitem_property_set(items[i], DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP, "size");
+		dbusmenu_menuitem_child_append(root, items[i]);
+	}
+	dbusmenu_menuitem_toggle_group_select(items[1]);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	dbusmenu_server_set_root(server, root);
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+
+	/* Selection sent with the layout */
+	wait_states(2, "first layout");
+
+	/* Selection moved on the server, only the parent changes */
+	if (passed) {
+		dbusmenu_menuitem_toggle_group_select(items[2]);
+	}
+	wait_states(3, "moved selection");
+
+	/* Leaving the group takes the state away */
+	if (passed) {
+		dbusmenu_menuitem_property_remove(items[0], DBUSMENU_MENUITEM_PROP_TOGGLE_GROUP);
+	}
+	wait_states(0, "left the group");
+
+	if (passed) {
+		check(state_get(3) == DBUSMENU_MENUITEM_TOGGLE_STATE_CHECKED, "selection kept after leaving");
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	for (i = 0; i < 3; i++) {
+		g_object_unref(G_OBJECT(items[i]));
+	}
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,345 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Follows a menu with a client that handles its layouts on the
+   worker.  Setting a new root on the server makes the client get
+   the whole layout again.  When the items still match the last one
+   only what changed is applied, so the client keeps its items, and
+   it still gets the properties that a layout doesn't have.  A
+   property that changes between two layouts isn't lost when the
+   second puts it back, and a signal that comes in while a layout
+   is out on the worker is applied after it. */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+/* The filter runs on the bus thread */
+G_LOCK_DEFINE_STATIC(calls);
+static guint fetched = 0; /* GetGroupProperties since the last GetLayout */
+static gboolean hold_armed = FALSE;
+static guint32 hold_serial = 0;
+
+/* Sends a signal right behind the layout and keeps the main context
+   busy until both are in, so the signal is there to be handled
+   while the layout is out on the worker */
+static gboolean
+hold_signal (gpointer user_data)
+{
+	g_dbus_connection_emit_signal(G_DBUS_CONNECTION(user_data),
+	                              NULL, /* destination */
+	                              "/org/test",
+	                              "com.canonical.dbusmenu",
+	                              "ItemsPropertiesUpdated",
+	                              g_variant_new_parsed("(@a(ia{sv}) [(11, {'label': <'Held'>})], @a(ias) [])"),
+	                              NULL);
+	g_dbus_connection_flush_sync(G_DBUS_CONNECTION(user_data), NULL, NULL);
+	g_usleep(G_USEC_PER_SEC / 10);
+	return FALSE;
+}
+
+/* Counts the properties fetched for each layout and catches the
+   reply to the layout that a signal should be held behind */
+static GDBusMessage *
+calls_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	G_LOCK(calls);
+
+	if (incoming && g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+		const gchar * member = g_dbus_message_get_member(message);
+
+		if (g_strcmp0(member, "GetLayout") == 0) {
+			fetched = 0;
+			if (hold_armed) {
+				hold_armed = FALSE;
+				hold_serial = g_dbus_message_get_serial(message);
+			}
+		} else if (g_strcmp0(member, "GetGroupProperties") == 0) {
+			fetched++;
+		}
+	} else if (!incoming && hold_serial != 0 && g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_METHOD_RETURN && g_dbus_message_get_reply_serial(message) == hold_serial) {
+		hold_serial = 0;
+		g_idle_add_full(G_PRIORITY_HIGH, hold_signal, connection, NULL);
+	}
+
+	G_UNLOCK(calls);
+	return message;
+}
+
+static guint
+fetched_get (void)
+{
+	G_LOCK(calls);
+	guint retval = fetched;
+	G_UNLOCK(calls);
+	return retval;
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+/* A root with a folder of two items, the second one labeled
+   @label, and a third one if @extra is set */
+static DbusmenuMenuitem *
+menu_new (const gchar * label, gboolean extra)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * folder = item_new(1, "Folder");
+	dbusmenu_menuitem_child_append(root, folder);
+	g_object_unref(folder);
+
+	DbusmenuMenuitem * one = item_new(11, "One");
+	dbusmenu_menuitem_child_append(folder, one);
+	g_object_unref(one);
+
+	DbusmenuMenuitem * two = item_new(12, label);
+	dbusmenu_menuitem_child_append(folder, two);
+	g_object_unref(two);
+
+	if (extra) {
+		DbusmenuMenuitem * three = item_new(13, "Three");
+		dbusmenu_menuitem_child_append(folder, three);
+		g_object_unref(three);
+	}
+
+	return root;
+}
+
+static DbusmenuClient * client = NULL;
+
+/* The property of the item on the client with the ID */
+static const gchar *
+property_get (gint id, const gchar * property)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(client);
+	if (root == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_menuitem_property_get(mi, property);
+}
+
+static const gchar *
+label_get (gint id)
+{
+	return property_get(id, DBUSMENU_MENUITEM_PROP_LABEL);
+}
+
+static void
+layout_updated (DbusmenuClient * client, gpointer user_data)
+{
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+static void
+wait_layout (void)
+{
+	if (!passed) {
+		return;
+	}
+
+	if (!loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+	return;
+}
+
+static gint wanted_id = 0;
+static const gchar * wanted_property = NULL;
+static const gchar * wanted_value = NULL;
+
+static gboolean
+property_poll (gpointer user_data)
+{
+	if (g_strcmp0(property_get(wanted_id, wanted_property), wanted_value) == 0) {
+		g_main_loop_quit(mainloop);
+	}
+	return TRUE;
+}
+
+static void
+wait_property (gint id, const gchar * property, const gchar * value)
+{
+	if (!passed) {
+		return;
+	}
+
+	wanted_id = id;
+	wanted_property = property;
+	wanted_value = value;
+	guint poll = g_timeout_add(5, property_poll, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		passed = FALSE;
+	}
+	g_source_remove(poll);
+
+	return;
+}
+
+/* Puts a new root on the server, which can't be followed from the
+   journal so the client gets the whole layout.  The first item gets
+   @icon, which isn't one of the properties in a layout. */
+static DbusmenuMenuitem *
+root_replace (DbusmenuServer * server, DbusmenuMenuitem * root, const gchar * label, gboolean extra, const gchar * icon)
+{
+	g_object_unref(G_OBJECT(root));
+	root = menu_new(label, extra);
+	if (icon != NULL) {
+		dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(root, 11), DBUSMENU_MENUITEM_PROP_ICON_NAME, icon);
+	}
+	dbusmenu_server_set_root(server, root);
+	return root;
+}
+
+int
+main (int argc, char ** argv)
+{
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	g_dbus_connection_add_filter(server_bus, calls_filter, NULL, NULL);
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = menu_new("Two", FALSE);
+	dbusmenu_server_set_root(server, root);
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/test");
+	g_object_set(G_OBJECT(client), DBUSMENU_CLIENT_PROP_WORKER_PARSING, TRUE, NULL);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(layout_updated), NULL);
+
+	wait_layout();
+
+	DbusmenuMenuitem * one = NULL;
+	if (passed) {
+		check(g_strcmp0(label_get(12), "Two") == 0, "first layout");
+
+		one = dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 11);
+		g_object_add_weak_pointer(G_OBJECT(one), (gpointer *)&one);
+
+		root = root_replace(server, root, "Two Again", FALSE, "icon");
+	}
+
+	wait_layout();
+
+	if (passed) {
+		check(g_strcmp0(label_get(12), "Two Again") == 0, "changed label");
+		check(one != NULL && one == dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 11), "kept the item");
+	}
+
+	/* Comes with the kept item's properties */
+	wait_property(11, DBUSMENU_MENUITEM_PROP_ICON_NAME, "icon");
+
+	if (passed) {
+		check(one != NULL && one == dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 11), "kept the item with its icon");
+
+		root = root_replace(server, root, "Two Again", TRUE, "icon");
+	}
+
+	wait_layout();
+
+	if (passed) {
+		check(g_strcmp0(label_get(13), "Three") == 0, "added item");
+		check(one != NULL && one == dbusmenu_menuitem_find_id(dbusmenu_client_get_root(client), 11), "kept the item with a new sibling");
+
+		/* Changed between the layouts and put back by the next */
+		dbusmenu_menuitem_property_set(dbusmenu_menuitem_find_id(root, 12), DBUSMENU_MENUITEM_PROP_LABEL, "Two Changed");
+	}
+
+	wait_property(12, DBUSMENU_MENUITEM_PROP_LABEL, "Two Changed");
+
+	if (passed) {
+		root = root_replace(server, root, "Two Again", TRUE, "icon");
+	}
+
+	wait_layout();
+
+	if (passed) {
+		check(g_strcmp0(label_get(12), "Two Again") == 0, "label put back by the layout");
+		check(fetched_get() > 0, "parsed whole after a change");
+
+		/* A signal goes out right behind the next layout */
+		G_LOCK(calls);
+		hold_armed = TRUE;
+		G_UNLOCK(calls);
+
+		root = root_replace(server, root, "Two", TRUE, "icon");
+	}
+
+	wait_layout();
+
+	if (passed) {
+		check(g_strcmp0(label_get(12), "Two") == 0, "layout applied");
+		check(g_strcmp0(label_get(11), "Held") == 0, "signal applied after the layout");
+	}
+
+	if (one != NULL) {
+		g_object_remove_weak_pointer(G_OBJECT(one), (gpointer *)&one);
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
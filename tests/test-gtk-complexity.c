@@ -0,0 +1,202 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Adds an item to a GtkMenu the parser is watching and takes it
+   away again, at a few sizes of menu.  Finding where the item
+   went can be linear in the size of the menu, but shouldn't grow
+   like the square of it.  See test-glib-complexity.c for the
+   same on the menuitems. */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/parser.h>
+
+/* How many times a single operation is done for one measurement */
+#define REPEAT        100
+/* Measurements at each size, the cheapest one is used */
+#define RUNS          5
+/* The same when it's timed, which is noisier */
+#define RUNS_TIMED    25
+/* What doubling the size can do to how much the cost grows.  It's
+   2 for linear, a bit over for n·log n and 4 for quadratic. */
+#define GROWTH_LIMIT  3.0
+/* Growth smaller than this part of the cost is noise */
+#define NOISE         0.05
+
+static const guint sizes[] = { 1000, 2000, 4000 };
+
+static gboolean passed = TRUE;
+static gint counter = -1;
+static guint runs = RUNS;
+
+/* Counts the instructions on this thread if the kernel will do it
+   for us.  Otherwise the CPU time of this thread is used, which is
+   noisier, so it takes the cheapest of more runs.  The test is only
+   skipped when there's neither. */
+static gboolean
+counter_open (void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	counter = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+	if (counter >= 0) {
+		return TRUE;
+	}
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec res;
+	if (clock_getres(CLOCK_THREAD_CPUTIME_ID, &res) == 0) {
+		g_debug("No instruction counter, timing instead");
+		runs = RUNS_TIMED;
+		return TRUE;
+	}
+#endif
+
+	return FALSE;
+}
+
+static guint64
+counter_read (void)
+{
+	guint64 count = 0;
+
+	if (counter < 0) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+		struct timespec now;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+			return (guint64)now.tv_sec * G_GUINT64_CONSTANT(1000000000) + now.tv_nsec;
+		}
+#endif
+		g_warning("Unable to read the CPU time");
+		passed = FALSE;
+		return count;
+	}
+
+	if (read(counter, &count, sizeof(count)) != sizeof(count)) {
+		g_warning("Unable to read the instruction counter");
+		passed = FALSE;
+	}
+
+	return count;
+}
+
+/* Inserts an item in the middle of a parsed menu and removes it */
+static guint64
+cost_insert (guint size)
+{
+	GtkWidget * menu = gtk_menu_new();
+	g_object_ref_sink(menu);
+	guint i;
+
+	for (i = 0; i < size; i++) {
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_menu_item_new_with_label("Item"));
+	}
+
+	DbusmenuMenuitem * root = dbusmenu_gtk_parse_menu_structure(menu);
+	GtkWidget * extra = gtk_menu_item_new_with_label("Extra");
+	g_object_ref_sink(extra);
+
+	guint64 start = counter_read();
+	for (i = 0; i < REPEAT; i++) {
+		gtk_menu_shell_insert(GTK_MENU_SHELL(menu), extra, size / 2);
+		gtk_container_remove(GTK_CONTAINER(menu), extra);
+	}
+	guint64 cost = counter_read() - start;
+
+	if (root == NULL || g_list_length(dbusmenu_menuitem_get_children(root)) != size) {
+		g_warning("Parsed menu doesn't have %d items", size);
+		passed = FALSE;
+	}
+
+	if (root != NULL) {
+		g_object_unref(root);
+	}
+	g_object_unref(extra);
+	gtk_widget_destroy(menu);
+	g_object_unref(menu);
+
+	return cost;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+	if (!counter_open()) {
+		g_debug("No way to measure the cost, skipping");
+		return 77;
+	}
+
+	guint64 cost[G_N_ELEMENTS(sizes)];
+	guint i, run;
+
+	for (i = 0; i < G_N_ELEMENTS(sizes) && passed; i++) {
+		cost[i] = G_MAXUINT64;
+		for (run = 0; run < runs && passed; run++) {
+			cost[i] = MIN(cost[i], cost_insert(sizes[i]));
+		}
+		g_debug("Insert at %d: %" G_GUINT64_FORMAT, sizes[i], cost[i]);
+	}
+
+	/* Compare how much it grew for each doubling */
+	for (i = 2; i < G_N_ELEMENTS(sizes) && passed; i++) {
+		gdouble before = MAX((gdouble)cost[i - 1] - (gdouble)cost[i - 2], (gdouble)cost[i - 2] * NOISE);
+		gdouble after = (gdouble)cost[i] - (gdouble)cost[i - 1];
+
+		if (after > before * GROWTH_LIMIT) {
+			g_warning("Insert grew %f times as much going from %d to %d as from %d to %d",
+			          after / before, sizes[i - 1], sizes[i], sizes[i - 2], sizes[i - 1]);
+			passed = FALSE;
+		}
+	}
+
+	if (counter >= 0) {
+		close(counter);
+	}
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
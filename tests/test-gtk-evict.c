@@ -0,0 +1,330 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Starts two GTK clients on the same menu and then leaves room for
+   only one of them to keep its widgets.  The first one should lose
+   the widgets under its top level items, and the shortcuts on them,
+   while keeping up with the server.  Items added and moved in the
+   meantime go in when it's used again, along with the new labels
+   and the shortcuts, which pushes the second one out. */
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/client.h>
+#include <libdbusmenu-gtk/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+/* The item on the client with the ID */
+static DbusmenuMenuitem *
+item_get (DbusmenuGtkClient * client, gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_menuitem_find_id(root, id);
+}
+
+/* The widget on the client for the item */
+static GtkMenuItem *
+widget_get (DbusmenuGtkClient * client, gint id)
+{
+	DbusmenuMenuitem * mi = item_get(client, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_gtkclient_menuitem_get(client, mi);
+}
+
+/* The labels in a GTK menu, all in one string */
+static gchar *
+menu_labels (GtkMenu * menu)
+{
+	GString * labels = g_string_new(NULL);
+	GList * children = gtk_container_get_children(GTK_CONTAINER(menu));
+	GList * child;
+
+	for (child = children; child != NULL; child = g_list_next(child)) {
+		g_string_append_printf(labels, "%s%s", labels->len == 0 ? "" : " ", gtk_menu_item_get_label(GTK_MENU_ITEM(child->data)));
+	}
+
+	g_list_free(children);
+	return g_string_free(labels, FALSE);
+}
+
+/* The labels in the submenu of the item on the client */
+static gchar *
+submenu_labels (DbusmenuGtkClient * client, gint id)
+{
+	DbusmenuMenuitem * mi = item_get(client, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	GtkMenu * menu = dbusmenu_gtkclient_menuitem_get_submenu(client, mi);
+	if (menu == NULL) {
+		return NULL;
+	}
+
+	return menu_labels(menu);
+}
+
+/* Polls until the deepest item on the client has a widget */
+static gboolean
+wait_built (gpointer user_data)
+{
+	if (widget_get(DBUSMENU_GTKCLIENT(user_data), 121) == NULL) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Polls until the item on the client has the new label */
+static gboolean
+wait_label (gpointer user_data)
+{
+	DbusmenuMenuitem * mi = item_get(DBUSMENU_GTKCLIENT(user_data), 11);
+	if (mi == NULL || g_strcmp0(dbusmenu_menuitem_property_get(mi, DBUSMENU_MENUITEM_PROP_LABEL), "One Again") != 0) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Polls until the items added and moved on the server are there */
+static gboolean
+wait_moved (gpointer user_data)
+{
+	DbusmenuMenuitem * added = item_get(DBUSMENU_GTKCLIENT(user_data), 122);
+	DbusmenuMenuitem * moved = item_get(DBUSMENU_GTKCLIENT(user_data), 121);
+
+	if (added == NULL || dbusmenu_menuitem_get_id(dbusmenu_menuitem_get_parent(added)) != 12) {
+		return TRUE;
+	}
+	if (moved == NULL || dbusmenu_menuitem_get_id(dbusmenu_menuitem_get_parent(moved)) != 13) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Whether the shortcut on the first item is in the group */
+static gboolean
+has_shortcut (GtkAccelGroup * agroup)
+{
+	guint count = 0;
+	gtk_accel_group_query(agroup, GDK_KEY_o, GDK_CONTROL_MASK, &count);
+	return count > 0;
+}
+
+static void
+wait_for (GSourceFunc func, gpointer data)
+{
+	if (!passed) {
+		return;
+	}
+
+	guint poll = g_timeout_add(1, func, data);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+/* Each one gets its own group, as an application would */
+static DbusmenuGtkClient *
+client_new (GDBusConnection * bus, GtkAccelGroup * agroup)
+{
+	DbusmenuGtkClient * client = g_object_new(DBUSMENU_GTKCLIENT_TYPE,
+	                                          DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, bus,
+	                                          DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                                          NULL);
+	dbusmenu_gtkclient_set_accel_group(client, agroup);
+	return client;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * folder = item_new(1, "Folder");
+	dbusmenu_menuitem_property_set(folder, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(root, folder);
+	g_object_unref(folder);
+
+	DbusmenuMenuitem * one = item_new(11, "One");
+	dbusmenu_menuitem_property_set_shortcut(one, GDK_KEY_o, GDK_CONTROL_MASK);
+	dbusmenu_menuitem_child_append(folder, one);
+	g_object_unref(one);
+
+	DbusmenuMenuitem * two = item_new(12, "Two");
+	dbusmenu_menuitem_property_set(two, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(folder, two);
+	g_object_unref(two);
+
+	DbusmenuMenuitem * deep = item_new(121, "Deep");
+	dbusmenu_menuitem_child_append(two, deep);
+	g_object_unref(deep);
+
+	dbusmenu_server_set_root(server, root);
+
+	GtkAccelGroup * first_agroup = gtk_accel_group_new();
+	GtkAccelGroup * second_agroup = gtk_accel_group_new();
+
+	DbusmenuGtkClient * first = client_new(client_bus, first_agroup);
+	wait_for(wait_built, first);
+	DbusmenuGtkClient * second = client_new(client_bus, second_agroup);
+	wait_for(wait_built, second);
+
+	GtkMenuItem * evicted = NULL;
+	if (passed) {
+		check(has_shortcut(first_agroup), "shortcut set up");
+
+		evicted = widget_get(first, 11);
+		g_object_add_weak_pointer(G_OBJECT(evicted), (gpointer *)&evicted);
+
+		/* Only room for one, the first was used longest ago */
+		dbusmenu_gtkclient_set_resident_limit(1);
+
+		check(evicted == NULL, "widget under the top level was destroyed");
+		check(widget_get(first, 121) == NULL, "deepest widget was destroyed");
+		check(widget_get(first, 1) != NULL, "top level widget was kept");
+		check(!has_shortcut(first_agroup), "shortcut went with the widget");
+		check(widget_get(second, 11) != NULL, "other client kept its widgets");
+		check(has_shortcut(second_agroup), "other client kept its shortcut");
+
+		gchar * labels = submenu_labels(first, 1);
+		check(g_strcmp0(labels, "") == 0, "top level submenu was emptied");
+		g_free(labels);
+
+		/* Changes while evicted still come through */
+		dbusmenu_menuitem_property_set(one, DBUSMENU_MENUITEM_PROP_LABEL, "One Again");
+	}
+
+	wait_for(wait_label, first);
+
+	/* Items go under ones that were evicted and get moved
+	   between them */
+	if (passed) {
+		DbusmenuMenuitem * added = item_new(122, "Added");
+		dbusmenu_menuitem_child_append(two, added);
+		g_object_unref(added);
+
+		DbusmenuMenuitem * three = item_new(13, "Three");
+		dbusmenu_menuitem_property_set(three, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+		dbusmenu_menuitem_child_append(folder, three);
+		g_object_unref(three);
+
+		check(dbusmenu_menuitem_child_reparent(three, deep, 0), "moved on the server");
+	}
+
+	wait_for(wait_moved, first);
+
+	if (passed) {
+		check(widget_get(first, 122) == NULL, "added item waits for its parent");
+		check(widget_get(first, 121) == NULL, "moved item waits for its parent");
+
+		dbusmenu_gtkclient_restore(first);
+
+		gchar * labels = submenu_labels(first, 1);
+		check(g_strcmp0(labels, "One Again Two Three") == 0, "submenu was rebuilt with the new label");
+		g_free(labels);
+
+		labels = submenu_labels(first, 12);
+		check(g_strcmp0(labels, "Added") == 0, "added item built under its parent");
+		g_free(labels);
+
+		labels = submenu_labels(first, 13);
+		check(g_strcmp0(labels, "Deep") == 0, "moved item built under its new parent");
+		g_free(labels);
+
+		check(has_shortcut(first_agroup), "shortcut came back");
+		check(widget_get(second, 11) == NULL, "restoring pushed the other client out");
+		check(!has_shortcut(second_agroup), "other client lost its shortcut");
+	}
+
+	if (evicted != NULL) {
+		g_object_remove_weak_pointer(G_OBJECT(evicted), (gpointer *)&evicted);
+	}
+
+	dbusmenu_gtkclient_set_resident_limit(0);
+
+	g_object_unref(G_OBJECT(first));
+	g_object_unref(G_OBJECT(second));
+	g_object_unref(G_OBJECT(first_agroup));
+	g_object_unref(G_OBJECT(second_agroup));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,284 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Follows a menu with a GTK client that builds flyweight items.
+   The items shouldn't have any child widgets but still need the
+   room for their label, growing with it when it changes on the
+   server.  They give their label to the accessible along with the
+   mnemonic and shortcut as its key binding, and get activated by
+   their mnemonic without a label widget to register it. */
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/client.h>
+#include <libdbusmenu-gtk/menuitem.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+/* The widget on the client for the item */
+static GtkMenuItem *
+widget_get (DbusmenuGtkClient * client, gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_gtkclient_menuitem_get(client, mi);
+}
+
+/* Polls until the item on the client has the label */
+static gboolean
+wait_label (gpointer user_data)
+{
+	GtkMenuItem * gmi = widget_get(DBUSMENU_GTKCLIENT(user_data), 11);
+	const gchar * label = (const gchar *)g_object_get_data(G_OBJECT(user_data), "label");
+
+	if (gmi == NULL || g_strcmp0(gtk_menu_item_get_label(gmi), label) != 0) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+wait_for (DbusmenuGtkClient * client, const gchar * label)
+{
+	if (!passed) {
+		return;
+	}
+
+	g_object_set_data(G_OBJECT(client), "label", (gpointer)label);
+
+	guint poll = g_timeout_add(1, wait_label, client);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+/* Checks the item is one widget that's as wide as its label,
+   returning how wide that is */
+static gint
+check_item (GtkMenuItem * gmi, const gchar * name)
+{
+	check(gtk_bin_get_child(GTK_BIN(gmi)) == NULL, "no child widgets");
+
+	AtkObject * aobj = gtk_widget_get_accessible(GTK_WIDGET(gmi));
+	check(aobj != NULL && g_strcmp0(atk_object_get_name(aobj), name) == 0, "label is the accessible name");
+
+	GtkWidget * empty = gtk_menu_item_new();
+	g_object_ref_sink(empty);
+
+	gint width = 0, empty_width = 0;
+	gtk_widget_get_preferred_width(GTK_WIDGET(gmi), NULL, &width);
+	gtk_widget_get_preferred_width(empty, NULL, &empty_width);
+	check(width > empty_width, "room for the label");
+
+	gtk_widget_destroy(empty);
+	g_object_unref(empty);
+
+	return width;
+}
+
+/* Checks the mnemonic, the path to it and the shortcut are the
+   parts of the key binding */
+static void
+check_keybinding (GtkMenuItem * gmi, const gchar * mnemonic, const gchar * path, guint key, GdkModifierType mods)
+{
+	AtkObject * aobj = gtk_widget_get_accessible(GTK_WIDGET(gmi));
+	check(ATK_IS_ACTION(aobj), "accessible has an action");
+	if (!ATK_IS_ACTION(aobj)) {
+		return;
+	}
+
+	gchar * accel = gtk_accelerator_name(key, mods);
+	gchar * wanted = g_strdup_printf("%s;%s;%s", mnemonic, path, accel);
+
+	const gchar * keybinding = atk_action_get_keybinding(ATK_ACTION(aobj), 0);
+	if (g_strcmp0(keybinding, wanted) != 0) {
+		g_warning("Key binding '%s' instead of '%s'", keybinding, wanted);
+		passed = FALSE;
+	}
+
+	g_free(wanted);
+	g_free(accel);
+	return;
+}
+
+static gboolean activated = FALSE;
+
+static void
+item_activated (DbusmenuMenuitem * mi, guint timestamp, gpointer user_data)
+{
+	activated = TRUE;
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+/* Presses the key in the menu the item is in, as the user would
+   with the menu up */
+static gboolean
+press_key (GtkMenuItem * gmi, guint keyval)
+{
+	GtkWidget * shell = gtk_widget_get_parent(GTK_WIDGET(gmi));
+	check(GTK_IS_MENU_SHELL(shell), "item is in a menu");
+	if (!GTK_IS_MENU_SHELL(shell)) {
+		return FALSE;
+	}
+
+	GdkEvent * event = gdk_event_new(GDK_KEY_PRESS);
+	event->key.keyval = keyval;
+	event->key.state = 0;
+	event->key.time = GDK_CURRENT_TIME;
+
+	gboolean handled = FALSE;
+	g_signal_emit_by_name(shell, "key-press-event", event, &handled);
+
+	gdk_event_free(event);
+	return handled;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+#if !GTK_CHECK_VERSION(3,0,0)
+	g_debug("Flyweight items need GTK+ 3");
+	return 0;
+#endif
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * folder = dbusmenu_menuitem_new_with_id(1);
+	dbusmenu_menuitem_property_set(folder, DBUSMENU_MENUITEM_PROP_LABEL, "_Folder");
+	dbusmenu_menuitem_property_set(folder, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(root, folder);
+	g_object_unref(folder);
+
+	DbusmenuMenuitem * item = dbusmenu_menuitem_new_with_id(11);
+	dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "_Open");
+	dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_ICON_NAME, "document-open");
+	dbusmenu_menuitem_property_set_shortcut(item, GDK_KEY_o, GDK_CONTROL_MASK);
+	dbusmenu_menuitem_child_append(folder, item);
+	g_object_unref(item);
+	g_signal_connect(G_OBJECT(item), DBUSMENU_MENUITEM_SIGNAL_ITEM_ACTIVATED, G_CALLBACK(item_activated), NULL);
+
+	dbusmenu_server_set_root(server, root);
+
+	DbusmenuGtkClient * client = g_object_new(DBUSMENU_GTKCLIENT_TYPE,
+	                                          DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, client_bus,
+	                                          DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                                          NULL);
+	dbusmenu_gtkclient_set_flyweight(client, TRUE);
+
+	/* The shortcuts need somewhere to go */
+	GtkAccelGroup * agroup = gtk_accel_group_new();
+	dbusmenu_gtkclient_set_accel_group(client, agroup);
+
+	wait_for(client, "_Open");
+
+	gint width = 0;
+	if (passed) {
+		width = check_item(widget_get(client, 11), "Open");
+		check_keybinding(widget_get(client, 11), "o", "f:o", GDK_KEY_o, GDK_CONTROL_MASK);
+
+		check(press_key(widget_get(client, 11), GDK_KEY_o), "mnemonic handled");
+	}
+
+	if (passed && !activated) {
+		if (!loopback_run(mainloop, 10)) {
+			passed = FALSE;
+		}
+	}
+
+	if (passed) {
+		check(activated, "mnemonic activated the item");
+
+		dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Open a Much _Longer Name");
+	}
+
+	wait_for(client, "Open a Much _Longer Name");
+
+	gint longer = 0;
+	if (passed) {
+		longer = check_item(widget_get(client, 11), "Open a Much Longer Name");
+		check(longer > width, "grew with the label");
+		check_keybinding(widget_get(client, 11), "l", "f:l", GDK_KEY_o, GDK_CONTROL_MASK);
+
+		dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Open");
+	}
+
+	wait_for(client, "Open");
+
+	if (passed) {
+		gint shorter = check_item(widget_get(client, 11), "Open");
+		check(shorter < longer, "shrank with the label");
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(agroup));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -19,8 +19,12 @@ You should have received a copy of the GNU General Public License along
 with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #include <libdbusmenu-glib/menuitem-private.h>
 #include <libdbusmenu-gtk/parser.h>
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-gtk/menuitem.h>
 
 /* Just makes sure we can connect here people */
 static void
@@ -108,12 +112,196 @@ test_parser_children (void) {
 	return;
 }
 
+/* Puts an accelerator on a bunch of items and makes sure that
+   they all come across, and that changing one of them after the
+   menu has been parsed gets picked up. */
+static void
+test_parser_shortcuts (void)
+{
+	GtkAccelGroup * group = gtk_accel_group_new();
+	GtkWidget * menu = gtk_menu_new();
+	g_object_ref_sink(menu);
+	gtk_menu_set_accel_group(GTK_MENU(menu), group);
+
+	gint i;
+	for (i = 0; i < 26; i++) {
+		GtkWidget * item = gtk_menu_item_new_with_label("Shortcut");
+		gtk_widget_add_accelerator(item, "activate", group, GDK_KEY_a + i, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_gtk_parse_menu_structure(menu);
+	g_assert(mi != NULL);
+
+	GList * children = dbusmenu_menuitem_get_children(mi);
+	g_assert(g_list_length(children) == 26);
+
+	GList * child;
+	for (child = children, i = 0; child != NULL; child = g_list_next(child), i++) {
+		guint key = 0;
+		GdkModifierType mods = 0;
+		dbusmenu_menuitem_property_get_shortcut(DBUSMENU_MENUITEM(child->data), &key, &mods);
+		g_assert(key == GDK_KEY_a + i);
+		g_assert(mods == GDK_CONTROL_MASK);
+	}
+
+	/* Move the first one somewhere else */
+	GList * widgets = gtk_container_get_children(GTK_CONTAINER(menu));
+	GtkWidget * first = GTK_WIDGET(widgets->data);
+	g_list_free(widgets);
+
+	gtk_widget_remove_accelerator(first, group, GDK_KEY_a, GDK_CONTROL_MASK);
+	gtk_widget_add_accelerator(first, "activate", group, GDK_KEY_z, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+
+	DbusmenuMenuitem * firstmi = DBUSMENU_MENUITEM(children->data);
+	g_assert(dbusmenu_menuitem_property_set_shortcut_menuitem(firstmi, GTK_MENU_ITEM(first)));
+
+	guint key = 0;
+	GdkModifierType mods = 0;
+	dbusmenu_menuitem_property_get_shortcut(firstmi, &key, &mods);
+	g_assert(key == GDK_KEY_z);
+	g_assert(mods == (GDK_CONTROL_MASK | GDK_SHIFT_MASK));
+
+	g_object_unref(mi);
+	g_object_unref(menu);
+	g_object_unref(group);
+
+	return;
+}
+
+/* The key of a shortcut that changes through the accel map after
+   the group has been looked at has to come from the updated index,
+   not from what was there when it was built */
+static void
+test_parser_shortcuts_changed (void)
+{
+	GtkAccelGroup * group = gtk_accel_group_new();
+	GtkWidget * menu = gtk_menu_new();
+	g_object_ref_sink(menu);
+	gtk_menu_set_accel_group(GTK_MENU(menu), group);
+
+	GtkWidget * fixed = gtk_menu_item_new_with_label("Fixed");
+	gtk_widget_add_accelerator(fixed, "activate", group, GDK_KEY_f, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), fixed);
+
+	gtk_accel_map_add_entry("<DbusmenuTest>/Changed", GDK_KEY_q, GDK_CONTROL_MASK);
+	GtkWidget * changed = gtk_menu_item_new_with_label("Changed");
+	gtk_widget_set_accel_path(changed, "<DbusmenuTest>/Changed", group);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), changed);
+
+	DbusmenuMenuitem * mi = dbusmenu_gtk_parse_menu_structure(menu);
+	g_assert(mi != NULL);
+
+	/* Both are in the index now */
+	GHashTable * index = (GHashTable *)g_object_get_data(G_OBJECT(group), "dbusmenu-gtk-accel-index");
+	g_assert(index != NULL);
+	g_assert_cmpint(g_hash_table_size(index), ==, 2);
+
+	DbusmenuMenuitem * changedmi = dbusmenu_gtk_parse_get_cached_item(changed);
+	g_assert(changedmi != NULL);
+
+	guint key = 0;
+	GdkModifierType mods = 0;
+	dbusmenu_menuitem_property_get_shortcut(changedmi, &key, &mods);
+	g_assert(key == GDK_KEY_q);
+
+	g_assert(gtk_accel_map_change_entry("<DbusmenuTest>/Changed", GDK_KEY_w, GDK_CONTROL_MASK | GDK_SHIFT_MASK, TRUE));
+	g_assert_cmpint(g_hash_table_size(index), ==, 2);
+
+	g_assert(dbusmenu_menuitem_property_set_shortcut_menuitem(changedmi, GTK_MENU_ITEM(changed)));
+	dbusmenu_menuitem_property_get_shortcut(changedmi, &key, &mods);
+	g_assert(key == GDK_KEY_w);
+	g_assert(mods == (GDK_CONTROL_MASK | GDK_SHIFT_MASK));
+
+	/* Taking one away takes it out of the index */
+	gtk_widget_remove_accelerator(fixed, group, GDK_KEY_f, GDK_CONTROL_MASK);
+	g_assert_cmpint(g_hash_table_size(index), ==, 1);
+
+	g_object_unref(mi);
+	g_object_unref(menu);
+	g_object_unref(group);
+
+	return;
+}
+
+/* Counts the handlers on the widget that were hooked up for the item */
+static guint
+test_parser_type_change_hooks (GtkWidget * widget, DbusmenuMenuitem * mi)
+{
+	guint count = g_signal_handlers_block_matched(widget, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, mi);
+	g_signal_handlers_unblock_matched(widget, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, mi);
+	return count;
+}
+
+static void
+test_parser_type_change_changed (DbusmenuMenuitem * mi, const gchar * property, GVariant * value, GString * changed)
+{
+	g_string_append_printf(changed, "%s ", property);
+	return;
+}
+
+/* An item that starts out as a separator and then gets a label
+   should stay the same item, just with different properties.  Only
+   the properties that are different get signalled and the widget
+   is only hooked up for the new type. */
+static void
+test_parser_type_change (void)
+{
+	GtkWidget * menu = gtk_menu_new();
+	g_object_ref_sink(menu);
+
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_menu_item_new_with_label("Before"));
+	GtkWidget * item = gtk_menu_item_new();
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_menu_item_new_with_label("After"));
+
+	DbusmenuMenuitem * mi = dbusmenu_gtk_parse_menu_structure(menu);
+	g_assert(mi != NULL);
+
+	DbusmenuMenuitem * sep = dbusmenu_gtk_parse_get_cached_item(item);
+	g_assert(sep != NULL);
+	gint id = dbusmenu_menuitem_get_id(sep);
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(sep, DBUSMENU_MENUITEM_PROP_TYPE), ==, DBUSMENU_CLIENT_TYPES_SEPARATOR);
+	guint hooks = test_parser_type_change_hooks(item, sep);
+
+	GString * changed = g_string_new("");
+	g_signal_connect(sep, DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(test_parser_type_change_changed), changed);
+
+	gtk_container_add(GTK_CONTAINER(item), gtk_label_new("Now"));
+
+	g_assert(dbusmenu_gtk_parse_get_cached_item(item) == sep);
+	g_assert(dbusmenu_menuitem_get_id(sep) == id);
+	g_assert(dbusmenu_menuitem_get_position(sep, mi) == 1);
+	g_assert(g_list_length(dbusmenu_menuitem_get_children(mi)) == 3);
+	g_assert(dbusmenu_menuitem_property_get(sep, DBUSMENU_MENUITEM_PROP_TYPE) == NULL);
+	g_assert_cmpstr(dbusmenu_menuitem_property_get(sep, DBUSMENU_MENUITEM_PROP_LABEL), ==, "Now");
+
+	/* Visible and enabled were the same for both */
+	g_assert(strstr(changed->str, DBUSMENU_MENUITEM_PROP_TYPE " ") != NULL);
+	g_assert(strstr(changed->str, DBUSMENU_MENUITEM_PROP_LABEL " ") != NULL);
+	g_assert(strstr(changed->str, DBUSMENU_MENUITEM_PROP_VISIBLE " ") == NULL);
+	g_assert(strstr(changed->str, DBUSMENU_MENUITEM_PROP_ENABLED " ") == NULL);
+	g_string_free(changed, TRUE);
+
+	/* A labelled item also watches for its shortcuts, and nothing
+	   from the separator is left behind */
+	g_assert_cmpuint(test_parser_type_change_hooks(item, sep), ==, hooks + 1);
+
+	g_object_unref(mi);
+	g_object_unref(menu);
+
+	return;
+}
+
 /* Build the test suite */
 static void
 test_gtk_parser_suite (void)
 {
 	g_test_add_func ("/dbusmenu/gtk/parser/base",          test_parser_runs);
 	g_test_add_func ("/dbusmenu/gtk/parser/children",      test_parser_children);
+	g_test_add_func ("/dbusmenu/gtk/parser/shortcuts",     test_parser_shortcuts);
+	g_test_add_func ("/dbusmenu/gtk/parser/shortcuts_changed", test_parser_shortcuts_changed);
+	g_test_add_func ("/dbusmenu/gtk/parser/type_change",   test_parser_type_change);
 	return;
 }
 
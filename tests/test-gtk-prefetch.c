@@ -0,0 +1,294 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The GTK client tells the server a submenu is about to be shown
+   when the pointer rests on its item, but not when it only passes
+   over it.  A submenu that opens without that shows right away,
+   without waiting on the server, and gets filled in when the
+   server's answer comes back. */
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/client.h>
+
+#include "test-loopback.h"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static DbusmenuGtkClient * client = NULL;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+/* How many times the server heard about each folder */
+static guint shown_first = 0;
+static guint shown_second = 0;
+
+static gboolean
+first_about_to_show (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	shown_first++;
+	return TRUE;
+}
+
+/* Fills the folder in only once it's asked for */
+static gboolean
+second_about_to_show (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	shown_second++;
+
+	if (dbusmenu_menuitem_child_find(mi, 22) == NULL) {
+		DbusmenuMenuitem * late = item_new(22, "Late");
+		dbusmenu_menuitem_child_append(mi, late);
+		g_object_unref(late);
+	}
+
+	return TRUE;
+}
+
+static DbusmenuMenuitem *
+client_item (gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_menuitem_find_id(root, id);
+}
+
+static GtkMenuItem *
+widget_get (gint id)
+{
+	DbusmenuMenuitem * mi = client_item(id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_gtkclient_menuitem_get(client, mi);
+}
+
+static GtkMenu *
+submenu_get (gint id)
+{
+	DbusmenuMenuitem * mi = client_item(id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_gtkclient_menuitem_get_submenu(client, mi);
+}
+
+static guint
+menu_count (GtkMenu * menu)
+{
+	GList * children = gtk_container_get_children(GTK_CONTAINER(menu));
+	guint count = g_list_length(children);
+	g_list_free(children);
+	return count;
+}
+
+/* Polls until the submenu of the folder has this many items */
+static gint wanted_folder = 0;
+static guint wanted_count = 0;
+
+static gboolean
+wait_items (gpointer user_data)
+{
+	GtkMenu * menu = submenu_get(wanted_folder);
+	if (menu == NULL || menu_count(menu) != wanted_count) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static gboolean
+wait_shown (gpointer user_data)
+{
+	if (shown_first == 0) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static gboolean
+wait_over (gpointer user_data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Just lets the time go by */
+static void
+wait_time (guint milliseconds)
+{
+	if (!passed) {
+		return;
+	}
+
+	g_timeout_add(milliseconds, wait_over, NULL);
+	loopback_run(mainloop, 10);
+
+	return;
+}
+
+static void
+wait_for (GSourceFunc func, const gchar * what)
+{
+	if (!passed) {
+		return;
+	}
+
+	guint poll = g_timeout_add(1, func, NULL);
+	if (!loopback_run(mainloop, 10)) {
+		g_warning("Timed out: %s", what);
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+static void
+wait_menu (gint folder, guint count, const gchar * what)
+{
+	wanted_folder = folder;
+	wanted_count = count;
+	wait_for(wait_items, what);
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * first = item_new(1, "First");
+	dbusmenu_menuitem_child_append(root, first);
+	g_object_unref(first);
+	DbusmenuMenuitem * child = item_new(11, "One");
+	dbusmenu_menuitem_child_append(first, child);
+	g_object_unref(child);
+	g_signal_connect(G_OBJECT(first), DBUSMENU_MENUITEM_SIGNAL_ABOUT_TO_SHOW, G_CALLBACK(first_about_to_show), NULL);
+
+	DbusmenuMenuitem * second = item_new(2, "Second");
+	dbusmenu_menuitem_child_append(root, second);
+	g_object_unref(second);
+	child = item_new(21, "Two");
+	dbusmenu_menuitem_child_append(second, child);
+	g_object_unref(child);
+	g_signal_connect(G_OBJECT(second), DBUSMENU_MENUITEM_SIGNAL_ABOUT_TO_SHOW, G_CALLBACK(second_about_to_show), NULL);
+
+	dbusmenu_server_set_root(server, root);
+
+	client = g_object_new(DBUSMENU_GTKCLIENT_TYPE,
+	                      DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, client_bus,
+	                      DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                      NULL);
+
+	wait_menu(1, 1, "first submenu");
+	wait_menu(2, 1, "second submenu");
+
+	/* Resting on the item gets the submenu ready */
+	if (passed) {
+		gtk_menu_item_select(widget_get(1));
+	}
+	wait_for(wait_shown, "prefetch after resting");
+	if (passed) {
+		gtk_menu_item_deselect(widget_get(1));
+		check(shown_first == 1, "first prefetched once");
+		check(shown_second == 0, "second not prefetched");
+	}
+
+	/* Passing over doesn't */
+	if (passed) {
+		gtk_menu_item_select(widget_get(2));
+		gtk_menu_item_deselect(widget_get(2));
+	}
+	wait_time(200);
+	if (passed) {
+		check(shown_second == 0, "second not prefetched when passing over");
+	}
+
+	/* Opening doesn't wait for the server, it shows what's there
+	   and fills in when the answer comes back */
+	GtkMenu * menu = NULL;
+	if (passed) {
+		/* Held so that it can be compared afterwards */
+		menu = g_object_ref(submenu_get(2));
+		gtk_widget_show(GTK_WIDGET(menu));
+		check(shown_second == 0, "opening didn't run the main loop");
+		check(menu_count(menu) == 1, "opened with what was there");
+	}
+	wait_menu(2, 2, "filled in after opening");
+	if (passed) {
+		check(shown_second == 1, "second told once");
+		check(submenu_get(2) == menu, "same menu filled in");
+		gtk_widget_hide(GTK_WIDGET(menu));
+	}
+	if (menu != NULL) {
+		g_object_unref(menu);
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
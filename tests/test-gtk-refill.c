@@ -0,0 +1,271 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2009 Canonical Ltd.
+
+Authors:
+    Ted Gould <ted@canonical.com>
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Clears out a submenu on the server and fills it up again, the
+   GTK client should keep the same GtkMenu for it the whole time.
+   Then takes the submenu away for real and makes sure the menu
+   gets released and handed out again to the next submenu. */
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/client.h>
+
+#include "test-loopback.h"
+
+#define MENU_TAG  "test-gtk-refill-menu"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static DbusmenuGtkClient * client = NULL;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+/* The submenu on the client for the item */
+static GtkMenu *
+submenu_get (gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root == NULL) {
+		return NULL;
+	}
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(root, id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_gtkclient_menuitem_get_submenu(client, mi);
+}
+
+/* The labels in a GTK menu, all in one string */
+static gchar *
+menu_labels (GtkMenu * menu)
+{
+	GString * labels = g_string_new(NULL);
+	GList * children = gtk_container_get_children(GTK_CONTAINER(menu));
+	GList * child;
+
+	for (child = children; child != NULL; child = g_list_next(child)) {
+		g_string_append_printf(labels, "%s%s", labels->len == 0 ? "" : " ", gtk_menu_item_get_label(GTK_MENU_ITEM(child->data)));
+	}
+
+	g_list_free(children);
+	return g_string_free(labels, FALSE);
+}
+
+/* Polls until the submenu of the item has these labels in it */
+static gboolean
+wait_labels (gpointer user_data)
+{
+	const gchar * expected = (const gchar *)user_data;
+	GtkMenu * menu = submenu_get(1);
+	if (menu == NULL) {
+		return TRUE;
+	}
+
+	gchar * labels = menu_labels(menu);
+	gboolean done = (g_strcmp0(labels, expected) == 0);
+	g_free(labels);
+
+	if (!done) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Polls until the item's submenu is gone */
+static gboolean
+wait_released (gpointer user_data)
+{
+	if (submenu_get(1) != NULL) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Polls until the item has a submenu */
+static gboolean
+wait_submenu (gpointer user_data)
+{
+	if (submenu_get(GPOINTER_TO_INT(user_data)) == NULL) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+wait_for (GSourceFunc func, gpointer data)
+{
+	if (!passed) {
+		return;
+	}
+
+	guint poll = g_timeout_add(1, func, data);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * folder = item_new(1, "Folder");
+	dbusmenu_menuitem_property_set(folder, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(root, folder);
+	g_object_unref(folder);
+
+	DbusmenuMenuitem * other = item_new(2, "Other");
+	dbusmenu_menuitem_child_append(root, other);
+	g_object_unref(other);
+
+	DbusmenuMenuitem * child = item_new(11, "One");
+	dbusmenu_menuitem_child_append(folder, child);
+	g_object_unref(child);
+	child = item_new(12, "Two");
+	dbusmenu_menuitem_child_append(folder, child);
+	g_object_unref(child);
+
+	dbusmenu_server_set_root(server, root);
+
+	client = g_object_new(DBUSMENU_GTKCLIENT_TYPE,
+	                      DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, client_bus,
+	                      DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                      NULL);
+
+	wait_for(wait_labels, "One Two");
+	GtkMenu * menu = submenu_get(1);
+	if (menu != NULL) {
+		/* Once it's released the pointer can't be trusted, the tag
+		   only comes back with the same menu */
+		g_object_set_data(G_OBJECT(menu), MENU_TAG, GINT_TO_POINTER(TRUE));
+	}
+
+	/* Clear it out and fill it up again */
+	if (passed) {
+		GList * children = g_list_copy(dbusmenu_menuitem_get_children(folder));
+		GList * lchild;
+		for (lchild = children; lchild != NULL; lchild = g_list_next(lchild)) {
+			dbusmenu_menuitem_child_delete(folder, DBUSMENU_MENUITEM(lchild->data));
+		}
+		g_list_free(children);
+
+		child = item_new(13, "Three");
+		dbusmenu_menuitem_child_append(folder, child);
+		g_object_unref(child);
+		child = item_new(14, "Four");
+		dbusmenu_menuitem_child_append(folder, child);
+		g_object_unref(child);
+	}
+
+	wait_for(wait_labels, "Three Four");
+	if (passed) {
+		check(submenu_get(1) == menu, "same menu after refilling");
+	}
+
+	/* Empty, but still a submenu */
+	if (passed) {
+		GList * children = g_list_copy(dbusmenu_menuitem_get_children(folder));
+		GList * lchild;
+		for (lchild = children; lchild != NULL; lchild = g_list_next(lchild)) {
+			dbusmenu_menuitem_child_delete(folder, DBUSMENU_MENUITEM(lchild->data));
+		}
+		g_list_free(children);
+	}
+
+	wait_for(wait_labels, "");
+	if (passed) {
+		check(submenu_get(1) == menu, "same menu while empty");
+
+		/* Now it's not a submenu anymore */
+		dbusmenu_menuitem_property_remove(folder, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY);
+	}
+
+	wait_for(wait_released, NULL);
+
+	/* The next submenu gets the menu that was released */
+	if (passed) {
+		dbusmenu_menuitem_property_set(other, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+		child = item_new(21, "Other One");
+		dbusmenu_menuitem_child_append(other, child);
+		g_object_unref(child);
+	}
+
+	wait_for(wait_submenu, GINT_TO_POINTER(2));
+	if (passed) {
+		GtkMenu * reused = submenu_get(2);
+		check(reused != NULL && g_object_get_data(G_OBJECT(reused), MENU_TAG) != NULL, "released menu was reused");
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
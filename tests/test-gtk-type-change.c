@@ -0,0 +1,234 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Turns an item with a submenu into a separator on the server and
+   back again.  The GTK client has to swap the widget each time,
+   keeping it in the same place and keeping its submenu. */
+
+#include <gtk/gtk.h>
+
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-gtk/client.h>
+
+#include "test-loopback.h"
+
+#define SUBMENU_TAG  "test-gtk-type-change-submenu"
+
+static GMainLoop * mainloop = NULL;
+static gboolean passed = TRUE;
+
+static DbusmenuGtkClient * client = NULL;
+
+static void
+check (gboolean value, const gchar * what)
+{
+	if (!value) {
+		g_warning("Failed: %s", what);
+		passed = FALSE;
+	}
+	return;
+}
+
+static DbusmenuMenuitem *
+item_new (gint id, const gchar * label)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_new_with_id(id);
+	dbusmenu_menuitem_property_set(mi, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	return mi;
+}
+
+/* The item on the client with the ID */
+static DbusmenuMenuitem *
+client_item (gint id)
+{
+	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(client));
+	if (root == NULL) {
+		return NULL;
+	}
+
+	return dbusmenu_menuitem_find_id(root, id);
+}
+
+/* The widget at a position in the submenu of the item */
+static GtkWidget *
+widget_at (gint id, guint position)
+{
+	DbusmenuMenuitem * mi = client_item(id);
+	if (mi == NULL) {
+		return NULL;
+	}
+
+	GtkMenu * menu = dbusmenu_gtkclient_menuitem_get_submenu(client, mi);
+	if (menu == NULL) {
+		return NULL;
+	}
+
+	GList * children = gtk_container_get_children(GTK_CONTAINER(menu));
+	GtkWidget * widget = NULL;
+	if (g_list_length(children) == 3) {
+		widget = GTK_WIDGET(g_list_nth_data(children, position));
+	}
+	g_list_free(children);
+
+	return widget;
+}
+
+/* Polls until the middle of the folder is a separator, or isn't */
+static gboolean
+wait_separator (gpointer user_data)
+{
+	gboolean separator = GPOINTER_TO_INT(user_data);
+	GtkWidget * widget = widget_at(1, 1);
+	if (widget == NULL || GTK_IS_SEPARATOR_MENU_ITEM(widget) != separator) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Polls until the middle item has its submenu */
+static gboolean
+wait_submenu (gpointer user_data)
+{
+	DbusmenuMenuitem * mi = client_item(12);
+	if (mi == NULL || dbusmenu_gtkclient_menuitem_get_submenu(client, mi) == NULL) {
+		return TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void
+wait_for (GSourceFunc func, gpointer data)
+{
+	if (!passed) {
+		return;
+	}
+
+	guint poll = g_timeout_add(1, func, data);
+	if (!loopback_run(mainloop, 10)) {
+		g_source_remove(poll);
+		passed = FALSE;
+	}
+
+	return;
+}
+
+/* The middle widget is the one for the item and has its submenu */
+static void
+check_middle (const gchar * what)
+{
+	DbusmenuMenuitem * mi = client_item(12);
+	GtkWidget * widget = widget_at(1, 1);
+
+	check(GTK_WIDGET(dbusmenu_gtkclient_menuitem_get(client, mi)) == widget, what);
+
+	GtkWidget * submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(widget));
+	check(submenu != NULL && g_object_get_data(G_OBJECT(submenu), SUBMENU_TAG) != NULL, what);
+
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	gtk_init(&argc, &argv);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	GDBusConnection * client_bus = NULL;
+	if (!loopback_connect(mainloop, &server_bus, &client_bus)) {
+		return 1;
+	}
+
+	DbusmenuServer * server = dbusmenu_server_new_for_connection(server_bus, "/org/test");
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+
+	DbusmenuMenuitem * folder = item_new(1, "Folder");
+	dbusmenu_menuitem_property_set(folder, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(root, folder);
+	g_object_unref(folder);
+
+	DbusmenuMenuitem * child = item_new(11, "Before");
+	dbusmenu_menuitem_child_append(folder, child);
+	g_object_unref(child);
+
+	DbusmenuMenuitem * middle = item_new(12, "Middle");
+	dbusmenu_menuitem_property_set(middle, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+	dbusmenu_menuitem_child_append(folder, middle);
+	g_object_unref(middle);
+
+	child = item_new(121, "Inside");
+	dbusmenu_menuitem_child_append(middle, child);
+	g_object_unref(child);
+
+	child = item_new(13, "After");
+	dbusmenu_menuitem_child_append(folder, child);
+	g_object_unref(child);
+
+	dbusmenu_server_set_root(server, root);
+
+	client = g_object_new(DBUSMENU_GTKCLIENT_TYPE,
+	                      DBUSMENU_CLIENT_PROP_DBUS_CONNECTION, client_bus,
+	                      DBUSMENU_CLIENT_PROP_DBUS_OBJECT, "/org/test",
+	                      NULL);
+
+	wait_for(wait_separator, GINT_TO_POINTER(FALSE));
+	wait_for(wait_submenu, NULL);
+
+	if (passed) {
+		GtkMenu * submenu = dbusmenu_gtkclient_menuitem_get_submenu(client, client_item(12));
+		g_object_set_data(G_OBJECT(submenu), SUBMENU_TAG, GINT_TO_POINTER(TRUE));
+		check_middle("first layout");
+
+		dbusmenu_menuitem_property_set(middle, DBUSMENU_MENUITEM_PROP_TYPE, DBUSMENU_CLIENT_TYPES_SEPARATOR);
+	}
+
+	wait_for(wait_separator, GINT_TO_POINTER(TRUE));
+
+	if (passed) {
+		check_middle("made a separator");
+
+		dbusmenu_menuitem_property_remove(middle, DBUSMENU_MENUITEM_PROP_TYPE);
+	}
+
+	wait_for(wait_separator, GINT_TO_POINTER(FALSE));
+
+	if (passed) {
+		check_middle("made a normal item again");
+		check(g_strcmp0(gtk_menu_item_get_label(GTK_MENU_ITEM(widget_at(1, 1))), "Middle") == 0, "label is back");
+	}
+
+	g_object_unref(G_OBJECT(client));
+	g_object_unref(G_OBJECT(server));
+	g_object_unref(G_OBJECT(root));
+	g_object_unref(G_OBJECT(client_bus));
+	g_object_unref(G_OBJECT(server_bus));
+
+	if (passed) {
+		g_debug("Quiting");
+		return 0;
+	} else {
+		g_debug("Quiting as we're a failure");
+		return 1;
+	}
+}
@@ -0,0 +1,181 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/socket.h>
+
+#include "test-loopback.h"
+
+typedef struct _loopback_wait_t loopback_wait_t;
+struct _loopback_wait_t {
+	GMainLoop * mainloop;
+	gboolean failed;
+	gboolean done;
+	gpointer result;
+};
+
+static void
+connection_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	loopback_wait_t * wait = (loopback_wait_t *)user_data;
+	GError * error = NULL;
+
+	wait->result = g_dbus_connection_new_finish(res, &error);
+	if (error != NULL) {
+		g_warning("Unable to build loopback connection: %s", error->message);
+		g_error_free(error);
+		wait->failed = TRUE;
+	}
+	wait->done = TRUE;
+
+	g_main_loop_quit(wait->mainloop);
+	return;
+}
+
+/* Makes a socket pair with a connection on each end of it for
+   the server and the client.  Both ends need to handshake with
+   each other, so start them both and then spin until they're done. */
+gboolean
+loopback_connect (GMainLoop * mainloop, GDBusConnection ** server_bus, GDBusConnection ** client_bus)
+{
+	*server_bus = NULL;
+	*client_bus = NULL;
+
+	gint fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		g_warning("Unable to create socket pair");
+		return FALSE;
+	}
+
+	loopback_wait_t server_wait = { mainloop, FALSE, FALSE, NULL };
+	loopback_wait_t client_wait = { mainloop, FALSE, FALSE, NULL };
+	gchar * guid = g_dbus_generate_guid();
+
+	GSocket * server_socket = g_socket_new_from_fd(fds[0], NULL);
+	GSocket * client_socket = g_socket_new_from_fd(fds[1], NULL);
+	GSocketConnection * server_stream = g_socket_connection_factory_create_connection(server_socket);
+	GSocketConnection * client_stream = g_socket_connection_factory_create_connection(client_socket);
+	g_object_unref(server_socket);
+	g_object_unref(client_socket);
+
+	g_dbus_connection_new(G_IO_STREAM(server_stream), guid,
+	                      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER | G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS,
+	                      NULL, NULL, connection_cb, &server_wait);
+	g_dbus_connection_new(G_IO_STREAM(client_stream), NULL,
+	                      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+	                      NULL, NULL, connection_cb, &client_wait);
+	g_object_unref(server_stream);
+	g_object_unref(client_stream);
+	g_free(guid);
+
+	/* Each one quits the loop when it's done, wait for both, even
+	   after a failure, as they point at our stack */
+	while (!server_wait.done || !client_wait.done) {
+		g_main_loop_run(mainloop);
+	}
+
+	*server_bus = server_wait.result;
+	*client_bus = client_wait.result;
+
+	if (server_wait.failed || client_wait.failed) {
+		g_clear_object(server_bus);
+		g_clear_object(client_bus);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+timer_func (gpointer user_data)
+{
+	loopback_wait_t * wait = (loopback_wait_t *)user_data;
+
+	g_debug("Death timer.  Oops.");
+	wait->failed = TRUE;
+	g_main_loop_quit(wait->mainloop);
+	return FALSE;
+}
+
+/* Runs the main loop until something quits it, returns FALSE
+   if it had to be stopped after @seconds */
+gboolean
+loopback_run (GMainLoop * mainloop, guint seconds)
+{
+	loopback_wait_t wait = { mainloop, FALSE, FALSE, NULL };
+
+	guint death = g_timeout_add_seconds(seconds, timer_func, &wait);
+	g_main_loop_run(mainloop);
+
+	if (!wait.failed) {
+		g_source_remove(death);
+	}
+
+	return !wait.failed;
+}
+
+static void
+call_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	loopback_wait_t * wait = (loopback_wait_t *)user_data;
+	GError * error = NULL;
+
+	wait->result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+	if (error != NULL) {
+		g_warning("Unable to call the server: %s", error->message);
+		g_error_free(error);
+	}
+	wait->done = TRUE;
+
+	/* The timer may have given up on us already */
+	if (wait->mainloop != NULL) {
+		g_main_loop_quit(wait->mainloop);
+	} else {
+		if (wait->result != NULL) {
+			g_variant_unref(wait->result);
+		}
+		g_free(wait);
+	}
+
+	return;
+}
+
+/* Calls a method on the menu at "/org/test" and waits for the
+   reply, returns NULL if there isn't one */
+GVariant *
+loopback_call (GMainLoop * mainloop, GDBusConnection * bus, const gchar * method, GVariant * params, const gchar * type)
+{
+	loopback_wait_t * wait = g_new0(loopback_wait_t, 1);
+	wait->mainloop = mainloop;
+
+	g_dbus_connection_call(bus, NULL, "/org/test", "com.canonical.dbusmenu", method,
+	                       params, G_VARIANT_TYPE(type),
+	                       G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+	                       call_cb, wait);
+
+	while (!wait->done) {
+		if (!loopback_run(mainloop, 10)) {
+			/* Let the reply clean up when it comes */
+			wait->mainloop = NULL;
+			return NULL;
+		}
+	}
+
+	GVariant * reply = wait->result;
+	g_free(wait);
+	return reply;
+}
@@ -0,0 +1,40 @@
+/*
+A test for libdbusmenu to ensure its quality.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The parts shared by the tests that put a server and a client in
+   the same process, talking over a socket pair instead of a bus
+   daemon. */
+
+#ifndef __TEST_LOOPBACK_H__
+#define __TEST_LOOPBACK_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+gboolean     loopback_connect    (GMainLoop * mainloop,
+                                  GDBusConnection ** server_bus,
+                                  GDBusConnection ** client_bus);
+gboolean     loopback_run        (GMainLoop * mainloop,
+                                  guint seconds);
+GVariant *   loopback_call       (GMainLoop * mainloop,
+                                  GDBusConnection * bus,
+                                  const gchar * method,
+                                  GVariant * params,
+                                  const gchar * type);
+
+#endif /* __TEST_LOOPBACK_H__ */
@@ -0,0 +1,1134 @@
+/*
+A small tool to record the traffic of a dbusmenu that a program
+is exporting and replay it between a server and a client on a
+private bus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include <libdbusmenu-glib/client.h>
+#include <libdbusmenu-glib/server.h>
+#include <libdbusmenu-glib/menuitem.h>
+
+#define DBUSMENU_INTERFACE  "com.canonical.dbusmenu"
+
+/* How long the client gets to catch up with one change */
+#define SYNC_TIMEOUT  5
+
+/* Each line of a recording is a GVariant of type (xsv) in the text
+   format, with the types annotated so that nothing gets lost going
+   back and forth.  That's the time in microseconds from the start of
+   the recording, the kind of record and its payload:
+
+     "layout"      (u(ia{sv}av))        What GetLayout returned for the
+                                        whole menu, first at the start
+                                        and then after each LayoutUpdated
+     "properties"  (a(ia{sv})a(ias))    An ItemsPropertiesUpdated signal
+     "call"        (sv)                 A method a client called and its
+                                        parameters
+*/
+#define RECORD_TYPE  "(xsv)"
+
+typedef struct _record_t record_t;
+struct _record_t {
+	gint64 time;
+	gchar * kind;
+	GVariant * payload;
+};
+
+static GMainLoop * mainloop = NULL;
+
+static gboolean recording = FALSE;
+static gchar * dbusname = NULL;
+static gchar * dbusobject = NULL;
+static gint duration = 0;
+static gboolean fast = FALSE;
+
+static void
+record_free (record_t * record)
+{
+	g_free(record->kind);
+	if (record->payload != NULL) {
+		g_variant_unref(record->payload);
+	}
+	g_free(record);
+	return;
+}
+
+/* *** Recording *** */
+
+typedef struct _captured_t captured_t;
+struct _captured_t {
+	gint64 time;
+	GDBusMessage * message;
+};
+
+static GDBusConnection * bus = NULL;
+static GDBusConnection * monitor = NULL;
+static gchar * owner = NULL;
+static FILE * output = NULL;
+static gint64 start = 0;
+static GQueue records = G_QUEUE_INIT;
+static gboolean stopping = FALSE;
+static guint recorded = 0;
+
+/* Writes out the records in order, stopping at a layout that
+   we're still waiting on */
+static void
+records_flush (void)
+{
+	record_t * record;
+
+	while ((record = g_queue_peek_head(&records)) != NULL && record->payload != NULL) {
+		g_queue_pop_head(&records);
+
+		GVariant * line = g_variant_ref_sink(g_variant_new("(xsv)", record->time, record->kind, record->payload));
+		gchar * text = g_variant_print(line, TRUE);
+		fprintf(output, "%s\n", text);
+		g_free(text);
+		g_variant_unref(line);
+
+		record_free(record);
+		recorded++;
+	}
+
+	if (stopping && g_queue_is_empty(&records)) {
+		g_main_loop_quit(mainloop);
+	}
+
+	return;
+}
+
+static void
+record_add (gint64 time, const gchar * kind, GVariant * payload)
+{
+	record_t * record = g_new0(record_t, 1);
+	record->time = time;
+	record->kind = g_strdup(kind);
+	record->payload = g_variant_ref_sink(payload);
+
+	g_queue_push_tail(&records, record);
+	records_flush();
+	return;
+}
+
+static void
+record_layout_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	record_t * record = (record_t *)user_data;
+	GError * error = NULL;
+
+	record->payload = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+	if (error != NULL) {
+		g_warning("Unable to get layout: %s", error->message);
+		g_error_free(error);
+		g_queue_remove(&records, record);
+		record_free(record);
+	}
+
+	records_flush();
+	return;
+}
+
+/* The signals only tell us that the layout changed, so we grab the
+   whole thing to have something to replay. */
+static void
+record_layout (gint64 time)
+{
+	record_t * record = g_new0(record_t, 1);
+	record->time = time;
+	record->kind = g_strdup("layout");
+	record->payload = NULL;
+	g_queue_push_tail(&records, record);
+
+	const gchar * props[] = { NULL };
+	g_dbus_connection_call(bus, owner, dbusobject, DBUSMENU_INTERFACE, "GetLayout",
+	                       g_variant_new("(ii^as)", 0, -1, props),
+	                       G_VARIANT_TYPE("(u(ia{sv}av))"),
+	                       G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+	                       record_layout_cb, record);
+
+	return;
+}
+
+static gboolean
+monitor_message (gpointer user_data)
+{
+	captured_t * captured = (captured_t *)user_data;
+	GDBusMessage * message = captured->message;
+
+	if (g_strcmp0(g_dbus_message_get_path(message), dbusobject) == 0 &&
+			g_strcmp0(g_dbus_message_get_interface(message), DBUSMENU_INTERFACE) == 0) {
+		const gchar * member = g_dbus_message_get_member(message);
+		GVariant * body = g_dbus_message_get_body(message);
+		if (body != NULL) {
+			g_variant_ref(body);
+		} else {
+			body = g_variant_ref_sink(g_variant_new("()"));
+		}
+
+		switch (g_dbus_message_get_message_type(message)) {
+		case G_DBUS_MESSAGE_TYPE_SIGNAL:
+			if (g_strcmp0(g_dbus_message_get_sender(message), owner) != 0) {
+				break;
+			}
+
+			if (g_strcmp0(member, "ItemsPropertiesUpdated") == 0) {
+				record_add(captured->time, "properties", body);
+			} else if (g_strcmp0(member, "LayoutUpdated") == 0) {
+				record_layout(captured->time);
+			}
+			break;
+		case G_DBUS_MESSAGE_TYPE_METHOD_CALL: {
+			const gchar * destination = g_dbus_message_get_destination(message);
+			if (g_strcmp0(destination, owner) != 0 && g_strcmp0(destination, dbusname) != 0) {
+				break;
+			}
+
+			/* Our own layout grabs aren't part of the traffic */
+			if (g_strcmp0(g_dbus_message_get_sender(message), g_dbus_connection_get_unique_name(bus)) == 0) {
+				break;
+			}
+
+			record_add(captured->time, "call", g_variant_new("(sv)", member, body));
+			break;
+		}
+		default:
+			break;
+		}
+
+		g_variant_unref(body);
+	}
+
+	g_object_unref(message);
+	g_free(captured);
+	return FALSE;
+}
+
+/* Runs in the GDBus thread, so we only timestamp the messages
+   here and look at them in the main loop. */
+static GDBusMessage *
+monitor_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (!incoming) {
+		return message;
+	}
+
+	GDBusMessageType type = g_dbus_message_get_message_type(message);
+	if (type != G_DBUS_MESSAGE_TYPE_SIGNAL && type != G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+		return message;
+	}
+
+	captured_t * captured = g_new0(captured_t, 1);
+	captured->time = g_get_monotonic_time() - start;
+	captured->message = message;
+	g_main_context_invoke(NULL, monitor_message, captured);
+
+	/* A monitor is only supposed to listen, so we don't let GDBus
+	   reply to the calls that it sees. */
+	return NULL;
+}
+
+static gboolean
+record_stop (gpointer user_data)
+{
+	stopping = TRUE;
+	records_flush();
+	return FALSE;
+}
+
+static int
+record_main (const gchar * filename)
+{
+	GError * error = NULL;
+
+	if (dbusname == NULL || dbusobject == NULL) {
+		g_printerr("ERROR: recording needs both --dbus-name and --dbus-object\n");
+		return 1;
+	}
+
+	bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (error != NULL) {
+		g_printerr("ERROR: Unable to get session bus: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	GVariant * reply = g_dbus_connection_call_sync(bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+	                                               "org.freedesktop.DBus", "GetNameOwner",
+	                                               g_variant_new("(s)", dbusname), G_VARIANT_TYPE("(s)"),
+	                                               G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+	if (error != NULL) {
+		g_printerr("ERROR: Unable to find '%s': %s\n", dbusname, error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_variant_get(reply, "(s)", &owner);
+	g_variant_unref(reply);
+
+	/* The monitor needs a connection of its own as it can't be
+	   used for anything else once it is one. */
+	gchar * address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (error == NULL) {
+		monitor = g_dbus_connection_new_for_address_sync(address,
+		                                                 G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+		                                                 NULL, NULL, &error);
+	}
+	g_free(address);
+	if (error != NULL) {
+		g_printerr("ERROR: Unable to connect monitor: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	output = fopen(filename, "w");
+	if (output == NULL) {
+		g_printerr("ERROR: Unable to open '%s' for writing\n", filename);
+		return 1;
+	}
+	fprintf(output, "# dbusmenu-replay recording of %s %s\n", dbusname, dbusobject);
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	start = g_get_monotonic_time();
+	record_layout(0);
+
+	gchar * rules[4];
+	rules[0] = g_strdup_printf("type='signal',sender='%s',path='%s',interface='%s'", owner, dbusobject, DBUSMENU_INTERFACE);
+	rules[1] = g_strdup_printf("type='method_call',destination='%s',path='%s',interface='%s'", owner, dbusobject, DBUSMENU_INTERFACE);
+	rules[2] = g_strdup_printf("type='method_call',destination='%s',path='%s',interface='%s'", dbusname, dbusobject, DBUSMENU_INTERFACE);
+	rules[3] = NULL;
+
+	g_dbus_connection_add_filter(monitor, monitor_filter, NULL, NULL);
+	reply = g_dbus_connection_call_sync(monitor, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+	                                    "org.freedesktop.DBus.Monitoring", "BecomeMonitor",
+	                                    g_variant_new("(^asu)", rules, 0), NULL,
+	                                    G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+	g_free(rules[0]);
+	g_free(rules[1]);
+	g_free(rules[2]);
+	if (error != NULL) {
+		g_printerr("ERROR: Unable to monitor the bus: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_variant_unref(reply);
+
+	g_unix_signal_add(SIGINT, record_stop, NULL);
+	if (duration > 0) {
+		g_timeout_add_seconds(duration, record_stop, NULL);
+	}
+
+	g_main_loop_run(mainloop);
+
+	g_print("Recorded %d records over %f seconds\n", recorded, (g_get_monotonic_time() - start) / 1000000.0);
+
+	fclose(output);
+	g_object_unref(monitor);
+	g_object_unref(bus);
+	g_free(owner);
+
+	return 0;
+}
+
+/* *** Replaying *** */
+
+enum {
+	STAT_INITIAL,
+	STAT_LAYOUT,
+	STAT_PROPERTIES,
+	STAT_EVENT,
+	STAT_ABOUT_TO_SHOW,
+	STAT_OTHER_CALL,
+	STAT_COUNT
+};
+
+typedef struct _stat_t stat_t;
+struct _stat_t {
+	const gchar * name;
+	guint count;
+	gint64 total;
+	gint64 max;
+};
+
+static stat_t stats[STAT_COUNT] = {
+	{ "initial layout", 0, 0, 0 },
+	{ "layout",         0, 0, 0 },
+	{ "properties",     0, 0, 0 },
+	{ "event",          0, 0, 0 },
+	{ "about-to-show",  0, 0, 0 },
+	{ "other calls",    0, 0, 0 }
+};
+
+static DbusmenuServer * server = NULL;
+static DbusmenuClient * client = NULL;
+static GDBusConnection * client_bus = NULL;
+static DbusmenuMenuitem * root = NULL;
+static GHashTable * items = NULL;
+static gboolean connection_failed = FALSE;
+
+static GList * current = NULL;
+static record_t * previous = NULL;
+static guint replayed = 0;
+static gint stat_waiting = -1;
+static gint64 applied = 0;
+static gint64 synced = 0;
+static guint check_idle = 0;
+static guint sync_timeout = 0;
+static guint behind = 0;
+static guint lost = 0;
+static gint64 checking = 0;
+static GQueue events_sent = G_QUEUE_INIT;
+
+static void replay_next (void);
+
+static void
+stat_add (gint stat, gint64 elapsed)
+{
+	stats[stat].count++;
+	stats[stat].total += elapsed;
+	stats[stat].max = MAX(stats[stat].max, elapsed);
+	return;
+}
+
+static void
+forget_item (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	gint id = dbusmenu_menuitem_get_id(mi);
+	if (g_hash_table_lookup(items, GINT_TO_POINTER(id)) == mi) {
+		g_hash_table_remove(items, GINT_TO_POINTER(id));
+	}
+	return;
+}
+
+/* Makes the properties on the item match the dictionary */
+static void
+replace_properties (DbusmenuMenuitem * mi, GVariant * props)
+{
+	GList * names = dbusmenu_menuitem_properties_list(mi);
+	GList * name;
+	for (name = names; name != NULL; name = g_list_next(name)) {
+		GVariant * value = g_variant_lookup_value(props, (gchar *)name->data, NULL);
+		if (value == NULL) {
+			dbusmenu_menuitem_property_remove(mi, (gchar *)name->data);
+		} else {
+			g_variant_unref(value);
+		}
+	}
+	g_list_free(names);
+
+	GVariantIter iter;
+	gchar * key;
+	GVariant * value;
+	g_variant_iter_init(&iter, props);
+	while (g_variant_iter_loop(&iter, "{sv}", &key, &value)) {
+		dbusmenu_menuitem_property_set_variant(mi, key, value);
+	}
+
+	return;
+}
+
+/* Changes the tree on the server to match the recorded layout
+   reusing the items that are still there, much like an application
+   repopulating its menus would. */
+static void
+apply_layout (DbusmenuMenuitem * mi, GVariant * layout)
+{
+	GVariant * props = g_variant_get_child_value(layout, 1);
+	replace_properties(mi, props);
+	g_variant_unref(props);
+
+	GVariant * children = g_variant_get_child_value(layout, 2);
+	gsize count = g_variant_n_children(children);
+	gsize i;
+
+	for (i = 0; i < count; i++) {
+		GVariant * boxed = g_variant_get_child_value(children, i);
+		GVariant * child = g_variant_get_variant(boxed);
+		gint id;
+		g_variant_get_child(child, 0, "i", &id);
+
+		DbusmenuMenuitem * item = g_hash_table_lookup(items, GINT_TO_POINTER(id));
+		if (item == NULL) {
+			item = dbusmenu_menuitem_new_with_id(id);
+			g_hash_table_insert(items, GINT_TO_POINTER(id), item);
+			dbusmenu_menuitem_child_add_position(mi, item, i);
+			g_object_unref(item);
+		} else if (dbusmenu_menuitem_get_parent(item) != mi) {
+			g_object_ref(item);
+			dbusmenu_menuitem_child_delete(dbusmenu_menuitem_get_parent(item), item);
+			dbusmenu_menuitem_child_add_position(mi, item, i);
+			g_object_unref(item);
+		} else {
+			dbusmenu_menuitem_child_reorder(mi, item, i);
+		}
+
+		apply_layout(item, child);
+
+		g_variant_unref(child);
+		g_variant_unref(boxed);
+	}
+	g_variant_unref(children);
+
+	/* Everything after the new children is gone */
+	GList * extra;
+	while ((extra = g_list_nth(dbusmenu_menuitem_get_children(mi), count)) != NULL) {
+		DbusmenuMenuitem * gone = DBUSMENU_MENUITEM(extra->data);
+		dbusmenu_menuitem_foreach(gone, forget_item, NULL);
+		dbusmenu_menuitem_child_delete(mi, gone);
+	}
+
+	return;
+}
+
+static DbusmenuMenuitem *
+server_item (gint id)
+{
+	if (id == 0) {
+		return root;
+	}
+	return g_hash_table_lookup(items, GINT_TO_POINTER(id));
+}
+
+static void
+apply_properties (GVariant * payload)
+{
+	GVariantIter iter;
+	gint id;
+	GVariant * props;
+	const gchar ** removed;
+
+	GVariant * updated = g_variant_get_child_value(payload, 0);
+	g_variant_iter_init(&iter, updated);
+	while (g_variant_iter_loop(&iter, "(i@a{sv})", &id, &props)) {
+		DbusmenuMenuitem * mi = server_item(id);
+		if (mi == NULL) {
+			continue;
+		}
+
+		GVariantIter propiter;
+		gchar * key;
+		GVariant * value;
+		g_variant_iter_init(&propiter, props);
+		while (g_variant_iter_loop(&propiter, "{sv}", &key, &value)) {
+			dbusmenu_menuitem_property_set_variant(mi, key, value);
+		}
+	}
+
+	g_variant_unref(updated);
+
+	GVariant * removals = g_variant_get_child_value(payload, 1);
+	g_variant_iter_init(&iter, removals);
+	while (g_variant_iter_next(&iter, "(i^a&s)", &id, &removed)) {
+		DbusmenuMenuitem * mi = server_item(id);
+		gint i;
+		for (i = 0; mi != NULL && removed[i] != NULL; i++) {
+			dbusmenu_menuitem_property_remove(mi, removed[i]);
+		}
+		g_free(removed);
+	}
+	g_variant_unref(removals);
+
+	return;
+}
+
+static void
+about_to_show_done (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	gint64 * sent = (gint64 *)user_data;
+	stat_add(STAT_ABOUT_TO_SHOW, g_get_monotonic_time() - *sent);
+	g_free(sent);
+	return;
+}
+
+/* The client answers events in the order that it sent them, so
+   the oldest time sent is for this one */
+static void
+event_result (DbusmenuClient * client, DbusmenuMenuitem * mi, gchar * event, GVariant * data, guint timestamp, GError * error, gpointer user_data)
+{
+	gint64 * sent = g_queue_pop_head(&events_sent);
+	if (sent == NULL) {
+		return;
+	}
+
+	stat_add(STAT_EVENT, g_get_monotonic_time() - *sent);
+	g_free(sent);
+	return;
+}
+
+static void
+call_event (DbusmenuMenuitem * clientroot, GVariant * event)
+{
+	gint id;
+	const gchar * name;
+	GVariant * data;
+	guint timestamp;
+	g_variant_get(event, "(i&svu)", &id, &name, &data, &timestamp);
+
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(clientroot, id);
+	if (mi != NULL) {
+		gint64 * sent = g_new(gint64, 1);
+		*sent = g_get_monotonic_time();
+		g_queue_push_tail(&events_sent, sent);
+		dbusmenu_menuitem_handle_event(mi, name, data, timestamp);
+	}
+
+	g_variant_unref(data);
+	return;
+}
+
+static void
+call_about_to_show (DbusmenuMenuitem * clientroot, gint id)
+{
+	DbusmenuMenuitem * mi = dbusmenu_menuitem_find_id(clientroot, id);
+	if (mi == NULL) {
+		return;
+	}
+
+	gint64 * sent = g_new(gint64, 1);
+	*sent = g_get_monotonic_time();
+	dbusmenu_menuitem_send_about_to_show(mi, about_to_show_done, sent);
+	return;
+}
+
+static void
+other_call_done (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	gint64 * sent = (gint64 *)user_data;
+	GError * error = NULL;
+
+	GVariant * reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+	if (reply != NULL) {
+		g_variant_unref(reply);
+	}
+	if (error != NULL) {
+		g_debug("Replayed call failed: %s", error->message);
+		g_error_free(error);
+	}
+
+	stat_add(STAT_OTHER_CALL, g_get_monotonic_time() - *sent);
+	g_free(sent);
+	return;
+}
+
+/* Fetches aren't something the client can be asked to do, so they
+   go straight to the server on the client's connection */
+static void
+call_other (const gchar * method, GVariant * params)
+{
+	gint64 * sent = g_new(gint64, 1);
+	*sent = g_get_monotonic_time();
+	g_dbus_connection_call(client_bus,
+	                       NULL,
+	                       "/org/dbusmenu/replay",
+	                       "com.canonical.dbusmenu",
+	                       method,
+	                       params,
+	                       NULL,
+	                       G_DBUS_CALL_FLAGS_NONE,
+	                       -1,   /* timeout */
+	                       NULL, /* cancellable */
+	                       other_call_done,
+	                       sent);
+	return;
+}
+
+/* Makes the calls that the user caused through the client.  Any
+   other call is made again as it was recorded and timed too. */
+static void
+apply_call (GVariant * payload)
+{
+	const gchar * method;
+	GVariant * params;
+	g_variant_get(payload, "(&sv)", &method, &params);
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(client);
+
+	if (clientroot == NULL) {
+		/* Nothing to click on yet */
+	} else if (g_strcmp0(method, "Event") == 0) {
+		call_event(clientroot, params);
+	} else if (g_strcmp0(method, "EventGroup") == 0) {
+		GVariant * events = g_variant_get_child_value(params, 0);
+		GVariantIter iter;
+		GVariant * event;
+		g_variant_iter_init(&iter, events);
+		while ((event = g_variant_iter_next_value(&iter)) != NULL) {
+			call_event(clientroot, event);
+			g_variant_unref(event);
+		}
+		g_variant_unref(events);
+	} else if (g_strcmp0(method, "AboutToShow") == 0) {
+		gint id;
+		g_variant_get(params, "(i)", &id);
+		call_about_to_show(clientroot, id);
+	} else if (g_strcmp0(method, "AboutToShowGroup") == 0) {
+		GVariantIter * iter;
+		gint id;
+		g_variant_get(params, "(ai)", &iter);
+		while (g_variant_iter_next(iter, "i", &id)) {
+			call_about_to_show(clientroot, id);
+		}
+		g_variant_iter_free(iter);
+	} else {
+		call_other(method, params);
+	}
+
+	g_variant_unref(params);
+	return;
+}
+
+/* Checks the client's copy against the server's items */
+static gboolean
+verify_mirror (DbusmenuMenuitem * serveritem, DbusmenuMenuitem * clientitem)
+{
+	if (!dbusmenu_menuitem_get_root(clientitem) && dbusmenu_menuitem_get_id(serveritem) != dbusmenu_menuitem_get_id(clientitem)) {
+		return FALSE;
+	}
+
+	gboolean same = TRUE;
+	GList * names = dbusmenu_menuitem_properties_list(serveritem);
+	GList * name;
+	for (name = names; name != NULL && same; name = g_list_next(name)) {
+		GVariant * clientvalue = dbusmenu_menuitem_property_get_variant(clientitem, (gchar *)name->data);
+		same = clientvalue != NULL && g_variant_equal(clientvalue, dbusmenu_menuitem_property_get_variant(serveritem, (gchar *)name->data));
+	}
+	g_list_free(names);
+
+	names = dbusmenu_menuitem_properties_list(clientitem);
+	for (name = names; name != NULL && same; name = g_list_next(name)) {
+		same = dbusmenu_menuitem_property_get_variant(serveritem, (gchar *)name->data) != NULL;
+	}
+	g_list_free(names);
+
+	if (!same) {
+		return FALSE;
+	}
+
+	GList * serverchildren = dbusmenu_menuitem_get_children(serveritem);
+	GList * clientchildren = dbusmenu_menuitem_get_children(clientitem);
+
+	while (serverchildren != NULL && clientchildren != NULL) {
+		if (!verify_mirror(DBUSMENU_MENUITEM(serverchildren->data), DBUSMENU_MENUITEM(clientchildren->data))) {
+			return FALSE;
+		}
+
+		serverchildren = g_list_next(serverchildren);
+		clientchildren = g_list_next(clientchildren);
+	}
+
+	return serverchildren == NULL && clientchildren == NULL;
+}
+
+static void
+change_done (void)
+{
+	if (check_idle != 0) {
+		g_source_remove(check_idle);
+		check_idle = 0;
+	}
+	if (sync_timeout != 0) {
+		g_source_remove(sync_timeout);
+		sync_timeout = 0;
+	}
+
+	stat_waiting = -1;
+	synced = g_get_monotonic_time();
+	replay_next();
+	return;
+}
+
+static gboolean
+check_sync (gpointer user_data)
+{
+	check_idle = 0;
+
+	if (stat_waiting == -1) {
+		return FALSE;
+	}
+
+	DbusmenuMenuitem * clientroot = dbusmenu_client_get_root(client);
+	if (clientroot == NULL) {
+		return FALSE;
+	}
+
+	gint64 now = g_get_monotonic_time();
+	gboolean same = verify_mirror(root, clientroot);
+	checking += g_get_monotonic_time() - now;
+
+	if (same) {
+		stat_add(stat_waiting, now - applied);
+		change_done();
+	}
+
+	return FALSE;
+}
+
+/* Something changed on the client, see if it's caught up once
+   it's done with what it's doing */
+static void
+client_changed (void)
+{
+	if (stat_waiting != -1 && check_idle == 0) {
+		check_idle = g_idle_add_full(G_PRIORITY_LOW, check_sync, NULL, NULL);
+	}
+	return;
+}
+
+static void
+client_prop_changed (DbusmenuMenuitem * mi, gchar * property, GVariant * value, gpointer user_data)
+{
+	client_changed();
+	return;
+}
+
+static void
+client_new_menuitem (DbusmenuClient * client, DbusmenuMenuitem * mi, gpointer user_data)
+{
+	g_signal_connect(G_OBJECT(mi), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(client_prop_changed), NULL);
+	client_changed();
+	return;
+}
+
+static void
+client_root_changed (DbusmenuClient * client, DbusmenuMenuitem * newroot, gpointer user_data)
+{
+	if (newroot != NULL) {
+		g_signal_connect(G_OBJECT(newroot), DBUSMENU_MENUITEM_SIGNAL_PROPERTY_CHANGED, G_CALLBACK(client_prop_changed), NULL);
+	}
+	client_changed();
+	return;
+}
+
+static void
+client_layout_updated (DbusmenuClient * client, gpointer user_data)
+{
+	client_changed();
+	return;
+}
+
+static gboolean
+sync_timeout_cb (gpointer user_data)
+{
+	sync_timeout = 0;
+	g_warning("Client didn't catch up with record %d", replayed);
+	lost++;
+	change_done();
+	return FALSE;
+}
+
+static void
+apply (record_t * record)
+{
+	replayed++;
+	applied = g_get_monotonic_time();
+
+	if (g_strcmp0(record->kind, "layout") == 0) {
+		GVariant * layout = g_variant_get_child_value(record->payload, 1);
+		apply_layout(root, layout);
+		g_variant_unref(layout);
+		stat_waiting = replayed == 1 ? STAT_INITIAL : STAT_LAYOUT;
+	} else if (g_strcmp0(record->kind, "properties") == 0) {
+		apply_properties(record->payload);
+		stat_waiting = STAT_PROPERTIES;
+	} else if (g_strcmp0(record->kind, "call") == 0) {
+		apply_call(record->payload);
+		change_done();
+		return;
+	} else {
+		g_warning("Unknown record kind '%s'", record->kind);
+		change_done();
+		return;
+	}
+
+	/* It might not have changed anything */
+	sync_timeout = g_timeout_add_seconds(SYNC_TIMEOUT, sync_timeout_cb, NULL);
+	client_changed();
+	return;
+}
+
+static gboolean
+apply_timeout (gpointer user_data)
+{
+	apply((record_t *)user_data);
+	return FALSE;
+}
+
+static gboolean
+replay_done (gpointer user_data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+/* Waits for the same amount of time as there was between the
+   records, less the time the client took to catch up. */
+static void
+replay_next (void)
+{
+	record_t * record = current != NULL ? (record_t *)current->data : NULL;
+
+	if (record == NULL) {
+		/* Give the last of the AboutToShow calls a chance */
+		g_timeout_add(100, replay_done, NULL);
+		return;
+	}
+
+	current = g_list_next(current);
+
+	gint64 delay = 0;
+	if (!fast && previous != NULL) {
+		delay = (record->time - previous->time) - (synced - applied);
+		if (delay < 0) {
+			behind++;
+		}
+	}
+	previous = record;
+
+	if (delay > 0) {
+		g_timeout_add(delay / 1000, apply_timeout, record);
+	} else {
+		g_idle_add(apply_timeout, record);
+	}
+
+	return;
+}
+
+static GList *
+load_records (const gchar * filename)
+{
+	gchar * contents = NULL;
+	GError * error = NULL;
+
+	if (!g_file_get_contents(filename, &contents, NULL, &error)) {
+		g_printerr("ERROR: Unable to read '%s': %s\n", filename, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	gchar ** lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	GList * list = NULL;
+	gint i;
+	for (i = 0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0' || lines[i][0] == '#') {
+			continue;
+		}
+
+		GVariant * line = g_variant_parse(G_VARIANT_TYPE(RECORD_TYPE), lines[i], NULL, NULL, &error);
+		if (error != NULL) {
+			g_printerr("ERROR: Line %d of '%s' isn't a record: %s\n", i + 1, filename, error->message);
+			g_error_free(error);
+			g_list_free_full(list, (GDestroyNotify)record_free);
+	g_queue_foreach(&events_sent, (GFunc)g_free, NULL);
+	g_queue_clear(&events_sent);
+			g_strfreev(lines);
+			return NULL;
+		}
+
+		record_t * record = g_new0(record_t, 1);
+		g_variant_get(line, "(xsv)", &record->time, &record->kind, &record->payload);
+		g_variant_unref(line);
+
+		list = g_list_prepend(list, record);
+	}
+	g_strfreev(lines);
+
+	if (list == NULL) {
+		g_printerr("ERROR: No records in '%s'\n", filename);
+	}
+
+	return g_list_reverse(list);
+}
+
+static void
+connection_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GDBusConnection ** connection = (GDBusConnection **)user_data;
+
+	*connection = g_dbus_connection_new_finish(res, &error);
+	if (error != NULL) {
+		g_printerr("ERROR: Unable to build private bus: %s\n", error->message);
+		g_error_free(error);
+		connection_failed = TRUE;
+	}
+
+	g_main_loop_quit(mainloop);
+	return;
+}
+
+static gdouble
+cpu_time (void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+	       (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+static int
+replay_main (const gchar * filename)
+{
+	GList * list = load_records(filename);
+	if (list == NULL) {
+		return 1;
+	}
+
+	/* The server and the client talk over a socket pair so that
+	   nothing else on the bus gets in the way. */
+	gint fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		g_printerr("ERROR: Unable to create socket pair\n");
+		return 1;
+	}
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	GDBusConnection * server_bus = NULL;
+	gchar * guid = g_dbus_generate_guid();
+
+	GSocket * server_socket = g_socket_new_from_fd(fds[0], NULL);
+	GSocket * client_socket = g_socket_new_from_fd(fds[1], NULL);
+	GSocketConnection * server_stream = g_socket_connection_factory_create_connection(server_socket);
+	GSocketConnection * client_stream = g_socket_connection_factory_create_connection(client_socket);
+	g_object_unref(server_socket);
+	g_object_unref(client_socket);
+
+	g_dbus_connection_new(G_IO_STREAM(server_stream), guid,
+	                      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER | G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS,
+	                      NULL, NULL, connection_cb, &server_bus);
+	g_dbus_connection_new(G_IO_STREAM(client_stream), NULL,
+	                      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+	                      NULL, NULL, connection_cb, &client_bus);
+	g_object_unref(server_stream);
+	g_object_unref(client_stream);
+	g_free(guid);
+
+	while (!connection_failed && (server_bus == NULL || client_bus == NULL)) {
+		g_main_loop_run(mainloop);
+	}
+
+	if (connection_failed) {
+		return 1;
+	}
+
+	items = g_hash_table_new(g_direct_hash, g_direct_equal);
+	root = dbusmenu_menuitem_new_with_id(0);
+
+	server = dbusmenu_server_new_for_connection(server_bus, "/org/dbusmenu/replay");
+	dbusmenu_server_set_root(server, root);
+
+	client = dbusmenu_client_new_for_connection(client_bus, NULL, "/org/dbusmenu/replay");
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_LAYOUT_UPDATED, G_CALLBACK(client_layout_updated), NULL);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_ROOT_CHANGED, G_CALLBACK(client_root_changed), NULL);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_NEW_MENUITEM, G_CALLBACK(client_new_menuitem), NULL);
+	g_signal_connect(G_OBJECT(client), DBUSMENU_CLIENT_SIGNAL_EVENT_RESULT, G_CALLBACK(event_result), NULL);
+
+	current = list;
+	gdouble cpu = cpu_time();
+	gint64 begin = g_get_monotonic_time();
+	synced = applied = begin;
+
+	replay_next();
+	g_main_loop_run(mainloop);
+
+	gint64 wall = g_get_monotonic_time() - begin;
+	cpu = cpu_time() - cpu;
+
+	g_print("Replayed %d records in %.1f ms, %.1f ms of CPU\n", replayed, wall / 1000.0, cpu);
+	g_print("  (%.1f ms of that checking the client's copy)\n", checking / 1000.0);
+
+	gint i;
+	for (i = 0; i < STAT_COUNT; i++) {
+		if (stats[i].count == 0) {
+			continue;
+		}
+		g_print("  %-16s %6d  mean %8.2f ms  max %8.2f ms\n", stats[i].name, stats[i].count,
+		        stats[i].total / 1000.0 / stats[i].count, stats[i].max / 1000.0);
+	}
+
+	if (!fast) {
+		g_print("  Fell behind the recording %d times\n", behind);
+	}
+	if (lost > 0) {
+		g_print("  The client didn't catch up %d times\n", lost);
+	}
+
+	g_object_unref(client);
+	g_object_unref(server);
+	g_object_unref(root);
+	g_hash_table_destroy(items);
+	g_object_unref(client_bus);
+	g_object_unref(server_bus);
+	g_list_free_full(list, (GDestroyNotify)record_free);
+
+	return lost > 0 ? 1 : 0;
+}
+
+static void
+usage (void)
+{
+	g_printerr("dbusmenu-replay --record --dbus-name=<name> --dbus-object=<object> <file>\n");
+	g_printerr("dbusmenu-replay [--fast] <file>\n");
+	return;
+}
+
+static GOptionEntry general_options[] = {
+	{"record",        'r',  0,                        G_OPTION_ARG_NONE,      &recording, "Record the menu into the file instead of replaying it", NULL},
+	{"dbus-name",     'd',  0,                        G_OPTION_ARG_STRING,    &dbusname, "The name of the program to record (i.e. org.test.bob", "dbusname"},
+	{"dbus-object",   'o',  0,                        G_OPTION_ARG_STRING,    &dbusobject, "The path to the Dbus object (i.e /org/test/bob/alvin)", "dbusobject"},
+	{"duration",      't',  0,                        G_OPTION_ARG_INT,       &duration, "Stop recording after this many seconds instead of on Ctrl+C", "seconds"},
+	{"fast",          'f',  0,                        G_OPTION_ARG_NONE,      &fast, "Replay each record as soon as the client has caught up instead of with the recorded timing", NULL},
+	{NULL}
+};
+
+int
+main (int argc, char ** argv)
+{
+	GError * error = NULL;
+	GOptionContext * context;
+
+	context = g_option_context_new("<file> - Record and replay the traffic of a DBus Menu");
+
+	g_option_context_add_main_entries(context, general_options, "dbusmenu-replay");
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("option parsing failed: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	if (argc != 2) {
+		usage();
+		return 1;
+	}
+
+	if (recording) {
+		return record_main(argv[1]);
+	}
+
+	return replay_main(argv[1]);
+}